@@ -2,6 +2,9 @@
 
 #include "CommonLexer/Lexer.h"
 
+#include <string_view>
+#include <vector>
+
 namespace CMakeLexer
 {
 	class Lexer : public CommonLexer::Lexer
@@ -9,6 +12,17 @@ namespace CMakeLexer
 	public:
 		Lexer();
 
-		CommonLexer::MatchResult unquotedLegacyCallback(CommonLexer::MatcherState& state, CommonLexer::SourceSpan span);
+		// Splits a large source at top level command boundaries and lexes the chunks on jobs threads,
+		// the lex is the same as lexSource would give, errors included
+		CommonLexer::Lex lexSourceParallel(CommonLexer::ISource* source, std::size_t jobs = 0) const;
+
+		// Indices just past every newline outside of parentheses, bracket arguments, quoted arguments and comments
+		static std::vector<std::size_t> findCommandBoundaries(std::string_view text);
+
+		static CommonLexer::MatchResult unquotedLegacyCallback(CommonLexer::MatcherState& state, CommonLexer::SourceSpan span);
+
+	public:
+		// Chunks smaller than this cost more to hand to a job than they take to lex
+		static constexpr std::size_t s_MinChunkSize = 16 * 1024;
 	};
 } // namespace CMakeLexer
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "LineTable.h"
+#include "Source.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace CommonLexer
+{
+	// Describes one edit, m_Begin to m_Begin + m_ErasedLength was replaced by m_InsertedLength characters
+	struct SourceEdit
+	{
+	public:
+		[[nodiscard]] SourceSpan getOldSpan() const { return { m_Begin, m_Begin.m_Index + m_ErasedLength }; }
+		[[nodiscard]] SourceSpan getNewSpan() const { return { m_Begin, m_Begin.m_Index + m_InsertedLength }; }
+
+	public:
+		SourcePoint m_Begin;
+		std::size_t m_ErasedLength   = 0;
+		std::size_t m_InsertedLength = 0;
+	};
+
+	// Piece table kept in a treap ordered by position, every node caches the length, newline and codepoint count of its subtree.
+	// That makes insert, erase, line and column lookups O(log n) without ever rebuilding a line table.
+	// Reads borrow one piece at a time, so nothing is flattened after an edit.
+	class EditableSource : public ISource
+	{
+	public:
+		using ChangeCallback = std::function<void(const SourceEdit& edit)>;
+
+	public:
+		EditableSource();
+		explicit EditableSource(const std::string& str);
+		explicit EditableSource(std::string&& str);
+		EditableSource(const EditableSource&) = delete;
+		EditableSource(EditableSource&&)      = default;
+		~EditableSource();
+
+		EditableSource& operator=(const EditableSource&) = delete;
+		EditableSource& operator=(EditableSource&&) = default;
+
+		void insert(std::size_t index, std::string_view str);
+		void erase(std::size_t index, std::size_t length);
+		void setChangeCallback(ChangeCallback&& callback);
+
+		[[nodiscard]] std::size_t getNumPieces() const;
+
+		virtual std::size_t                     getSize() override;
+		virtual std::size_t                     getNumLines() override;
+		virtual std::size_t                     getIndexFromLineNumber(std::size_t line) override;
+		virtual std::size_t                     getLineNumberFromIndex(std::size_t index) override;
+		virtual std::size_t                     getColumnNumberFromIndex(std::size_t index) override;
+		virtual std::size_t                     getCodepointCount(SourceSpan span) override;
+		virtual SourceBlock                     getBlock(std::size_t index) override;
+		virtual std::string                     getSpan(std::size_t index, std::size_t length) override;
+		virtual std::string                     getLine(std::size_t line) override;
+		virtual std::vector<std::string>        getLines(std::size_t startLine, std::size_t lines) override;
+
+	private:
+		struct Piece
+		{
+		public:
+			bool        m_Added;
+			std::size_t m_Start;
+			std::size_t m_Length;
+			std::size_t m_Newlines;
+			std::size_t m_Codepoints;
+		};
+
+		struct PieceNode
+		{
+		public:
+			Piece         m_Piece;
+			std::uint32_t m_Priority;
+			std::size_t   m_Length;
+			std::size_t   m_Newlines;
+			std::size_t   m_Codepoints;
+
+			std::unique_ptr<PieceNode> m_Left;
+			std::unique_ptr<PieceNode> m_Right;
+		};
+
+	private:
+		std::unique_ptr<PieceNode> createNode(bool added, std::size_t start, std::size_t length);
+
+		void split(std::unique_ptr<PieceNode> node, std::size_t index, std::unique_ptr<PieceNode>& left, std::unique_ptr<PieceNode>& right);
+
+		std::unique_ptr<PieceNode> merge(std::unique_ptr<PieceNode> left, std::unique_ptr<PieceNode> right);
+
+		void appendSpan(const PieceNode* node, std::size_t index, std::size_t length, std::string& str) const;
+
+		std::size_t getCodepointsBefore(std::size_t index) const;
+		std::size_t getPieceCodepoints(const Piece& piece, std::size_t begin, std::size_t end) const;
+
+		std::size_t getNewlinesBefore(const Piece& piece, std::size_t offset) const;
+
+		std::string_view getBuffer(const Piece& piece) const { return piece.m_Added ? std::string_view { m_Added } : std::string_view { m_Original }; }
+		const LineTable& getBufferLines(const Piece& piece) const { return piece.m_Added ? m_AddedLines : m_OriginalLines; }
+
+		void update(PieceNode* node);
+		void notify(const SourceEdit& edit);
+
+	private:
+		std::string m_Original;
+		std::string m_Added;
+		LineTable   m_OriginalLines;
+		LineTable   m_AddedLines;
+
+		std::unique_ptr<PieceNode> m_Root;
+		std::uint32_t              m_Seed;
+
+		ChangeCallback m_ChangeCallback;
+	};
+} // namespace CommonLexer
\ No newline at end of file
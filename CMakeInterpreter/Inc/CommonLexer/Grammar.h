@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Lexer.h"
+#include "Matchers.h"
+#include "Rule.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace CommonLexer
+{
+	enum class EGrammarOp : std::uint8_t
+	{
+		Text,
+		Regex,
+		Reference,
+		NamedGroup,
+		NamedGroupReference,
+		Space,
+		Negative,
+		Optional,
+		Range,
+		Combination,
+		Or,
+		Ordered,
+		Cut
+	};
+
+	// A matcher before it is built, plain data so the grammar can be rewritten first
+	struct GrammarNode
+	{
+	public:
+		[[nodiscard]] std::size_t getSize() const;
+
+		bool operator==(const GrammarNode& other) const = default;
+
+	public:
+		EGrammarOp               m_Op             = EGrammarOp::Combination;
+		std::string              m_Text           = {};
+		std::size_t              m_LowerBounds    = 0;
+		std::size_t              m_UpperBounds    = ~0ULL;
+		bool                     m_Forced         = false;
+		ESpaceMethod             m_SpaceMethod    = ESpaceMethod::Normal;
+		ESpaceDirection          m_SpaceDirection = ESpaceDirection::Right;
+		std::vector<GrammarNode> m_Children       = {};
+	};
+
+	struct GrammarRule
+	{
+	public:
+		std::string            m_Name       = {};
+		GrammarNode            m_Matcher    = {};
+		CallbackRule::Callback m_Callback   = {};
+		bool                   m_CreateNode = true;
+		bool                   m_Memoize    = false;
+	};
+
+	struct GrammarStats
+	{
+	public:
+		std::size_t m_Rules    = 0;
+		std::size_t m_Matchers = 0;
+	};
+
+	struct GrammarOptimizeStats
+	{
+	public:
+		GrammarStats m_Before;
+		GrammarStats m_After;
+		std::size_t  m_Inlined   = 0;
+		std::size_t  m_Flattened = 0;
+		std::size_t  m_Merged    = 0;
+		std::size_t  m_Factored  = 0;
+		std::size_t  m_Removed   = 0;
+		double       m_Seconds   = 0.0;
+	};
+
+	class Grammar
+	{
+	public:
+		void setMainRule(std::string_view mainRule) { m_MainRule = mainRule; }
+		void addRule(GrammarRule&& rule);
+
+		[[nodiscard]] auto& getMainRule() const { return m_MainRule; }
+		[[nodiscard]] auto& getRules() const { return m_Rules; }
+		[[nodiscard]] bool  hasRule(std::string_view name) const;
+
+		[[nodiscard]] GrammarStats getStats() const;
+
+		// Inlines nodeless rules, flattens nested sequences and alternatives, merges adjacent texts, left factors alternatives and removes unreachable rules.
+		// Every input still lexes to the same nodes, only which of several failures gets reported can change.
+		GrammarOptimizeStats optimize();
+
+		// Builds and registers every rule, then hashes the grammar of the lexer from every rule it has.
+		// When steps is set every matcher adds its calls to it, so only lex on one thread then.
+		void registerRules(Lexer& lexer, std::size_t* steps = nullptr) const;
+
+	private:
+		void inlineRules(GrammarOptimizeStats& stats);
+		void simplify(GrammarNode& node, std::string_view rule, GrammarOptimizeStats& stats);
+		void removeDeadRules(GrammarOptimizeStats& stats);
+
+	private:
+		std::string                                  m_MainRule;
+		std::vector<GrammarRule>                     m_Rules;
+		std::unordered_map<std::string, std::size_t> m_RuleIndices;
+	};
+} // namespace CommonLexer
\ No newline at end of file
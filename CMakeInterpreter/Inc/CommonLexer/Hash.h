@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+#include <string_view>
+
+namespace CommonLexer::Hash
+{
+	// Finalizer of splitmix64, every input bit affects every output bit
+	[[nodiscard]] constexpr std::uint64_t Mix(std::uint64_t value)
+	{
+		value ^= value >> 30;
+		value *= 0xBF58476D1CE4E5B9ULL;
+		value ^= value >> 27;
+		value *= 0x94D049BB133111EBULL;
+		value ^= value >> 31;
+		return value;
+	}
+
+	// Folds value into seed, for hashes made of several fields
+	[[nodiscard]] constexpr std::uint64_t Combine(std::uint64_t seed, std::uint64_t value)
+	{
+		return Mix(seed ^ (value + 0x9E3779B97F4A7C15ULL));
+	}
+
+	// Hashes eight bytes at a time, good for cache keys but not against inputs crafted to collide
+	[[nodiscard]] std::uint64_t Bytes(std::string_view data, std::uint64_t seed = 0);
+} // namespace CommonLexer::Hash
\ No newline at end of file
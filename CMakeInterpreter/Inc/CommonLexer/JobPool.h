@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CommonLexer
+{
+	// Runs jobs on a fixed set of workers, every worker has a queue of its own and steals from the others once it runs dry.
+	// Jobs are pushed round robin and the thread waiting for them helps out, so a pool of one worker still has two threads lexing.
+	class JobPool
+	{
+	public:
+		using Job = std::function<void()>;
+
+	public:
+		// A worker count of 0 uses one less than the hardware threads, leaving the last one to the waiting thread
+		explicit JobPool(std::size_t workers = 0);
+		JobPool(const JobPool&) = delete;
+		JobPool(JobPool&&)      = delete;
+		~JobPool();
+
+		JobPool& operator=(const JobPool&) = delete;
+		JobPool& operator=(JobPool&&)      = delete;
+
+		void push(Job&& job);
+		// Runs queued jobs on the calling thread until every job pushed so far has finished
+		void wait();
+
+		[[nodiscard]] std::size_t getWorkerCount() const { return m_Workers.size(); }
+
+	private:
+		struct Queue
+		{
+		public:
+			std::mutex      m_Mutex;
+			std::deque<Job> m_Jobs;
+		};
+
+	private:
+		// Takes from the back of its own queue and from the front of the others, so thieves take the oldest jobs
+		bool runOne(std::size_t queue);
+		void work(std::size_t queue);
+
+	private:
+		std::vector<std::unique_ptr<Queue>> m_Queues;
+		std::vector<std::thread>            m_Workers;
+		std::atomic<std::size_t>            m_NextQueue = 0;
+
+		std::mutex              m_Mutex;
+		std::condition_variable m_JobsAvailable;
+		std::condition_variable m_JobsDone;
+		std::size_t             m_Queued  = 0;
+		std::size_t             m_Pending = 0;
+		bool                    m_Stop    = false;
+	};
+} // namespace CommonLexer
\ No newline at end of file
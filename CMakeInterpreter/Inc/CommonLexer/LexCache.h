@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Lexer.h"
+
+#include <cstdint>
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace CommonLexer
+{
+	// Keeps lexes in a directory, one binary file per source named after the hash of its content and the grammar hash of the lexer.
+	// An edited source or grammar hashes to another name, so stale files are never read, they are only left behind.
+	class LexCache
+	{
+	public:
+		// Bump whenever the layout of the files changes
+		static constexpr std::uint32_t s_Version        = 2;
+		// Bump whenever a matcher or callback of this library matches differently, the grammar hash only sees what the matchers are made of
+		static constexpr std::uint64_t s_LibraryVersion = 1;
+
+	public:
+		explicit LexCache(const std::filesystem::path& directory);
+
+		// Maps the file of the source if there is one, the duration of the lex is how long loading took
+		std::optional<Lex> load(const Lexer& lexer, ISource* source) const;
+		// Returns false if the lexer has no grammar hash or the file couldn't be written, the directory is created as needed
+		bool store(const Lex& lex) const;
+		// Loads the lex of the source or lexes and stores it
+		Lex lexSource(const Lexer& lexer, ISource* source) const;
+
+		[[nodiscard]] auto&   getDirectory() const { return m_Directory; }
+		std::filesystem::path getPath(std::uint64_t contentHash, std::uint64_t grammarHash) const;
+
+		static std::uint64_t hashSource(ISource* source);
+		// The file format without a directory, deserialize returns nothing if the data is damaged or belongs to another source or grammar
+		static std::string        serialize(const Lex& lex);
+		static std::optional<Lex> deserialize(const Lexer& lexer, ISource* source, std::string_view data);
+
+	private:
+		std::filesystem::path m_Directory;
+	};
+} // namespace CommonLexer
\ No newline at end of file
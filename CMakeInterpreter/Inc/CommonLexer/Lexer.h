@@ -1,22 +1,62 @@
 #pragma once
 
+#include "EditableSource.h"
 #include "Message.h"
 #include "Node.h"
 #include "Rule.h"
 #include "Source.h"
 
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <span>
+#include <string_view>
 #include <unordered_map>
 
 namespace CommonLexer
 {
+	struct MemoEntry
+	{
+	public:
+		MatchResult          m_Result;
+		std::vector<Node>    m_Nodes;
+		std::vector<Message> m_Messages;
+	};
+
+	struct MemoStats
+	{
+	public:
+		[[nodiscard]] double getHitRate() const;
+
+	public:
+		std::string m_Rule;
+		std::size_t m_Hits      = 0;
+		std::size_t m_Misses    = 0;
+		std::size_t m_Entries   = 0;
+		std::size_t m_Bytes     = 0;
+		std::size_t m_PeakBytes = 0;
+	};
+
+	// A top level element of the main rule ended at m_Index with m_Nodes children on the root, matching can restart there
+	struct RestartPoint
+	{
+	public:
+		std::size_t m_Index = 0;
+		std::size_t m_Nodes = 0;
+	};
+
 	struct Lex
 	{
 	public:
-		explicit Lex(Lexer& lexer);
-		Lex(Lexer& lexer, ISource* source);
+		explicit Lex(const Lexer& lexer);
+		Lex(const Lexer& lexer, ISource* source);
 
 		void setSource(ISource* source);
 		void setMessages(std::vector<Message>&& messages);
+		void setFarthestFailure(std::optional<Message>&& failure);
+		void setMemoStats(const MemoStats& stats, std::vector<MemoStats>&& ruleStats);
+		void setDuration(std::chrono::duration<double> duration);
+		void setRestartPoints(std::vector<RestartPoint>&& points);
 
 		[[nodiscard]] auto  getLexer() const { return m_Lexer; }
 		[[nodiscard]] auto  getSource() const { return m_Source; }
@@ -24,41 +64,168 @@ namespace CommonLexer
 		[[nodiscard]] auto& getRoot() const { return m_Root; }
 		[[nodiscard]] auto& getMessages() { return m_Messages; }
 		[[nodiscard]] auto& getMessages() const { return m_Messages; }
+		// The failure that got the farthest into the source, even if the alternative it came from was discarded
+		[[nodiscard]] auto& getFarthestFailure() const { return m_FarthestFailure; }
+		[[nodiscard]] auto& getMemoStats() const { return m_MemoStats; }
+		// Sorted by rule name
+		[[nodiscard]] auto& getRuleMemoStats() const { return m_RuleMemoStats; }
+		// How long matching took, so batches can report every file on its own
+		[[nodiscard]] auto  getDuration() const { return m_Duration; }
+		// Sorted by index, empty if the main rule doesn't add its elements to the root
+		[[nodiscard]] auto& getRestartPoints() const { return m_RestartPoints; }
 
 	private:
-		Lexer*               m_Lexer;
-		ISource*             m_Source;
-		Node                 m_Root;
-		std::vector<Message> m_Messages;
+		const Lexer*           m_Lexer;
+		ISource*               m_Source;
+		Node                   m_Root;
+		std::vector<Message>   m_Messages;
+		std::optional<Message> m_FarthestFailure;
+		MemoStats              m_MemoStats;
+		std::vector<MemoStats> m_RuleMemoStats;
+
+		std::chrono::duration<double> m_Duration {};
+		std::vector<RestartPoint>     m_RestartPoints;
+	};
+
+	// Everything that changes while lexing one source, shared by all matcher states of that lex
+	struct LexState
+	{
+	public:
+		// Called by matchers for every failure, only the farthest one is kept
+		void noteFailure(const Message& message);
+
+		void       setGroupedValue(const std::string& group, SourceSpan span);
+		void       setGroupedValue(std::string&& group, SourceSpan span);
+		SourceSpan getGroupedValue(const std::string& group) const;
+
+		// Memo entries are keyed by (key, span), key is any address unique to the rule
+		const MemoEntry*       findMemo(const void* key, std::string_view rule, SourceSpan span);
+		void                   storeMemo(const void* key, SourceSpan span, MemoEntry&& entry);
+		std::vector<MemoStats> getRuleMemoStats() const;
+
+		// Called for every top level element matched, backtracking drops the points past index
+		void noteRestartPoint(const Node* parent, std::size_t index);
+		// An incremental lex stops matching top level elements where they line up with the previous lex again
+		[[nodiscard]] bool isStopPoint(std::size_t index) const;
+
+	public:
+		const Node*            m_Root = nullptr;
+		std::optional<Message> m_FarthestFailure;
+		MemoStats              m_MemoStats;
+
+		std::vector<RestartPoint> m_RestartPoints;
+		// Restart points of the previous lex, m_StopOffset is added to them to get indices in the edited source
+		std::span<const RestartPoint> m_StopPoints;
+		std::ptrdiff_t                m_StopOffset = 0;
+
+	private:
+		struct MemoKey
+		{
+		public:
+			bool operator==(const MemoKey& other) const = default;
+
+		public:
+			const void* m_Rule;
+			std::size_t m_Begin;
+			std::size_t m_End;
+		};
+
+		struct MemoKeyHash
+		{
+		public:
+			std::size_t operator()(const MemoKey& key) const;
+		};
+
+	private:
+		std::unordered_map<std::string, SourceSpan> m_GroupedValues;
+
+		std::unordered_map<MemoKey, MemoEntry, MemoKeyHash> m_Memo;
+		std::unordered_map<const void*, MemoStats>          m_RuleMemoStats;
+		std::size_t                                         m_MemoBytes = 0;
 	};
 
 	class Lexer
 	{
 	public:
+		// Interned before any other name, so the root node of every lex has this ID
+		static constexpr RuleID s_RootRule = 1;
+
+	public:
+		Lexer();
+
+		// Only reads the lexer, so once it is linked any number of threads can lex with it at once
+		Lex lexSource(ISource* source) const;
+		Lex lexSource(ISource* source, SourceSpan span) const;
+		// Links first if rules were registered or the main rule was set since
 		Lex lexSource(ISource* source);
 		Lex lexSource(ISource* source, SourceSpan span);
+		// Lexes every source on a job pool of its own and returns the lexes in the order of the sources.
+		// A job count of 0 uses every hardware thread, 1 lexes on the calling thread only.
+		std::vector<Lex> lexSources(std::span<ISource* const> sources, std::size_t jobs = 0) const;
+		std::vector<Lex> lexSources(std::span<ISource* const> sources, std::size_t jobs = 0);
+		// Lexes the spans between the boundaries on a job pool and joins their nodes in order, every boundary has to be a place the main rule repeats at.
+		// Each chunk stops at its boundary but reads past it where a serial lex would, so their messages and farthest failures add up to the serial ones.
+		// Falls back to lexing the whole source on the calling thread if a span stops short, so errors are reported exactly where a serial lex reports them.
+		Lex lexSourceSplit(ISource* source, std::span<const std::size_t> boundaries, std::size_t jobs = 0) const;
+		Lex lexSourceSplit(ISource* source, std::span<const std::size_t> boundaries, std::size_t jobs = 0);
+		// Lexes the source of previous again after the edits, in the order they were made. Top level elements before the first edit are kept,
+		// matching restarts after the last of them and stops once the elements line up with previous again, the rest of previous is moved over.
+		// Lexes the whole source if previous didn't get to the end of its source or the edited source doesn't lex to the end.
+		Lex relexSource(Lex&& previous, std::span<const SourceEdit> edits) const;
+		Lex relexSource(Lex&& previous, std::span<const SourceEdit> edits);
 
 		template <Rule Rule>
 		void   registerRule(Rule&& rule);
 		void   registerRule(std::unique_ptr<IRule>&& rule);
-		IRule* getRule(const std::string& rule);
+		IRule* getRule(std::string_view rule) const;
+		IRule* getRule(RuleID rule) const;
 		void   setMainRule(const std::string& mainRule);
+		// Resolves every reference and the first sets, then reports undefined, unused and left recursive rules.
+		// lexSource does this itself whenever rules were registered or the main rule was set since, undefined references then only fail when reached.
+		std::vector<Message> link();
+		// Resolves the first sets of every rule, links first if rules were registered or the main rule was set since
+		void                 computeFirstSets();
+		// What link resolves a reference to an undefined rule to, it fails with a missing rule message
+		IRule*               getMissingRule(std::string_view rule);
 
-		void       setGroupedValue(const std::string& group, SourceSpan span);
-		void       setGroupedValue(std::string&& group, SourceSpan span);
-		SourceSpan getGroupedValue(const std::string& group) const;
+		// Interns the name, rules and nodes refer to it by the returned ID
+		RuleID                           getRuleID(std::string_view rule);
+		[[nodiscard]] const std::string& getRuleName(RuleID rule) const { return m_RuleNames[rule]; }
+		[[nodiscard]] std::size_t        getRuleNameCount() const { return m_RuleNames.size(); }
+
+		[[nodiscard]] auto isLinked() const { return !m_LinkDirty; }
+		// The reference the main rule repeats, set by link when the main rule is nothing but that repetition.
+		// Its matches are the top level elements, streaming sources commit after them and incremental lexes restart at them.
+		[[nodiscard]] auto getTopLevelReference() const { return m_TopLevelReference; }
+
+		// Identifies the rules for caches of lexes. 0 means nothing set one and lexes aren't cached, registering a rule or setting the main rule clears it again.
+		void               setGrammarHash(std::uint64_t hash) { m_GrammarHash = hash; }
+		[[nodiscard]] auto getGrammarHash() const { return m_GrammarHash; }
+		// Sets the grammar hash from the main rule and the matchers of every rule, call it once all rules are registered
+		void               hashGrammar();
+
+	private:
+		// Top level elements aren't matched at the stop points, lexSourceSplit stops its chunks there while their matchers still see the text past them
+		Lex lexSource(ISource* source, SourceSpan span, std::span<const RestartPoint> stopPoints) const;
 
 	private:
 		std::string m_MainRule;
 
 		std::vector<std::unique_ptr<IRule>> m_Rules;
+		std::vector<std::unique_ptr<IRule>> m_MissingRules;
+		bool                                m_LinkDirty         = true;
+		std::uint64_t                       m_GrammarHash       = 0;
+		const IMatcher*                     m_TopLevelReference = nullptr;
 
-		std::unordered_map<std::string, SourceSpan> m_GroupedValues;
+		// A deque so the views used as keys stay valid as names are added
+		std::deque<std::string>                      m_RuleNames;
+		std::unordered_map<std::string_view, RuleID> m_RuleIDs;
+		std::vector<IRule*>                          m_RulesByID;
 	};
 
 	template <Rule Rule>
 	void Lexer::registerRule(Rule&& rule)
 	{
-		m_Rules.push_back(std::make_unique<Rule>(std::move(rule)));
+		registerRule(std::unique_ptr<IRule> { std::make_unique<Rule>(std::move(rule)) });
 	}
 } // namespace CommonLexer
\ No newline at end of file
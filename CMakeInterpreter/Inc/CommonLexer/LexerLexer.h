@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Grammar.h"
 #include "Lexer.h"
 #include "Message.h"
 
@@ -9,12 +10,16 @@
 
 namespace CommonLexer
 {
+	// Strips the quotes of a text or regex matcher literal and resolves its escapes
+	std::string UnescapeText(std::string&& text);
+
 	struct LexerLexerResult
 	{
 	public:
 		std::vector<Message> m_Messages;
 
-		Lexer m_Lexer;
+		Lexer                m_Lexer;
+		GrammarOptimizeStats m_OptimizeStats;
 	};
 
 	struct LexerCPPResult
@@ -32,7 +37,8 @@ namespace CommonLexer
 	public:
 		LexerLexer();
 
-		LexerLexerResult createLexer(const Lex& lex, std::unordered_map<std::string, CallbackRule::Callback> callbacks = {});
+		Grammar          createGrammar(const Lex& lex, std::vector<Message>& messages, std::unordered_map<std::string, CallbackRule::Callback> callbacks = {});
+		LexerLexerResult createLexer(const Lex& lex, std::unordered_map<std::string, CallbackRule::Callback> callbacks = {}, bool optimize = true);
 
 		LexerCPPResult createCPPLexer(const Lex& lex);
 		std::string    compileLexer(LexerCPPResult& result, std::string_view namespaceName);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "UTF8.h"
+
+#include <cstddef>
+
+#include <string_view>
+#include <vector>
+
+namespace CommonLexer
+{
+	// Line start indices of a source, lines are 1 based and ~0ULL is returned for anything out of range.
+	// Columns count codepoints, the codepoint table is built in the same pass so they stay O(1) within a line.
+	class LineTable
+	{
+	public:
+		void build(std::string_view str);
+		// Scans str which starts at offset in the source, chunks have to be appended in order
+		void append(std::string_view str, std::size_t offset);
+		void clear();
+
+		[[nodiscard]] bool        empty() const { return m_LineToIndex.empty(); }
+		[[nodiscard]] std::size_t getNumLines() const { return m_LineToIndex.size(); }
+		[[nodiscard]] std::size_t getIndexFromLineNumber(std::size_t line) const;
+		[[nodiscard]] std::size_t getLineNumberFromIndex(std::size_t index) const;
+		[[nodiscard]] std::size_t getColumnNumberFromIndex(std::size_t index) const;
+
+		[[nodiscard]] const CodepointTable& getCodepoints() const { return m_Codepoints; }
+
+		// Returns the line without its trailing newline
+		[[nodiscard]] std::string_view getLine(std::string_view str, std::size_t line) const;
+
+	private:
+		void scanNewlines(std::string_view str, std::size_t offset);
+
+	private:
+		std::vector<std::size_t> m_LineToIndex;
+		CodepointTable           m_Codepoints;
+	};
+} // namespace CommonLexer
\ No newline at end of file
@@ -4,26 +4,49 @@
 #include "Node.h"
 #include "Source.h"
 
+#include <cstdint>
+
+#include <bitset>
 #include <vector>
 
 namespace CommonLexer
 {
 	class Lexer;
 	struct IRule;
+	struct LexState;
 
+	// The lexer and its rules are only read while matching, everything a lex changes goes through the lex state,
+	// so any number of sources can be lexed with the same lexer at once
 	struct MatcherState
 	{
 	public:
 		std::vector<Message> m_Messages;
 		Node*                m_ParentNode;
 
-		Lexer* m_Lexer;
+		const Lexer* m_Lexer;
+		LexState*    m_LexState;
 
 		ISource*   m_Source;
 		SourceSpan m_SourceSpan;
 
-		IRule*      m_CurrentRule;
-		SourcePoint m_RuleBegin;
+		const IRule* m_CurrentRule;
+		SourcePoint  m_RuleBegin;
+
+		// Set by a cut, the innermost choice around it then tries no further alternatives. Rules and repetitions start without one.
+		bool m_Cut = false;
+	};
+
+	// Handed to the matchers of one rule by Lexer::link
+	struct LinkState
+	{
+	public:
+		Lexer*                m_Lexer;
+		IRule*                m_CurrentRule;
+		std::vector<Message>* m_Messages;
+		// Every rule the current rule references
+		std::vector<IRule*> m_References;
+		// Whether the current rule sets or reads a named group itself
+		bool m_UsesNamedGroups = false;
 	};
 
 	enum class EMatchStatus
@@ -42,13 +65,47 @@ namespace CommonLexer
 		SourceSpan   m_Span;
 	};
 
+	// Bytes a match can start with, a nullable matcher may also succeed without consuming anything
+	struct FirstSet
+	{
+	public:
+		static constexpr std::size_t s_EOF = 256;
+
+	public:
+		static FirstSet Any();
+
+		[[nodiscard]] bool canStartWith(std::size_t c) const { return m_Nullable || (c < s_EOF && m_Bytes.test(c)); }
+
+		void add(const FirstSet& other);
+
+		bool operator==(const FirstSet& other) const = default;
+
+	public:
+		std::bitset<256> m_Bytes;
+		bool             m_Nullable = false;
+	};
+
 	struct IMatcher
 	{
 	public:
 		virtual ~IMatcher() = default;
 
-		virtual void        cleanUp()                                   = 0;
-		virtual MatchResult match(MatcherState& state, SourceSpan span) = 0;
+		// Called once by Lexer::link before anything is matched, resolves whatever the matcher refers to
+		virtual void        link(LinkState& state)                            = 0;
+		virtual MatchResult match(MatcherState& state, SourceSpan span) const = 0;
+
+		// Called until the first sets of all rules stop changing, matchers that can't tell have to assume anything
+		virtual FirstSet computeFirstSet([[maybe_unused]] Lexer& lexer) { return FirstSet::Any(); }
+		// Adds the rules that can be entered before any input is consumed and returns whether this can match nothing, called once first sets are resolved
+		virtual bool collectLeftRules(Lexer& lexer, [[maybe_unused]] std::vector<IRule*>& rules) { return computeFirstSet(lexer).m_Nullable; }
+
+		// Folds everything deciding what the matcher matches into seed, referenced rules only by name. Lexer::hashGrammar builds the grammar hash from it.
+		[[nodiscard]] virtual std::uint64_t hash(std::uint64_t seed) const = 0;
+
+		// The reference this matches with nothing but spaces around it, and the one this repeats that way.
+		// Only a main rule repeating a single reference never backtracks over its top level elements, so only its elements are committed.
+		[[nodiscard]] virtual const IMatcher* getSoleReference() const { return nullptr; }
+		[[nodiscard]] virtual const IMatcher* getRepeatedReference() const { return nullptr; }
 	};
 
 	template <class T>
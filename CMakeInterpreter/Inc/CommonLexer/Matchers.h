@@ -1,11 +1,16 @@
 #pragma once
 
 #include "Matcher.h"
+#include "Regex.h"
 #include "Rule.h"
 #include "Tuple.h"
 
+#include <array>
+#include <bitset>
 #include <memory>
-#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace CommonLexer
 {
@@ -20,25 +25,38 @@ namespace CommonLexer
 		CombinationMatcher(Tuple<Matchers...>&& matchers);
 		CombinationMatcher(std::vector<std::unique_ptr<IMatcher>>&& matchers);
 
-		virtual void        cleanUp() override;
-		virtual MatchResult match(MatcherState& state, SourceSpan span) override;
+		virtual void          link(LinkState& state) override;
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet      computeFirstSet(Lexer& lexer) override;
+		virtual bool          collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules) override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
 
 	private:
 		std::vector<std::unique_ptr<IMatcher>> m_Matchers;
 	};
 
+	// Keeps the longest match, or when ordered the first success, either way a cut stops it from trying the alternatives after
 	struct OrMatcher final : public IMatcher
 	{
 	public:
 		template <Matcher... Matchers>
-		OrMatcher(Tuple<Matchers...>&& matchers);
-		OrMatcher(std::vector<std::unique_ptr<IMatcher>>&& matchers);
+		OrMatcher(Tuple<Matchers...>&& matchers, bool ordered = false);
+		OrMatcher(std::vector<std::unique_ptr<IMatcher>>&& matchers, bool ordered = false);
 
-		virtual void        cleanUp() override;
-		virtual MatchResult match(MatcherState& state, SourceSpan span) override;
+		virtual void          link(LinkState& state) override;
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet      computeFirstSet(Lexer& lexer) override;
+		virtual bool          collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules) override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
 
 	private:
 		std::vector<std::unique_ptr<IMatcher>> m_Matchers;
+		bool                                   m_Ordered;
+
+		// Indices of the matchers that can start with each byte, FirstSet::s_EOF holds the ones that can match at the end
+		std::vector<std::uint16_t>                     m_Dispatch;
+		std::array<std::uint32_t, FirstSet::s_EOF + 2> m_DispatchOffsets {};
+		bool                                           m_HasDispatch = false;
 	};
 
 	//---------
@@ -52,8 +70,12 @@ namespace CommonLexer
 		RangeMatcher(Matcher&& matcher, std::size_t lowerBounds = 0, std::size_t upperBounds = ~0ULL);
 		RangeMatcher(std::unique_ptr<IMatcher>&& matcher, std::size_t lowerBounds = 0, std::size_t upperBounds = ~0ULL);
 
-		virtual void        cleanUp() override;
-		virtual MatchResult match(MatcherState& state, SourceSpan span) override;
+		virtual void            link(LinkState& state) override;
+		virtual MatchResult     match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet        computeFirstSet(Lexer& lexer) override;
+		virtual bool            collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules) override;
+		virtual std::uint64_t   hash(std::uint64_t seed) const override;
+		virtual const IMatcher* getRepeatedReference() const override { return m_Matcher->getSoleReference(); }
 
 	private:
 		std::unique_ptr<IMatcher> m_Matcher;
@@ -67,8 +89,11 @@ namespace CommonLexer
 		OptionalMatcher(Matcher&& matcher);
 		OptionalMatcher(std::unique_ptr<IMatcher>&& matcher);
 
-		virtual void        cleanUp() override;
-		virtual MatchResult match(MatcherState& state, SourceSpan span) override;
+		virtual void          link(LinkState& state) override;
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet      computeFirstSet(Lexer& lexer) override;
+		virtual bool          collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules) override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
 
 	private:
 		std::unique_ptr<IMatcher> m_Matcher;
@@ -81,8 +106,11 @@ namespace CommonLexer
 		NegativeMatcher(Matcher&& matcher);
 		NegativeMatcher(std::unique_ptr<IMatcher>&& matcher);
 
-		virtual void        cleanUp() override;
-		virtual MatchResult match(MatcherState& state, SourceSpan span) override;
+		virtual void          link(LinkState& state) override;
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet      computeFirstSet(Lexer& lexer) override;
+		virtual bool          collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules) override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
 
 	private:
 		std::unique_ptr<IMatcher> m_Matcher;
@@ -112,11 +140,15 @@ namespace CommonLexer
 		SpaceMatcher(Matcher&& matcher, bool forced = false, ESpaceMethod method = ESpaceMethod::Normal, ESpaceDirection direction = ESpaceDirection::Right);
 		SpaceMatcher(std::unique_ptr<IMatcher>&& matcher, bool forced = false, ESpaceMethod method = ESpaceMethod::Normal, ESpaceDirection direction = ESpaceDirection::Right);
 
-		virtual void        cleanUp() override;
-		virtual MatchResult match(MatcherState& state, SourceSpan span) override;
+		virtual void            link(LinkState& state) override;
+		virtual MatchResult     match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet        computeFirstSet(Lexer& lexer) override;
+		virtual bool            collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules) override;
+		virtual std::uint64_t   hash(std::uint64_t seed) const override;
+		virtual const IMatcher* getSoleReference() const override { return m_Matcher->getSoleReference(); }
 
-		bool        isSpace(char c);
-		MatchResult matchSpaces(MatcherState& state, SourceSpan span);
+		bool        isSpace(char c) const;
+		MatchResult matchSpaces(MatcherState& state, SourceSpan span) const;
 
 	private:
 		std::unique_ptr<IMatcher> m_Matcher;
@@ -139,8 +171,11 @@ namespace CommonLexer
 		NamedGroupMatcher(const std::string& name, std::unique_ptr<IMatcher>&& matcher);
 		NamedGroupMatcher(std::string&& name, std::unique_ptr<IMatcher>&& matcher);
 
-		virtual void        cleanUp() override;
-		virtual MatchResult match(MatcherState& state, SourceSpan span) override;
+		virtual void          link(LinkState& state) override;
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet      computeFirstSet(Lexer& lexer) override;
+		virtual bool          collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules) override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
 
 	private:
 		std::string               m_Name;
@@ -153,21 +188,36 @@ namespace CommonLexer
 		NamedGroupReferenceMatcher(const std::string& name);
 		NamedGroupReferenceMatcher(std::string&& name);
 
-		virtual void        cleanUp() override {}
-		virtual MatchResult match(MatcherState& state, SourceSpan span) override;
+		virtual void          link(LinkState& state) override;
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
 
 	private:
 		std::string m_Name;
 	};
 
+	// Matches nothing and commits the alternative it is in
+	struct CutMatcher final : public IMatcher
+	{
+	public:
+		virtual void          link([[maybe_unused]] LinkState& state) override {}
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet      computeFirstSet(Lexer& lexer) override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
+	};
+
 	struct ReferenceMatcher final : public IMatcher
 	{
 	public:
 		ReferenceMatcher(const std::string& name);
 		ReferenceMatcher(std::string&& name);
 
-		virtual void        cleanUp() override;
-		virtual MatchResult match(MatcherState& state, SourceSpan span) override;
+		virtual void            link(LinkState& state) override;
+		virtual MatchResult     match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet        computeFirstSet(Lexer& lexer) override;
+		virtual bool            collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules) override;
+		virtual std::uint64_t   hash(std::uint64_t seed) const override;
+		virtual const IMatcher* getSoleReference() const override { return this; }
 
 	private:
 		std::string m_Name;
@@ -181,24 +231,109 @@ namespace CommonLexer
 		TextMatcher(const std::string& text);
 		TextMatcher(std::string&& text);
 
-		virtual void        cleanUp() override {}
-		virtual MatchResult match(MatcherState& state, SourceSpan span) override;
+		virtual void          link([[maybe_unused]] LinkState& state) override {}
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet      computeFirstSet(Lexer& lexer) override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
 
 	private:
 		std::string m_Text;
 	};
 
+	// Longest match over a set of literals, equivalent to an OrMatcher of TextMatchers but walking a single trie
+	struct LiteralSetMatcher final : public IMatcher
+	{
+	public:
+		LiteralSetMatcher(std::vector<std::string>&& literals);
+
+		virtual void          link([[maybe_unused]] LinkState& state) override {}
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet      computeFirstSet(Lexer& lexer) override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
+
+		// Generated lexers have no current rule, so they pass the rule name for messages themselves
+		MatchResult matchLiterals(MatcherState& state, SourceSpan span, std::string_view rule) const;
+
+		[[nodiscard]] auto& getLiterals() const { return m_Literals; }
+		[[nodiscard]] auto  getNumStates() const { return m_Accepts.size(); }
+
+	private:
+		std::vector<std::string> m_Literals;
+
+		// State 0 is dead and state 1 the root, bytes with identical transitions in every state share a class and class 0 always leads to the dead state
+		std::array<std::uint16_t, 256> m_ByteClasses {};
+		std::size_t                    m_NumClasses = 1;
+		std::vector<std::uint32_t>     m_Transitions;
+		std::vector<std::uint32_t>     m_Accepts;
+		std::vector<std::uint32_t>     m_FirstLiterals;
+		std::vector<std::uint32_t>     m_Branches;
+	};
+
+	// A single byte from a set, what regexes like '[^\]]' are lowered to
+	struct CharClassMatcher final : public IMatcher
+	{
+	public:
+		CharClassMatcher(const std::bitset<256>& bytes);
+
+		virtual void          link([[maybe_unused]] LinkState& state) override {}
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet      computeFirstSet(Lexer& lexer) override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
+
+		// Generated lexers have no current rule, so they pass the rule name for messages themselves
+		MatchResult matchByte(MatcherState& state, SourceSpan span, std::string_view rule) const;
+
+		[[nodiscard]] auto& getBytes() const { return m_Bytes; }
+
+	private:
+		std::bitset<256> m_Bytes;
+	};
+
+	// A run of bytes from a set, what regexes like '[ \t]+' and '[A-Za-z_][A-Za-z0-9_]*' are lowered to.
+	// Everything after the first byte is scanned 16 or 32 bytes at a time.
+	struct CharRunMatcher final : public IMatcher
+	{
+	public:
+		CharRunMatcher(const Regex::CharRun& run);
+
+		virtual void          link([[maybe_unused]] LinkState& state) override {}
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet      computeFirstSet(Lexer& lexer) override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
+
+		// Generated lexers have no current rule, so they pass the rule name for messages themselves
+		MatchResult matchRun(MatcherState& state, SourceSpan span, std::string_view rule) const;
+
+		// Returns how many bytes from the start of str are in the rest of the run
+		[[nodiscard]] std::size_t scanRest(std::string_view str) const;
+
+		[[nodiscard]] auto& getRun() const { return m_Run; }
+
+	private:
+		Regex::CharRun m_Run;
+
+		// Indexed by a byte's low nibble, bit (high nibble & 7) is set when the byte is in the rest, bytes from 0x80 use the high table
+		std::array<std::uint8_t, 16> m_LowTable {};
+		std::array<std::uint8_t, 16> m_HighTable {};
+		// The rest as inclusive ranges for SSE2, which has no byte shuffle, empty when there are too many
+		std::vector<std::pair<std::uint8_t, std::uint8_t>> m_Ranges;
+	};
+
 	struct RegexMatcher final : public IMatcher
 	{
 	public:
 		RegexMatcher(const std::string& regex);
 		RegexMatcher(std::string&& regex);
 
-		virtual void        cleanUp() override {}
-		virtual MatchResult match(MatcherState& state, SourceSpan span) override;
+		virtual void          link([[maybe_unused]] LinkState& state) override {}
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet      computeFirstSet(Lexer& lexer) override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
+
+		[[nodiscard]] auto& getRegex() const { return m_Regex; }
 
 	private:
-		std::regex m_Regex;
+		std::shared_ptr<const Regex> m_Regex;
 	};
 
 	template <Matcher... Matchers>
@@ -208,8 +343,8 @@ namespace CommonLexer
 	}
 
 	template <Matcher... Matchers>
-	OrMatcher::OrMatcher(Tuple<Matchers...>&& matchers)
-	    : m_Matchers(Details::make_unique_ptrs<IMatcher>(std::move(matchers)))
+	OrMatcher::OrMatcher(Tuple<Matchers...>&& matchers, bool ordered)
+	    : m_Matchers(Details::make_unique_ptrs<IMatcher>(std::move(matchers))), m_Ordered(ordered)
 	{
 	}
 
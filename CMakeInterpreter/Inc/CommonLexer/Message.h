@@ -2,7 +2,10 @@
 
 #include "Source.h"
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace CommonLexer
 {
@@ -12,21 +15,57 @@ namespace CommonLexer
 		Error
 	};
 
+	// Matchers report failures as codes with arguments, the text is only formatted once a message is read
+	enum class EMessageCode : std::uint8_t
+	{
+		Text,
+		ExpectedText,
+		ExpectedRule,
+		MissingRule,
+		UnexpectedByte,
+		ExpectedSpace,
+		ExpectedWhitespace,
+		ExpectedMatches,
+		RegexFailed,
+		UnexpectedSequence
+	};
+
+	// Views have to outlive the message, they point into matchers, rules or string literals
+	struct MessageArgs
+	{
+	public:
+		static constexpr std::uint16_t s_EOF = 256;
+
+	public:
+		std::string_view m_Text      = {};
+		std::string_view m_Rule      = {};
+		std::uint16_t    m_Got       = s_EOF;
+		std::size_t      m_Counts[2] = {};
+	};
+
 	struct Message
 	{
 	public:
 		Message(const std::string& message, SourcePoint point, SourceSpan span, EMessageSeverity severity = EMessageSeverity::Error);
 		Message(std::string&& message, SourcePoint point, SourceSpan span, EMessageSeverity severity = EMessageSeverity::Error);
+		Message(EMessageCode code, const MessageArgs& args, SourcePoint point, SourceSpan span, EMessageSeverity severity = EMessageSeverity::Error);
+
+		// Moves the point and span, for messages kept after an edit before them
+		void offsetPosition(std::ptrdiff_t offset);
 
-		[[nodiscard]] auto& getMessage() const { return m_Message; }
+		std::string         getMessage() const;
+		[[nodiscard]] auto  getCode() const { return m_Code; }
+		[[nodiscard]] auto& getArgs() const { return m_Args; }
 		[[nodiscard]] auto  getPoint() const { return m_Point; }
 		[[nodiscard]] auto  getSpan() const { return m_Span; }
 		[[nodiscard]] auto  getSeverity() const { return m_Severity; }
 
 	private:
 		std::string      m_Message;
+		MessageArgs      m_Args;
 		SourcePoint      m_Point;
 		SourceSpan       m_Span;
 		EMessageSeverity m_Severity;
+		EMessageCode     m_Code;
 	};
 } // namespace CommonLexer
\ No newline at end of file
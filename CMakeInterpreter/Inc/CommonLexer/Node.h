@@ -2,40 +2,54 @@
 
 #include "Source.h"
 
+#include <cstddef>
+#include <cstdint>
+
 #include <string>
+#include <string_view>
 
 namespace CommonLexer
 {
 	class Lexer;
 
+	// Dense index into the lexer's rule name table, 0 is the unnamed rule
+	using RuleID = std::uint32_t;
+
 	struct Node
 	{
 	public:
-		explicit Node(Lexer& lexer);
-		Node(Lexer& lexer, const std::string& rule);
-		Node(Lexer& lexer, std::string&& rule);
-
-		void setLexer(Lexer& lexer);
-		void setRule(const std::string& rule);
-		void setRule(std::string&& rule);
-		void setSourceSpan(ISource* source, SourceSpan span);
+		explicit Node(const Lexer& lexer);
+		Node(const Lexer& lexer, RuleID rule);
+		// Interns the name, so it needs a lexer that is not shared yet
+		Node(Lexer& lexer, std::string_view rule);
+
+		void setLexer(const Lexer& lexer);
+		void setRule(RuleID rule);
+		void setSpan(SourceSpan span);
 		void addChild(const Node& child);
 		void addChild(Node&& child);
-		void addChildren(const Node& node);
 		void addChildren(Node&& node);
+		// Only moves the children from begin to end, node keeps its moved from children
+		void addChildren(Node&& node, std::size_t begin, std::size_t end);
+		void reserveChildren(std::size_t count);
+		// Moves the span of this node and every node below it, for nodes kept after an edit before them
+		void offsetSpans(std::ptrdiff_t offset);
+		// Speculative matchers append straight into their parent and roll back to the child count they started at
+		void truncateChildren(std::size_t count);
+		void eraseChildren(std::size_t begin, std::size_t end);
 
 		Node*               getChild(std::size_t index);
 		const Node*         getChild(std::size_t index) const;
 		[[nodiscard]] auto  getLexer() const { return m_Lexer; }
-		[[nodiscard]] auto& getRule() const { return m_Rule; }
-		[[nodiscard]] auto  getSource() const { return m_Source; }
+		[[nodiscard]] auto  getRuleID() const { return m_Rule; }
+		// Resolves the rule name through the lexer
+		[[nodiscard]] const std::string& getRule() const;
 		[[nodiscard]] auto  getSpan() const { return m_Span; }
 		[[nodiscard]] auto& getChildren() const { return m_Children; }
 
 	private:
-		Lexer*            m_Lexer;
-		std::string       m_Rule;
-		ISource*          m_Source;
+		const Lexer*      m_Lexer;
+		RuleID            m_Rule = 0;
 		SourceSpan        m_Span;
 		std::vector<Node> m_Children;
 	};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Node.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace CommonLexer
+{
+	class NodeRef;
+	class NodeChildren;
+
+	// Index of a node in its arena
+	using NodeIndex = std::uint32_t;
+
+	// A lex tree flattened into parallel arrays with one entry per node in depth first order, so the root is node 0.
+	// Children are linked through first child and next sibling indices, which makes a node 32 bytes and the whole tree five allocations.
+	class NodeArena
+	{
+	public:
+		static constexpr NodeIndex s_NoNode = ~NodeIndex { 0 };
+
+	public:
+		NodeArena() = default;
+		explicit NodeArena(const Node& root);
+
+		[[nodiscard]] NodeRef     getRoot() const;
+		[[nodiscard]] NodeRef     getNode(NodeIndex index) const;
+		[[nodiscard]] auto        getLexer() const { return m_Lexer; }
+		[[nodiscard]] std::size_t size() const { return m_Rules.size(); }
+		[[nodiscard]] bool        empty() const { return m_Rules.empty(); }
+		// Bytes held by the arrays
+		[[nodiscard]] std::size_t getMemoryUsage() const;
+
+		[[nodiscard]] RuleID     getRuleID(NodeIndex index) const { return m_Rules[index]; }
+		[[nodiscard]] SourceSpan getSpan(NodeIndex index) const { return { { m_Begins[index] }, { m_Ends[index] } }; }
+		[[nodiscard]] NodeIndex  getFirstChild(NodeIndex index) const { return m_FirstChildren[index]; }
+		[[nodiscard]] NodeIndex  getNextSibling(NodeIndex index) const { return m_NextSiblings[index]; }
+
+	private:
+		NodeIndex addTree(const Node& node);
+
+	private:
+		const Lexer*             m_Lexer = nullptr;
+		std::vector<RuleID>      m_Rules;
+		std::vector<std::size_t> m_Begins;
+		std::vector<std::size_t> m_Ends;
+		std::vector<NodeIndex>   m_FirstChildren;
+		std::vector<NodeIndex>   m_NextSiblings;
+	};
+
+	// View of one node in a NodeArena, as cheap to copy as a pointer and valid as long as the arena is
+	class NodeRef
+	{
+	public:
+		NodeRef() = default;
+		NodeRef(const NodeArena* arena, NodeIndex index)
+		    : m_Arena(arena), m_Index(index) {}
+
+		[[nodiscard]] bool isValid() const { return m_Arena && m_Index != NodeArena::s_NoNode; }
+		[[nodiscard]] explicit operator bool() const { return isValid(); }
+
+		[[nodiscard]] auto getArena() const { return m_Arena; }
+		[[nodiscard]] auto getIndex() const { return m_Index; }
+		[[nodiscard]] auto getRuleID() const { return m_Arena->getRuleID(m_Index); }
+		// Resolves the rule name through the lexer
+		[[nodiscard]] const std::string& getRule() const;
+		[[nodiscard]] auto               getSpan() const { return m_Arena->getSpan(m_Index); }
+		[[nodiscard]] NodeRef            getFirstChild() const { return { m_Arena, m_Arena->getFirstChild(m_Index) }; }
+		[[nodiscard]] NodeRef            getNextSibling() const { return { m_Arena, m_Arena->getNextSibling(m_Index) }; }
+		// Children are only linked through their siblings, so these walk them
+		[[nodiscard]] std::size_t getChildCount() const;
+		[[nodiscard]] NodeRef     getChild(std::size_t index) const;
+		[[nodiscard]] NodeChildren getChildren() const;
+
+		bool operator==(const NodeRef& other) const = default;
+
+	private:
+		const NodeArena* m_Arena = nullptr;
+		NodeIndex        m_Index = NodeArena::s_NoNode;
+	};
+
+	// The children of a node as a range for range based for loops
+	class NodeChildren
+	{
+	public:
+		class Iterator
+		{
+		public:
+			using value_type        = NodeRef;
+			using difference_type   = std::ptrdiff_t;
+			using reference         = NodeRef;
+			using pointer           = void;
+			using iterator_category = std::forward_iterator_tag;
+
+			Iterator() = default;
+			explicit Iterator(NodeRef node)
+			    : m_Node(node) {}
+
+			[[nodiscard]] NodeRef operator*() const { return m_Node; }
+
+			Iterator& operator++()
+			{
+				m_Node = m_Node.getNextSibling();
+				return *this;
+			}
+			Iterator operator++(int)
+			{
+				Iterator copy = *this;
+				++*this;
+				return copy;
+			}
+
+			bool operator==(const Iterator& other) const = default;
+
+		private:
+			NodeRef m_Node;
+		};
+
+	public:
+		explicit NodeChildren(NodeRef first)
+		    : m_First(first) {}
+
+		[[nodiscard]] Iterator begin() const { return Iterator { m_First }; }
+		[[nodiscard]] Iterator end() const { return Iterator { { m_First.getArena(), NodeArena::s_NoNode } }; }
+
+	private:
+		NodeRef m_First;
+	};
+
+	inline NodeRef NodeArena::getRoot() const
+	{
+		return { this, empty() ? s_NoNode : 0 };
+	}
+
+	inline NodeRef NodeArena::getNode(NodeIndex index) const
+	{
+		return { this, index };
+	}
+
+	inline NodeChildren NodeRef::getChildren() const
+	{
+		return NodeChildren { getFirstChild() };
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Source.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <bitset>
+#include <memory>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CommonLexer
+{
+	// Anchored ECMAScript regex compiled to minimized DFAs.
+	// Classes, groups, alternation and quantifiers are supported anywhere, lookaheads only at the top level after a fixed length prefix.
+	// The DFAs keep ECMAScript's leftmost first semantics, so results are identical to std::regex with match_continuous.
+	// Anything else (anchors, word boundaries, backreferences) falls back to std::regex.
+	class Regex
+	{
+	public:
+		static constexpr std::size_t s_NoMatch = ~0ULL;
+
+		// A byte from m_First followed by as many bytes from m_Rest as possible, optional runs also match nothing
+		struct CharRun
+		{
+		public:
+			std::bitset<256> m_First;
+			std::bitset<256> m_Rest;
+			bool             m_Optional = false;
+		};
+
+	public:
+		// Returns the shared compiled form of pattern, identical patterns share one automaton
+		[[nodiscard]] static std::shared_ptr<const Regex> Get(const std::string& pattern);
+
+	public:
+		explicit Regex(const std::string& pattern);
+
+		[[nodiscard]] auto& getPattern() const { return m_Pattern; }
+		[[nodiscard]] auto& getError() const { return m_Error; }
+		[[nodiscard]] bool  isValid() const { return m_Error.empty(); }
+		[[nodiscard]] bool  isFallback() const { return m_Fallback.has_value(); }
+		// Describes the construct that made this fall back to std::regex
+		[[nodiscard]] auto& getUnsupported() const { return m_Unsupported; }
+
+		[[nodiscard]] std::size_t getNumStates() const;
+		// Fills bytes with every byte a match can start with, returns true if a match may also be empty or the start can't be known
+		[[nodiscard]] bool getFirstBytes(std::bitset<256>& bytes) const;
+		// Returns the run the automaton describes when the pattern is that simple, like '[ \t]+' or '[A-Za-z_][A-Za-z0-9_]*'
+		[[nodiscard]] std::optional<CharRun> getCharRun() const;
+
+		// Returns the length of the match starting at the beginning, or s_NoMatch
+		[[nodiscard]] std::size_t match(std::string_view str) const;
+		[[nodiscard]] std::size_t match(ISource* source, SourceSpan span) const;
+
+	private:
+		struct Automaton
+		{
+		public:
+			std::uint8_t               m_ByteClasses[256];
+			std::size_t                m_NumClasses = 0;
+			std::uint32_t              m_Start      = 0;
+			std::vector<std::uint32_t> m_Transitions;
+			std::vector<bool>          m_Accepting;
+		};
+
+		// Steps run in order, assertions check their automaton at the current position without moving it
+		struct Step
+		{
+		public:
+			Automaton m_Automaton;
+			bool      m_Assertion = false;
+			bool      m_Negative  = false;
+		};
+
+	private:
+		template <class Itr>
+		std::size_t run(Itr begin, Itr end) const;
+
+	private:
+		std::string               m_Pattern;
+		std::string               m_Error;
+		std::string               m_Unsupported;
+		std::vector<Step>         m_Steps;
+		std::optional<std::regex> m_Fallback;
+	};
+} // namespace CommonLexer
\ No newline at end of file
@@ -14,11 +14,27 @@ namespace CommonLexer
 		IRule(std::string&& name, bool createNode = true);
 
 		[[nodiscard]] auto& getName() const { return m_Name; }
+		[[nodiscard]] auto  getID() const { return m_ID; }
 		[[nodiscard]] auto  doesCreateNode() const { return m_CreateNode; }
+		[[nodiscard]] auto& getFirstSet() const { return m_FirstSet; }
+		[[nodiscard]] auto  doesMemoize() const { return m_Memoize; }
+
+		// Set by the lexer when the rule is registered
+		void setID(RuleID id) { m_ID = id; }
+		void setFirstSet(const FirstSet& firstSet) { m_FirstSet = firstSet; }
+		// Memoized rules store their result per position in the lexer's memo table.
+		// Lexer::link turns it off again and reports an error for rules that set or read named groups, hits could not replay those.
+		void setMemoize(bool memoize) { m_Memoize = memoize; }
+
+	protected:
+		std::uint64_t hashRule(std::uint64_t seed) const;
 
 	protected:
 		std::string m_Name;
+		RuleID      m_ID = 0;
 		bool        m_CreateNode;
+		bool        m_Memoize  = false;
+		FirstSet    m_FirstSet = FirstSet::Any();
 	};
 
 	template <class T>
@@ -34,8 +50,15 @@ namespace CommonLexer
 		MatcherRule(const std::string& name, std::unique_ptr<IMatcher>&& matcher, bool createNode = true);
 		MatcherRule(std::string&& name, std::unique_ptr<IMatcher>&& matcher, bool createNode = true);
 
-		virtual void         cleanUp() override;
-		virtual MatchResult  match(MatcherState& state, SourceSpan span) override;
+		virtual void            link(LinkState& state) override;
+		virtual MatchResult     match(MatcherState& state, SourceSpan span) const override;
+		virtual FirstSet        computeFirstSet(Lexer& lexer) override;
+		virtual bool            collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules) override;
+		virtual std::uint64_t   hash(std::uint64_t seed) const override;
+		virtual const IMatcher* getRepeatedReference() const override { return m_Matcher->getRepeatedReference(); }
+
+	private:
+		MatchResult matchUnmemoized(MatcherState& state, SourceSpan span) const;
 
 	private:
 		std::unique_ptr<IMatcher> m_Matcher;
@@ -50,11 +73,16 @@ namespace CommonLexer
 		CallbackRule(const std::string& name, Callback&& callback, bool createNode = true);
 		CallbackRule(std::string&& name, Callback&& callback, bool createNode = true);
 
-		virtual void         cleanUp() override {}
-		virtual MatchResult  match(MatcherState& state, SourceSpan span) override;
+		virtual void          link([[maybe_unused]] LinkState& state) override {}
+		virtual MatchResult   match(MatcherState& state, SourceSpan span) const override;
+		virtual std::uint64_t hash(std::uint64_t seed) const override;
+
+		// The grammar hash can't look into the callback, so it takes the rule name and this version for it. Bump it whenever the callback matches differently.
+		void setCallbackVersion(std::uint64_t version) { m_CallbackVersion = version; }
 
 	private:
-		Callback m_Callback;
+		Callback      m_Callback;
+		std::uint64_t m_CallbackVersion = 0;
 	};
 
 	template <Matcher Matcher>
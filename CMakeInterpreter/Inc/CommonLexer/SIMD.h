@@ -0,0 +1,18 @@
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COMMON_LEXER_SSE2 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#define COMMON_LEXER_TARGET_AVX2
+#else
+#define COMMON_LEXER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define COMMON_LEXER_SSE2 0
+#endif
+
+namespace CommonLexer::SIMD
+{
+	// AVX2 paths are compiled with a target attribute and only taken when the running cpu supports them
+	bool HasAVX2();
+} // namespace CommonLexer::SIMD
\ No newline at end of file
@@ -1,9 +1,15 @@
 #pragma once
 
+#include "LineTable.h"
+
 #include <cstddef>
 
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -22,45 +28,87 @@ namespace CommonLexer
 		std::size_t m_Index = 0;
 	};
 
+	// Only holds the source and a position, characters are read through a block borrowed from the source
 	struct SourceIterator
 	{
 	public:
 		using value_type        = char;
-		using difference_type   = std::size_t;
-		using reference         = char&;
-		using pointer           = char*;
-		using iterator_category = std::bidirectional_iterator_tag;
+		using difference_type   = std::ptrdiff_t;
+		using reference         = char;
+		using pointer           = const char*;
+		using iterator_category = std::random_access_iterator_tag;
+		using iterator_concept  = std::random_access_iterator_tag;
 
-		SourceIterator();
-		SourceIterator(ISource* source, SourcePoint point);
+		SourceIterator() = default;
+		SourceIterator(ISource* source, SourcePoint point)
+		    : m_Source(source), m_Point(point) {}
 
 		[[nodiscard]] operator SourcePoint() const { return m_Point; }
 
 		char operator*() const;
+		char operator[](difference_type offset) const { return *(*this + offset); }
 
-		SourceIterator& operator++();
-		SourceIterator  operator++(int);
-		SourceIterator& operator--();
-		SourceIterator  operator--(int);
+		SourceIterator& operator++()
+		{
+			++m_Point.m_Index;
+			return *this;
+		}
+		SourceIterator operator++(int)
+		{
+			auto c = *this;
+			++m_Point.m_Index;
+			return c;
+		}
+		SourceIterator& operator--()
+		{
+			--m_Point.m_Index;
+			return *this;
+		}
+		SourceIterator operator--(int)
+		{
+			auto c = *this;
+			--m_Point.m_Index;
+			return c;
+		}
 
-		SourceIterator& operator+=(std::size_t count);
-		SourceIterator& operator-=(std::size_t count);
+		SourceIterator& operator+=(difference_type count)
+		{
+			m_Point.m_Index += count;
+			return *this;
+		}
+		SourceIterator& operator-=(difference_type count)
+		{
+			m_Point.m_Index -= count;
+			return *this;
+		}
 
-		bool operator==(const SourceIterator& other) const;
-		bool operator!=(const SourceIterator& other) const;
-		bool operator<(const SourceIterator& other) const;
-		bool operator<=(const SourceIterator& other) const;
-		bool operator>(const SourceIterator& other) const;
-		bool operator>=(const SourceIterator& other) const;
+		friend SourceIterator  operator+(SourceIterator itr, difference_type count) { return itr += count; }
+		friend SourceIterator  operator+(difference_type count, SourceIterator itr) { return itr += count; }
+		friend SourceIterator  operator-(SourceIterator itr, difference_type count) { return itr -= count; }
+		friend difference_type operator-(const SourceIterator& lhs, const SourceIterator& rhs)
+		{
+			return static_cast<difference_type>(lhs.m_Point.m_Index - rhs.m_Point.m_Index);
+		}
 
-	private:
-		void movePoint(std::size_t count, bool negative = false);
+		bool operator==(const SourceIterator& other) const { return m_Point.m_Index == other.m_Point.m_Index; }
+		bool operator!=(const SourceIterator& other) const { return m_Point.m_Index != other.m_Point.m_Index; }
+		bool operator<(const SourceIterator& other) const { return m_Point.m_Index < other.m_Point.m_Index; }
+		bool operator<=(const SourceIterator& other) const { return m_Point.m_Index <= other.m_Point.m_Index; }
+		bool operator>(const SourceIterator& other) const { return m_Point.m_Index > other.m_Point.m_Index; }
+		bool operator>=(const SourceIterator& other) const { return m_Point.m_Index >= other.m_Point.m_Index; }
 
 	private:
-		ISource*    m_Source;
+		ISource*    m_Source = nullptr;
 		SourcePoint m_Point;
-		std::size_t m_CachedOffset;
-		std::string m_Cached;
+	};
+
+	// A contiguous run of characters, m_Begin is the index of the first one in the owning source
+	struct SourceBlock
+	{
+	public:
+		const char* m_Data  = nullptr;
+		std::size_t m_Begin = 0;
+		std::size_t m_Size  = 0;
 	};
 
 	struct SourceSpan
@@ -78,6 +126,8 @@ namespace CommonLexer
 	class ISource
 	{
 	public:
+		virtual ~ISource() = default;
+
 		[[nodiscard]] virtual std::size_t getSize()                                   = 0;
 		[[nodiscard]] virtual std::size_t getNumLines()                               = 0;
 		[[nodiscard]] virtual std::size_t getIndexFromLineNumber(std::size_t line)    = 0;
@@ -86,6 +136,49 @@ namespace CommonLexer
 
 		[[nodiscard]] SourceSpan getCompleteSpan();
 
+		// Columns, codepoint counts and line spans are in codepoints, sources with a LineTable answer them without rescanning
+		[[nodiscard]] virtual std::size_t getInvalidUTF8Index();
+		[[nodiscard]] virtual std::size_t getCodepointCount(SourceSpan span);
+		[[nodiscard]] virtual SourceSpan  getLineSpan(SourcePoint point);
+		[[nodiscard]] bool                isValidUTF8() { return getInvalidUTF8Index() == ~0ULL; }
+
+		// Everything before point has been consumed and won't be read again, streaming sources recycle their buffers here
+		virtual void commit([[maybe_unused]] SourcePoint point) {}
+		// The lowest index read after a commit recycled it, those reads got nothing. ~0ULL if there was none.
+		[[nodiscard]] virtual std::size_t getRecycledReadIndex() { return ~0ULL; }
+
+		// Sources that keep their whole content in one contiguous buffer return a view of it,
+		// this lets iterators and matchers walk raw pointers instead of copying windows with getSpan.
+		[[nodiscard]] virtual std::optional<std::string_view> data() { return std::nullopt; }
+		[[nodiscard]] virtual std::optional<std::string_view> getSpanView(SourceSpan span);
+
+		// Returns the block containing index, the default uses data() and falls back to a window copied with getSpan.
+		// The block stays valid until the next getBlock call or until the source changes.
+		[[nodiscard]] virtual SourceBlock getBlock(std::size_t index);
+
+		// Borrows the block containing index ahead of time, for a contiguous source that block is all of it,
+		// so afterwards at() only reads and several threads can share the source until it changes.
+		void prepareBlock(std::size_t index = 0) { (void) loadBlock(index); }
+
+		// Reads through the last borrowed block and only asks getBlock for another one when index leaves it
+		[[nodiscard]] char at(std::size_t index)
+		{
+			std::size_t offset = index - m_Block.m_Begin;
+			return offset < m_Block.m_Size ? m_Block.m_Data[offset] : loadBlock(index);
+		}
+
+		// The borrowed block containing index, it is empty past the end of the source
+		[[nodiscard]] SourceBlock getBlockAt(std::size_t index)
+		{
+			if (index - m_Block.m_Begin >= m_Block.m_Size)
+			{
+				(void) loadBlock(index);
+				if (index - m_Block.m_Begin >= m_Block.m_Size)
+					return { nullptr, index, 0 };
+			}
+			return m_Block;
+		}
+
 		[[nodiscard]] virtual std::string getSpan(std::size_t index, std::size_t length) = 0;
 		[[nodiscard]] std::string         getSpan(SourceSpan span)
 		{
@@ -100,38 +193,159 @@ namespace CommonLexer
 		[[nodiscard]] virtual std::vector<std::string> getLines(std::size_t startLine, std::size_t lines) = 0;
 		[[nodiscard]] std::vector<std::string>         getLines(SourcePoint start, SourcePoint end)
 		{
-			auto startLine = getLineNumberFromIndex(start.m_Index);
-			auto endLine   = getLineNumberFromIndex(end.m_Index);
-			return getLines(startLine, (endLine + 1) - startLine);
+			return getLines(SourceSpan { start, end });
 		}
-		[[nodiscard]] std::vector<std::string> getLines(SourceSpan span)
+		[[nodiscard]] virtual std::vector<std::string> getLines(SourceSpan span)
 		{
 			auto startLine = getLineNumberFromIndex(span.m_Begin.m_Index);
 			auto endLine   = getLineNumberFromIndex(span.m_End.m_Index);
 			return getLines(startLine, (endLine + 1) - startLine);
 		}
+
+		// Sources that borrow blocks of this one, like a SourceManager, register here so every change to this source drops their block too
+		void setWrapper(ISource* wrapper) { m_Wrapper = wrapper; }
+
+	protected:
+		// The borrowed block points into the content of one object, so copies and moves start without one and take it from both sides.
+		// The wrapper stays with the object it registered on.
+		ISource() = default;
+		ISource(const ISource& copy);
+		ISource(ISource&& move) noexcept;
+
+		ISource& operator=(const ISource& copy);
+		ISource& operator=(ISource&& move) noexcept;
+
+		void invalidateBlock();
+
+	private:
+		char loadBlock(std::size_t index);
+
+	private:
+		SourceBlock m_Block;
+		std::string m_Window;
+		ISource*    m_Wrapper = nullptr;
 	};
 
+	inline char SourceIterator::operator*() const
+	{
+		return m_Source ? m_Source->at(m_Point.m_Index) : '\0';
+	}
+
 	class StringSource : public ISource
 	{
 	public:
 		explicit StringSource(const std::string& str);
 		explicit StringSource(std::string&& str);
 
+		virtual std::size_t                     getSize() override;
+		virtual std::size_t                     getNumLines() override;
+		virtual std::size_t                     getIndexFromLineNumber(std::size_t line) override;
+		virtual std::size_t                     getLineNumberFromIndex(std::size_t index) override;
+		virtual std::size_t                     getColumnNumberFromIndex(std::size_t index) override;
+		virtual std::size_t                     getInvalidUTF8Index() override;
+		virtual std::size_t                     getCodepointCount(SourceSpan span) override;
+		virtual std::optional<std::string_view> data() override;
+		virtual std::string                     getSpan(std::size_t index, std::size_t length) override;
+		virtual std::string                     getLine(std::size_t line) override;
+		virtual std::vector<std::string>        getLines(std::size_t startLine, std::size_t lines) override;
+
+	private:
+		std::string m_Str;
+		LineTable   m_Lines;
+	};
+
+	class FileSource : public ISource
+	{
+	public:
+		explicit FileSource(const std::filesystem::path& filepath);
+		FileSource(const FileSource&) = delete;
+		FileSource(FileSource&& move) noexcept;
+		~FileSource();
+
+		FileSource& operator=(const FileSource&) = delete;
+		FileSource& operator=(FileSource&& move) noexcept;
+
+		[[nodiscard]] bool                         isOpen() const { return m_Data != nullptr; }
+		[[nodiscard]] const std::filesystem::path& getFilepath() const { return m_Filepath; }
+
+		virtual std::size_t                     getSize() override;
+		virtual std::size_t                     getNumLines() override;
+		virtual std::size_t                     getIndexFromLineNumber(std::size_t line) override;
+		virtual std::size_t                     getLineNumberFromIndex(std::size_t index) override;
+		virtual std::size_t                     getColumnNumberFromIndex(std::size_t index) override;
+		virtual std::size_t                     getInvalidUTF8Index() override;
+		virtual std::size_t                     getCodepointCount(SourceSpan span) override;
+		virtual std::optional<std::string_view> data() override;
+		virtual std::string                     getSpan(std::size_t index, std::size_t length) override;
+		virtual std::string                     getLine(std::size_t line) override;
+		virtual std::vector<std::string>        getLines(std::size_t startLine, std::size_t lines) override;
+
+	private:
+		void map();
+		void unmap();
+		void setupLines();
+
+	private:
+		std::filesystem::path m_Filepath;
+		const char*           m_Data;
+		std::size_t           m_Size;
+		LineTable             m_Lines;
+	};
+
+	// Streams a file descriptor through a ring of fixed size blocks, blocks before the last commit point are reused.
+	// The size has to be known up front so the descriptor has to refer to a regular file.
+	// A lexer only commits after the top level elements its main rule repeats, without a top level reference every block stays loaded.
+	class ChunkedSource : public ISource
+	{
+	public:
+		static constexpr std::size_t s_DefaultBlockSize  = 64 * 1024;
+		static constexpr std::size_t s_DefaultBlockCount = 16;
+
+	public:
+		ChunkedSource(int fd, std::size_t blockSize = s_DefaultBlockSize, std::size_t blockCount = s_DefaultBlockCount);
+		explicit ChunkedSource(const std::filesystem::path& filepath, std::size_t blockSize = s_DefaultBlockSize, std::size_t blockCount = s_DefaultBlockCount);
+		ChunkedSource(const ChunkedSource&) = delete;
+		~ChunkedSource();
+
+		ChunkedSource& operator=(const ChunkedSource&) = delete;
+
+		[[nodiscard]] bool        isOpen() const { return m_Fd >= 0; }
+		[[nodiscard]] std::size_t getBlockSize() const { return m_BlockSize; }
+		[[nodiscard]] std::size_t getAllocatedBlocks() const { return m_Blocks.size() + m_FreeBlocks.size(); }
+
 		virtual std::size_t              getSize() override;
 		virtual std::size_t              getNumLines() override;
 		virtual std::size_t              getIndexFromLineNumber(std::size_t line) override;
 		virtual std::size_t              getLineNumberFromIndex(std::size_t index) override;
 		virtual std::size_t              getColumnNumberFromIndex(std::size_t index) override;
+		virtual std::size_t              getInvalidUTF8Index() override;
+		virtual std::size_t              getCodepointCount(SourceSpan span) override;
+		virtual void                     commit(SourcePoint point) override;
+		virtual std::size_t              getRecycledReadIndex() override { return m_RecycledRead; }
+		virtual SourceBlock              getBlock(std::size_t index) override;
 		virtual std::string              getSpan(std::size_t index, std::size_t length) override;
 		virtual std::string              getLine(std::size_t line) override;
 		virtual std::vector<std::string> getLines(std::size_t startLine, std::size_t lines) override;
 
 	private:
-		void setupLineToIndex();
+		void        setup(std::size_t blockCount);
+		bool        readBlock();
+		void        readThrough(std::size_t index);
+		// The data of the block containing index, nullptr once a commit recycled it or past the end
+		const char* getBlockData(std::size_t index);
 
 	private:
-		std::string              m_Str;
-		std::vector<std::size_t> m_LineToIndex;
+		int         m_Fd;
+		bool        m_OwnsFd;
+		std::size_t m_Size;
+		std::size_t m_BlockSize;
+
+		std::deque<std::unique_ptr<char[]>>  m_Blocks;
+		std::vector<std::unique_ptr<char[]>> m_FreeBlocks;
+		std::size_t                          m_FirstBlock;
+		std::size_t                          m_ReadBlocks;
+		std::size_t                          m_RecycledRead = ~0ULL;
+
+		LineTable m_Lines;
 	};
 } // namespace CommonLexer
\ No newline at end of file
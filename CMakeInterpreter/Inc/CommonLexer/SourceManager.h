@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Source.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace CommonLexer
+{
+	using FileID = std::uint32_t;
+
+	static constexpr FileID s_InvalidFileID = ~FileID { 0 };
+
+	// Owns many sources and gives each one a range in a single global offset space, so a SourcePoint identifies both the file and the position.
+	// Ranges are separated by one unused offset so the end of one file never equals the beginning of the next.
+	// Sources must not change size after being added, their ranges are fixed when they are added.
+	class SourceManager : public ISource
+	{
+	public:
+		using ISource::getSpan;
+
+		FileID addSource(std::string name, std::unique_ptr<ISource>&& source);
+		FileID addFile(const std::filesystem::path& filepath);
+
+		[[nodiscard]] std::size_t getNumFiles() const { return m_Files.size(); }
+		[[nodiscard]] FileID      getFileID(SourcePoint point) const;
+		[[nodiscard]] ISource*    getSource(FileID file) const;
+		[[nodiscard]] std::string getName(FileID file) const;
+		[[nodiscard]] SourceSpan  getFileSpan(FileID file) const;
+		[[nodiscard]] SourcePoint getPoint(FileID file, std::size_t localIndex) const;
+		[[nodiscard]] std::size_t getLocalIndex(SourcePoint point) const;
+
+		virtual std::size_t                     getSize() override;
+		virtual std::size_t                     getNumLines() override;
+		virtual std::size_t                     getIndexFromLineNumber(std::size_t line) override;
+		virtual std::size_t                     getLineNumberFromIndex(std::size_t index) override;
+		virtual std::size_t                     getColumnNumberFromIndex(std::size_t index) override;
+		virtual std::size_t                     getInvalidUTF8Index() override;
+		virtual std::size_t                     getCodepointCount(SourceSpan span) override;
+		virtual SourceSpan                      getLineSpan(SourcePoint point) override;
+		virtual void                            commit(SourcePoint point) override;
+		virtual std::size_t                     getRecycledReadIndex() override;
+		virtual std::optional<std::string_view> getSpanView(SourceSpan span) override;
+		virtual SourceBlock                     getBlock(std::size_t index) override;
+		virtual std::string                     getSpan(std::size_t index, std::size_t length) override;
+		virtual std::string                     getLine(std::size_t line) override;
+		virtual std::string                     getLine(SourcePoint point) override;
+		virtual std::vector<std::string>        getLines(std::size_t startLine, std::size_t lines) override;
+		virtual std::vector<std::string>        getLines(SourceSpan span) override;
+
+	private:
+		struct File
+		{
+		public:
+			std::string              m_Name;
+			std::unique_ptr<ISource> m_Source;
+			std::size_t              m_Begin;
+			std::size_t              m_Size;
+		};
+
+	private:
+		const File* getFile(std::size_t index) const;
+
+	private:
+		std::vector<File> m_Files;
+		std::size_t       m_Size = 0;
+	};
+} // namespace CommonLexer
\ No newline at end of file
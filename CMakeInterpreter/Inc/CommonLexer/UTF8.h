@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CommonLexer
+{
+	namespace UTF8
+	{
+		// Returns the index of the first byte that isn't part of a valid sequence, or str.size() if the whole string is valid
+		[[nodiscard]] std::size_t Validate(std::string_view str);
+		// Counts lead bytes, invalid bytes count as one codepoint each and stray continuation bytes as none
+		[[nodiscard]] std::size_t CountCodepoints(std::string_view str);
+	} // namespace UTF8
+
+	// Validates a source once and keeps a rank over its codepoint lead bytes, so codepoint counts between two indices are O(1).
+	// Pure ASCII content never allocates anything, the rank is only built once the first non ASCII byte shows up.
+	class CodepointTable
+	{
+	public:
+		void build(std::string_view str);
+		// Chunks have to be appended in order, sequences may be split between two chunks
+		void append(std::string_view str);
+		void clear();
+
+		[[nodiscard]] bool        isASCII() const { return m_Blocks.empty(); }
+		[[nodiscard]] bool        isValid() const { return getInvalidIndex() == ~0ULL; }
+		[[nodiscard]] std::size_t getInvalidIndex() const;
+		[[nodiscard]] std::size_t getCodepointIndex(std::size_t index) const;
+		[[nodiscard]] std::size_t getCodepointCount(std::size_t begin, std::size_t end) const { return getCodepointIndex(end) - getCodepointIndex(begin); }
+
+	private:
+		struct Block
+		{
+		public:
+			std::uint64_t m_Mask;
+			std::size_t   m_Rank;
+		};
+
+	private:
+		void validate(std::string_view str);
+		void appendBlocks(std::string_view str);
+
+	private:
+		std::vector<Block> m_Blocks;
+		std::size_t        m_Size         = 0;
+		std::size_t        m_Codepoints   = 0;
+		std::size_t        m_InvalidIndex = ~0ULL;
+		std::string        m_Pending;
+	};
+} // namespace CommonLexer
\ No newline at end of file
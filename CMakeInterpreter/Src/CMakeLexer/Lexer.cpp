@@ -1,134 +1,36 @@
 #include "CMakeLexer/Lexer.h"
+#include "CommonLexer/Matchers.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
 
 namespace CMakeLexer
 {
-	Lexer::Lexer()
+	// Returns the index just past the bracket argument opening at index, index itself if none opens there and npos if it is never closed
+	static std::size_t SkipBracket(std::string_view text, std::size_t index)
 	{
-		using namespace CommonLexer;
-		setMainRule("File");
+		if (index >= text.size() || text[index] != '[')
+			return index;
+
+		std::size_t equals = text.find_first_not_of('=', index + 1);
+		if (equals == std::string_view::npos || text[equals] != '[')
+			return index;
 
-		/*registerRule({ "File", MatcherMultiple(MatcherReference("FileElement")) });
-		registerRule({ "FileElement",
-		               MatcherBranch(Tuple {
-		                   MatcherCombination(Tuple {
-		                       MatcherReference("CommandInvocation"),
-		                       MatcherReference("LineEnding") }),
-		                   MatcherCombination(Tuple {
-		                       MatcherMultiple(
-		                           MatcherOr(Tuple {
-		                               MatcherReference("BracketComment"),
-		                               MatcherReference("Space") })),
-		                       MatcherReference("LineEnding") }) }) });
-		registerRule({ "LineEnding",
-		               MatcherCombination(Tuple {
-		                   MatcherOptional(MatcherReference("LineComment")),
-		                   MatcherReference("Newline") }),
-		               false });
-		registerRule({ "Space", MatcherRegex("[ \t]+"), false });
-		registerRule({ "Newline", MatcherText("\n"), false });
-
-		registerRule({ "CommandInvocation", MatcherCombination(Tuple {
-		                                        MatcherMultiple(MatcherReference("Space")),
-		                                        MatcherReference("Identifier"),
-		                                        MatcherMultiple(MatcherReference("Space")),
-		                                        MatcherText("("),
-		                                        MatcherReference("Arguments"),
-		                                        MatcherText(")") }) });
-		registerRule({ "Identifier", MatcherRegex("[A-Za-z_][A-Za-z0-9_]*") });
-		registerRule({ "Arguments",
-		               MatcherCombination(Tuple {
-		                   MatcherOptional(MatcherReference("Argument")),
-		                   MatcherMultiple(MatcherReference("SeparatedArguments")) }) });
-		registerRule({ "SeparatedArguments",
-		               MatcherBranch(Tuple {
-		                   MatcherCombination(Tuple {
-		                       MatcherMultiple(MatcherReference("Separation"), EMatcherMultipleType::OneOrMore),
-		                       MatcherOptional(MatcherReference("Argument")) }),
-		                   MatcherCombination(Tuple {
-		                       MatcherMultiple(MatcherReference("Separation")),
-		                       MatcherText("("),
-		                       MatcherReference("Arguments"),
-		                       MatcherText(")") }) }) });
-		registerRule({ "Separation", MatcherReference("Space"), false });
-
-		registerRule({ "Argument",
-		               MatcherBranch(Tuple {
-		                   MatcherReference("BracketArgument"),
-		                   MatcherReference("QuotedArgument"),
-		                   MatcherReference("UnquotedArgument") }) });
-
-		registerRule({ "BracketArgument",
-		               MatcherCombination(Tuple {
-		                   MatcherReference("BracketOpen"),
-		                   MatcherReference("BracketContent"),
-		                   MatcherReference("BracketClose") }) });
-		registerRule({ "BracketOpen",
-		               MatcherCombination(Tuple {
-		                   MatcherText("["),
-		                   MatcherNamedGroup("BracketCount", MatcherRegex("=*")) }),
-		               false });
-		registerRule({ "BracketContent",
-		               MatcherMultiple(
-		                   MatcherOr(Tuple {
-		                       MatcherRegex("."),
-		                       MatcherReference("Newline") })),
-		               false });
-		registerRule({ "BracketClose",
-		               MatcherCombination(Tuple {
-		                   MatcherText("]"),
-		                   MatcherNamedGroupReference("BracketCount"),
-		                   MatcherText("]") }) });
-
-		registerRule({ "QuotedArgument",
-		               MatcherCombination(Tuple {
-		                   MatcherText("\""),
-		                   MatcherMultiple(MatcherReference("QuotedElement")),
-		                   MatcherText("\"") }) });
-		registerRule({ "QuotedElement",
-		               MatcherBranch(Tuple {
-		                   MatcherReference("EscapeSequence"),
-		                   MatcherReference("QuotedContinuation"),
-		                   MatcherMultiple(
-		                       MatcherOr(Tuple {
-		                           MatcherReference("Newline"),
-		                           MatcherRegex("[^\"\\\\]") }),
-		                       EMatcherMultipleType::OneOrMore) }) });
-		registerRule({ "QuotedContinuation",
-		               MatcherCombination(Tuple {
-		                   MatcherText("\\"),
-		                   MatcherReference("Newline") }) });
-
-		registerRule({ "UnquotedArgument",
-		               MatcherBranch(Tuple {
-		                   MatcherMultiple(MatcherReference("UnquotedElement"), EMatcherMultipleType::OneOrMore),
-		                   MatcherReference("UnquotedLegacy") }) });
-		registerRule({ "UnquotedElement",
-		               MatcherBranch(Tuple {
-		                   MatcherReference("EscapeSequence"),
-		                   MatcherRegex("(?:[^\\s()#\\\"\\\\])+") }) });
-		registerRule({ "UnquotedLegacy", MatcherCallback(std::bind(&Lexer::unquotedLegacyCallback, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4)) });
-
-		registerRule({ "EscapeSequence", MatcherRegex("\\\\(?:[^A-Za-z0-9;]|[trn;])") });
-
-		registerRule({ "LineComment", MatcherRegex("#(?!\\[=*\\[).*") });
-		registerRule({ "BracketComment",
-		               MatcherCombination(Tuple {
-		                   MatcherText("#"),
-		                   MatcherReference("BracketArgument") }) });*/
+		std::string close = "]" + std::string(equals - index - 1, '=') + "]";
+		std::size_t end   = text.find(close, equals + 1);
+		return end == std::string_view::npos ? end : end + close.size();
 	}
 
-	CommonLexer::MatchResult Lexer::unquotedLegacyCallback(CommonLexer::MatcherState& state, CommonLexer::SourceSpan span)
+	// Unquoted legacy arguments end at ')', a newline or a space outside of quotes, a '(' doesn't open anything in them.
+	// Shared by the callback and the command boundary scan, so both agree on where the arguments end.
+	template <class Iterator>
+	static Iterator SkipUnquotedLegacy(Iterator itr, Iterator end)
 	{
-		auto itr = span.begin(state.m_Source);
-		auto end = span.end(state.m_Source);
-		if (itr == end || *itr == '"' || *itr == '(')
-			return { CommonLexer::EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
-
 		bool insideString = false;
 
-		bool        escaped  = false;
-		bool        breakOut = false;
-		std::size_t len      = 0;
+		bool escaped  = false;
+		bool breakOut = false;
 		while (itr != end)
 		{
 			char c = *itr;
@@ -138,17 +40,14 @@ namespace CMakeLexer
 			case '\\':
 				escaped = true;
 				++itr;
-				++len;
 				break;
 			case '"':
 				if (!escaped)
 					insideString = !insideString;
 				++itr;
-				++len;
 				break;
 			case '$':
 				++itr;
-				++len;
 				if (itr == end)
 					break;
 
@@ -157,16 +56,14 @@ namespace CMakeLexer
 					if (*itr == '(')
 					{
 						++itr;
-						++len;
 						while (itr != end)
 						{
 							if (*itr == ')')
 								break;
 							++itr;
-							++len;
 						}
-						++itr;
-						++len;
+						if (itr != end)
+							++itr;
 					}
 				}
 				break;
@@ -181,21 +78,276 @@ namespace CMakeLexer
 					break;
 				}
 				++itr;
-				++len;
 				break;
 			default:
 				escaped = false;
 				++itr;
-				++len;
 			}
 
 			if (breakOut)
 				break;
 		}
 
-		if (len == 0)
-			return { CommonLexer::EMatchStatus::Failure, { span.m_Begin, itr } };
+		return itr;
+	}
+
+	Lexer::Lexer()
+	{
+		using namespace CommonLexer;
+		setMainRule("File");
+
+		registerRule(MatcherRule { "File", RangeMatcher(ReferenceMatcher("FileElement")), false });
+		registerRule(MatcherRule {
+		    "FileElement",
+		    OrMatcher(Tuple {
+		        CombinationMatcher(Tuple {
+		            ReferenceMatcher("CommandInvocation"),
+		            ReferenceMatcher("LineEnding") }),
+		        CombinationMatcher(Tuple {
+		            RangeMatcher(
+		                OrMatcher(Tuple {
+		                    ReferenceMatcher("BracketComment"),
+		                    ReferenceMatcher("Space") })),
+		            ReferenceMatcher("LineEnding") }) }),
+		    false });
+		registerRule(MatcherRule {
+		    "LineEnding",
+		    CombinationMatcher(Tuple {
+		        OptionalMatcher(ReferenceMatcher("LineComment")),
+		        ReferenceMatcher("Newline") }),
+		    false });
+		registerRule(MatcherRule { "Space", RegexMatcher("[ \t]+"), false });
+		registerRule(MatcherRule { "Newline", TextMatcher("\n"), false });
+
+		registerRule(MatcherRule { "CommandInvocation", CombinationMatcher(Tuple {
+		                                                    RangeMatcher(ReferenceMatcher("Space")),
+		                                                    ReferenceMatcher("Identifier"),
+		                                                    RangeMatcher(ReferenceMatcher("Space")),
+		                                                    TextMatcher("("),
+		                                                    ReferenceMatcher("Arguments"),
+		                                                    TextMatcher(")") }) });
+		registerRule(MatcherRule { "Identifier", RegexMatcher("[A-Za-z_][A-Za-z0-9_]*") });
+		registerRule(MatcherRule {
+		    "Arguments",
+		    CombinationMatcher(Tuple {
+		        OptionalMatcher(ReferenceMatcher("Argument")),
+		        RangeMatcher(ReferenceMatcher("SeparatedArguments")) }) });
+		registerRule(MatcherRule {
+		    "SeparatedArguments",
+		    OrMatcher(Tuple {
+		        CombinationMatcher(Tuple {
+		            RangeMatcher(ReferenceMatcher("Separation"), 1),
+		            OptionalMatcher(ReferenceMatcher("Argument")) }),
+		        CombinationMatcher(Tuple {
+		            RangeMatcher(ReferenceMatcher("Separation")),
+		            TextMatcher("("),
+		            ReferenceMatcher("Arguments"),
+		            TextMatcher(")") }) }) });
+		registerRule(MatcherRule {
+		    "Separation",
+		    OrMatcher(Tuple {
+		        ReferenceMatcher("Space"),
+		        ReferenceMatcher("LineEnding") }),
+		    false });
+
+		registerRule(MatcherRule {
+		    "Argument",
+		    OrMatcher(Tuple {
+		        ReferenceMatcher("BracketArgument"),
+		        ReferenceMatcher("QuotedArgument"),
+		        ReferenceMatcher("UnquotedArgument") }) });
+
+		registerRule(MatcherRule {
+		    "BracketArgument",
+		    CombinationMatcher(Tuple {
+		        ReferenceMatcher("BracketOpen"),
+		        ReferenceMatcher("BracketContent"),
+		        ReferenceMatcher("BracketClose") }) });
+		registerRule(MatcherRule {
+		    "BracketOpen",
+		    CombinationMatcher(Tuple {
+		        TextMatcher("["),
+		        NamedGroupMatcher("BracketCount", RegexMatcher("=*")),
+		        TextMatcher("[") }),
+		    false });
+		// A ']' only ends the content when the bracket count and another ']' follow it
+		registerRule(MatcherRule {
+		    "BracketContent",
+		    RangeMatcher(
+		        OrMatcher(Tuple {
+		            CombinationMatcher(Tuple {
+		                TextMatcher("]"),
+		                NegativeMatcher(CombinationMatcher(Tuple {
+		                    NamedGroupReferenceMatcher("BracketCount"),
+		                    TextMatcher("]") })) }),
+		            RegexMatcher("[^\\]]"),
+		            ReferenceMatcher("Newline") })) });
+		registerRule(MatcherRule {
+		    "BracketClose",
+		    CombinationMatcher(Tuple {
+		        TextMatcher("]"),
+		        NamedGroupReferenceMatcher("BracketCount"),
+		        TextMatcher("]") }),
+		    false });
+
+		registerRule(MatcherRule {
+		    "QuotedArgument",
+		    CombinationMatcher(Tuple {
+		        TextMatcher("\""),
+		        RangeMatcher(ReferenceMatcher("QuotedElement")),
+		        TextMatcher("\"") }) });
+		registerRule(MatcherRule {
+		    "QuotedElement",
+		    OrMatcher(Tuple {
+		        ReferenceMatcher("EscapeSequence"),
+		        ReferenceMatcher("QuotedContinuation"),
+		        RangeMatcher(
+		            OrMatcher(Tuple {
+		                ReferenceMatcher("Newline"),
+		                RegexMatcher("[^\"\\\\]") }),
+		            1) }) });
+		registerRule(MatcherRule {
+		    "QuotedContinuation",
+		    CombinationMatcher(Tuple {
+		        TextMatcher("\\"),
+		        ReferenceMatcher("Newline") }) });
+		registerRule(MatcherRule {
+		    "UnquotedArgument",
+		    OrMatcher(Tuple {
+		        RangeMatcher(ReferenceMatcher("UnquotedElement"), 1),
+		        ReferenceMatcher("UnquotedLegacy") }) });
+		registerRule(MatcherRule {
+		    "UnquotedElement",
+		    OrMatcher(Tuple {
+		        ReferenceMatcher("EscapeSequence"),
+		        RegexMatcher("(?:[^\\s()#\"\\\\])+") }) });
+		registerRule(CallbackRule { "UnquotedLegacy", &Lexer::unquotedLegacyCallback });
+		registerRule(MatcherRule { "EscapeSequence", RegexMatcher("\\\\(?:[^A-Za-z0-9;]|[trn;])") });
+		registerRule(MatcherRule { "LineComment", RegexMatcher("#(?!\\[=*\\[).*") });
+		registerRule(MatcherRule {
+		    "BracketComment",
+		    CombinationMatcher(Tuple {
+		        TextMatcher("#"),
+		        ReferenceMatcher("BracketArgument") }) });
+
+		// Linked right away so the lexer can be shared between threads as is
+		link();
+
+		hashGrammar();
+	}
+
+	CommonLexer::Lex Lexer::lexSourceParallel(CommonLexer::ISource* source, std::size_t jobs) const
+	{
+		auto text = source ? source->data() : std::nullopt;
+		if (jobs == 0)
+			jobs = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+		// A few chunks per job, so jobs that finish early have something left to steal
+		std::size_t chunks = text ? std::min(jobs * 4, text->size() / s_MinChunkSize) : 0;
+		if (jobs <= 1 || chunks <= 1)
+			return lexSource(source);
+
+		std::size_t              chunkSize = text->size() / chunks;
+		std::vector<std::size_t> splits;
+		for (auto boundary : findCommandBoundaries(*text))
+			if (boundary >= (splits.empty() ? 0 : splits.back()) + chunkSize)
+				splits.push_back(boundary);
+		return lexSourceSplit(source, splits, jobs);
+	}
+
+	std::vector<std::size_t> Lexer::findCommandBoundaries(std::string_view text)
+	{
+		std::vector<std::size_t> boundaries;
+
+		// Brackets, quotes and comments only start where an argument can, inside an unquoted argument they are just characters
+		std::size_t depth     = 0;
+		bool        separated = true;
+		std::size_t i         = 0;
+		while (i < text.size())
+		{
+			// Right after a '(' the first argument is tried before a comment, so a '#' starts an unquoted argument there
+			char c       = text[i];
+			bool comment = c == '#' && !(depth > 0 && text[i - 1] == '(');
+			if (separated && (c == '[' || comment))
+			{
+				std::size_t open = c == '#' ? i + 1 : i;
+				std::size_t end  = SkipBracket(text, open);
+				if (end == std::string_view::npos)
+					break;
+				if (end != open)
+				{
+					i         = end;
+					separated = c == '#';
+					continue;
+				}
+				if (c == '#')
+				{
+					i = text.find('\n', i);
+					continue;
+				}
+			}
+
+			// Anything else starting an argument is unquoted, legacy arguments being the longest of those
+			if (depth > 0 && separated && std::string_view { " \t\n()\"" }.find(c) == std::string_view::npos)
+			{
+				i         = SkipUnquotedLegacy(text.begin() + i, text.end()) - text.begin();
+				separated = false;
+				continue;
+			}
+
+			switch (c)
+			{
+			case '"':
+				if (separated)
+				{
+					for (++i; i < text.size() && text[i] != '"'; ++i)
+						if (text[i] == '\\')
+							++i;
+					if (i >= text.size())
+						return boundaries;
+				}
+				separated = false;
+				break;
+			case '\\':
+				++i;
+				separated = false;
+				break;
+			case '(':
+				++depth;
+				separated = true;
+				break;
+			case ')':
+				if (depth > 0)
+					--depth;
+				separated = true;
+				break;
+			case '\n':
+				if (depth == 0)
+					boundaries.push_back(i + 1);
+				separated = true;
+				break;
+			case ' ':
+			case '\t':
+				separated = true;
+				break;
+			default:
+				separated = false;
+			}
+			++i;
+		}
+		return boundaries;
+	}
+
+	CommonLexer::MatchResult Lexer::unquotedLegacyCallback(CommonLexer::MatcherState& state, CommonLexer::SourceSpan span)
+	{
+		auto itr = span.begin(state.m_Source);
+		auto end = span.end(state.m_Source);
+		if (itr == end || *itr == '"' || *itr == '(')
+			return { CommonLexer::EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
+
+		auto last = SkipUnquotedLegacy(itr, end);
+		if (last == itr)
+			return { CommonLexer::EMatchStatus::Failure, { span.m_Begin, last } };
 
-		return { CommonLexer::EMatchStatus::Success, { span.m_Begin, itr } };
+		return { CommonLexer::EMatchStatus::Success, { span.m_Begin, last } };
 	}
 } // namespace CMakeLexer
\ No newline at end of file
@@ -0,0 +1,415 @@
+#include "CommonLexer/EditableSource.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace CommonLexer
+{
+	static std::size_t CountPieces(const auto* node)
+	{
+		return node ? 1 + CountPieces(node->m_Left.get()) + CountPieces(node->m_Right.get()) : 0;
+	}
+
+	EditableSource::EditableSource()
+	    : m_Seed(0x9E3779B9U)
+	{
+		m_OriginalLines.build(m_Original);
+		m_AddedLines.build(m_Added);
+	}
+
+	EditableSource::EditableSource(const std::string& str)
+	    : m_Original(str), m_Seed(0x9E3779B9U)
+	{
+		m_OriginalLines.build(m_Original);
+		m_AddedLines.build(m_Added);
+		if (!m_Original.empty())
+			m_Root = createNode(false, 0, m_Original.size());
+	}
+
+	EditableSource::EditableSource(std::string&& str)
+	    : m_Original(std::move(str)), m_Seed(0x9E3779B9U)
+	{
+		m_OriginalLines.build(m_Original);
+		m_AddedLines.build(m_Added);
+		if (!m_Original.empty())
+			m_Root = createNode(false, 0, m_Original.size());
+	}
+
+	EditableSource::~EditableSource() = default;
+
+	void EditableSource::insert(std::size_t index, std::string_view str)
+	{
+		index = std::min(index, getSize());
+		if (str.empty())
+			return;
+
+		std::size_t start = m_Added.size();
+		m_Added.append(str);
+		m_AddedLines.append(str, start);
+
+		std::unique_ptr<PieceNode> left, right;
+		split(std::move(m_Root), index, left, right);
+		m_Root = merge(merge(std::move(left), createNode(true, start, str.size())), std::move(right));
+
+		notify({ index, 0, str.size() });
+	}
+
+	void EditableSource::erase(std::size_t index, std::size_t length)
+	{
+		std::size_t size = getSize();
+		if (index >= size || length == 0)
+			return;
+		length = std::min(length, size - index);
+
+		std::unique_ptr<PieceNode> left, middle, right;
+		split(std::move(m_Root), index, left, right);
+		split(std::move(right), length, middle, right);
+		m_Root = merge(std::move(left), std::move(right));
+
+		notify({ index, length, 0 });
+	}
+
+	void EditableSource::setChangeCallback(ChangeCallback&& callback)
+	{
+		m_ChangeCallback = std::move(callback);
+	}
+
+	std::size_t EditableSource::getNumPieces() const
+	{
+		return CountPieces(m_Root.get());
+	}
+
+	std::size_t EditableSource::getSize()
+	{
+		return m_Root ? m_Root->m_Length : 0;
+	}
+
+	std::size_t EditableSource::getNumLines()
+	{
+		return (m_Root ? m_Root->m_Newlines : 0) + 1;
+	}
+
+	std::size_t EditableSource::getIndexFromLineNumber(std::size_t line)
+	{
+		if (line == 1)
+			return 0;
+		if (line == 0 || line > getNumLines())
+			return ~0ULL;
+
+		// Find the (line - 1)th newline, the line starts right after it
+		std::size_t newline = line - 1;
+		std::size_t base    = 0;
+
+		const PieceNode* node = m_Root.get();
+		while (node)
+		{
+			std::size_t leftNewlines = node->m_Left ? node->m_Left->m_Newlines : 0;
+			if (newline <= leftNewlines)
+			{
+				node = node->m_Left.get();
+				continue;
+			}
+
+			newline -= leftNewlines;
+			base += node->m_Left ? node->m_Left->m_Length : 0;
+
+			auto& piece = node->m_Piece;
+			if (newline <= piece.m_Newlines)
+			{
+				auto&       lines  = getBufferLines(piece);
+				std::size_t before = lines.getLineNumberFromIndex(piece.m_Start) - 1;
+				std::size_t offset = lines.getIndexFromLineNumber(before + newline + 1) - piece.m_Start;
+				return base + offset;
+			}
+
+			newline -= piece.m_Newlines;
+			base += piece.m_Length;
+			node = node->m_Right.get();
+		}
+		return ~0ULL;
+	}
+
+	std::size_t EditableSource::getLineNumberFromIndex(std::size_t index)
+	{
+		std::size_t newlines = 0;
+
+		const PieceNode* node = m_Root.get();
+		while (node)
+		{
+			std::size_t leftLength = node->m_Left ? node->m_Left->m_Length : 0;
+			if (index < leftLength)
+			{
+				node = node->m_Left.get();
+				continue;
+			}
+
+			newlines += node->m_Left ? node->m_Left->m_Newlines : 0;
+			index -= leftLength;
+
+			auto& piece = node->m_Piece;
+			if (index < piece.m_Length)
+				return newlines + getNewlinesBefore(piece, index) + 1;
+
+			newlines += piece.m_Newlines;
+			index -= piece.m_Length;
+			node = node->m_Right.get();
+		}
+		return newlines + 1;
+	}
+
+	std::size_t EditableSource::getColumnNumberFromIndex(std::size_t index)
+	{
+		std::size_t lineStart = getIndexFromLineNumber(getLineNumberFromIndex(index));
+		if (lineStart == ~0ULL)
+			return 1;
+		return getCodepointCount({ lineStart, index }) + 1;
+	}
+
+	std::size_t EditableSource::getCodepointCount(SourceSpan span)
+	{
+		return getCodepointsBefore(span.m_End.m_Index) - getCodepointsBefore(span.m_Begin.m_Index);
+	}
+
+	SourceBlock EditableSource::getBlock(std::size_t index)
+	{
+		std::size_t base = 0;
+
+		const PieceNode* node = m_Root.get();
+		while (node)
+		{
+			std::size_t leftLength = node->m_Left ? node->m_Left->m_Length : 0;
+			if (index < leftLength)
+			{
+				node = node->m_Left.get();
+				continue;
+			}
+
+			base += leftLength;
+			index -= leftLength;
+
+			auto& piece = node->m_Piece;
+			if (index < piece.m_Length)
+				return { getBuffer(piece).data() + piece.m_Start, base, piece.m_Length };
+
+			base += piece.m_Length;
+			index -= piece.m_Length;
+			node = node->m_Right.get();
+		}
+		return {};
+	}
+
+	std::string EditableSource::getSpan(std::size_t index, std::size_t length)
+	{
+		std::size_t size = getSize();
+		if (index >= size)
+			return {};
+
+		if ((index + length) >= size)
+			length = size - index;
+
+		std::string str;
+		str.reserve(length);
+		appendSpan(m_Root.get(), index, length, str);
+		return str;
+	}
+
+	std::string EditableSource::getLine(std::size_t line)
+	{
+		std::size_t lineStart = getIndexFromLineNumber(line);
+		if (lineStart == ~0ULL)
+			return {};
+
+		std::size_t lineEnd = getIndexFromLineNumber(line + 1);
+		lineEnd             = lineEnd == ~0ULL ? getSize() : lineEnd - 1;
+		return getSpan(lineStart, lineEnd - lineStart);
+	}
+
+	std::vector<std::string> EditableSource::getLines(std::size_t startLine, std::size_t lines)
+	{
+		std::vector<std::string> lns;
+		for (std::size_t line = startLine, end = startLine + lines; line != end; ++line)
+			lns.push_back(std::move(getLine(line)));
+		return lns;
+	}
+
+	std::unique_ptr<EditableSource::PieceNode> EditableSource::createNode(bool added, std::size_t start, std::size_t length)
+	{
+		m_Seed ^= m_Seed << 13;
+		m_Seed ^= m_Seed >> 17;
+		m_Seed ^= m_Seed << 5;
+
+		auto node                  = std::make_unique<PieceNode>();
+		node->m_Piece.m_Added      = added;
+		node->m_Piece.m_Start      = start;
+		node->m_Piece.m_Length     = length;
+		node->m_Piece.m_Newlines   = getNewlinesBefore(node->m_Piece, length);
+		node->m_Piece.m_Codepoints = getPieceCodepoints(node->m_Piece, 0, length);
+		node->m_Priority           = m_Seed;
+		update(node.get());
+		return node;
+	}
+
+	void EditableSource::split(std::unique_ptr<PieceNode> node, std::size_t index, std::unique_ptr<PieceNode>& left, std::unique_ptr<PieceNode>& right)
+	{
+		if (!node)
+		{
+			left  = nullptr;
+			right = nullptr;
+			return;
+		}
+
+		std::size_t leftLength = node->m_Left ? node->m_Left->m_Length : 0;
+		if (index <= leftLength)
+		{
+			split(std::move(node->m_Left), index, left, node->m_Left);
+			update(node.get());
+			right = std::move(node);
+		}
+		else if (index >= leftLength + node->m_Piece.m_Length)
+		{
+			split(std::move(node->m_Right), index - leftLength - node->m_Piece.m_Length, node->m_Right, right);
+			update(node.get());
+			left = std::move(node);
+		}
+		else
+		{
+			// The split point is inside this piece, the tail becomes a new node taking over the right subtree.
+			// It inherits the priority so the heap order of that subtree still holds.
+			std::size_t offset = index - leftLength;
+
+			auto tail                  = std::make_unique<PieceNode>();
+			tail->m_Piece.m_Added      = node->m_Piece.m_Added;
+			tail->m_Piece.m_Start      = node->m_Piece.m_Start + offset;
+			tail->m_Piece.m_Length     = node->m_Piece.m_Length - offset;
+			tail->m_Piece.m_Newlines   = getNewlinesBefore(tail->m_Piece, tail->m_Piece.m_Length);
+			tail->m_Piece.m_Codepoints = getPieceCodepoints(tail->m_Piece, 0, tail->m_Piece.m_Length);
+			tail->m_Priority           = node->m_Priority;
+			tail->m_Right              = std::move(node->m_Right);
+
+			node->m_Piece.m_Length     = offset;
+			node->m_Piece.m_Newlines   = node->m_Piece.m_Newlines - tail->m_Piece.m_Newlines;
+			node->m_Piece.m_Codepoints = node->m_Piece.m_Codepoints - tail->m_Piece.m_Codepoints;
+
+			update(tail.get());
+			update(node.get());
+			left  = std::move(node);
+			right = std::move(tail);
+		}
+	}
+
+	std::unique_ptr<EditableSource::PieceNode> EditableSource::merge(std::unique_ptr<PieceNode> left, std::unique_ptr<PieceNode> right)
+	{
+		if (!left)
+			return right;
+		if (!right)
+			return left;
+
+		if (left->m_Priority >= right->m_Priority)
+		{
+			left->m_Right = merge(std::move(left->m_Right), std::move(right));
+			update(left.get());
+			return left;
+		}
+		else
+		{
+			right->m_Left = merge(std::move(left), std::move(right->m_Left));
+			update(right.get());
+			return right;
+		}
+	}
+
+	void EditableSource::appendSpan(const PieceNode* node, std::size_t index, std::size_t length, std::string& str) const
+	{
+		if (!node || length == 0)
+			return;
+
+		std::size_t leftLength = node->m_Left ? node->m_Left->m_Length : 0;
+		if (index < leftLength)
+		{
+			std::size_t count = std::min(length, leftLength - index);
+			appendSpan(node->m_Left.get(), index, count, str);
+			index += count;
+			length -= count;
+		}
+		if (length == 0)
+			return;
+
+		index -= leftLength;
+		auto& piece = node->m_Piece;
+		if (index < piece.m_Length)
+		{
+			std::size_t count = std::min(length, piece.m_Length - index);
+			str.append(getBuffer(piece).substr(piece.m_Start + index, count));
+			index += count;
+			length -= count;
+		}
+
+		appendSpan(node->m_Right.get(), index - piece.m_Length, length, str);
+	}
+
+	std::size_t EditableSource::getCodepointsBefore(std::size_t index) const
+	{
+		std::size_t codepoints = 0;
+
+		const PieceNode* node = m_Root.get();
+		while (node)
+		{
+			std::size_t leftLength = node->m_Left ? node->m_Left->m_Length : 0;
+			if (index < leftLength)
+			{
+				node = node->m_Left.get();
+				continue;
+			}
+
+			codepoints += node->m_Left ? node->m_Left->m_Codepoints : 0;
+			index -= leftLength;
+
+			auto& piece = node->m_Piece;
+			if (index < piece.m_Length)
+				return codepoints + getPieceCodepoints(piece, 0, index);
+
+			codepoints += piece.m_Codepoints;
+			index -= piece.m_Length;
+			node = node->m_Right.get();
+		}
+		// Past the end every index counts as one column, the same way the LineTable based sources do it
+		return codepoints + index;
+	}
+
+	std::size_t EditableSource::getPieceCodepoints(const Piece& piece, std::size_t begin, std::size_t end) const
+	{
+		return getBufferLines(piece).getCodepoints().getCodepointCount(piece.m_Start + begin, piece.m_Start + end);
+	}
+
+	std::size_t EditableSource::getNewlinesBefore(const Piece& piece, std::size_t offset) const
+	{
+		auto& lines = getBufferLines(piece);
+		return lines.getLineNumberFromIndex(piece.m_Start + offset) - lines.getLineNumberFromIndex(piece.m_Start);
+	}
+
+	void EditableSource::update(PieceNode* node)
+	{
+		node->m_Length     = node->m_Piece.m_Length;
+		node->m_Newlines   = node->m_Piece.m_Newlines;
+		node->m_Codepoints = node->m_Piece.m_Codepoints;
+		if (node->m_Left)
+		{
+			node->m_Length += node->m_Left->m_Length;
+			node->m_Newlines += node->m_Left->m_Newlines;
+			node->m_Codepoints += node->m_Left->m_Codepoints;
+		}
+		if (node->m_Right)
+		{
+			node->m_Length += node->m_Right->m_Length;
+			node->m_Newlines += node->m_Right->m_Newlines;
+			node->m_Codepoints += node->m_Right->m_Codepoints;
+		}
+	}
+
+	void EditableSource::notify(const SourceEdit& edit)
+	{
+		invalidateBlock();
+		if (m_ChangeCallback)
+			m_ChangeCallback(edit);
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,475 @@
+#include "CommonLexer/Grammar.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <optional>
+
+namespace CommonLexer
+{
+	// Bodies up to this many matchers once expanded are inlined everywhere, larger ones only when referenced once
+	static constexpr std::size_t s_InlineSize = 16;
+
+	// Forwards to the built matcher and counts its calls, so grammars can be compared by the work lexing does
+	struct StepCountingMatcher final : public IMatcher
+	{
+	public:
+		StepCountingMatcher(std::unique_ptr<IMatcher>&& matcher, std::size_t* steps)
+		    : m_Matcher(std::move(matcher)), m_Steps(steps) {}
+
+		virtual void link(LinkState& state) override { m_Matcher->link(state); }
+		virtual MatchResult match(MatcherState& state, SourceSpan span) const override
+		{
+			++*m_Steps;
+			return m_Matcher->match(state, span);
+		}
+		virtual FirstSet        computeFirstSet(Lexer& lexer) override { return m_Matcher->computeFirstSet(lexer); }
+		virtual bool            collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules) override { return m_Matcher->collectLeftRules(lexer, rules); }
+		virtual std::uint64_t   hash(std::uint64_t seed) const override { return m_Matcher->hash(seed); }
+		virtual const IMatcher* getSoleReference() const override { return m_Matcher->getSoleReference(); }
+		virtual const IMatcher* getRepeatedReference() const override { return m_Matcher->getRepeatedReference(); }
+
+	private:
+		std::unique_ptr<IMatcher> m_Matcher;
+		std::size_t*              m_Steps;
+	};
+
+	// Matchers that only ever succeed or fail, so wrapping them in a sequence or alternative of one doesn't change their status
+	static bool NeverSkips(const GrammarNode& node)
+	{
+		switch (node.m_Op)
+		{
+		case EGrammarOp::Text:
+		case EGrammarOp::Regex:
+		case EGrammarOp::Space:
+		case EGrammarOp::Negative:
+		case EGrammarOp::Range:
+		case EGrammarOp::Cut:
+		case EGrammarOp::Combination: return true;
+		default: return false;
+		}
+	}
+
+	static bool IsChoice(EGrammarOp op)
+	{
+		return op == EGrammarOp::Or || op == EGrammarOp::Ordered;
+	}
+
+	// A cut commits the innermost choice around it, so moving it out of its choice changes what that commits
+	static bool ContainsCut(const GrammarNode& node)
+	{
+		if (node.m_Op == EGrammarOp::Cut)
+			return true;
+		for (auto& child : node.m_Children)
+			if (ContainsCut(child))
+				return true;
+		return false;
+	}
+
+	// A choice drops the nodes of an alternative that failed, a sequence keeps them, so a choice around anything that can add nodes has to stay
+	static bool MayAddNodes(const GrammarNode& node)
+	{
+		if (node.m_Op == EGrammarOp::Reference)
+			return true;
+		for (auto& child : node.m_Children)
+			if (MayAddNodes(child))
+				return true;
+		return false;
+	}
+
+	// Named groups are state that a failed alternative may leave changed for the next one
+	static bool UsesNamedGroups(const GrammarNode& node)
+	{
+		if (node.m_Op == EGrammarOp::NamedGroup || node.m_Op == EGrammarOp::NamedGroupReference)
+			return true;
+		for (auto& child : node.m_Children)
+			if (UsesNamedGroups(child))
+				return true;
+		return false;
+	}
+
+	// A head depending on nothing but the source matches the same at the start of every alternative, so a shared one can be matched once for all of them.
+	// References to other rules count too, the nodes they add are the same either way. The rule's own would turn left recursion into something else.
+	static const GrammarNode* GetHead(const GrammarNode& node, std::string_view rule)
+	{
+		const GrammarNode* head = node.m_Op == EGrammarOp::Combination ? (node.m_Children.empty() ? nullptr : &node.m_Children[0]) : &node;
+		if (!head || head->m_Op == EGrammarOp::Combination || IsChoice(head->m_Op) || ContainsCut(*head) || UsesNamedGroups(*head))
+			return nullptr;
+		if (head->m_Op == EGrammarOp::Reference && head->m_Text == rule)
+			return nullptr;
+		return head;
+	}
+
+	static GrammarNode GetRest(GrammarNode&& node)
+	{
+		GrammarNode rest { .m_Op = EGrammarOp::Combination };
+		if (node.m_Op == EGrammarOp::Combination)
+			rest.m_Children.assign(std::make_move_iterator(node.m_Children.begin() + 1), std::make_move_iterator(node.m_Children.end()));
+		if (rest.m_Children.size() == 1 && NeverSkips(rest.m_Children[0]))
+			return std::move(rest.m_Children[0]);
+		return rest;
+	}
+
+	static void CollectReferences(const GrammarNode& node, std::vector<std::string_view>& references)
+	{
+		if (node.m_Op == EGrammarOp::Reference)
+			references.emplace_back(node.m_Text);
+		for (auto& child : node.m_Children)
+			CollectReferences(child, references);
+	}
+
+	static std::unique_ptr<IMatcher> CreateMatcher(const GrammarNode& node, std::size_t* steps)
+	{
+		std::unique_ptr<IMatcher> matcher;
+		switch (node.m_Op)
+		{
+		case EGrammarOp::Text:
+			matcher = std::make_unique<TextMatcher>(node.m_Text);
+			break;
+		case EGrammarOp::Regex:
+			if (auto run = Regex::Get(node.m_Text)->getCharRun())
+			{
+				if (run->m_Rest.none() && !run->m_Optional)
+					matcher = std::make_unique<CharClassMatcher>(run->m_First);
+				else
+					matcher = std::make_unique<CharRunMatcher>(*run);
+			}
+			else
+			{
+				matcher = std::make_unique<RegexMatcher>(node.m_Text);
+			}
+			break;
+		case EGrammarOp::Reference:
+			matcher = std::make_unique<ReferenceMatcher>(node.m_Text);
+			break;
+		case EGrammarOp::NamedGroup:
+			matcher = std::make_unique<NamedGroupMatcher>(node.m_Text, CreateMatcher(node.m_Children[0], steps));
+			break;
+		case EGrammarOp::NamedGroupReference:
+			matcher = std::make_unique<NamedGroupReferenceMatcher>(node.m_Text);
+			break;
+		case EGrammarOp::Space:
+			matcher = std::make_unique<SpaceMatcher>(CreateMatcher(node.m_Children[0], steps), node.m_Forced, node.m_SpaceMethod, node.m_SpaceDirection);
+			break;
+		case EGrammarOp::Negative:
+			matcher = std::make_unique<NegativeMatcher>(CreateMatcher(node.m_Children[0], steps));
+			break;
+		case EGrammarOp::Optional:
+			matcher = std::make_unique<OptionalMatcher>(CreateMatcher(node.m_Children[0], steps));
+			break;
+		case EGrammarOp::Range:
+			matcher = std::make_unique<RangeMatcher>(CreateMatcher(node.m_Children[0], steps), node.m_LowerBounds, node.m_UpperBounds);
+			break;
+		case EGrammarOp::Cut:
+			matcher = std::make_unique<CutMatcher>();
+			break;
+		case EGrammarOp::Combination:
+		case EGrammarOp::Or:
+		case EGrammarOp::Ordered:
+		{
+			// Alternatives that are all text literals are matched by a single trie instead of one text matcher each
+			if (node.m_Op == EGrammarOp::Or && node.m_Children.size() >= 2 &&
+			    std::all_of(node.m_Children.begin(), node.m_Children.end(), [](const GrammarNode& child) { return child.m_Op == EGrammarOp::Text; }))
+			{
+				std::vector<std::string> literals;
+				literals.reserve(node.m_Children.size());
+				for (auto& child : node.m_Children)
+					literals.push_back(child.m_Text);
+				matcher = std::make_unique<LiteralSetMatcher>(std::move(literals));
+				break;
+			}
+
+			std::vector<std::unique_ptr<IMatcher>> matchers;
+			matchers.reserve(node.m_Children.size());
+			for (auto& child : node.m_Children)
+				matchers.push_back(CreateMatcher(child, steps));
+			if (IsChoice(node.m_Op))
+				matcher = std::make_unique<OrMatcher>(std::move(matchers), node.m_Op == EGrammarOp::Ordered);
+			else
+				matcher = std::make_unique<CombinationMatcher>(std::move(matchers));
+			break;
+		}
+		}
+
+		if (steps)
+			return std::make_unique<StepCountingMatcher>(std::move(matcher), steps);
+		return matcher;
+	}
+
+	std::size_t GrammarNode::getSize() const
+	{
+		std::size_t size = 1;
+		for (auto& child : m_Children)
+			size += child.getSize();
+		return size;
+	}
+
+	void Grammar::addRule(GrammarRule&& rule)
+	{
+		m_RuleIndices.insert_or_assign(rule.m_Name, m_Rules.size());
+		m_Rules.push_back(std::move(rule));
+	}
+
+	bool Grammar::hasRule(std::string_view name) const
+	{
+		return m_RuleIndices.contains(std::string { name });
+	}
+
+	GrammarStats Grammar::getStats() const
+	{
+		GrammarStats stats;
+		stats.m_Rules = m_Rules.size();
+		for (auto& rule : m_Rules)
+			if (!rule.m_Callback)
+				stats.m_Matchers += rule.m_Matcher.getSize();
+		return stats;
+	}
+
+	GrammarOptimizeStats Grammar::optimize()
+	{
+		GrammarOptimizeStats stats;
+		stats.m_Before = getStats();
+
+		auto begin = std::chrono::high_resolution_clock::now();
+		inlineRules(stats);
+		for (auto& rule : m_Rules)
+			if (!rule.m_Callback)
+				simplify(rule.m_Matcher, rule.m_Name, stats);
+		removeDeadRules(stats);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		stats.m_After   = getStats();
+		stats.m_Seconds = std::chrono::duration<double>(end - begin).count();
+		return stats;
+	}
+
+	void Grammar::registerRules(Lexer& lexer, std::size_t* steps) const
+	{
+		if (!m_MainRule.empty())
+			lexer.setMainRule(m_MainRule);
+
+		for (auto& rule : m_Rules)
+		{
+			if (rule.m_Callback)
+			{
+				lexer.registerRule(std::make_unique<CallbackRule>(rule.m_Name, CallbackRule::Callback { rule.m_Callback }, rule.m_CreateNode));
+				continue;
+			}
+
+			auto matcherRule = std::make_unique<MatcherRule>(rule.m_Name, CreateMatcher(rule.m_Matcher, steps), rule.m_CreateNode);
+			matcherRule->setMemoize(rule.m_Memoize);
+			lexer.registerRule(std::move(matcherRule));
+		}
+		lexer.hashGrammar();
+	}
+
+	void Grammar::inlineRules(GrammarOptimizeStats& stats)
+	{
+		std::vector<std::vector<std::size_t>> references(m_Rules.size());
+		std::vector<std::size_t>              referenceCounts(m_Rules.size());
+		for (std::size_t i = 0; i < m_Rules.size(); ++i)
+		{
+			std::vector<std::string_view> names;
+			CollectReferences(m_Rules[i].m_Matcher, names);
+			for (auto name : names)
+			{
+				auto itr = m_RuleIndices.find(std::string { name });
+				if (itr == m_RuleIndices.end())
+					continue;
+				references[i].push_back(itr->second);
+				++referenceCounts[itr->second];
+			}
+		}
+
+		auto isRecursive = [&](std::size_t rule) {
+			std::vector<bool>        visited(m_Rules.size());
+			std::vector<std::size_t> pending = references[rule];
+			while (!pending.empty())
+			{
+				std::size_t current = pending.back();
+				pending.pop_back();
+				if (current == rule)
+					return true;
+				if (visited[current])
+					continue;
+				visited[current] = true;
+				pending.insert(pending.end(), references[current].begin(), references[current].end());
+			}
+			return false;
+		};
+
+		// Named rules add nodes and memoized rules store results, both need the rule to exist when matching.
+		// Nothing is inlined into the main rule either, it decides when a streaming source may drop what was matched.
+		std::vector<bool> candidates(m_Rules.size()), recursive(m_Rules.size());
+		for (std::size_t i = 0; i < m_Rules.size(); ++i)
+		{
+			auto& rule    = m_Rules[i];
+			candidates[i] = !rule.m_CreateNode && !rule.m_Memoize && !rule.m_Callback && rule.m_Name != m_MainRule && !ContainsCut(rule.m_Matcher) &&
+			                (rule.m_Matcher.getSize() <= s_InlineSize || referenceCounts[i] == 1);
+			recursive[i]  = candidates[i] && isRecursive(i);
+		}
+
+		// A recursive rule is expanded again at every use and left as a reference once it is already being expanded,
+		// the others are expanded once and copied
+		std::vector<std::optional<GrammarNode>> bodies(m_Rules.size());
+		std::vector<bool>                       expanding(m_Rules.size());
+		std::function<void(GrammarNode&)>       expand = [&](GrammarNode& node) {
+			if (node.m_Op != EGrammarOp::Reference)
+			{
+				for (auto& child : node.m_Children)
+					expand(child);
+				return;
+			}
+
+			auto itr = m_RuleIndices.find(node.m_Text);
+			if (itr == m_RuleIndices.end() || !candidates[itr->second] || expanding[itr->second])
+				return;
+
+			std::size_t index = itr->second;
+			// Copies of what a rule inlined would multiply at every use, so the expanded body has to stay small for that
+			bool copied = referenceCounts[index] > 1;
+			if (recursive[index])
+			{
+				GrammarNode body = m_Rules[index].m_Matcher;
+				expanding[index] = true;
+				expand(body);
+				expanding[index] = false;
+				if (copied && body.getSize() > s_InlineSize)
+					return;
+				node = std::move(body);
+			}
+			else
+			{
+				auto& body = bodies[index];
+				if (!body)
+				{
+					body = m_Rules[index].m_Matcher;
+					expand(*body);
+				}
+				if (copied && body->getSize() > s_InlineSize)
+					return;
+				node = *body;
+			}
+			++stats.m_Inlined;
+		};
+		for (std::size_t i = 0; i < m_Rules.size(); ++i)
+		{
+			auto& rule = m_Rules[i];
+			if (rule.m_Callback || rule.m_Name == m_MainRule)
+				continue;
+
+			expanding[i] = true;
+			expand(rule.m_Matcher);
+			expanding[i] = false;
+		}
+	}
+
+	void Grammar::simplify(GrammarNode& node, std::string_view rule, GrammarOptimizeStats& stats)
+	{
+		for (auto& child : node.m_Children)
+			simplify(child, rule, stats);
+
+		if (node.m_Op != EGrammarOp::Combination && !IsChoice(node.m_Op))
+			return;
+
+		std::vector<GrammarNode> children;
+		children.reserve(node.m_Children.size());
+		for (auto& child : node.m_Children)
+		{
+			if (child.m_Op == node.m_Op && (node.m_Op == EGrammarOp::Combination || !ContainsCut(child)))
+			{
+				children.insert(children.end(), std::make_move_iterator(child.m_Children.begin()), std::make_move_iterator(child.m_Children.end()));
+				++stats.m_Flattened;
+			}
+			else if (node.m_Op == EGrammarOp::Combination && child.m_Op == EGrammarOp::Text && !children.empty() && children.back().m_Op == EGrammarOp::Text)
+			{
+				children.back().m_Text += child.m_Text;
+				++stats.m_Merged;
+			}
+			else
+			{
+				children.push_back(std::move(child));
+			}
+		}
+
+		// Only neighbouring alternatives are factored, the first of equally long matches wins so their order has to stay
+		if (IsChoice(node.m_Op))
+		{
+			std::vector<GrammarNode> alternatives;
+			alternatives.reserve(children.size());
+			for (std::size_t i = 0; i < children.size();)
+			{
+				auto        head = ContainsCut(children[i]) ? nullptr : GetHead(children[i], rule);
+				std::size_t end  = i + 1;
+				while (head && end < children.size() && !ContainsCut(children[end]) && GetHead(children[end], rule) && *GetHead(children[end], rule) == *head)
+					++end;
+				if (end - i < 2)
+				{
+					alternatives.push_back(std::move(children[i++]));
+					continue;
+				}
+
+				GrammarNode factored { .m_Op = EGrammarOp::Combination };
+				GrammarNode rests { .m_Op = node.m_Op };
+				factored.m_Children.push_back(*head);
+				for (; i < end; ++i)
+					rests.m_Children.push_back(GetRest(std::move(children[i])));
+				simplify(rests, rule, stats);
+				factored.m_Children.push_back(std::move(rests));
+				alternatives.push_back(std::move(factored));
+				++stats.m_Factored;
+			}
+			children = std::move(alternatives);
+		}
+
+		node.m_Children = std::move(children);
+		if (node.m_Children.size() == 1 && (IsChoice(node.m_Op) ? !ContainsCut(node.m_Children[0]) && !MayAddNodes(node.m_Children[0]) : NeverSkips(node.m_Children[0])))
+		{
+			GrammarNode child = std::move(node.m_Children[0]);
+			node              = std::move(child);
+		}
+	}
+
+	void Grammar::removeDeadRules(GrammarOptimizeStats& stats)
+	{
+		auto mainItr = m_RuleIndices.find(m_MainRule);
+		if (mainItr == m_RuleIndices.end())
+			return;
+
+		std::vector<bool>        reachable(m_Rules.size());
+		std::vector<std::size_t> pending { mainItr->second };
+		while (!pending.empty())
+		{
+			std::size_t current = pending.back();
+			pending.pop_back();
+			if (reachable[current])
+				continue;
+			reachable[current] = true;
+
+			std::vector<std::string_view> names;
+			CollectReferences(m_Rules[current].m_Matcher, names);
+			for (auto name : names)
+			{
+				auto itr = m_RuleIndices.find(std::string { name });
+				if (itr != m_RuleIndices.end())
+					pending.push_back(itr->second);
+			}
+		}
+
+		// Callback rules are kept, whoever supplied them might look them up
+		std::vector<GrammarRule> rules;
+		rules.reserve(m_Rules.size());
+		for (std::size_t i = 0; i < m_Rules.size(); ++i)
+		{
+			if (reachable[i] || m_Rules[i].m_Callback)
+				rules.push_back(std::move(m_Rules[i]));
+			else
+				++stats.m_Removed;
+		}
+
+		m_Rules = std::move(rules);
+		m_RuleIndices.clear();
+		for (std::size_t i = 0; i < m_Rules.size(); ++i)
+			m_RuleIndices.emplace(m_Rules[i].m_Name, i);
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include "CommonLexer/Hash.h"
+
+#include <cstring>
+
+namespace CommonLexer::Hash
+{
+	std::uint64_t Bytes(std::string_view data, std::uint64_t seed)
+	{
+		// Two lanes so the multiplies of one word don't wait on the previous one
+		std::uint64_t lanes[2] { Combine(seed, data.size()), Mix(seed ^ 0x6A09E667F3BCC909ULL) };
+
+		const char* itr  = data.data();
+		std::size_t size = data.size();
+		for (; size >= 16; itr += 16, size -= 16)
+		{
+			std::uint64_t words[2];
+			std::memcpy(words, itr, 16);
+			lanes[0] = Mix(lanes[0] ^ words[0]);
+			lanes[1] = Mix(lanes[1] ^ words[1]);
+		}
+
+		std::uint64_t tail[2] {};
+		std::memcpy(tail, itr, size);
+		lanes[0] = Mix(lanes[0] ^ tail[0]);
+		lanes[1] = Mix(lanes[1] ^ tail[1]);
+		return Combine(lanes[0], lanes[1]);
+	}
+} // namespace CommonLexer::Hash
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "CommonLexer/JobPool.h"
+
+#include <algorithm>
+
+namespace CommonLexer
+{
+	JobPool::JobPool(std::size_t workers)
+	{
+		if (workers == 0)
+			workers = std::max<std::size_t>(std::thread::hardware_concurrency(), 2) - 1;
+
+		// The last queue belongs to the waiting thread
+		for (std::size_t i = 0; i <= workers; ++i)
+			m_Queues.push_back(std::make_unique<Queue>());
+		m_Workers.reserve(workers);
+		for (std::size_t i = 0; i < workers; ++i)
+			m_Workers.emplace_back(&JobPool::work, this, i);
+	}
+
+	JobPool::~JobPool()
+	{
+		wait();
+		{
+			std::lock_guard lock { m_Mutex };
+			m_Stop = true;
+		}
+		m_JobsAvailable.notify_all();
+		for (auto& worker : m_Workers)
+			worker.join();
+	}
+
+	void JobPool::push(Job&& job)
+	{
+		// Counted before it is queued, so a worker can never take a job that isn't counted yet
+		{
+			std::lock_guard lock { m_Mutex };
+			++m_Queued;
+			++m_Pending;
+		}
+		auto& queue = *m_Queues[m_NextQueue++ % m_Queues.size()];
+		{
+			std::lock_guard lock { queue.m_Mutex };
+			queue.m_Jobs.push_back(std::move(job));
+		}
+		m_JobsAvailable.notify_one();
+	}
+
+	void JobPool::wait()
+	{
+		std::size_t queue = m_Queues.size() - 1;
+		while (runOne(queue)) {}
+
+		std::unique_lock lock { m_Mutex };
+		m_JobsDone.wait(lock, [this]() { return m_Pending == 0; });
+	}
+
+	bool JobPool::runOne(std::size_t queue)
+	{
+		Job job;
+		for (std::size_t i = 0; i < m_Queues.size() && !job; ++i)
+		{
+			auto&           victim = *m_Queues[(queue + i) % m_Queues.size()];
+			std::lock_guard lock { victim.m_Mutex };
+			if (victim.m_Jobs.empty())
+				continue;
+
+			if (i == 0)
+			{
+				job = std::move(victim.m_Jobs.back());
+				victim.m_Jobs.pop_back();
+			}
+			else
+			{
+				job = std::move(victim.m_Jobs.front());
+				victim.m_Jobs.pop_front();
+			}
+		}
+		if (!job)
+			return false;
+
+		{
+			std::lock_guard lock { m_Mutex };
+			--m_Queued;
+		}
+		job();
+
+		bool done;
+		{
+			std::lock_guard lock { m_Mutex };
+			done = --m_Pending == 0;
+		}
+		if (done)
+			m_JobsDone.notify_all();
+		return true;
+	}
+
+	void JobPool::work(std::size_t queue)
+	{
+		while (true)
+		{
+			if (runOne(queue))
+				continue;
+
+			std::unique_lock lock { m_Mutex };
+			m_JobsAvailable.wait(lock, [this]() { return m_Stop || m_Queued > 0; });
+			if (m_Stop)
+				return;
+		}
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include "CommonLexer/LexCache.h"
+#include "CommonLexer/Hash.h"
+#include "CommonLexer/NodeArena.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#include <fmt/format.h>
+
+namespace CommonLexer
+{
+	// "MLEX" read as a little endian integer
+	static constexpr std::uint32_t s_Magic = 0x58454C4D;
+
+	// Every section starts on 8 bytes, so a mapped file could be read in place.
+	// The node arrays are the ones of NodeArena, followed by the restart points and the messages with their text.
+	struct LexCacheHeader
+	{
+	public:
+		std::uint32_t m_Magic;
+		std::uint32_t m_Version;
+		std::uint64_t m_LibraryVersion;
+		std::uint64_t m_ContentHash;
+		std::uint64_t m_GrammarHash;
+		std::uint64_t m_SourceSize;
+		std::uint64_t m_Nodes;
+		std::uint64_t m_RestartPoints;
+		std::uint64_t m_Messages;
+		std::uint64_t m_FarthestFailures;
+	};
+
+	template <class T>
+	static void Append(std::string& out, T value)
+	{
+		out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	static void Align(std::string& out)
+	{
+		out.resize((out.size() + 7) & ~std::size_t { 7 });
+	}
+
+	template <class T, class Getter>
+	static void AppendArray(std::string& out, const NodeArena& arena, Getter getter)
+	{
+		for (NodeIndex index = 0; index < arena.size(); ++index)
+			Append<T>(out, getter(index));
+		Align(out);
+	}
+
+	static void AppendMessage(std::string& out, const Message& message)
+	{
+		auto text = message.getMessage();
+		Append<std::uint64_t>(out, message.getPoint().m_Index);
+		Append<std::uint64_t>(out, message.getSpan().m_Begin.m_Index);
+		Append<std::uint64_t>(out, message.getSpan().m_End.m_Index);
+		Append<std::uint32_t>(out, static_cast<std::uint32_t>(message.getSeverity()));
+		Append<std::uint32_t>(out, static_cast<std::uint32_t>(text.size()));
+		out += text;
+		Align(out);
+	}
+
+	// The mapping has no alignment the compiler knows of, so values are copied out instead of read in place
+	template <class T>
+	static T LoadAt(const char* array, std::size_t index)
+	{
+		T value;
+		std::memcpy(&value, array + index * sizeof(T), sizeof(T));
+		return value;
+	}
+
+	struct LexCacheReader
+	{
+	public:
+		template <class T>
+		bool read(T& value)
+		{
+			if (sizeof(T) > m_Data.size() - m_Offset)
+				return false;
+			std::memcpy(&value, m_Data.data() + m_Offset, sizeof(T));
+			m_Offset += sizeof(T);
+			return true;
+		}
+
+		// Skips the section and its padding, nullptr if the data ends before it does
+		const char* readSection(std::size_t size)
+		{
+			std::size_t aligned = (size + 7) & ~std::size_t { 7 };
+			if (size > m_Data.size() || aligned > m_Data.size() - m_Offset)
+				return nullptr;
+			const char* section = m_Data.data() + m_Offset;
+			m_Offset += aligned;
+			return section;
+		}
+
+		std::optional<Message> readMessage(std::size_t sourceSize)
+		{
+			std::uint64_t point, begin, end;
+			std::uint32_t severity, size;
+			if (!read(point) || !read(begin) || !read(end) || !read(severity) || !read(size))
+				return {};
+
+			const char* text = readSection(size);
+			if (!text || point > sourceSize || begin > end || end > sourceSize || severity > static_cast<std::uint32_t>(EMessageSeverity::Error))
+				return {};
+			return Message { std::string { text, size }, { point }, { { begin }, { end } }, static_cast<EMessageSeverity>(severity) };
+		}
+
+	public:
+		std::string_view m_Data;
+		std::size_t      m_Offset = 0;
+	};
+
+	struct LexCacheNodes
+	{
+	public:
+		// Nodes have to come in depth first order, so a damaged file can't make a node be built twice
+		bool build(Node& node, NodeIndex index)
+		{
+			if (index != m_Next || index >= m_Count)
+				return false;
+			++m_Next;
+
+			auto rule  = LoadAt<RuleID>(m_Rules, index);
+			auto begin = LoadAt<std::uint64_t>(m_Begins, index);
+			auto end   = LoadAt<std::uint64_t>(m_Ends, index);
+			if (rule >= m_Lexer->getRuleNameCount() || begin > end || end > m_SourceSize)
+				return false;
+			node.setRule(rule);
+			node.setSpan({ { begin }, { end } });
+
+			std::size_t children = 0;
+			for (auto child = LoadAt<NodeIndex>(m_FirstChildren, index); child != NodeArena::s_NoNode; ++children)
+			{
+				if (child >= m_Count)
+					return false;
+				auto next = LoadAt<NodeIndex>(m_NextSiblings, child);
+				if (next != NodeArena::s_NoNode && next <= child)
+					return false;
+				child = next;
+			}
+
+			node.reserveChildren(children);
+			for (auto child = LoadAt<NodeIndex>(m_FirstChildren, index); child != NodeArena::s_NoNode; child = LoadAt<NodeIndex>(m_NextSiblings, child))
+			{
+				Node childNode(*m_Lexer);
+				if (!build(childNode, child))
+					return false;
+				node.addChild(std::move(childNode));
+			}
+			return true;
+		}
+
+	public:
+		const Lexer* m_Lexer;
+		std::size_t  m_Count;
+		std::size_t  m_SourceSize;
+		const char*  m_Rules;
+		const char*  m_Begins;
+		const char*  m_Ends;
+		const char*  m_FirstChildren;
+		const char*  m_NextSiblings;
+		NodeIndex    m_Next = 0;
+	};
+
+	LexCache::LexCache(const std::filesystem::path& directory)
+	    : m_Directory(directory) {}
+
+	std::optional<Lex> LexCache::load(const Lexer& lexer, ISource* source) const
+	{
+		if (!source || lexer.getGrammarHash() == 0)
+			return {};
+
+		auto       begin = std::chrono::high_resolution_clock::now();
+		FileSource file(getPath(hashSource(source), lexer.getGrammarHash()));
+		auto       data = file.isOpen() ? file.data() : std::nullopt;
+		if (!data)
+			return {};
+
+		auto lex = deserialize(lexer, source, *data);
+		if (lex)
+			lex->setDuration(std::chrono::high_resolution_clock::now() - begin);
+		return lex;
+	}
+
+	bool LexCache::store(const Lex& lex) const
+	{
+		if (!lex.getSource() || lex.getLexer()->getGrammarHash() == 0)
+			return false;
+
+		std::error_code error;
+		std::filesystem::create_directories(m_Directory, error);
+		if (error)
+			return false;
+
+		// Written next to the file and renamed over it, so other processes never map a file that is half written
+		auto path = getPath(hashSource(lex.getSource()), lex.getLexer()->getGrammarHash());
+		auto temp = path;
+		temp += fmt::format(".{:x}.tmp", Hash::Combine(std::hash<std::thread::id> {}(std::this_thread::get_id()), static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count())));
+		{
+			auto          data = serialize(lex);
+			std::ofstream file { temp, std::ios::binary };
+			if (!file || !file.write(data.data(), static_cast<std::streamsize>(data.size())))
+			{
+				file.close();
+				std::filesystem::remove(temp, error);
+				return false;
+			}
+		}
+
+		std::filesystem::rename(temp, path, error);
+		if (error)
+		{
+			std::filesystem::remove(temp, error);
+			return false;
+		}
+		return true;
+	}
+
+	Lex LexCache::lexSource(const Lexer& lexer, ISource* source) const
+	{
+		if (auto lex = load(lexer, source))
+			return std::move(*lex);
+
+		auto lex = lexer.lexSource(source);
+		store(lex);
+		return lex;
+	}
+
+	std::filesystem::path LexCache::getPath(std::uint64_t contentHash, std::uint64_t grammarHash) const
+	{
+		return m_Directory / fmt::format("{:016x}-{:016x}.lex", contentHash, grammarHash);
+	}
+
+	std::uint64_t LexCache::hashSource(ISource* source)
+	{
+		if (auto data = source->data())
+			return Hash::Bytes(*data);
+		return Hash::Bytes(source->getSpan(0, source->getSize()));
+	}
+
+	std::string LexCache::serialize(const Lex& lex)
+	{
+		NodeArena arena(lex.getRoot());
+
+		auto& restartPoints   = lex.getRestartPoints();
+		auto& messages        = lex.getMessages();
+		auto& farthestFailure = lex.getFarthestFailure();
+
+		LexCacheHeader header {
+			.m_Magic            = s_Magic,
+			.m_Version          = s_Version,
+			.m_LibraryVersion   = s_LibraryVersion,
+			.m_ContentHash      = hashSource(lex.getSource()),
+			.m_GrammarHash      = lex.getLexer()->getGrammarHash(),
+			.m_SourceSize       = lex.getSource()->getSize(),
+			.m_Nodes            = arena.size(),
+			.m_RestartPoints    = restartPoints.size(),
+			.m_Messages         = messages.size(),
+			.m_FarthestFailures = farthestFailure.has_value()
+		};
+
+		std::string out;
+		out.reserve(sizeof(header) + arena.size() * 32 + restartPoints.size() * 16);
+		Append(out, header);
+
+		AppendArray<RuleID>(out, arena, [&](NodeIndex index) { return arena.getRuleID(index); });
+		AppendArray<std::uint64_t>(out, arena, [&](NodeIndex index) { return arena.getSpan(index).m_Begin.m_Index; });
+		AppendArray<std::uint64_t>(out, arena, [&](NodeIndex index) { return arena.getSpan(index).m_End.m_Index; });
+		AppendArray<NodeIndex>(out, arena, [&](NodeIndex index) { return arena.getFirstChild(index); });
+		AppendArray<NodeIndex>(out, arena, [&](NodeIndex index) { return arena.getNextSibling(index); });
+
+		for (auto& point : restartPoints)
+		{
+			Append<std::uint64_t>(out, point.m_Index);
+			Append<std::uint64_t>(out, point.m_Nodes);
+		}
+		for (auto& message : messages)
+			AppendMessage(out, message);
+		if (farthestFailure)
+			AppendMessage(out, *farthestFailure);
+		return out;
+	}
+
+	std::optional<Lex> LexCache::deserialize(const Lexer& lexer, ISource* source, std::string_view data)
+	{
+		LexCacheReader reader { data };
+		LexCacheHeader header;
+		if (!source || !reader.read(header) || header.m_Magic != s_Magic || header.m_Version != s_Version || header.m_LibraryVersion != s_LibraryVersion || header.m_GrammarHash != lexer.getGrammarHash() || header.m_SourceSize != source->getSize())
+			return {};
+		if (header.m_Nodes == 0 || header.m_Nodes >= NodeArena::s_NoNode || header.m_FarthestFailures > 1 || header.m_ContentHash != hashSource(source))
+			return {};
+
+		std::size_t   count = header.m_Nodes;
+		LexCacheNodes nodes {
+			.m_Lexer         = &lexer,
+			.m_Count         = count,
+			.m_SourceSize    = header.m_SourceSize,
+			.m_Rules         = reader.readSection(count * sizeof(RuleID)),
+			.m_Begins        = reader.readSection(count * sizeof(std::uint64_t)),
+			.m_Ends          = reader.readSection(count * sizeof(std::uint64_t)),
+			.m_FirstChildren = reader.readSection(count * sizeof(NodeIndex)),
+			.m_NextSiblings  = reader.readSection(count * sizeof(NodeIndex))
+		};
+		if (!nodes.m_Rules || !nodes.m_Begins || !nodes.m_Ends || !nodes.m_FirstChildren || !nodes.m_NextSiblings)
+			return {};
+
+		Lex lex(lexer, source);
+		if (!nodes.build(lex.getRoot(), 0) || nodes.m_Next != count)
+			return {};
+
+		const char* points = header.m_RestartPoints < data.size() ? reader.readSection(header.m_RestartPoints * 2 * sizeof(std::uint64_t)) : nullptr;
+		if (!points)
+			return {};
+		std::vector<RestartPoint> restartPoints(header.m_RestartPoints);
+		for (std::size_t i = 0; i < restartPoints.size(); ++i)
+		{
+			restartPoints[i] = { LoadAt<std::uint64_t>(points, i * 2), LoadAt<std::uint64_t>(points, i * 2 + 1) };
+			if (restartPoints[i].m_Index > header.m_SourceSize || restartPoints[i].m_Nodes > lex.getRoot().getChildren().size())
+				return {};
+		}
+
+		std::vector<Message> messages;
+		for (std::size_t i = 0; i < header.m_Messages + header.m_FarthestFailures; ++i)
+		{
+			auto message = reader.readMessage(header.m_SourceSize);
+			if (!message)
+				return {};
+			messages.push_back(std::move(*message));
+		}
+		if (header.m_FarthestFailures > 0)
+		{
+			lex.setFarthestFailure(std::move(messages.back()));
+			messages.pop_back();
+		}
+
+		lex.setRestartPoints(std::move(restartPoints));
+		lex.setMessages(std::move(messages));
+		return lex;
+	}
+} // namespace CommonLexer
\ No newline at end of file
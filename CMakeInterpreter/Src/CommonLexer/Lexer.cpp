@@ -1,13 +1,74 @@
 #include "CommonLexer/Lexer.h"
+#include "CommonLexer/Hash.h"
+#include "CommonLexer/JobPool.h"
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <thread>
 #include <utility>
 
+#include <fmt/format.h>
+
 namespace CommonLexer
 {
-	Lex::Lex(Lexer& lexer)
+	// Runs job(0) to job(count - 1), on the calling thread alone when there is one job or less
+	static void RunJobs(std::size_t count, std::size_t jobs, const std::function<void(std::size_t)>& job)
+	{
+		if (jobs == 0)
+			jobs = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+		jobs = std::min(jobs, count);
+
+		if (jobs <= 1)
+		{
+			for (std::size_t i = 0; i < count; ++i)
+				job(i);
+			return;
+		}
+
+		// The calling thread runs jobs too, so one worker less than jobs
+		JobPool pool { jobs - 1 };
+		for (std::size_t i = 0; i < count; ++i)
+			pool.push([&job, i]() { job(i); });
+		pool.wait();
+	}
+
+	// Whatever matched where the source had recycled its data saw '\0' there instead, so the lex can't be trusted
+	static void NoteRecycledRead(ISource* source, std::vector<Message>& messages)
+	{
+		std::size_t index = source->getRecycledReadIndex();
+		if (index != ~0ULL)
+			messages.emplace_back(fmt::format("Read index {} after the source recycled it, the main rule went back over committed elements", index), SourcePoint { index }, SourceSpan { index, index });
+	}
+
+	static std::size_t EstimateBytes(const Node& node)
+	{
+		std::size_t bytes = sizeof(Node);
+		for (auto& child : node.getChildren())
+			bytes += EstimateBytes(child);
+		return bytes;
+	}
+
+	static std::size_t EstimateBytes(const MemoEntry& entry)
+	{
+		std::size_t bytes = sizeof(MemoEntry);
+		for (auto& node : entry.m_Nodes)
+			bytes += EstimateBytes(node);
+		for (auto& message : entry.m_Messages)
+			bytes += sizeof(Message) + (message.getCode() == EMessageCode::Text ? message.getMessage().size() : 0);
+		return bytes;
+	}
+
+	double MemoStats::getHitRate() const
+	{
+		std::size_t lookups = m_Hits + m_Misses;
+		return lookups > 0 ? static_cast<double>(m_Hits) / static_cast<double>(lookups) : 0.0;
+	}
+
+	Lex::Lex(const Lexer& lexer)
 	    : m_Lexer(&lexer), m_Source(nullptr), m_Root(lexer) {}
 
-	Lex::Lex(Lexer& lexer, ISource* source)
+	Lex::Lex(const Lexer& lexer, ISource* source)
 	    : m_Lexer(&lexer), m_Source(source), m_Root(lexer) {}
 
 	void Lex::setSource(ISource* source)
@@ -20,65 +81,594 @@ namespace CommonLexer
 		m_Messages = std::move(messages);
 	}
 
-	Lex Lexer::lexSource(ISource* source)
+	void Lex::setFarthestFailure(std::optional<Message>&& failure)
+	{
+		m_FarthestFailure = std::move(failure);
+	}
+
+	void Lex::setMemoStats(const MemoStats& stats, std::vector<MemoStats>&& ruleStats)
+	{
+		m_MemoStats     = stats;
+		m_RuleMemoStats = std::move(ruleStats);
+	}
+
+	void Lex::setDuration(std::chrono::duration<double> duration)
+	{
+		m_Duration = duration;
+	}
+
+	void Lex::setRestartPoints(std::vector<RestartPoint>&& points)
+	{
+		m_RestartPoints = std::move(points);
+	}
+
+	void LexState::noteFailure(const Message& message)
+	{
+		if (!m_FarthestFailure || message.getPoint().m_Index > m_FarthestFailure->getPoint().m_Index)
+			m_FarthestFailure = message;
+	}
+
+	void LexState::setGroupedValue(const std::string& group, SourceSpan span)
+	{
+		m_GroupedValues.insert_or_assign(group, span);
+	}
+
+	void LexState::setGroupedValue(std::string&& group, SourceSpan span)
+	{
+		m_GroupedValues.insert_or_assign(std::move(group), span);
+	}
+
+	SourceSpan LexState::getGroupedValue(const std::string& group) const
+	{
+		auto itr = m_GroupedValues.find(group);
+		return itr != m_GroupedValues.end() ? itr->second : SourceSpan {};
+	}
+
+	const MemoEntry* LexState::findMemo(const void* key, std::string_view rule, SourceSpan span)
+	{
+		auto& ruleStats = m_RuleMemoStats[key];
+		if (ruleStats.m_Rule.empty())
+			ruleStats.m_Rule = rule;
+
+		auto itr = m_Memo.find(MemoKey { key, span.m_Begin.m_Index, span.m_End.m_Index });
+		if (itr == m_Memo.end())
+		{
+			++ruleStats.m_Misses;
+			++m_MemoStats.m_Misses;
+			return nullptr;
+		}
+		++ruleStats.m_Hits;
+		++m_MemoStats.m_Hits;
+		return &itr->second;
+	}
+
+	void LexState::storeMemo(const void* key, SourceSpan span, MemoEntry&& entry)
+	{
+		std::size_t bytes     = EstimateBytes(entry);
+		auto&       ruleStats = m_RuleMemoStats[key];
+		++ruleStats.m_Entries;
+		++m_MemoStats.m_Entries;
+		ruleStats.m_Bytes   += bytes;
+		m_MemoStats.m_Bytes += bytes;
+		m_MemoBytes         += bytes;
+
+		m_MemoStats.m_PeakBytes = std::max(m_MemoStats.m_PeakBytes, m_MemoBytes);
+		m_Memo.insert_or_assign(MemoKey { key, span.m_Begin.m_Index, span.m_End.m_Index }, std::move(entry));
+	}
+
+	std::vector<MemoStats> LexState::getRuleMemoStats() const
+	{
+		std::vector<MemoStats> stats;
+		stats.reserve(m_RuleMemoStats.size());
+		for (auto& [key, ruleStats] : m_RuleMemoStats)
+			stats.push_back(ruleStats);
+		std::sort(stats.begin(), stats.end(), [](const MemoStats& lhs, const MemoStats& rhs) { return lhs.m_Rule < rhs.m_Rule; });
+		return stats;
+	}
+
+	void LexState::noteRestartPoint(const Node* parent, std::size_t index)
+	{
+		if (parent != m_Root)
+			return;
+
+		while (!m_RestartPoints.empty() && m_RestartPoints.back().m_Index >= index)
+			m_RestartPoints.pop_back();
+		m_RestartPoints.push_back({ index, parent->getChildren().size() });
+	}
+
+	bool LexState::isStopPoint(std::size_t index) const
+	{
+		if (m_StopPoints.empty())
+			return false;
+
+		std::size_t previous = index - static_cast<std::size_t>(m_StopOffset);
+		auto        itr      = std::lower_bound(m_StopPoints.begin(), m_StopPoints.end(), previous, [](const RestartPoint& point, std::size_t value) { return point.m_Index < value; });
+		return itr != m_StopPoints.end() && itr->m_Index == previous;
+	}
+
+	std::size_t LexState::MemoKeyHash::operator()(const MemoKey& key) const
+	{
+		std::size_t hash = std::hash<const void*> {}(key.m_Rule);
+		hash ^= key.m_Begin + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+		hash ^= key.m_End + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+		return hash;
+	}
+
+	Lexer::Lexer()
+	{
+		getRuleID("");
+		getRuleID("Root");
+	}
+
+	Lex Lexer::lexSource(ISource* source) const
 	{
 		return lexSource(source, source->getCompleteSpan());
 	}
 
-	Lex Lexer::lexSource(ISource* source, SourceSpan span)
+	Lex Lexer::lexSource(ISource* source, SourceSpan span) const
 	{
-		m_GroupedValues.clear();
+		return lexSource(source, span, {});
+	}
 
+	Lex Lexer::lexSource(ISource* source, SourceSpan span, std::span<const RestartPoint> stopPoints) const
+	{
 		Lex  lex { *this, source };
 		auto rule = getRule(m_MainRule);
-		if (rule && source)
+		if (m_LinkDirty)
+		{
+			lex.setMessages({ Message { "Rules were registered or the main rule was set since the lexer was last linked", span.m_Begin, SourceSpan { span.m_Begin, span.m_Begin } } });
+		}
+		else if (rule && source)
 		{
 			auto& root = lex.getRoot();
-			root.setRule("Root");
+			root.setRule(s_RootRule);
 
-			MatcherState state { {}, &root, this, source, span, nullptr, span.m_Begin };
+			LexState lexState;
+			lexState.m_Root       = &root;
+			lexState.m_StopPoints = stopPoints;
+			MatcherState state { {}, &root, this, &lexState, source, span, nullptr, span.m_Begin };
 
+			auto begin  = std::chrono::steady_clock::now();
 			auto result = rule->match(state, span);
+			lex.setDuration(std::chrono::steady_clock::now() - begin);
 			if (result.m_Status == EMatchStatus::Success)
-				root.setSourceSpan(source, result.m_Span);
+				root.setSpan(result.m_Span);
 			else
-				root.setSourceSpan(source, { span.m_Begin, span.m_Begin });
+				root.setSpan({ span.m_Begin, span.m_Begin });
+			// Matching up to a stop point isn't stopping short, a lex that ends there wouldn't keep these
+			if (result.m_Status == EMatchStatus::Success && lexState.isStopPoint(result.m_Span.m_End.m_Index))
+				state.m_Messages.clear();
+			NoteRecycledRead(source, state.m_Messages);
 			lex.setMessages(std::move(state.m_Messages));
+			lex.setFarthestFailure(std::move(lexState.m_FarthestFailure));
+			lex.setMemoStats(lexState.m_MemoStats, lexState.getRuleMemoStats());
+			lex.setRestartPoints(std::move(lexState.m_RestartPoints));
+		}
+		return lex;
+	}
+
+	Lex Lexer::lexSource(ISource* source)
+	{
+		return lexSource(source, source->getCompleteSpan());
+	}
+
+	Lex Lexer::lexSource(ISource* source, SourceSpan span)
+	{
+		if (m_LinkDirty)
+			link();
+		return std::as_const(*this).lexSource(source, span);
+	}
+
+	std::vector<Lex> Lexer::lexSources(std::span<ISource* const> sources, std::size_t jobs) const
+	{
+		std::vector<Lex> lexes(sources.size(), Lex { *this });
+		RunJobs(sources.size(), jobs, [&](std::size_t i) {
+			lexes[i] = lexSource(sources[i]);
+		});
+		return lexes;
+	}
+
+	std::vector<Lex> Lexer::lexSources(std::span<ISource* const> sources, std::size_t jobs)
+	{
+		if (m_LinkDirty)
+			link();
+		return std::as_const(*this).lexSources(sources, jobs);
+	}
+
+	Lex Lexer::lexSourceSplit(ISource* source, std::span<const std::size_t> boundaries, std::size_t jobs) const
+	{
+		// Chunks read the source from several threads at once, which only a contiguous buffer allows.
+		// They stop at the next boundary by not matching another top level element there, so the main rule has to repeat one.
+		if (m_LinkDirty || !m_TopLevelReference || !source || !source->data())
+			return lexSource(source);
+
+		std::size_t               size  = source->getSize();
+		std::size_t               begin = 0;
+		std::vector<SourceSpan>   spans;
+		std::vector<RestartPoint> stopPoints;
+		for (auto boundary : boundaries)
+		{
+			if (boundary <= begin || boundary >= size)
+				continue;
+			spans.push_back({ { begin }, { boundary } });
+			stopPoints.push_back({ boundary, 0 });
+			begin = boundary;
 		}
+		spans.push_back({ { begin }, { size } });
+		if (spans.size() == 1)
+			return lexSource(source);
+
+		// Borrowing the whole buffer before the chunks start keeps their at() calls from writing to the shared source
+		source->prepareBlock();
+
+		auto             start = std::chrono::steady_clock::now();
+		std::vector<Lex> lexes(spans.size(), Lex { *this });
+		// Every chunk matches up to the end of the source, so attempts that read past its boundary fail where they do in a serial lex
+		RunJobs(spans.size(), jobs, [&](std::size_t i) {
+			lexes[i] = lexSource(source, { spans[i].m_Begin, { size } }, std::span { stopPoints }.subspan(i, i + 1 < spans.size() ? 1 : 0));
+		});
+
+		Lex   lex { *this, source };
+		auto& root = lex.getRoot();
+		root.setRule(s_RootRule);
+		root.setSpan({ { 0 }, { size } });
+
+		std::vector<Message>      messages;
+		std::optional<Message>    farthestFailure;
+		std::vector<RestartPoint> restartPoints;
+		for (std::size_t i = 0; i < lexes.size(); ++i)
+		{
+			// A chunk that stops short has an error or was split at the wrong place,
+			// the serial lex reports either exactly the way a lex of the whole source does
+			auto& chunk = lexes[i];
+			if (chunk.getRoot().getSpan().m_End.m_Index != spans[i].m_End.m_Index)
+				return lexSource(source);
+
+			std::size_t nodes = root.getChildren().size();
+			for (auto& point : chunk.getRestartPoints())
+				restartPoints.push_back({ point.m_Index, nodes + point.m_Nodes });
+			root.addChildren(std::move(chunk.getRoot()));
+			auto& chunkMessages = chunk.getMessages();
+			messages.insert(messages.end(), std::make_move_iterator(chunkMessages.begin()), std::make_move_iterator(chunkMessages.end()));
+
+			// The serial lex notes the earlier chunk's failures first and keeps the first on a tie
+			auto& failure = chunk.getFarthestFailure();
+			if (failure && (!farthestFailure || failure->getPoint().m_Index > farthestFailure->getPoint().m_Index))
+				farthestFailure = failure;
+		}
+		lex.setMessages(std::move(messages));
+		lex.setFarthestFailure(std::move(farthestFailure));
+		lex.setDuration(std::chrono::steady_clock::now() - start);
+		lex.setRestartPoints(std::move(restartPoints));
 		return lex;
 	}
 
+	Lex Lexer::lexSourceSplit(ISource* source, std::span<const std::size_t> boundaries, std::size_t jobs)
+	{
+		if (m_LinkDirty)
+			link();
+		return std::as_const(*this).lexSourceSplit(source, boundaries, jobs);
+	}
+
+	Lex Lexer::relexSource(Lex&& previous, std::span<const SourceEdit> edits) const
+	{
+		auto* source = previous.getSource();
+		if (edits.empty())
+			return std::move(previous);
+
+		// The damage runs from damageBegin to damageEnd in the edited source, everything after it moved by offset
+		std::size_t    damageBegin = edits.front().m_Begin.m_Index;
+		std::size_t    damageEnd   = damageBegin;
+		std::ptrdiff_t offset      = 0;
+		for (auto& edit : edits)
+		{
+			std::size_t begin = edit.m_Begin.m_Index;
+			if (damageEnd > begin)
+				damageEnd = damageEnd >= begin + edit.m_ErasedLength ? damageEnd - edit.m_ErasedLength + edit.m_InsertedLength : begin + edit.m_InsertedLength;
+			damageBegin = std::min(damageBegin, begin);
+			damageEnd   = std::max(damageEnd, begin + edit.m_InsertedLength);
+			offset += static_cast<std::ptrdiff_t>(edit.m_InsertedLength) - static_cast<std::ptrdiff_t>(edit.m_ErasedLength);
+		}
+
+		// A lex that stopped short kept the messages of everything before, a lex that got to the end threw them away,
+		// so only the latter can be picked up and only if the main rule put its elements on the root
+		auto        rule         = getRule(m_MainRule);
+		auto&       points       = previous.getRestartPoints();
+		auto&       previousRoot = previous.getRoot();
+		std::size_t size         = source ? source->getSize() : 0;
+		if (m_LinkDirty || !rule || !source || points.empty() || !previous.getMessages().empty() || previousRoot.getSpan().m_Begin.m_Index != 0 || previousRoot.getSpan().m_End.m_Index + static_cast<std::size_t>(offset) != size)
+			return lexSource(source);
+
+		auto start = std::chrono::steady_clock::now();
+
+		// An element ending right where the damage begins may have looked at its first character, so it is matched again
+		auto         byIndex      = [](const RestartPoint& point, std::size_t index) { return point.m_Index < index; };
+		auto         restart      = std::lower_bound(points.begin(), points.end(), damageBegin, byIndex);
+		auto         stop         = std::lower_bound(restart, points.end(), damageEnd - static_cast<std::size_t>(offset), byIndex);
+		RestartPoint restartPoint = restart == points.begin() ? RestartPoint {} : *(restart - 1);
+
+		Lex   lex { *this, source };
+		auto& root = lex.getRoot();
+		root.setRule(s_RootRule);
+		root.addChildren(std::move(previousRoot), 0, restartPoint.m_Nodes);
+
+		LexState lexState;
+		lexState.m_Root = &root;
+		lexState.m_RestartPoints.assign(points.begin(), restart);
+		lexState.m_StopPoints = { stop, points.end() };
+		lexState.m_StopOffset = offset;
+
+		SourceSpan   span { { restartPoint.m_Index }, { size } };
+		MatcherState state { {}, &root, this, &lexState, source, span, nullptr, span.m_Begin };
+		auto         result = rule->match(state, span);
+		std::size_t  end    = result.m_Status == EMatchStatus::Success ? result.m_Span.m_End.m_Index : span.m_Begin.m_Index;
+		if (end != size)
+		{
+			// Stopping short anywhere else is an error, which only a lex of the whole source reports right
+			if (!lexState.isStopPoint(end))
+				return lexSource(source);
+
+			auto        resume = std::lower_bound(stop, points.end(), end - static_cast<std::size_t>(offset), byIndex);
+			std::size_t nodes  = root.getChildren().size();
+			root.addChildren(std::move(previousRoot), resume->m_Nodes, previousRoot.getChildren().size());
+			for (std::size_t i = nodes; i < root.getChildren().size(); ++i)
+				root.getChild(i)->offsetSpans(offset);
+			for (auto point = resume + 1; point != points.end(); ++point)
+				lexState.m_RestartPoints.push_back({ point->m_Index + static_cast<std::size_t>(offset), point->m_Nodes - resume->m_Nodes + nodes });
+
+			// The failures after the damage are the same as before, on a tie the new part was noted first
+			auto& previousFailure = previous.getFarthestFailure();
+			if (previousFailure && previousFailure->getPoint().m_Index >= resume->m_Index && (!lexState.m_FarthestFailure || previousFailure->getPoint().m_Index + static_cast<std::size_t>(offset) > lexState.m_FarthestFailure->getPoint().m_Index))
+			{
+				lexState.m_FarthestFailure = previousFailure;
+				lexState.m_FarthestFailure->offsetPosition(offset);
+			}
+
+			// Matching stopped short of the end only because of the stop point, a lex of the whole source wouldn't keep these
+			state.m_Messages.clear();
+		}
+
+		root.setSpan({ { 0 }, { size } });
+		NoteRecycledRead(source, state.m_Messages);
+		lex.setMessages(std::move(state.m_Messages));
+		lex.setFarthestFailure(std::move(lexState.m_FarthestFailure));
+		lex.setMemoStats(lexState.m_MemoStats, lexState.getRuleMemoStats());
+		lex.setRestartPoints(std::move(lexState.m_RestartPoints));
+		lex.setDuration(std::chrono::steady_clock::now() - start);
+		return lex;
+	}
+
+	Lex Lexer::relexSource(Lex&& previous, std::span<const SourceEdit> edits)
+	{
+		if (m_LinkDirty)
+			link();
+		return std::as_const(*this).relexSource(std::move(previous), edits);
+	}
+
 	void Lexer::registerRule(std::unique_ptr<IRule>&& rule)
 	{
+		RuleID id = getRuleID(rule->getName());
+		rule->setID(id);
+		// The first rule registered under a name is the one references resolve to
+		if (!m_RulesByID[id])
+			m_RulesByID[id] = rule.get();
 		m_Rules.push_back(std::move(rule));
+		m_LinkDirty   = true;
+		m_GrammarHash = 0;
 	}
 
-	IRule* Lexer::getRule(const std::string& rule)
+	IRule* Lexer::getRule(std::string_view rule) const
 	{
-		for (auto& rl : m_Rules)
-			if (rl->getName() == rule)
-				return rl.get();
-		return nullptr;
+		auto itr = m_RuleIDs.find(rule);
+		return itr != m_RuleIDs.end() ? m_RulesByID[itr->second] : nullptr;
 	}
 
-	void Lexer::setMainRule(const std::string& mainRule)
+	IRule* Lexer::getRule(RuleID rule) const
 	{
-		m_MainRule = mainRule;
+		return rule < m_RulesByID.size() ? m_RulesByID[rule] : nullptr;
 	}
 
-	void Lexer::setGroupedValue(const std::string& group, SourceSpan span)
+	RuleID Lexer::getRuleID(std::string_view rule)
 	{
-		m_GroupedValues.insert_or_assign(group, span);
+		auto itr = m_RuleIDs.find(rule);
+		if (itr != m_RuleIDs.end())
+			return itr->second;
+
+		RuleID id = static_cast<RuleID>(m_RuleNames.size());
+		m_RuleIDs.insert({ m_RuleNames.emplace_back(rule), id });
+		m_RulesByID.push_back(nullptr);
+		return id;
 	}
 
-	void Lexer::setGroupedValue(std::string&& group, SourceSpan span)
+	std::vector<Message> Lexer::link()
 	{
-		m_GroupedValues.insert_or_assign(std::move(group), span);
+		std::vector<Message>             messages;
+		std::vector<std::vector<IRule*>> references(m_Rules.size());
+		std::vector<bool>                usesNamedGroups(m_Rules.size());
+		for (std::size_t i = 0; i < m_Rules.size(); ++i)
+		{
+			LinkState state { this, m_Rules[i].get(), &messages, {} };
+			m_Rules[i]->link(state);
+			references[i]      = std::move(state.m_References);
+			usesNamedGroups[i] = state.m_UsesNamedGroups;
+		}
+		m_LinkDirty = false;
+		computeFirstSets();
+
+		auto mainRule       = getRule(m_MainRule);
+		m_TopLevelReference = mainRule ? mainRule->getRepeatedReference() : nullptr;
+
+		// Missing rules have no index, so they drop out of both graphs
+		std::unordered_map<const IRule*, std::size_t> indices;
+		for (std::size_t i = 0; i < m_Rules.size(); ++i)
+			indices.insert({ m_Rules[i].get(), i });
+		auto toIndices = [&](const std::vector<IRule*>& rules)
+		{
+			std::vector<std::size_t> result;
+			for (auto rule : rules)
+				if (auto itr = indices.find(rule); itr != indices.end())
+					result.push_back(itr->second);
+			std::sort(result.begin(), result.end());
+			result.erase(std::unique(result.begin(), result.end()), result.end());
+			return result;
+		};
+
+		std::vector<std::vector<std::size_t>> leftRules(m_Rules.size());
+		for (std::size_t i = 0; i < m_Rules.size(); ++i)
+		{
+			std::vector<IRule*> rules;
+			m_Rules[i]->collectLeftRules(*this, rules);
+			leftRules[i] = toIndices(rules);
+		}
+
+		// Every cycle in the left rule graph is reported once, from the first of its rules that was registered
+		std::vector<std::uint8_t> visited(m_Rules.size(), 0);
+		std::vector<std::size_t>  path;
+		std::function<void(std::size_t)> visit = [&](std::size_t i)
+		{
+			visited[i] = 1;
+			path.push_back(i);
+			for (auto next : leftRules[i])
+			{
+				if (visited[next] == 1)
+				{
+					std::string cycle;
+					for (auto itr = std::find(path.begin(), path.end(), next); itr != path.end(); ++itr)
+						cycle += m_Rules[*itr]->getName() + " -> ";
+					cycle += m_Rules[next]->getName();
+					messages.emplace_back(fmt::format("Rule '{}' is left recursive through {}", m_Rules[next]->getName(), cycle), SourcePoint {}, SourceSpan {});
+				}
+				else if (visited[next] == 0)
+				{
+					visit(next);
+				}
+			}
+			path.pop_back();
+			visited[i] = 2;
+		};
+		for (std::size_t i = 0; i < m_Rules.size(); ++i)
+			if (visited[i] == 0)
+				visit(i);
+
+		// A memo entry is only keyed by the rule and span, a hit would neither set the groups the rule sets nor depend on the ones it reads
+		for (std::size_t i = 0; i < m_Rules.size(); ++i)
+		{
+			if (!m_Rules[i]->doesMemoize())
+				continue;
+
+			std::vector<bool>        reached(m_Rules.size(), false);
+			std::vector<std::size_t> stack { i };
+			reached[i] = true;
+			while (!stack.empty())
+			{
+				std::size_t current = stack.back();
+				stack.pop_back();
+				if (usesNamedGroups[current])
+				{
+					messages.emplace_back(fmt::format("Memoized rule '{}' uses named groups through rule '{}', it is not memoized", m_Rules[i]->getName(), m_Rules[current]->getName()), SourcePoint {}, SourceSpan {});
+					m_Rules[i]->setMemoize(false);
+					break;
+				}
+				for (auto next : toIndices(references[current]))
+				{
+					if (!reached[next])
+					{
+						reached[next] = true;
+						stack.push_back(next);
+					}
+				}
+			}
+		}
+
+		if (!m_MainRule.empty())
+		{
+			auto mainIndex = indices.find(mainRule);
+			if (mainIndex == indices.end())
+			{
+				messages.emplace_back(fmt::format("Main rule '{}' is not defined", m_MainRule), SourcePoint {}, SourceSpan {});
+			}
+			else
+			{
+				std::vector<bool>        used(m_Rules.size(), false);
+				std::vector<std::size_t> stack { mainIndex->second };
+				used[mainIndex->second] = true;
+				while (!stack.empty())
+				{
+					std::size_t i = stack.back();
+					stack.pop_back();
+					for (auto next : toIndices(references[i]))
+					{
+						if (!used[next])
+						{
+							used[next] = true;
+							stack.push_back(next);
+						}
+					}
+				}
+				for (std::size_t i = 0; i < m_Rules.size(); ++i)
+					if (!used[i])
+						messages.emplace_back(fmt::format("Rule '{}' is never used", m_Rules[i]->getName()), SourcePoint {}, SourceSpan {}, EMessageSeverity::Warning);
+			}
+		}
+		return messages;
 	}
 
-	SourceSpan Lexer::getGroupedValue(const std::string& group) const
+	IRule* Lexer::getMissingRule(std::string_view rule)
 	{
-		auto itr = m_GroupedValues.find(group);
-		return itr != m_GroupedValues.end() ? itr->second : SourceSpan {};
+		for (auto& missingRule : m_MissingRules)
+			if (missingRule->getName() == rule)
+				return missingRule.get();
+
+		std::string name { rule };
+		auto        callback = [name](MatcherState& state, SourceSpan span) -> MatchResult
+		{
+			state.m_LexState->noteFailure(state.m_Messages.emplace_back(EMessageCode::MissingRule, MessageArgs { .m_Text = name }, span.m_Begin, SourceSpan { span.m_Begin, span.m_Begin }));
+			return { EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
+		};
+		return m_MissingRules.emplace_back(std::make_unique<CallbackRule>(name, std::move(callback), false)).get();
+	}
+
+	void Lexer::computeFirstSets()
+	{
+		if (m_LinkDirty)
+		{
+			link();
+			return;
+		}
+
+		// Sets only ever grow, so starting from nothing and iterating reaches the smallest fixed point even with recursive rules
+		for (auto& rule : m_Rules)
+			rule->setFirstSet({});
+
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (auto& rule : m_Rules)
+			{
+				auto firstSet = rule->computeFirstSet(*this);
+				if (firstSet != rule->getFirstSet())
+				{
+					rule->setFirstSet(firstSet);
+					changed = true;
+				}
+			}
+		}
+	}
+
+	void Lexer::setMainRule(const std::string& mainRule)
+	{
+		m_MainRule    = mainRule;
+		m_LinkDirty   = true;
+		m_GrammarHash = 0;
+	}
+
+	void Lexer::hashGrammar()
+	{
+		std::uint64_t hash = Hash::Bytes(m_MainRule);
+		for (auto& rule : m_Rules)
+			hash = rule->hash(hash);
+		// 0 is left for lexers whose lexes aren't cached
+		m_GrammarHash = hash != 0 ? hash : 1;
 	}
 } // namespace CommonLexer
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include "CommonLexer/LexerLexer.h"
+#include "CommonLexer/Grammar.h"
 #include "CommonLexer/Matchers.h"
 #include "CommonLexer/Rule.h"
 
+#include <optional>
 #include <sstream>
 
 #include <fmt/format.h>
@@ -302,6 +304,7 @@ namespace CommonLexer
 		    OrMatcher(Tuple {
 		        ReferenceMatcher("CombinationMatcher"),
 		        ReferenceMatcher("OrMatcher"),
+		        ReferenceMatcher("OrderedMatcher"),
 		        ReferenceMatcher("Depth3Matcher") }),
 		    false });
 		registerRule(MatcherRule {
@@ -330,7 +333,8 @@ namespace CommonLexer
 		        ReferenceMatcher("NamedGroupReferenceMatcher"),
 		        ReferenceMatcher("ReferenceMatcher"),
 		        ReferenceMatcher("TextMatcher"),
-		        ReferenceMatcher("RegexMatcher") }),
+		        ReferenceMatcher("RegexMatcher"),
+		        ReferenceMatcher("CutMatcher") }),
 		    false });
 
 		registerRule(MatcherRule {
@@ -387,6 +391,27 @@ namespace CommonLexer
 		                ESpaceMethod::Whitespace,
 		                ESpaceDirection::Both),
 		            1) }) });
+		registerRule(MatcherRule {
+		    "OrderedMatcher",
+		    CombinationMatcher(Tuple {
+		        SpaceMatcher(
+		            ReferenceMatcher("Depth3Matcher"),
+		            false,
+		            ESpaceMethod::Whitespace,
+		            ESpaceDirection::Both),
+		        RangeMatcher(
+		            SpaceMatcher(
+		                CombinationMatcher(Tuple {
+		                    SpaceMatcher(
+		                        TextMatcher("/"),
+		                        false,
+		                        ESpaceMethod::Whitespace,
+		                        ESpaceDirection::Both),
+		                    ReferenceMatcher("Depth3Matcher") }),
+		                false,
+		                ESpaceMethod::Whitespace,
+		                ESpaceDirection::Both),
+		            1) }) });
 
 		registerRule(MatcherRule {
 		    "ZeroOrMore",
@@ -598,6 +623,7 @@ namespace CommonLexer
 		                    TextMatcher(":") }) })) }) });
 		registerRule(MatcherRule { "TextMatcher", RegexMatcher("\"(?:[^\"\\\\\n]|\\.|\\\\.)*\"") });
 		registerRule(MatcherRule { "RegexMatcher", RegexMatcher("'(?:[^'\\\\\n]|\\.|\\\\.)*'") });
+		registerRule(MatcherRule { "CutMatcher", TextMatcher("^") });
 	}
 
 	struct ScopeSettings
@@ -605,9 +631,45 @@ namespace CommonLexer
 	public:
 		ESpaceMethod    m_SpaceMethod    = ESpaceMethod::Normal;
 		ESpaceDirection m_SpaceDirection = ESpaceDirection::Right;
+		bool            m_Memoize        = false;
 	};
 
-	std::unique_ptr<IMatcher> handleMatcher(LexerLexerResult& result, const Lex& lex, const Node& node, ScopeSettings settings, std::size_t depth = 0)
+	static void ReportRegex(std::vector<Message>& messages, const Regex& regex, SourceSpan span)
+	{
+		if (!regex.isValid())
+			messages.emplace_back(fmt::format("Regex '{}' is invalid: {}", regex.getPattern(), regex.getError()), span.m_Begin, span);
+		else if (regex.isFallback())
+			messages.emplace_back(fmt::format("Regex '{}' uses {}, falling back to std::regex", regex.getPattern(), regex.getUnsupported()), span.m_Begin, span, EMessageSeverity::Warning);
+	}
+
+	// Only choices with a cut somewhere below them need to track it in generated code
+	static bool HasCut(const Node& node)
+	{
+		if (node.getRule() == "CutMatcher")
+			return true;
+		for (auto& child : node.getChildren())
+			if (HasCut(child))
+				return true;
+		return false;
+	}
+
+	// Alternatives that are all text literals are matched by a single trie instead of one text matcher each
+	static bool CollectLiterals(const Lex& lex, const Node& node, std::vector<std::string>& literals)
+	{
+		auto& children = node.getChildren();
+		if (children.size() < 2)
+			return false;
+		for (auto& child : children)
+			if (child.getRule() != "TextMatcher")
+				return false;
+
+		literals.reserve(children.size());
+		for (auto& child : children)
+			literals.push_back(UnescapeText(lex.getSource()->getSpan(child.getSpan())));
+		return true;
+	}
+
+	std::optional<GrammarNode> handleMatcher(std::vector<Message>& messages, const Lex& lex, const Node& node, ScopeSettings settings, std::size_t depth = 0)
 	{
 		auto source = lex.getSource();
 
@@ -615,144 +677,147 @@ namespace CommonLexer
 		auto span = node.getSpan();
 		if (rule == "RegexMatcher")
 		{
-			return std::make_unique<RegexMatcher>(UnescapeText(source->getSpan(span)));
+			std::string pattern = UnescapeText(source->getSpan(span));
+			auto        regex   = Regex::Get(pattern);
+			ReportRegex(messages, *regex, span);
+			return GrammarNode { .m_Op = EGrammarOp::Regex, .m_Text = std::move(pattern) };
 		}
 		else if (rule == "TextMatcher")
 		{
-			return std::make_unique<TextMatcher>(UnescapeText(source->getSpan(span)));
+			return GrammarNode { .m_Op = EGrammarOp::Text, .m_Text = UnescapeText(source->getSpan(span)) };
 		}
 		else if (rule == "ReferenceMatcher")
 		{
 			auto ruleId = node.getChild(0);
 			if (!ruleId || ruleId->getRule() != "Identifier")
 			{
-				result.m_Messages.emplace_back("Unexpected ReferenceMatcher missing Identifier", span.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected ReferenceMatcher missing Identifier", span.m_Begin, span);
+				return {};
 			}
 
-			return std::make_unique<ReferenceMatcher>(source->getSpan(ruleId->getSpan()));
+			return GrammarNode { .m_Op = EGrammarOp::Reference, .m_Text = source->getSpan(ruleId->getSpan()) };
 		}
 		else if (rule == "NamedGroupReferenceMatcher")
 		{
 			auto namedGroupId = node.getChild(0);
 			if (!namedGroupId || namedGroupId->getRule() != "Identifier")
 			{
-				result.m_Messages.emplace_back("Unexpected NamedGroupReferenceMatcher missing Identifier", span.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected NamedGroupReferenceMatcher missing Identifier", span.m_Begin, span);
+				return {};
 			}
 
-			return std::make_unique<ReferenceMatcher>(source->getSpan(namedGroupId->getSpan()));
+			return GrammarNode { .m_Op = EGrammarOp::NamedGroupReference, .m_Text = source->getSpan(namedGroupId->getSpan()) };
 		}
 		else if (rule == "NamedGroupMatcher")
 		{
 			auto namedGroupId = node.getChild(0);
 			if (!namedGroupId || namedGroupId->getRule() != "Identifier")
 			{
-				result.m_Messages.emplace_back("Unexpected NamedGroupMatcher missing Identifier", span.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected NamedGroupMatcher missing Identifier", span.m_Begin, span);
+				return {};
 			}
 			auto namedGroupSpan = namedGroupId->getSpan();
 
 			auto subMatcher = node.getChild(1);
 			if (!subMatcher)
 			{
-				result.m_Messages.emplace_back("Unexpected NamedGroupMatcher missing Matcher", namedGroupSpan.m_End, span);
-				return nullptr;
+				messages.emplace_back("Unexpected NamedGroupMatcher missing Matcher", namedGroupSpan.m_End, span);
+				return {};
 			}
 			auto subMatcherSpan = subMatcher->getSpan();
 
-			auto matcher = handleMatcher(result, lex, *subMatcher, settings, depth + 1);
+			auto matcher = handleMatcher(messages, lex, *subMatcher, settings, depth + 1);
 			if (!matcher)
-				return nullptr;
+				return {};
 
-			return std::make_unique<NamedGroupMatcher>(source->getSpan(namedGroupSpan), std::move(matcher));
+			return GrammarNode { .m_Op = EGrammarOp::NamedGroup, .m_Text = source->getSpan(namedGroupSpan), .m_Children = { std::move(*matcher) } };
 		}
 		else if (rule == "Group")
 		{
 			auto subMatcher = node.getChild(0);
 			if (!subMatcher)
 			{
-				result.m_Messages.emplace_back("Unexpected Group missing Matcher", span.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected Group missing Matcher", span.m_Begin, span);
+				return {};
 			}
 
-			return handleMatcher(result, lex, *subMatcher, settings, depth);
+			return handleMatcher(messages, lex, *subMatcher, settings, depth);
 		}
 		else if (rule == "ForcedSpaceMatcher")
 		{
 			auto subMatcher = node.getChild(0);
 			if (!subMatcher)
 			{
-				result.m_Messages.emplace_back("Unexpected ForcedSpaceMatcher missing Matcher", span.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected ForcedSpaceMatcher missing Matcher", span.m_Begin, span);
+				return {};
 			}
 
-			auto matcher = handleMatcher(result, lex, *subMatcher, settings, depth + 1);
+			auto matcher = handleMatcher(messages, lex, *subMatcher, settings, depth + 1);
 			if (!matcher)
-				return nullptr;
+				return {};
 
-			return std::make_unique<SpaceMatcher>(std::move(matcher), true, settings.m_SpaceMethod, settings.m_SpaceDirection);
+			return GrammarNode { .m_Op = EGrammarOp::Space, .m_Forced = true, .m_SpaceMethod = settings.m_SpaceMethod, .m_SpaceDirection = settings.m_SpaceDirection, .m_Children = { std::move(*matcher) } };
 		}
 		else if (rule == "LenientSpaceMatcher")
 		{
 			auto subMatcher = node.getChild(0);
 			if (!subMatcher)
 			{
-				result.m_Messages.emplace_back("Unexpected LenientSpaceMatcher missing Matcher", span.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected LenientSpaceMatcher missing Matcher", span.m_Begin, span);
+				return {};
 			}
 
-			auto matcher = handleMatcher(result, lex, *subMatcher, settings, depth + 1);
+			auto matcher = handleMatcher(messages, lex, *subMatcher, settings, depth + 1);
 			if (!matcher)
-				return nullptr;
+				return {};
 
-			return std::make_unique<SpaceMatcher>(std::move(matcher), false, settings.m_SpaceMethod, settings.m_SpaceDirection);
+			return GrammarNode { .m_Op = EGrammarOp::Space, .m_Forced = false, .m_SpaceMethod = settings.m_SpaceMethod, .m_SpaceDirection = settings.m_SpaceDirection, .m_Children = { std::move(*matcher) } };
 		}
 		else if (rule == "NegativeMatcher")
 		{
 			auto subMatcher = node.getChild(0);
 			if (!subMatcher)
 			{
-				result.m_Messages.emplace_back("Unexpected NegativeMatcher missing Matcher", span.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected NegativeMatcher missing Matcher", span.m_Begin, span);
+				return {};
 			}
 
-			auto matcher = handleMatcher(result, lex, *subMatcher, settings, depth + 1);
+			auto matcher = handleMatcher(messages, lex, *subMatcher, settings, depth + 1);
 			if (!matcher)
-				return nullptr;
+				return {};
 
-			return std::make_unique<NegativeMatcher>(std::move(matcher));
+			return GrammarNode { .m_Op = EGrammarOp::Negative, .m_Children = { std::move(*matcher) } };
 		}
 		else if (rule == "OptionalMatcher")
 		{
 			auto subMatcher = node.getChild(0);
 			if (!subMatcher)
 			{
-				result.m_Messages.emplace_back("Unexpected OptionalMatcher missing Matcher", span.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected OptionalMatcher missing Matcher", span.m_Begin, span);
+				return {};
 			}
 
-			auto matcher = handleMatcher(result, lex, *subMatcher, settings, depth + 1);
+			auto matcher = handleMatcher(messages, lex, *subMatcher, settings, depth + 1);
 			if (!matcher)
-				return nullptr;
+				return {};
 
-			return std::make_unique<OptionalMatcher>(std::move(matcher));
+			return GrammarNode { .m_Op = EGrammarOp::Optional, .m_Children = { std::move(*matcher) } };
 		}
 		else if (rule == "RangeMatcher")
 		{
 			auto subMatcher = node.getChild(0);
 			if (!subMatcher)
 			{
-				result.m_Messages.emplace_back("Unexpected RangeMatcher missing Matcher", span.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected RangeMatcher missing Matcher", span.m_Begin, span);
+				return {};
 			}
 			auto subMatcherSpan = subMatcher->getSpan();
 
 			auto lowerBoundsNode = node.getChild(1);
 			if (!lowerBoundsNode || lowerBoundsNode->getRule() != "Integer")
 			{
-				result.m_Messages.emplace_back("Unexpected RangeMatcher missing lower bounds", subMatcherSpan.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected RangeMatcher missing lower bounds", subMatcherSpan.m_Begin, span);
+				return {};
 			}
 			auto lowerBoundsSpan = lowerBoundsNode->getSpan();
 			auto lowerBounds     = ReadUInt(source->getSpan(lowerBoundsSpan));
@@ -760,126 +825,143 @@ namespace CommonLexer
 			auto upperBoundsNode = node.getChild(2);
 			if (!upperBoundsNode || upperBoundsNode->getRule() != "Integer")
 			{
-				result.m_Messages.emplace_back("Unexpected RangeMatcher missing upper bounds", subMatcherSpan.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected RangeMatcher missing upper bounds", subMatcherSpan.m_Begin, span);
+				return {};
 			}
 			auto upperBoundsSpan = upperBoundsNode->getSpan();
 			auto upperBounds     = ReadUInt(source->getSpan(upperBoundsSpan));
 			if (upperBounds < lowerBounds)
 			{
-				result.m_Messages.emplace_back("Range Matcher upper bounds is smaller than lower bounds, assuming UpperBounds=LowerBounds", upperBoundsSpan.m_Begin, span, EMessageSeverity::Warning);
+				messages.emplace_back("Range Matcher upper bounds is smaller than lower bounds, assuming UpperBounds=LowerBounds", upperBoundsSpan.m_Begin, span, EMessageSeverity::Warning);
 				upperBounds = lowerBounds;
 			}
 
-			auto matcher = handleMatcher(result, lex, *subMatcher, settings, depth + 1);
+			auto matcher = handleMatcher(messages, lex, *subMatcher, settings, depth + 1);
 			if (!matcher)
-				return nullptr;
+				return {};
 
-			return std::make_unique<RangeMatcher>(std::move(matcher), lowerBounds, upperBounds);
+			return GrammarNode { .m_Op = EGrammarOp::Range, .m_LowerBounds = lowerBounds, .m_UpperBounds = upperBounds, .m_Children = { std::move(*matcher) } };
 		}
 		else if (rule == "ExactAmount")
 		{
 			auto subMatcher = node.getChild(0);
 			if (!subMatcher)
 			{
-				result.m_Messages.emplace_back("Unexpected ExactAmount missing Matcher", span.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected ExactAmount missing Matcher", span.m_Begin, span);
+				return {};
 			}
 			auto subMatcherSpan = subMatcher->getSpan();
 
 			auto amountNode = node.getChild(1);
 			if (!amountNode || amountNode->getRule() != "Integer")
 			{
-				result.m_Messages.emplace_back("Unexpected ExactAmount missing amount", subMatcherSpan.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected ExactAmount missing amount", subMatcherSpan.m_Begin, span);
+				return {};
 			}
 			auto amount = ReadUInt(source->getSpan(amountNode->getSpan()));
 
-			auto matcher = handleMatcher(result, lex, *subMatcher, settings, depth + 1);
+			auto matcher = handleMatcher(messages, lex, *subMatcher, settings, depth + 1);
 			if (!matcher)
-				return nullptr;
+				return {};
 
-			return std::make_unique<RangeMatcher>(std::move(matcher), amount, amount);
+			return GrammarNode { .m_Op = EGrammarOp::Range, .m_LowerBounds = amount, .m_UpperBounds = amount, .m_Children = { std::move(*matcher) } };
 		}
 		else if (rule == "OneOrMore")
 		{
 			auto subMatcher = node.getChild(0);
 			if (!subMatcher)
 			{
-				result.m_Messages.emplace_back("Unexpected ExactAmount missing Matcher", span.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected ExactAmount missing Matcher", span.m_Begin, span);
+				return {};
 			}
 			auto subMatcherSpan = subMatcher->getSpan();
 
-			auto matcher = handleMatcher(result, lex, *subMatcher, settings, depth + 1);
+			auto matcher = handleMatcher(messages, lex, *subMatcher, settings, depth + 1);
 			if (!matcher)
-				return nullptr;
+				return {};
 
-			return std::make_unique<RangeMatcher>(std::move(matcher), 1);
+			return GrammarNode { .m_Op = EGrammarOp::Range, .m_LowerBounds = 1, .m_Children = { std::move(*matcher) } };
 		}
 		else if (rule == "ZeroOrMore")
 		{
 			auto subMatcher = node.getChild(0);
 			if (!subMatcher)
 			{
-				result.m_Messages.emplace_back("Unexpected ExactAmount missing Matcher", span.m_Begin, span);
-				return nullptr;
+				messages.emplace_back("Unexpected ExactAmount missing Matcher", span.m_Begin, span);
+				return {};
 			}
 			auto subMatcherSpan = subMatcher->getSpan();
 
-			auto matcher = handleMatcher(result, lex, *subMatcher, settings, depth + 1);
+			auto matcher = handleMatcher(messages, lex, *subMatcher, settings, depth + 1);
 			if (!matcher)
-				return nullptr;
+				return {};
 
-			return std::make_unique<RangeMatcher>(std::move(matcher));
+			return GrammarNode { .m_Op = EGrammarOp::Range, .m_Children = { std::move(*matcher) } };
 		}
 		else if (rule == "OrMatcher")
 		{
-			std::vector<std::unique_ptr<IMatcher>> matchers;
-			matchers.reserve(node.getChildren().size());
+			GrammarNode matcher { .m_Op = EGrammarOp::Or };
+			matcher.m_Children.reserve(node.getChildren().size());
 			for (auto& child : node.getChildren())
 			{
-				auto matcher = handleMatcher(result, lex, child, settings, depth + 1);
-				if (!matcher)
-					return nullptr;
-				matchers.push_back(std::move(matcher));
+				auto subMatcher = handleMatcher(messages, lex, child, settings, depth + 1);
+				if (!subMatcher)
+					return {};
+				matcher.m_Children.push_back(std::move(*subMatcher));
 			}
-			return std::make_unique<OrMatcher>(std::move(matchers));
+			return matcher;
+		}
+		else if (rule == "OrderedMatcher")
+		{
+			GrammarNode matcher { .m_Op = EGrammarOp::Ordered };
+			matcher.m_Children.reserve(node.getChildren().size());
+			for (auto& child : node.getChildren())
+			{
+				auto subMatcher = handleMatcher(messages, lex, child, settings, depth + 1);
+				if (!subMatcher)
+					return {};
+				matcher.m_Children.push_back(std::move(*subMatcher));
+			}
+			return matcher;
+		}
+		else if (rule == "CutMatcher")
+		{
+			return GrammarNode { .m_Op = EGrammarOp::Cut };
 		}
 		else if (rule == "CombinationMatcher")
 		{
-			std::vector<std::unique_ptr<IMatcher>> matchers;
-			matchers.reserve(node.getChildren().size());
+			GrammarNode matcher { .m_Op = EGrammarOp::Combination };
+			matcher.m_Children.reserve(node.getChildren().size());
 			for (auto& child : node.getChildren())
 			{
-				auto matcher = handleMatcher(result, lex, child, settings, depth + 1);
-				if (!matcher)
-					return nullptr;
-				matchers.push_back(std::move(matcher));
+				auto subMatcher = handleMatcher(messages, lex, child, settings, depth + 1);
+				if (!subMatcher)
+					return {};
+				matcher.m_Children.push_back(std::move(*subMatcher));
 			}
-			return std::make_unique<CombinationMatcher>(std::move(matchers));
+			return matcher;
 		}
 		else if (rule == "Branch")
 		{
-			std::vector<std::unique_ptr<IMatcher>> matchers;
-			matchers.reserve(node.getChildren().size());
+			GrammarNode matcher { .m_Op = EGrammarOp::Or };
+			matcher.m_Children.reserve(node.getChildren().size());
 			for (auto& child : node.getChildren())
 			{
-				auto matcher = handleMatcher(result, lex, child, settings, depth + 1);
-				if (!matcher)
-					return nullptr;
-				matchers.push_back(std::move(matcher));
+				auto subMatcher = handleMatcher(messages, lex, child, settings, depth + 1);
+				if (!subMatcher)
+					return {};
+				matcher.m_Children.push_back(std::move(*subMatcher));
 			}
-			return std::make_unique<OrMatcher>(std::move(matchers));
+			return matcher;
 		}
 		else
 		{
-			result.m_Messages.emplace_back(fmt::format("Rule '{}' is not a recognized matcher rule", rule), span.m_Begin, span, EMessageSeverity::Warning);
-			return nullptr;
+			messages.emplace_back(fmt::format("Rule '{}' is not a recognized matcher rule", rule), span.m_Begin, span, EMessageSeverity::Warning);
+			return {};
 		}
 	}
 
-	void handleScope(LexerLexerResult& result, const Lex& lex, const Node& node, ScopeSettings settings, std::unordered_map<std::string, CallbackRule::Callback>& callbacks, std::size_t depth = 0)
+	void handleScope(Grammar& grammar, std::vector<Message>& messages, const Lex& lex, const Node& node, ScopeSettings settings, std::unordered_map<std::string, CallbackRule::Callback>& callbacks, std::size_t depth = 0)
 	{
 		auto source = lex.getSource();
 
@@ -894,7 +976,7 @@ namespace CommonLexer
 				auto optionIdNode = declaration.getChild(0);
 				if (!optionIdNode || optionIdNode->getRule() != "Identifier")
 				{
-					result.m_Messages.emplace_back("Unexpected OptionDeclaration missing Identifier", declarationSpan.m_Begin, declarationSpan);
+					messages.emplace_back("Unexpected OptionDeclaration missing Identifier", declarationSpan.m_Begin, declarationSpan);
 					continue;
 				}
 				auto optionIdSpan = optionIdNode->getSpan();
@@ -902,14 +984,14 @@ namespace CommonLexer
 				auto valueNode = declaration.getChild(1);
 				if (!valueNode)
 				{
-					result.m_Messages.emplace_back("Unexpected OptionDeclaration missing Value", optionIdSpan.m_End, declarationSpan);
+					messages.emplace_back("Unexpected OptionDeclaration missing Value", optionIdSpan.m_End, declarationSpan);
 					continue;
 				}
 
 				auto optionId = source->getSpan(optionIdSpan);
 				if (std::find(declaredOptions.begin(), declaredOptions.end(), optionId) != declaredOptions.end())
 				{
-					result.m_Messages.emplace_back(fmt::format("OptionDeclaration {} already previously declared", optionId), optionIdSpan.m_Begin, optionIdSpan, EMessageSeverity::Warning);
+					messages.emplace_back(fmt::format("OptionDeclaration {} already previously declared", optionId), optionIdSpan.m_Begin, optionIdSpan, EMessageSeverity::Warning);
 					continue;
 				}
 
@@ -917,25 +999,25 @@ namespace CommonLexer
 				{
 					if (depth > 0)
 					{
-						result.m_Messages.emplace_back("MainRule can only be set in the global scope", declarationSpan.m_Begin, declarationSpan);
+						messages.emplace_back("MainRule can only be set in the global scope", declarationSpan.m_Begin, declarationSpan);
 						continue;
 					}
 
 					auto valueSpan = valueNode->getSpan();
 					if (valueNode->getRule() != "Identifier")
 					{
-						result.m_Messages.emplace_back("MainRule value is not an Identifier", valueSpan.m_Begin, valueSpan);
+						messages.emplace_back("MainRule value is not an Identifier", valueSpan.m_Begin, valueSpan);
 						continue;
 					}
 
-					result.m_Lexer.setMainRule(source->getSpan(valueSpan));
+					grammar.setMainRule(source->getSpan(valueSpan));
 				}
 				else if (optionId == "SpaceMethod")
 				{
 					auto valueSpan = valueNode->getSpan();
 					if (valueNode->getRule() != "TextMatcher")
 					{
-						result.m_Messages.emplace_back("SpaceMethod value is not a string", valueSpan.m_Begin, valueSpan);
+						messages.emplace_back("SpaceMethod value is not a string", valueSpan.m_Begin, valueSpan);
 						continue;
 					}
 
@@ -950,7 +1032,7 @@ namespace CommonLexer
 					}
 					else
 					{
-						result.m_Messages.emplace_back(fmt::format("SpaceMethod value \"{}\" is not valid, should be either \"Normal\" or \"Whitespace\" ", EscapeText(value)), valueSpan.m_Begin, valueSpan);
+						messages.emplace_back(fmt::format("SpaceMethod value \"{}\" is not valid, should be either \"Normal\" or \"Whitespace\" ", EscapeText(value)), valueSpan.m_Begin, valueSpan);
 						continue;
 					}
 				}
@@ -959,7 +1041,7 @@ namespace CommonLexer
 					auto valueSpan = valueNode->getSpan();
 					if (valueNode->getRule() != "TextMatcher")
 					{
-						result.m_Messages.emplace_back("SpaceDirection value is not a string", valueSpan.m_Begin, valueSpan);
+						messages.emplace_back("SpaceDirection value is not a string", valueSpan.m_Begin, valueSpan);
 						continue;
 					}
 
@@ -978,9 +1060,22 @@ namespace CommonLexer
 					}
 					else
 					{
-						result.m_Messages.emplace_back(fmt::format("SpaceDirection value \"{}\" is not valid, should be either \"Left\", \"Right\" or \"Both\" ", EscapeText(value)), valueSpan.m_Begin, valueSpan);
+						messages.emplace_back(fmt::format("SpaceDirection value \"{}\" is not valid, should be either \"Left\", \"Right\" or \"Both\" ", EscapeText(value)), valueSpan.m_Begin, valueSpan);
+						continue;
+					}
+				}
+				else if (optionId == "Memoize")
+				{
+					// Value tries Identifier first, so true and false usually come out as Identifiers
+					auto valueSpan = valueNode->getSpan();
+					auto value     = source->getSpan(valueSpan);
+					if ((valueNode->getRule() != "Boolean" && valueNode->getRule() != "Identifier") || (value != "true" && value != "false"))
+					{
+						messages.emplace_back("Memoize value is not a Boolean", valueSpan.m_Begin, valueSpan);
 						continue;
 					}
+
+					settings.m_Memoize = value == "true";
 				}
 
 				declaredOptions.push_back(optionId);
@@ -998,14 +1093,14 @@ namespace CommonLexer
 			else if (rule == "BlockDeclaration")
 			{
 				ScopeSettings blockScope = settings;
-				handleScope(result, lex, declaration, blockScope, callbacks, depth + 1);
+				handleScope(grammar, messages, lex, declaration, blockScope, callbacks, depth + 1);
 			}
 			else if (rule == "RuleDeclaration")
 			{
 				auto ruleIdNode = declaration.getChild(0);
 				if (!ruleIdNode || ruleIdNode->getRule() != "Identifier")
 				{
-					result.m_Messages.emplace_back("Unexpected RuleDeclaration missing Identifier", declarationSpan.m_Begin, declarationSpan);
+					messages.emplace_back("Unexpected RuleDeclaration missing Identifier", declarationSpan.m_Begin, declarationSpan);
 					continue;
 				}
 				auto ruleIdSpan = ruleIdNode->getSpan();
@@ -1013,32 +1108,32 @@ namespace CommonLexer
 				auto matcherNode = declaration.getChild(1);
 				if (!matcherNode)
 				{
-					result.m_Messages.emplace_back("Unexpected RuleDeclaration missing Matcher", ruleIdSpan.m_End, declarationSpan);
+					messages.emplace_back("Unexpected RuleDeclaration missing Matcher", ruleIdSpan.m_End, declarationSpan);
 					continue;
 				}
 				auto matcherSpan = matcherNode->getSpan();
 
 				auto ruleId = source->getSpan(ruleIdSpan);
-				if (result.m_Lexer.getRule(ruleId))
+				if (grammar.hasRule(ruleId))
 				{
-					result.m_Messages.emplace_back(fmt::format("Rule {} has already been declared", ruleId), ruleIdSpan.m_Begin, declarationSpan);
+					messages.emplace_back(fmt::format("Rule {} has already been declared", ruleId), ruleIdSpan.m_Begin, declarationSpan);
 					continue;
 				}
 
-				auto matcher = handleMatcher(result, lex, *matcherNode, settings);
+				auto matcher = handleMatcher(messages, lex, *matcherNode, settings);
 				if (!matcher)
 				{
-					result.m_Messages.emplace_back(fmt::format("Rule {} failed to create its matchers", ruleId), matcherSpan.m_Begin, declarationSpan);
+					messages.emplace_back(fmt::format("Rule {} failed to create its matchers", ruleId), matcherSpan.m_Begin, declarationSpan);
 					continue;
 				}
-				result.m_Lexer.registerRule(std::make_unique<MatcherRule>(ruleId, std::move(matcher), true));
+				grammar.addRule({ .m_Name = ruleId, .m_Matcher = std::move(*matcher), .m_CreateNode = true, .m_Memoize = settings.m_Memoize });
 			}
 			else if (rule == "NodelessRuleDeclaration")
 			{
 				auto ruleIdNode = declaration.getChild(0);
 				if (!ruleIdNode || ruleIdNode->getRule() != "Identifier")
 				{
-					result.m_Messages.emplace_back("Unexpected RuleDeclaration missing Identifier", declarationSpan.m_Begin, declarationSpan);
+					messages.emplace_back("Unexpected RuleDeclaration missing Identifier", declarationSpan.m_Begin, declarationSpan);
 					continue;
 				}
 				auto ruleIdSpan = ruleIdNode->getSpan();
@@ -1046,68 +1141,145 @@ namespace CommonLexer
 				auto matcherNode = declaration.getChild(1);
 				if (!matcherNode)
 				{
-					result.m_Messages.emplace_back("Unexpected RuleDeclaration missing Matcher", ruleIdSpan.m_End, declarationSpan);
+					messages.emplace_back("Unexpected RuleDeclaration missing Matcher", ruleIdSpan.m_End, declarationSpan);
 					continue;
 				}
 				auto matcherSpan = matcherNode->getSpan();
 
 				auto ruleId = source->getSpan(ruleIdSpan);
-				if (result.m_Lexer.getRule(ruleId))
+				if (grammar.hasRule(ruleId))
 				{
-					result.m_Messages.emplace_back(fmt::format("Rule {} has already been declared", ruleId), ruleIdSpan.m_Begin, declarationSpan);
+					messages.emplace_back(fmt::format("Rule {} has already been declared", ruleId), ruleIdSpan.m_Begin, declarationSpan);
 					continue;
 				}
 
-				auto matcher = handleMatcher(result, lex, *matcherNode, settings);
+				auto matcher = handleMatcher(messages, lex, *matcherNode, settings);
 				if (!matcher)
 				{
-					result.m_Messages.emplace_back(fmt::format("Rule {} failed to create its matchers", ruleId), matcherSpan.m_Begin, declarationSpan);
+					messages.emplace_back(fmt::format("Rule {} failed to create its matchers", ruleId), matcherSpan.m_Begin, declarationSpan);
 					continue;
 				}
-				result.m_Lexer.registerRule(std::make_unique<MatcherRule>(ruleId, std::move(matcher), false));
+				grammar.addRule({ .m_Name = ruleId, .m_Matcher = std::move(*matcher), .m_CreateNode = false, .m_Memoize = settings.m_Memoize });
 			}
 			else if (rule == "CallbackRuleDeclaration")
 			{
 				auto ruleIdNode = declaration.getChild(0);
 				if (!ruleIdNode || ruleIdNode->getRule() != "Identifier")
 				{
-					result.m_Messages.emplace_back("Unexpected CallbackRuleDeclaration missing Identifier", declarationSpan.m_Begin, declarationSpan);
+					messages.emplace_back("Unexpected CallbackRuleDeclaration missing Identifier", declarationSpan.m_Begin, declarationSpan);
 					continue;
 				}
 				auto ruleIdSpan = ruleIdNode->getSpan();
 
 				auto ruleId = source->getSpan(ruleIdSpan);
-				if (result.m_Lexer.getRule(ruleId))
+				if (grammar.hasRule(ruleId))
 				{
-					result.m_Messages.emplace_back(fmt::format("Rule {} has already been declared", ruleId), ruleIdSpan.m_Begin, declarationSpan);
+					messages.emplace_back(fmt::format("Rule {} has already been declared", ruleId), ruleIdSpan.m_Begin, declarationSpan);
 					continue;
 				}
 
 				auto callbackItr = callbacks.find(ruleId);
 				if (callbackItr == callbacks.end())
 				{
-					result.m_Messages.emplace_back(fmt::format("Missing callback for rule {}", ruleId), declarationSpan.m_Begin, declarationSpan);
+					messages.emplace_back(fmt::format("Missing callback for rule {}", ruleId), declarationSpan.m_Begin, declarationSpan);
 					continue;
 				}
 
-				result.m_Lexer.registerRule(std::make_unique<CallbackRule>(ruleId, std::move(callbackItr->second)));
+				grammar.addRule({ .m_Name = ruleId, .m_Callback = std::move(callbackItr->second) });
 			}
 			else
 			{
-				result.m_Messages.emplace_back(fmt::format("Rule {} is not a recognized declaration", rule), declarationSpan.m_Begin, declarationSpan, EMessageSeverity::Warning);
+				messages.emplace_back(fmt::format("Rule {} is not a recognized declaration", rule), declarationSpan.m_Begin, declarationSpan, EMessageSeverity::Warning);
 				continue;
 			}
 		}
 	}
 
-	LexerLexerResult LexerLexer::createLexer(const Lex& lex, std::unordered_map<std::string, CallbackRule::Callback> callbacks)
+	Grammar LexerLexer::createGrammar(const Lex& lex, std::vector<Message>& messages, std::unordered_map<std::string, CallbackRule::Callback> callbacks)
+	{
+		Grammar       grammar;
+		ScopeSettings settings;
+		handleScope(grammar, messages, lex, lex.getRoot(), settings, callbacks);
+		return grammar;
+	}
+
+	LexerLexerResult LexerLexer::createLexer(const Lex& lex, std::unordered_map<std::string, CallbackRule::Callback> callbacks, bool optimize)
 	{
 		LexerLexerResult result;
-		ScopeSettings    settings;
-		handleScope(result, lex, lex.getRoot(), settings, callbacks);
+		Grammar          grammar = createGrammar(lex, result.m_Messages, std::move(callbacks));
+		if (optimize)
+			result.m_OptimizeStats = grammar.optimize();
+		grammar.registerRules(result.m_Lexer);
+		for (auto& message : result.m_Lexer.link())
+			result.m_Messages.push_back(std::move(message));
 		return result;
 	}
 
+	// Wraps <ruleId>MatchUnmemoized, mirroring MatcherRule::match
+	static std::string MemoizedRuleCPP(std::string_view ruleId)
+	{
+		std::ostringstream str;
+		str << "CommonLexer::MatchResult " << ruleId << "Match(CommonLexer::MatcherState& state, CommonLexer::SourceSpan span)\n"
+		    << "{\n"
+		    << "\tstatic const char memoKey = 0;\n"
+		    << "\tif (auto entry = state.m_LexState->findMemo(&memoKey, \"" << ruleId << "\", span))\n"
+		    << "\t{\n"
+		    << "\t\tfor (auto& node : entry->m_Nodes)\n"
+		    << "\t\t\tstate.m_ParentNode->addChild(node);\n"
+		    << "\t\tstate.m_Messages.insert(state.m_Messages.end(), entry->m_Messages.begin(), entry->m_Messages.end());\n"
+		    << "\t\treturn entry->m_Result;\n"
+		    << "\t}\n\n"
+		    << "\tstd::size_t nodeMark    = state.m_ParentNode->getChildren().size();\n"
+		    << "\tstd::size_t messageMark = state.m_Messages.size();\n"
+		    << "\tauto        result      = " << ruleId << "MatchUnmemoized(state, span);\n\n"
+		    << "\tauto& children = state.m_ParentNode->getChildren();\n"
+		    << "\tstate.m_LexState->storeMemo(&memoKey, span, { result, { children.begin() + nodeMark, children.end() }, { state.m_Messages.begin() + messageMark, state.m_Messages.end() } });\n"
+		    << "\treturn result;\n"
+		    << "}";
+		return str.str();
+	}
+
+	// The run is rebuilt from the shared regex when the generated lexer starts, so the tables are only in one place
+	static std::string CharRunCPP(const std::string& pattern, const Regex::CharRun& run, std::string_view ruleId, std::string_view resultID, std::string_view stateID, std::string_view spanID, std::size_t depth)
+	{
+		std::string indents = std::string(depth, '\t');
+
+		std::ostringstream str;
+		if (run.m_Rest.none() && !run.m_Optional)
+		{
+			str << indents << "// CharClassMatcher\n"
+			    << indents << "{\n"
+			    << indents << "\tstatic const CommonLexer::CharClassMatcher charClass" << depth << " { CommonLexer::Regex::Get(\"" << EscapeText(std::string { pattern }) << "\")->getCharRun()->m_First };\n\n"
+			    << indents << "\t" << resultID << " = charClass" << depth << ".matchByte(" << stateID << ", " << spanID << ", \"" << ruleId << "\");\n"
+			    << indents << "}";
+		}
+		else
+		{
+			str << indents << "// CharRunMatcher\n"
+			    << indents << "{\n"
+			    << indents << "\tstatic const CommonLexer::CharRunMatcher charRun" << depth << " { *CommonLexer::Regex::Get(\"" << EscapeText(std::string { pattern }) << "\")->getCharRun() };\n\n"
+			    << indents << "\t" << resultID << " = charRun" << depth << ".matchRun(" << stateID << ", " << spanID << ", \"" << ruleId << "\");\n"
+			    << indents << "}";
+		}
+		return str.str();
+	}
+
+	static std::string LiteralSetCPP(const std::vector<std::string>& literals, std::string_view ruleId, std::string_view resultID, std::string_view stateID, std::string_view spanID, std::size_t depth)
+	{
+		std::string indents = std::string(depth, '\t');
+
+		std::ostringstream str;
+		str << indents << "// LiteralSetMatcher\n"
+		    << indents << "{\n"
+		    << indents << "\tstatic const CommonLexer::LiteralSetMatcher literalSet" << depth << " { std::vector<std::string> {";
+		for (std::size_t i = 0; i < literals.size(); ++i)
+			str << (i ? ", \"" : " \"") << EscapeText(std::string { literals[i] }) << '"';
+		str << " } };\n\n"
+		    << indents << "\t" << resultID << " = literalSet" << depth << ".matchLiterals(" << stateID << ", " << spanID << ", \"" << ruleId << "\");\n"
+		    << indents << "}";
+		return str.str();
+	}
+
 	std::string handleMatcher(LexerCPPResult& result, const Lex& lex, const Node& node, ScopeSettings settings, std::string_view ruleId, std::string_view resultID, std::string_view stateID, std::string_view spanID, std::size_t depth = 1)
 	{
 		auto source = lex.getSource();
@@ -1117,19 +1289,24 @@ namespace CommonLexer
 		if (rule == "RegexMatcher")
 		{
 			std::string indents = std::string(depth, '\t');
+			std::string pattern = UnescapeText(source->getSpan(span));
+			auto        regex   = Regex::Get(pattern);
+			ReportRegex(result.m_Messages, *regex, span);
+			if (auto run = regex->getCharRun())
+				return CharRunCPP(pattern, *run, ruleId, resultID, stateID, spanID, depth);
 
 			std::ostringstream str;
 			str << indents << "// Regex Matcher\n"
 			    << indents << "{\n"
-			    << indents << "\tstd::regex regex" << depth << " = std::regex(\"" << EscapeText(UnescapeText(source->getSpan(span))) << "\", std::regex_constants::ECMAScript | std::regex_constants::optimize);\n\n"
-			    << indents << "\tstd::match_results<CommonLexer::SourceIterator> results;\n"
-			    << indents << "\tif (std::regex_search(" << spanID << ".begin(" << stateID << ".m_Source), " << spanID << ".end(" << stateID << ".m_Source), results, regex" << depth << ", std::regex_constants::match_continuous))\n"
+			    << indents << "\tstatic auto regex" << depth << " = CommonLexer::Regex::Get(\"" << EscapeText(pattern) << "\");\n\n"
+			    << indents << "\tstd::size_t length = regex" << depth << "->match(" << stateID << ".m_Source, " << spanID << ");\n"
+			    << indents << "\tif (length != CommonLexer::Regex::s_NoMatch)\n"
 			    << indents << "\t{\n"
-			    << indents << "\t\t" << resultID << " = { CommonLexer::EMatchStatus::Success, { results[0].first, results[0].second } };\n"
+			    << indents << "\t\t" << resultID << " = { CommonLexer::EMatchStatus::Success, { " << spanID << ".m_Begin, { " << spanID << ".m_Begin.m_Index + length } } };\n"
 			    << indents << "\t}\n"
 			    << indents << "\telse\n"
 			    << indents << "\t{\n"
-			    << indents << "\t\t" << stateID << ".m_Messages.emplace_back(\"Expected regex to succeed, but failed. Sadly I don't get regex error messages, maybe in the future ;), " << ruleId << "\", " << spanID << ".m_Begin, CommonLexer::SourceSpan { " << spanID << ".m_Begin, " << spanID << ".m_Begin });\n"
+			    << indents << "\t\t" << stateID << ".m_LexState->noteFailure(" << stateID << ".m_Messages.emplace_back(CommonLexer::EMessageCode::RegexFailed, CommonLexer::MessageArgs { .m_Rule = \"" << ruleId << "\" }, " << spanID << ".m_Begin, CommonLexer::SourceSpan { " << spanID << ".m_Begin, " << spanID << ".m_Begin }));\n"
 			    << indents << "\t\t" << resultID << " = { CommonLexer::EMatchStatus::Failure, { " << spanID << ".m_Begin, " << spanID << ".m_Begin } };\n"
 			    << indents << "\t}\n"
 			    << indents << "}";
@@ -1144,20 +1321,21 @@ namespace CommonLexer
 			    << indents << "{\n"
 			    << indents << "\tauto itr = " << spanID << ".begin(" << stateID << ".m_Source);\n"
 			    << indents << "\tauto end = " << spanID << ".end(" << stateID << ".m_Source);\n\n"
-			    << indents << "\tstd::string_view text    = \"" << EscapeText(UnescapeText(source->getSpan(span))) << "\";\n"
-			    << indents << "\tauto             textItr = text.begin();\n"
-			    << indents << "\tauto             textEnd = text.end();\n\n"
+			    << indents << "\tstd::string_view text      = \"" << EscapeText(UnescapeText(source->getSpan(span))) << "\";\n"
+			    << indents << "\tauto             textBegin = text.begin();\n"
+			    << indents << "\tauto             textItr   = text.begin();\n"
+			    << indents << "\tauto             textEnd   = text.end();\n\n"
 			    << indents << "\twhile (textItr != textEnd)\n"
 			    << indents << "\t{\n"
 			    << indents << "\t\tif (itr == end)\n"
 			    << indents << "\t\t{\n"
-			    << indents << "\t\t\t" << stateID << ".m_Messages.emplace_back(fmt::format(\"Expected '{}' but got 'EOF', " << ruleId << "\", std::string_view { textItr, textEnd }), itr, CommonLexer::SourceSpan { " << spanID << ".m_Begin, itr });\n"
+			    << indents << "\t\t\t" << stateID << ".m_LexState->noteFailure(" << stateID << ".m_Messages.emplace_back(CommonLexer::EMessageCode::ExpectedText, CommonLexer::MessageArgs { .m_Text = text.substr(static_cast<std::size_t>(textItr - textBegin)), .m_Rule = \"" << ruleId << "\" }, itr, CommonLexer::SourceSpan { " << spanID << ".m_Begin, itr }));\n"
 			    << indents << "\t\t\t" << resultID << " = { CommonLexer::EMatchStatus::Failure, { " << spanID << ".m_Begin, itr } };\n"
 			    << indents << "\t\t\tbreak;\n"
 			    << indents << "\t\t}\n\n"
 			    << indents << "\t\tif (*itr != *textItr)\n"
 			    << indents << "\t\t{\n"
-			    << indents << "\t\t\t" << stateID << ".m_Messages.emplace_back(fmt::format(\"Expected '{}' but got '{}', " << ruleId << "\", *textItr, *itr), itr, CommonLexer::SourceSpan { " << spanID << ".m_Begin, itr });\n"
+			    << indents << "\t\t\t" << stateID << ".m_LexState->noteFailure(" << stateID << ".m_Messages.emplace_back(CommonLexer::EMessageCode::ExpectedText, CommonLexer::MessageArgs { .m_Text = text.substr(static_cast<std::size_t>(textItr - textBegin), 1), .m_Rule = \"" << ruleId << "\", .m_Got = static_cast<std::uint8_t>(*itr) }, itr, CommonLexer::SourceSpan { " << spanID << ".m_Begin, itr }));\n"
 			    << indents << "\t\t\t" << resultID << " = { CommonLexer::EMatchStatus::Failure, { " << spanID << ".m_Begin, itr } };\n"
 			    << indents << "\t\t}\n\n"
 			    << indents << "\t\t++itr;\n"
@@ -1198,7 +1376,7 @@ namespace CommonLexer
 			std::ostringstream str;
 			str << indents << "// NamedGroupReferenceMatcher\n"
 			    << indents << "{\n"
-			    << indents << "\tauto groupedSpan = " << stateID << ".m_Lexer->getGroupedValue(\"" << source->getSpan(namedGroupId->getSpan()) << "\");\n\n"
+			    << indents << "\tauto groupedSpan = " << stateID << ".m_LexState->getGroupedValue(\"" << source->getSpan(namedGroupId->getSpan()) << "\");\n\n"
 			    << indents << "\tauto itr = " << spanID << ".begin(" << stateID << ".m_Source);\n"
 			    << indents << "\tauto end = " << spanID << ".end(" << stateID << ".m_Source);\n\n"
 			    << indents << "\tauto textItr = groupedSpan.begin(" << stateID << ".m_Source);\n"
@@ -1262,7 +1440,7 @@ namespace CommonLexer
 			    << indents << "\t\t" << resultID << " = { CommonLexer::EMatchStatus::Skip, " << newResultID << ".m_Span };\n"
 			    << indents << "\t\tbreak;\n"
 			    << indents << "\tcase CommonLexer::EMatchStatus::Success:\n"
-			    << indents << "\t\t" << stateID << ".m_Lexer->setGroupedValue(\"" << source->getSpan(namedGroupSpan) << "\", " << newResultID << ".m_Span);\n"
+			    << indents << "\t\t" << stateID << ".m_LexState->setGroupedValue(\"" << source->getSpan(namedGroupSpan) << "\", " << newResultID << ".m_Span);\n"
 			    << indents << "\t\t" << resultID << " = { CommonLexer::EMatchStatus::Success, " << newResultID << ".m_Span };\n"
 			    << indents << "\t\tbreak;\n"
 			    << indents << "\tdefault:\n"
@@ -1310,6 +1488,7 @@ namespace CommonLexer
 				    << indents << "\t\tstd::size_t i = 0;\n\n"
 				    << indents << "\t\tauto begin = " << stateID << ".m_SourceSpan.begin(" << stateID << ".m_Source);\n"
 				    << indents << "\t\tauto itr   = " << subSpanID << ".begin(" << stateID << ".m_Source);\n"
+				    << indents << "\t\tauto first = itr;\n"
 				    << indents << "\t\tauto end   = " << subSpanID << ".end(" << stateID << ".m_Source);\n"
 				    << indents << "\t\t--itr;\n"
 				    << indents << "\t\tif (itr < begin)\n"
@@ -1339,7 +1518,7 @@ namespace CommonLexer
 				str << indents << "\t\t\t\tbreakOut = false;\n"
 				    << indents << "\t\t\t\tbreak;\n"
 				    << indents << "\t\t\t}\n"
-				    << indents << "\t\t\tif (i > 0 && breakOut)\n"
+				    << indents << "\t\t\tif (breakOut && !(itr < first))\n"
 				    << indents << "\t\t\t\tbreak;\n"
 				    << indents << "\t\t\t++itr;\n"
 				    << indents << "\t\t\tif (!breakOut)\n"
@@ -1347,17 +1526,8 @@ namespace CommonLexer
 				    << indents << "\t\t}\n\n"
 				    << indents << "\t\tif (i == 0)\n"
 				    << indents << "\t\t{\n"
-				    << indents << "\t\t\t" << stateID << ".m_Messages.emplace_back(fmt::format(\"Expected ";
-				switch (settings.m_SpaceMethod)
-				{
-				case ESpaceMethod::Normal:
-					str << "space or tab";
-					break;
-				case ESpaceMethod::Whitespace:
-					str << "spacee, tab, vertical tab, form feed, carriage return or line feed";
-					break;
-				}
-				str << " but got '{}'\", itr != end ? std::string { *itr } : \"EOF\"), " << subSpanID << ".m_Begin, CommonLexer::SourceSpan { " << subSpanID << ".m_Begin, " << subSpanID << ".m_Begin });\n"
+				    << indents << "\t\t\tstd::uint16_t got = itr != end ? static_cast<std::uint8_t>(*itr) : CommonLexer::MessageArgs::s_EOF;\n"
+				    << indents << "\t\t\t" << stateID << ".m_LexState->noteFailure(" << stateID << ".m_Messages.emplace_back(CommonLexer::EMessageCode::" << (settings.m_SpaceMethod == ESpaceMethod::Normal ? "ExpectedSpace" : "ExpectedWhitespace") << ", CommonLexer::MessageArgs { .m_Got = got }, " << subSpanID << ".m_Begin, CommonLexer::SourceSpan { " << subSpanID << ".m_Begin, " << subSpanID << ".m_Begin }));\n"
 				    << indents << "\t\t\t" << resultID << " = { CommonLexer::EMatchStatus::Failure, { " << spanID << ".m_Begin, itr } };\n"
 				    << indents << "\t\t\t" << failedID << " = true;\n"
 				    << indents << "\t\t}\n"
@@ -1381,7 +1551,7 @@ namespace CommonLexer
 			    << indents << "\t\t\t" << failedID << " = true;\n"
 			    << indents << "\t\t\tbreak;\n"
 			    << indents << "\t\tcase CommonLexer::EMatchStatus::Success:\n"
-			    << indents << "\t\t\t" << subSpanID << ".m_Begin = " << totalSpanID << ".m_End = " << resultID << ".m_Span.m_End;\n"
+			    << indents << "\t\t\t" << subSpanID << ".m_Begin = " << totalSpanID << ".m_End = " << newResultID << ".m_Span.m_End;\n"
 			    << indents << "\t\t\tbreak;\n"
 			    << indents << "\t\tdefault: break;\n"
 			    << indents << "\t\t}\n";
@@ -1393,6 +1563,7 @@ namespace CommonLexer
 				    << indents << "\t\t\tstd::size_t i = 0;\n\n"
 				    << indents << "\t\t\tauto begin = " << stateID << ".m_SourceSpan.begin(" << stateID << ".m_Source);\n"
 				    << indents << "\t\t\tauto itr   = " << subSpanID << ".begin(" << stateID << ".m_Source);\n"
+				    << indents << "\t\t\tauto first = itr;\n"
 				    << indents << "\t\t\tauto end   = " << subSpanID << ".end(" << stateID << ".m_Source);\n"
 				    << indents << "\t\t\t--itr;\n"
 				    << indents << "\t\t\tif (itr < begin)\n"
@@ -1422,7 +1593,7 @@ namespace CommonLexer
 				str << indents << "\t\t\t\t\tbreakOut = false;\n"
 				    << indents << "\t\t\t\t\tbreak;\n"
 				    << indents << "\t\t\t\t}\n"
-				    << indents << "\t\t\t\tif (i > 0 && breakOut)\n"
+				    << indents << "\t\t\t\tif (breakOut && !(itr < first))\n"
 				    << indents << "\t\t\t\t\tbreak;\n"
 				    << indents << "\t\t\t\t++itr;\n"
 				    << indents << "\t\t\t\tif (!breakOut)\n"
@@ -1430,17 +1601,8 @@ namespace CommonLexer
 				    << indents << "\t\t\t}\n\n"
 				    << indents << "\t\t\tif (i == 0)\n"
 				    << indents << "\t\t\t{\n"
-				    << indents << "\t\t\t\t" << stateID << ".m_Messages.emplace_back(fmt::format(\"Expected ";
-				switch (settings.m_SpaceMethod)
-				{
-				case ESpaceMethod::Normal:
-					str << "space or tab";
-					break;
-				case ESpaceMethod::Whitespace:
-					str << "spacee, tab, vertical tab, form feed, carriage return or line feed";
-					break;
-				}
-				str << " but got '{}'\", itr != end ? std::string { *itr } : \"EOF\"), " << subSpanID << ".m_Begin, CommonLexer::SourceSpan { " << subSpanID << ".m_Begin, " << subSpanID << ".m_Begin });\n"
+				    << indents << "\t\t\t\tstd::uint16_t got = itr != end ? static_cast<std::uint8_t>(*itr) : CommonLexer::MessageArgs::s_EOF;\n"
+				    << indents << "\t\t\t\t" << stateID << ".m_LexState->noteFailure(" << stateID << ".m_Messages.emplace_back(CommonLexer::EMessageCode::" << (settings.m_SpaceMethod == ESpaceMethod::Normal ? "ExpectedSpace" : "ExpectedWhitespace") << ", CommonLexer::MessageArgs { .m_Got = got }, " << subSpanID << ".m_Begin, CommonLexer::SourceSpan { " << subSpanID << ".m_Begin, " << subSpanID << ".m_Begin }));\n"
 				    << indents << "\t\t\t\t" << resultID << " = { CommonLexer::EMatchStatus::Failure, { " << spanID << ".m_Begin, itr } };\n"
 				    << indents << "\t\t\t\t" << failedID << " = true;\n"
 				    << indents << "\t\t\t}\n"
@@ -1481,13 +1643,8 @@ namespace CommonLexer
 			if (settings.m_SpaceDirection == ESpaceDirection::Left || settings.m_SpaceDirection == ESpaceDirection::Both)
 			{
 				str << indents << "\t{\n"
-				    << indents << "\t\tstd::size_t i = 0;\n\n"
-				    << indents << "\t\tauto begin = " << stateID << ".m_SourceSpan.begin(" << stateID << ".m_Source);\n"
-				    << indents << "\t\tauto itr   = " << subSpanID << ".begin(" << stateID << ".m_Source);\n"
-				    << indents << "\t\tauto end   = " << subSpanID << ".end(" << stateID << ".m_Source);\n"
-				    << indents << "\t\t--itr;\n"
-				    << indents << "\t\tif (itr < begin)\n"
-				    << indents << "\t\t\t++itr;\n"
+				    << indents << "\t\tauto itr = " << subSpanID << ".begin(" << stateID << ".m_Source);\n"
+				    << indents << "\t\tauto end = " << subSpanID << ".end(" << stateID << ".m_Source);\n"
 				    << indents << "\t\twhile (itr != end)\n"
 				    << indents << "\t\t{\n"
 				    << indents << "\t\t\tbool breakOut = true;\n"
@@ -1497,7 +1654,7 @@ namespace CommonLexer
 				switch (settings.m_SpaceMethod)
 				{
 				case ESpaceMethod::Normal:
-					str << indents << "\t\t\tcase '\\t': [[tallthrough]];\n"
+					str << indents << "\t\t\tcase '\\t': [[fallthrough]];\n"
 					    << indents << "\t\t\tcase ' ':\n";
 					break;
 				case ESpaceMethod::Whitespace:
@@ -1513,7 +1670,7 @@ namespace CommonLexer
 				str << indents << "\t\t\t\tbreakOut = false;\n"
 				    << indents << "\t\t\t\tbreak;\n"
 				    << indents << "\t\t\t}\n"
-				    << indents << "\t\t\tif (i > 0 && breakOut)\n"
+				    << indents << "\t\t\tif (breakOut)\n"
 				    << indents << "\t\t\t\tbreak;\n"
 				    << indents << "\t\t\t++itr;\n"
 				    << indents << "\t\t}\n\n"
@@ -1534,7 +1691,7 @@ namespace CommonLexer
 			    << indents << "\t\t\t" << failedID << " = true;\n"
 			    << indents << "\t\t\tbreak;\n"
 			    << indents << "\t\tcase CommonLexer::EMatchStatus::Success:\n"
-			    << indents << "\t\t\t" << subSpanID << ".m_Begin = " << totalSpanID << ".m_End = " << resultID << ".m_Span.m_End;\n"
+			    << indents << "\t\t\t" << subSpanID << ".m_Begin = " << totalSpanID << ".m_End = " << newResultID << ".m_Span.m_End;\n"
 			    << indents << "\t\t\tbreak;\n"
 			    << indents << "\t\tdefault: break;\n"
 			    << indents << "\t\t}\n";
@@ -1543,13 +1700,8 @@ namespace CommonLexer
 			{
 				str << indents << "\t\tif (!" << failedID << ")\n"
 				    << indents << "\t\t{\n"
-				    << indents << "\t\t\tstd::size_t i = 0;\n\n"
-				    << indents << "\t\t\tauto begin = " << stateID << ".m_SourceSpan.begin(" << stateID << ".m_Source);\n"
-				    << indents << "\t\t\tauto itr   = " << subSpanID << ".begin(" << stateID << ".m_Source);\n"
-				    << indents << "\t\t\tauto end   = " << subSpanID << ".end(" << stateID << ".m_Source);\n"
-				    << indents << "\t\t\t--itr;\n"
-				    << indents << "\t\t\tif (itr < begin)\n"
-				    << indents << "\t\t\t\t++itr;\n"
+				    << indents << "\t\t\tauto itr = " << subSpanID << ".begin(" << stateID << ".m_Source);\n"
+				    << indents << "\t\t\tauto end = " << subSpanID << ".end(" << stateID << ".m_Source);\n"
 				    << indents << "\t\t\twhile (itr != end)\n"
 				    << indents << "\t\t\t{\n"
 				    << indents << "\t\t\t\tbool breakOut = true;\n"
@@ -1575,7 +1727,7 @@ namespace CommonLexer
 				str << indents << "\t\t\t\t\tbreakOut = false;\n"
 				    << indents << "\t\t\t\t\tbreak;\n"
 				    << indents << "\t\t\t\t}\n"
-				    << indents << "\t\t\t\tif (i > 0 && breakOut)\n"
+				    << indents << "\t\t\t\tif (breakOut)\n"
 				    << indents << "\t\t\t\t\tbreak;\n"
 				    << indents << "\t\t\t\t++itr;\n"
 				    << indents << "\t\t\t}\n\n"
@@ -1599,15 +1751,17 @@ namespace CommonLexer
 			}
 			std::string indents = std::string(depth, '\t');
 
-			std::string tempNodeID  = "tempNode" + std::to_string(depth);
-			std::string tempStateID = "tempState" + std::to_string(depth);
+			std::string nodeMarkID    = "nodeMark" + std::to_string(depth);
+			std::string messageMarkID = "messageMark" + std::to_string(depth);
 
 			std::ostringstream str;
 			str << indents << "// NegativeMatcher\n"
 			    << indents << "{\n"
-			    << indents << "\tCommonLexer::Node         " << tempNodeID << " { *" << stateID << ".m_Lexer };\n"
-			    << indents << "\tCommonLexer::MatcherState " << tempStateID << " { {}, &" << tempNodeID << ", " << stateID << ".m_Lexer, " << stateID << ".m_Source, " << stateID << ".m_SourceSpan, " << stateID << ".m_CurrentRule, " << stateID << ".m_RuleBegin };\n"
-			    << handleMatcher(result, lex, *subMatcher, settings, ruleId, resultID, tempStateID, spanID, depth + 1) << '\n'
+			    << indents << "\tstd::size_t " << nodeMarkID << " = " << stateID << ".m_ParentNode->getChildren().size();\n"
+			    << indents << "\tstd::size_t " << messageMarkID << " = " << stateID << ".m_Messages.size();\n"
+			    << handleMatcher(result, lex, *subMatcher, settings, ruleId, resultID, stateID, spanID, depth + 1) << '\n'
+			    << indents << "\t" << stateID << ".m_ParentNode->truncateChildren(" << nodeMarkID << ");\n"
+			    << indents << "\t" << stateID << ".m_Messages.erase(" << stateID << ".m_Messages.begin() + " << messageMarkID << ", " << stateID << ".m_Messages.end());\n"
 			    << indents << "\tswitch (" << resultID << ".m_Status)\n"
 			    << indents << "\t{\n"
 			    << indents << "\tcase CommonLexer::EMatchStatus::Failure: [[fallthrough]];\n"
@@ -1615,7 +1769,7 @@ namespace CommonLexer
 			    << indents << "\t\t" << resultID << "= { CommonLexer::EMatchStatus::Success, { " << spanID << ".m_Begin, " << spanID << ".m_Begin } };\n"
 			    << indents << "\t\tbreak;\n"
 			    << indents << "\tcase CommonLexer::EMatchStatus::Success:\n"
-			    << indents << "\t\t" << stateID << ".m_Messages.emplace_back(\"Did not expect following sequence\", " << spanID << ".m_Begin, " << resultID << ".m_Span);\n"
+			    << indents << "\t\t" << stateID << ".m_LexState->noteFailure(" << stateID << ".m_Messages.emplace_back(CommonLexer::EMessageCode::UnexpectedSequence, CommonLexer::MessageArgs {}, " << spanID << ".m_Begin, " << resultID << ".m_Span));\n"
 			    << indents << "\t\t" << resultID << "= { CommonLexer::EMatchStatus::Failure, " << resultID << ".m_Span };\n"
 			    << indents << "\t\tbreak;\n"
 			    << indents << "\tdefault:\n"
@@ -1698,7 +1852,7 @@ namespace CommonLexer
 
 			str << indents << "\tCommonLexer::SourceSpan " << subSpanID << " = " << spanID << ";\n"
 			    << indents << "\tCommonLexer::SourceSpan " << totalSpanID << " = { " << spanID << ".m_Begin, " << spanID << ".m_Begin };\n"
-			    << indents << "\tCommonLexer::MatcherState " << tempStateID << " = { {}, " << stateID << ".m_ParentNode, " << stateID << ".m_Lexer, " << stateID << ".m_Source, " << stateID << ".m_SourceSpan, " << stateID << ".m_CurrentRule, " << stateID << ".m_RuleBegin };\n"
+			    << indents << "\tCommonLexer::MatcherState " << tempStateID << " = { {}, " << stateID << ".m_ParentNode, " << stateID << ".m_Lexer, " << stateID << ".m_LexState, " << stateID << ".m_Source, " << stateID << ".m_SourceSpan, " << stateID << ".m_CurrentRule, " << stateID << ".m_RuleBegin };\n"
 			    << indents << "\tCommonLexer::MatchResult " << newResultID << " { CommonLexer::EMatchStatus::Failure, { " << spanID << ".m_Begin, " << spanID << ".m_Begin } };\n";
 
 			if (upperBounds != ~0ULL)
@@ -1717,9 +1871,7 @@ namespace CommonLexer
 			    << indents << "\t}\n"
 			    << indents << "\tif (" << totalSpanID << ".m_End.m_Index < " << spanID << ".m_End.m_Index)\n"
 			    << indents << "\t{\n"
-			    << indents << "\t\t" << stateID << ".m_Messages.reserve(" << stateID << ".m_Messages.size() + " << tempStateID << ".m_Messages.size());\n"
-			    << indents << "\t\tfor (auto& message : " << tempStateID << ".m_Messages)\n"
-			    << indents << "\t\t\t" << tempStateID << ".m_Messages.push_back(std::move(message));\n"
+			    << indents << "\t\t" << stateID << ".m_Messages.insert(" << stateID << ".m_Messages.end(), std::make_move_iterator(" << tempStateID << ".m_Messages.begin()), std::make_move_iterator(" << tempStateID << ".m_Messages.end()));\n"
 			    << indents << "\t}\n";
 
 			if (lowerBounds != 0)
@@ -1770,7 +1922,7 @@ namespace CommonLexer
 			    << indents << "\tstd::size_t " << matchesID << " = 0;\n"
 			    << indents << "\tCommonLexer::SourceSpan " << subSpanID << " = " << spanID << ";\n"
 			    << indents << "\tCommonLexer::SourceSpan " << totalSpanID << " = { " << spanID << ".m_Begin, " << spanID << ".m_Begin };\n"
-			    << indents << "\tCommonLexer::MatcherState " << tempStateID << " = { {}, " << stateID << ".m_ParentNode, " << stateID << ".m_Lexer, " << stateID << ".m_Source, " << stateID << ".m_SourceSpan, " << stateID << ".m_CurrentRule, " << stateID << ".m_RuleBegin };\n"
+			    << indents << "\tCommonLexer::MatcherState " << tempStateID << " = { {}, " << stateID << ".m_ParentNode, " << stateID << ".m_Lexer, " << stateID << ".m_LexState, " << stateID << ".m_Source, " << stateID << ".m_SourceSpan, " << stateID << ".m_CurrentRule, " << stateID << ".m_RuleBegin };\n"
 			    << indents << "\tCommonLexer::MatchResult " << newResultID << " { CommonLexer::EMatchStatus::Failure, { " << spanID << ".m_Begin, " << spanID << ".m_Begin } };\n"
 			    << indents << "\twhile (" << matchesID << " < " << std::to_string(amount) << ")\n"
 			    << indents << "\t{\n"
@@ -1784,9 +1936,7 @@ namespace CommonLexer
 			    << indents << "\t}\n"
 			    << indents << "\tif (" << totalSpanID << ".m_End.m_Index < " << spanID << ".m_End.m_Index)\n"
 			    << indents << "\t{\n"
-			    << indents << "\t\t" << stateID << ".m_Messages.reserve(" << stateID << ".m_Messages.size() + " << tempStateID << ".m_Messages.size());\n"
-			    << indents << "\t\tfor (auto& message : " << tempStateID << ".m_Messages)\n"
-			    << indents << "\t\t\t" << tempStateID << ".m_Messages.push_back(std::move(message));\n"
+			    << indents << "\t\t" << stateID << ".m_Messages.insert(" << stateID << ".m_Messages.end(), std::make_move_iterator(" << tempStateID << ".m_Messages.begin()), std::make_move_iterator(" << tempStateID << ".m_Messages.end()));\n"
 			    << indents << "\t}\n"
 			    << indents << "\tif (" << matchesID << " < " << std::to_string(amount) << ")\n"
 			    << indents << "\t{\n"
@@ -1824,7 +1974,7 @@ namespace CommonLexer
 			    << indents << "\tstd::size_t " << matchesID << " = 0;\n"
 			    << indents << "\tCommonLexer::SourceSpan " << subSpanID << " = " << spanID << ";\n"
 			    << indents << "\tCommonLexer::SourceSpan " << totalSpanID << " = { " << spanID << ".m_Begin, " << spanID << ".m_Begin };\n"
-			    << indents << "\tCommonLexer::MatcherState " << tempStateID << " = { {}, " << stateID << ".m_ParentNode, " << stateID << ".m_Lexer, " << stateID << ".m_Source, " << stateID << ".m_SourceSpan, " << stateID << ".m_CurrentRule, " << stateID << ".m_RuleBegin };\n"
+			    << indents << "\tCommonLexer::MatcherState " << tempStateID << " = { {}, " << stateID << ".m_ParentNode, " << stateID << ".m_Lexer, " << stateID << ".m_LexState, " << stateID << ".m_Source, " << stateID << ".m_SourceSpan, " << stateID << ".m_CurrentRule, " << stateID << ".m_RuleBegin };\n"
 			    << indents << "\tCommonLexer::MatchResult " << newResultID << " { CommonLexer::EMatchStatus::Failure, { " << spanID << ".m_Begin, " << spanID << ".m_Begin } };\n"
 			    << indents << "\twhile (true)\n"
 			    << indents << "\t{\n"
@@ -1838,9 +1988,7 @@ namespace CommonLexer
 			    << indents << "\t}\n"
 			    << indents << "\tif (" << totalSpanID << ".m_End.m_Index < " << spanID << ".m_End.m_Index)\n"
 			    << indents << "\t{\n"
-			    << indents << "\t\t" << stateID << ".m_Messages.reserve(" << stateID << ".m_Messages.size() + " << tempStateID << ".m_Messages.size());\n"
-			    << indents << "\t\tfor (auto& message : " << tempStateID << ".m_Messages)\n"
-			    << indents << "\t\t\t" << tempStateID << ".m_Messages.push_back(std::move(message));\n"
+			    << indents << "\t\t" << stateID << ".m_Messages.insert(" << stateID << ".m_Messages.end(), std::make_move_iterator(" << tempStateID << ".m_Messages.begin()), std::make_move_iterator(" << tempStateID << ".m_Messages.end()));\n"
 			    << indents << "\t}\n"
 			    << indents << "\tif (" << matchesID << " < 1)\n"
 			    << indents << "\t{\n"
@@ -1877,7 +2025,7 @@ namespace CommonLexer
 			    << indents << "{\n"
 			    << indents << "\tCommonLexer::SourceSpan " << subSpanID << " = " << spanID << ";\n"
 			    << indents << "\tCommonLexer::SourceSpan " << totalSpanID << " = { " << spanID << ".m_Begin, " << spanID << ".m_Begin };\n"
-			    << indents << "\tCommonLexer::MatcherState " << tempStateID << " = { {}, " << stateID << ".m_ParentNode, " << stateID << ".m_Lexer, " << stateID << ".m_Source, " << stateID << ".m_SourceSpan, " << stateID << ".m_CurrentRule, " << stateID << ".m_RuleBegin };\n"
+			    << indents << "\tCommonLexer::MatcherState " << tempStateID << " = { {}, " << stateID << ".m_ParentNode, " << stateID << ".m_Lexer, " << stateID << ".m_LexState, " << stateID << ".m_Source, " << stateID << ".m_SourceSpan, " << stateID << ".m_CurrentRule, " << stateID << ".m_RuleBegin };\n"
 			    << indents << "\tCommonLexer::MatchResult " << newResultID << " { CommonLexer::EMatchStatus::Failure, { " << spanID << ".m_Begin, " << spanID << ".m_Begin } };\n"
 			    << indents << "\twhile (true)\n"
 			    << indents << "\t{\n"
@@ -1890,39 +2038,56 @@ namespace CommonLexer
 			    << indents << "\t}\n"
 			    << indents << "\tif (" << totalSpanID << ".m_End.m_Index < " << spanID << ".m_End.m_Index)\n"
 			    << indents << "\t{\n"
-			    << indents << "\t\t" << stateID << ".m_Messages.reserve(" << stateID << ".m_Messages.size() + " << tempStateID << ".m_Messages.size());\n"
-			    << indents << "\t\tfor (auto& message : " << tempStateID << ".m_Messages)\n"
-			    << indents << "\t\t\t" << tempStateID << ".m_Messages.push_back(std::move(message));\n"
+			    << indents << "\t\t" << stateID << ".m_Messages.insert(" << stateID << ".m_Messages.end(), std::make_move_iterator(" << tempStateID << ".m_Messages.begin()), std::make_move_iterator(" << tempStateID << ".m_Messages.end()));\n"
 			    << indents << "\t}\n"
 			    << indents << "\t" << resultID << " = { CommonLexer::EMatchStatus::Success, " << totalSpanID << " };\n"
 			    << indents << "}";
 			return str.str();
 		}
-		else if (rule == "OrMatcher")
+		else if (rule == "OrMatcher" || rule == "Branch" || rule == "OrderedMatcher")
 		{
 			std::string indents = std::string(depth, '\t');
 
-			std::string statusID      = "status" + std::to_string(depth);
-			std::string messagesID    = "messages" + std::to_string(depth);
-			std::string largestCopyID = "largestCopy" + std::to_string(depth);
-			std::string largestSpanID = "largestSpan" + std::to_string(depth);
-			std::string tempNodeID    = "tempNode" + std::to_string(depth);
-			std::string tempStateID   = "tempState" + std::to_string(depth);
+			bool ordered = rule == "OrderedMatcher";
+			bool cut     = HasCut(node);
+
+			std::vector<std::string> literals;
+			if (!ordered && CollectLiterals(lex, node, literals))
+				return LiteralSetCPP(literals, ruleId, resultID, stateID, spanID, depth);
+
+			std::string statusID          = "status" + std::to_string(depth);
+			std::string largestID         = "largest" + std::to_string(depth);
+			std::string largestSpanID     = "largestSpan" + std::to_string(depth);
+			std::string nodeMarkID        = "nodeMark" + std::to_string(depth);
+			std::string messageMarkID     = "messageMark" + std::to_string(depth);
+			std::string largestNodesID    = "largestNodes" + std::to_string(depth);
+			std::string largestMessagesID = "largestMessages" + std::to_string(depth);
+			std::string stopID            = "stop" + std::to_string(depth);
+			std::string cutID             = "cut" + std::to_string(depth);
 
 			std::ostringstream str;
-			str << indents << "// OrMatcher\n"
+			str << indents << "// " << rule << '\n'
 			    << indents << "{\n"
 			    << indents << "\tCommonLexer::EMatchStatus " << statusID << " = CommonLexer::EMatchStatus::Failure;\n"
-			    << indents << "\tstd::vector<CommonLexer::Message> " << messagesID << ";\n"
-			    << indents << "\tCommonLexer::Node " << largestCopyID << " { *" << stateID << ".m_Lexer };\n"
-			    << indents << "\tCommonLexer::SourceSpan " << largestSpanID << " { " << spanID << ".m_Begin, " << spanID << ".m_Begin };\n";
+			    << indents << "\tCommonLexer::SourceSpan " << largestSpanID << " { " << spanID << ".m_Begin, " << spanID << ".m_Begin };\n"
+			    << indents << "\tstd::size_t " << nodeMarkID << " = " << stateID << ".m_ParentNode->getChildren().size();\n"
+			    << indents << "\tstd::size_t " << messageMarkID << " = " << stateID << ".m_Messages.size();\n"
+			    << indents << "\tstd::size_t " << largestNodesID << " = " << nodeMarkID << ";\n"
+			    << indents << "\tstd::size_t " << largestMessagesID << " = " << messageMarkID << ";\n";
+			if (ordered || cut)
+				str << indents << "\tbool " << stopID << " = false;\n";
+			if (cut)
+				str << indents << "\tbool " << cutID << " = " << stateID << ".m_Cut;\n";
 
 			for (auto& child : node.getChildren())
 			{
-				str << indents << "\t{\n"
-				    << indents << "\t\tCommonLexer::Node " << tempNodeID << " { *" << stateID << ".m_Lexer };\n"
-				    << indents << "\t\tCommonLexer::MatcherState " << tempStateID << " { {}, &" << tempNodeID << ", " << stateID << ".m_Lexer, " << stateID << ".m_Source, " << stateID << ".m_SourceSpan, " << stateID << ".m_CurrentRule, " << stateID << ".m_RuleBegin };\n"
-				    << handleMatcher(result, lex, child, settings, ruleId, resultID, tempStateID, spanID, depth + 2) << '\n'
+				if (ordered || cut)
+					str << indents << "\tif (!" << stopID << ")\n";
+				str << indents << "\t{\n";
+				if (cut)
+					str << indents << "\t\t" << stateID << ".m_Cut = false;\n";
+				str << indents << "\t\tbool " << largestID << " = false;\n"
+				    << handleMatcher(result, lex, child, settings, ruleId, resultID, stateID, spanID, depth + 2) << '\n'
 				    << indents << "\t\tswitch (" << resultID << ".m_Status)\n"
 				    << indents << "\t\t{\n"
 				    << indents << "\t\tcase CommonLexer::EMatchStatus::Skip:\n"
@@ -1934,31 +2099,42 @@ namespace CommonLexer
 				    << indents << "\t\t\tstd::size_t len = " << resultID << ".m_Span.length();\n"
 				    << indents << "\t\t\tif (len == 0)\n"
 				    << indents << "\t\t\t\tlen = 1;\n"
-				    << indents << "\t\t\tif ((" << statusID << " == CommonLexer::EMatchStatus::Skip || " << statusID << " == CommonLexer::EMatchStatus::Failure) && len > " << largestSpanID << ".length())\n"
-				    << indents << "\t\t\t{\n"
-				    << indents << "\t\t\t\t" << largestSpanID << " = " << resultID << ".m_Span;\n"
-				    << indents << "\t\t\t\t" << largestCopyID << " = std::move(" << tempNodeID << ");\n"
-				    << indents << "\t\t\t\t" << messagesID << " = std::move(" << tempStateID << ".m_Messages);\n"
-				    << indents << "\t\t\t}\n"
+				    << indents << "\t\t\t" << largestID << " = (" << statusID << " == CommonLexer::EMatchStatus::Skip || " << statusID << " == CommonLexer::EMatchStatus::Failure) && len > " << largestSpanID << ".length();\n"
 				    << indents << "\t\t\tbreak;\n"
 				    << indents << "\t\t}\n"
 				    << indents << "\t\tcase CommonLexer::EMatchStatus::Success:\n"
-				    << indents << "\t\t\tif (" << statusID << " == CommonLexer::EMatchStatus::Skip || " << statusID << " == CommonLexer::EMatchStatus::Failure || " << resultID << ".m_Span.length() > " << largestSpanID << ".length())\n"
-				    << indents << "\t\t\t{\n"
-				    << indents << "\t\t\t\t" << largestSpanID << " = " << resultID << ".m_Span;\n"
-				    << indents << "\t\t\t\t" << largestCopyID << " = std::move(" << tempNodeID << ");\n"
-				    << indents << "\t\t\t\t" << messagesID << " = std::move(" << tempStateID << ".m_Messages);\n"
+				    << indents << "\t\t\t" << largestID << " = " << statusID << " == CommonLexer::EMatchStatus::Skip || " << statusID << " == CommonLexer::EMatchStatus::Failure || " << resultID << ".m_Span.length() > " << largestSpanID << ".length();\n"
+				    << indents << "\t\t\tif (" << largestID << ")\n"
 				    << indents << "\t\t\t\t" << statusID << " = CommonLexer::EMatchStatus::Success;\n"
-				    << indents << "\t\t\t}\n"
 				    << indents << "\t\t\tbreak;\n"
 				    << indents << "\t\tdefault: break;\n"
 				    << indents << "\t\t}\n"
-				    << indents << "\t}\n";
+				    << indents << "\t\tif (" << largestID << ")\n"
+				    << indents << "\t\t{\n"
+				    << indents << "\t\t\t" << largestSpanID << " = " << resultID << ".m_Span;\n"
+				    << indents << "\t\t\t" << stateID << ".m_ParentNode->eraseChildren(" << nodeMarkID << ", " << largestNodesID << ");\n"
+				    << indents << "\t\t\t" << stateID << ".m_Messages.erase(" << stateID << ".m_Messages.begin() + " << messageMarkID << ", " << stateID << ".m_Messages.begin() + " << largestMessagesID << ");\n"
+				    << indents << "\t\t\t" << largestNodesID << " = " << stateID << ".m_ParentNode->getChildren().size();\n"
+				    << indents << "\t\t\t" << largestMessagesID << " = " << stateID << ".m_Messages.size();\n"
+				    << indents << "\t\t}\n"
+				    << indents << "\t\telse\n"
+				    << indents << "\t\t{\n"
+				    << indents << "\t\t\t" << stateID << ".m_ParentNode->truncateChildren(" << largestNodesID << ");\n"
+				    << indents << "\t\t\t" << stateID << ".m_Messages.erase(" << stateID << ".m_Messages.begin() + " << largestMessagesID << ", " << stateID << ".m_Messages.end());\n"
+				    << indents << "\t\t}\n";
+				if (ordered)
+					str << indents << "\t\tif (" << statusID << " == CommonLexer::EMatchStatus::Success)\n"
+					    << indents << "\t\t\t" << stopID << " = true;\n";
+				if (cut)
+					str << indents << "\t\tif (" << stateID << ".m_Cut && " << resultID << ".m_Status != CommonLexer::EMatchStatus::Success)\n"
+					    << indents << "\t\t\t" << stopID << " = true;\n";
+				str << indents << "\t}\n";
 			}
+			if (cut)
+				str << indents << "\t" << stateID << ".m_Cut = " << cutID << ";\n";
 
-			str << indents << "\t" << stateID << ".m_Messages.reserve(" << stateID << ".m_Messages.size() + " << messagesID << ".size());\n"
-			    << indents << "\tfor (auto& message : " << messagesID << ")\n"
-			    << indents << "\t\t" << stateID << ".m_Messages.push_back(std::move(message));\n"
+			str << indents << "\tif (" << statusID << " != CommonLexer::EMatchStatus::Success)\n"
+			    << indents << "\t\t" << stateID << ".m_ParentNode->truncateChildren(" << nodeMarkID << ");\n"
 			    << indents << "\tswitch (" << statusID << ")\n"
 			    << indents << "\t{\n"
 			    << indents << "\tcase CommonLexer::EMatchStatus::Failure:\n"
@@ -1968,7 +2144,6 @@ namespace CommonLexer
 			    << indents << "\t\t" << resultID << " = { CommonLexer::EMatchStatus::Skip, " << largestSpanID << " };\n"
 			    << indents << "\t\tbreak;\n"
 			    << indents << "\tcase CommonLexer::EMatchStatus::Success:\n"
-			    << indents << "\t\t" << stateID << ".m_ParentNode->addChildren(" << largestCopyID << ");\n"
 			    << indents << "\t\t" << resultID << " = { CommonLexer::EMatchStatus::Success, " << largestSpanID << " };\n"
 			    << indents << "\t\tbreak;\n"
 			    << indents << "\tdefault:\n"
@@ -2016,84 +2191,14 @@ namespace CommonLexer
 			    << indents << "}";
 			return str.str();
 		}
-		else if (rule == "Branch")
+		else if (rule == "CutMatcher")
 		{
 			std::string indents = std::string(depth, '\t');
 
-			std::string statusID      = "status" + std::to_string(depth);
-			std::string messagesID    = "messages" + std::to_string(depth);
-			std::string largestCopyID = "largestCopy" + std::to_string(depth);
-			std::string largestSpanID = "largestSpan" + std::to_string(depth);
-			std::string tempNodeID    = "tempNode" + std::to_string(depth);
-			std::string tempStateID   = "tempState" + std::to_string(depth);
-
 			std::ostringstream str;
-			str << indents << "// Branch\n"
-			    << indents << "{\n"
-			    << indents << "\tCommonLexer::EMatchStatus " << statusID << " = CommonLexer::EMatchStatus::Failure;\n"
-			    << indents << "\tstd::vector<CommonLexer::Message> " << messagesID << ";\n"
-			    << indents << "\tCommonLexer::Node " << largestCopyID << " { *" << stateID << ".m_Lexer };\n"
-			    << indents << "\tCommonLexer::SourceSpan " << largestSpanID << " { " << spanID << ".m_Begin, " << spanID << ".m_Begin };\n";
-
-			for (auto& child : node.getChildren())
-			{
-				str << indents << "\t{\n"
-				    << indents << "\t\tCommonLexer::Node " << tempNodeID << " { *" << stateID << ".m_Lexer };\n"
-				    << indents << "\t\tCommonLexer::MatcherState " << tempStateID << " { {}, &" << tempNodeID << ", " << stateID << ".m_Lexer, " << stateID << ".m_Source, " << stateID << ".m_SourceSpan, " << stateID << ".m_CurrentRule, " << stateID << ".m_RuleBegin };\n"
-				    << handleMatcher(result, lex, child, settings, ruleId, resultID, tempStateID, spanID, depth + 2) << '\n'
-				    << indents << "\t\tswitch (" << resultID << ".m_Status)\n"
-				    << indents << "\t\t{\n"
-				    << indents << "\t\tcase CommonLexer::EMatchStatus::Skip:\n"
-				    << indents << "\t\t\tif (" << statusID << " == CommonLexer::EMatchStatus::Failure)\n"
-				    << indents << "\t\t\t\t" << statusID << " = CommonLexer::EMatchStatus::Skip;\n"
-				    << indents << "\t\t\t[[fallthrough]];\n"
-				    << indents << "\t\tcase CommonLexer::EMatchStatus::Failure:\n"
-				    << indents << "\t\t{\n"
-				    << indents << "\t\t\tstd::size_t len = " << resultID << ".m_Span.length();\n"
-				    << indents << "\t\t\tif (len == 0)\n"
-				    << indents << "\t\t\t\tlen = 1;\n"
-				    << indents << "\t\t\tif ((" << statusID << " == CommonLexer::EMatchStatus::Skip || " << statusID << " == CommonLexer::EMatchStatus::Failure) && len > " << largestSpanID << ".length())\n"
-				    << indents << "\t\t\t{\n"
-				    << indents << "\t\t\t\t" << largestSpanID << " = " << resultID << ".m_Span;\n"
-				    << indents << "\t\t\t\t" << largestCopyID << " = std::move(" << tempNodeID << ");\n"
-				    << indents << "\t\t\t\t" << messagesID << " = std::move(" << tempStateID << ".m_Messages);\n"
-				    << indents << "\t\t\t}\n"
-				    << indents << "\t\t\tbreak;\n"
-				    << indents << "\t\t}\n"
-				    << indents << "\t\tcase CommonLexer::EMatchStatus::Success:\n"
-				    << indents << "\t\t\tif (" << statusID << " == CommonLexer::EMatchStatus::Skip || " << statusID << " == CommonLexer::EMatchStatus::Failure || " << resultID << ".m_Span.length() > " << largestSpanID << ".length())\n"
-				    << indents << "\t\t\t{\n"
-				    << indents << "\t\t\t\t" << largestSpanID << " = " << resultID << ".m_Span;\n"
-				    << indents << "\t\t\t\t" << largestCopyID << " = std::move(" << tempNodeID << ");\n"
-				    << indents << "\t\t\t\t" << messagesID << " = std::move(" << tempStateID << ".m_Messages);\n"
-				    << indents << "\t\t\t\t" << statusID << " = CommonLexer::EMatchStatus::Success;\n"
-				    << indents << "\t\t\t}\n"
-				    << indents << "\t\t\tbreak;\n"
-				    << indents << "\t\tdefault: break;\n"
-				    << indents << "\t\t}\n"
-				    << indents << "\t}\n";
-			}
-
-			str << indents << "\t" << stateID << ".m_Messages.reserve(" << stateID << ".m_Messages.size() + " << messagesID << ".size());\n"
-			    << indents << "\tfor (auto& message : " << messagesID << ")\n"
-			    << indents << "\t\t" << stateID << ".m_Messages.push_back(std::move(message));\n"
-			    << indents << "\tswitch (" << statusID << ")\n"
-			    << indents << "\t{\n"
-			    << indents << "\tcase CommonLexer::EMatchStatus::Failure:\n"
-			    << indents << "\t\t" << resultID << " = { CommonLexer::EMatchStatus::Failure, " << largestSpanID << " };\n"
-			    << indents << "\t\tbreak;\n"
-			    << indents << "\tcase CommonLexer::EMatchStatus::Skip:\n"
-			    << indents << "\t\t" << resultID << " = { CommonLexer::EMatchStatus::Skip, " << largestSpanID << " };\n"
-			    << indents << "\t\tbreak;\n"
-			    << indents << "\tcase CommonLexer::EMatchStatus::Success:\n"
-			    << indents << "\t\t" << stateID << ".m_ParentNode->addChildren(" << largestCopyID << ");\n"
-			    << indents << "\t\t" << resultID << " = { CommonLexer::EMatchStatus::Success, " << largestSpanID << " };\n"
-			    << indents << "\t\tbreak;\n"
-			    << indents << "\tdefault:\n"
-			    << indents << "\t\t" << resultID << " = { CommonLexer::EMatchStatus::Failure, " << largestSpanID << " };\n"
-			    << indents << "\t\tbreak;\n"
-			    << indents << "\t}\n"
-			    << indents << "}";
+			str << indents << "// CutMatcher\n"
+			    << indents << stateID << ".m_Cut = true;\n"
+			    << indents << resultID << " = { CommonLexer::EMatchStatus::Success, { " << spanID << ".m_Begin, " << spanID << ".m_Begin } };";
 			return str.str();
 		}
 		else
@@ -2206,6 +2311,19 @@ namespace CommonLexer
 						continue;
 					}
 				}
+				else if (optionId == "Memoize")
+				{
+					// Value tries Identifier first, so true and false usually come out as Identifiers
+					auto valueSpan = valueNode->getSpan();
+					auto value     = source->getSpan(valueSpan);
+					if ((valueNode->getRule() != "Boolean" && valueNode->getRule() != "Identifier") || (value != "true" && value != "false"))
+					{
+						result.m_Messages.emplace_back("Memoize value is not a Boolean", valueSpan.m_Begin, valueSpan);
+						continue;
+					}
+
+					settings.m_Memoize = value == "true";
+				}
 
 				declaredOptions.push_back(optionId);
 			}
@@ -2251,22 +2369,23 @@ namespace CommonLexer
 
 				std::ostringstream str;
 				str << "// Rule " << ruleId << '\n'
-				    << "CommonLexer::MatchResult " << ruleId << "Match(CommonLexer::MatcherState& state, CommonLexer::SourceSpan span)\n"
+				    << "CommonLexer::MatchResult " << ruleId << (settings.m_Memoize ? "MatchUnmemoized" : "Match") << "(CommonLexer::MatcherState& state, CommonLexer::SourceSpan span)\n"
 				    << "{\n"
-				    << "\tCommonLexer::Node         currentNode { *state.m_Lexer, \"" << ruleId << "\" };\n"
-				    << "\tCommonLexer::MatcherState tempState { {}, &currentNode, state.m_Lexer, state.m_Source, state.m_SourceSpan, nullptr, span.m_Begin };\n"
+				    << "\tCommonLexer::Node         currentNode { GetLexer(), " << ruleId << "ID };\n"
+				    << "\tCommonLexer::MatcherState tempState { {}, &currentNode, state.m_Lexer, state.m_LexState, state.m_Source, state.m_SourceSpan, nullptr, span.m_Begin };\n"
 				    << "\tCommonLexer::MatchResult  result { CommonLexer::EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };\n\n"
 				    << handleMatcher(result, lex, *matcherNode, settings, ruleId, "result", "tempState", "span") << '\n'
 				    << "\tif (result.m_Status == CommonLexer::EMatchStatus::Success)\n"
 				    << "\t{\n"
-				    << "\t\tcurrentNode.setSourceSpan(state.m_Source, result.m_Span);\n"
+				    << "\t\tcurrentNode.setSpan(result.m_Span);\n"
 				    << "\t\tstate.m_ParentNode->addChild(std::move(currentNode));\n"
 				    << "\t}\n"
-				    << "\tstate.m_Messages.reserve(state.m_Messages.size() + tempState.m_Messages.size());\n"
-				    << "\tfor (auto& message : tempState.m_Messages)\n"
-				    << "\t\tstate.m_Messages.push_back(std::move(message));\n"
+				    << "\tstate.m_Messages.insert(state.m_Messages.end(), std::make_move_iterator(tempState.m_Messages.begin()), std::make_move_iterator(tempState.m_Messages.end()));\n"
 				    << "\treturn result;\n"
 				    << "}";
+				if (settings.m_Memoize)
+					str << "\n\n"
+					    << MemoizedRuleCPP(ruleId);
 				result.m_Rules.insert({ std::move(ruleId), str.str() });
 			}
 			else if (rule == "NodelessRuleDeclaration")
@@ -2296,16 +2415,17 @@ namespace CommonLexer
 
 				std::ostringstream str;
 				str << "// Rule " << ruleId << '\n'
-				    << "CommonLexer::MatchResult " << ruleId << "Match(CommonLexer::MatcherState& state, CommonLexer::SourceSpan span)\n"
+				    << "CommonLexer::MatchResult " << ruleId << (settings.m_Memoize ? "MatchUnmemoized" : "Match") << "(CommonLexer::MatcherState& state, CommonLexer::SourceSpan span)\n"
 				    << "{\n"
-				    << "\tCommonLexer::MatcherState tempState { {}, state.m_ParentNode, state.m_Lexer, state.m_Source, state.m_SourceSpan, nullptr, span.m_Begin };\n"
+				    << "\tCommonLexer::MatcherState tempState { {}, state.m_ParentNode, state.m_Lexer, state.m_LexState, state.m_Source, state.m_SourceSpan, nullptr, span.m_Begin };\n"
 				    << "\tCommonLexer::MatchResult  result { CommonLexer::EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };\n\n"
 				    << handleMatcher(result, lex, *matcherNode, settings, ruleId, "result", "tempState", "span") << '\n'
-				    << "\tstate.m_Messages.reserve(state.m_Messages.size() + tempState.m_Messages.size());\n"
-				    << "\tfor (auto& message : tempState.m_Messages)\n"
-				    << "\t\tstate.m_Messages.push_back(std::move(message));\n"
+				    << "\tstate.m_Messages.insert(state.m_Messages.end(), std::make_move_iterator(tempState.m_Messages.begin()), std::make_move_iterator(tempState.m_Messages.end()));\n"
 				    << "\treturn result;\n"
 				    << "}";
+				if (settings.m_Memoize)
+					str << "\n\n"
+					    << MemoizedRuleCPP(ruleId);
 				result.m_Rules.insert({ std::move(ruleId), str.str() });
 			}
 			else if (rule == "CallbackRuleDeclaration")
@@ -2348,12 +2468,13 @@ namespace CommonLexer
 		std::ostringstream str;
 		str << "#include <CommonLexer/Lexer.h>\n"
 		    << "#include <CommonLexer/Matcher.h>\n"
+		    << "#include <CommonLexer/Matchers.h>\n"
 		    << "#include <CommonLexer/Message.h>\n"
 		    << "#include <CommonLexer/Node.h>\n"
+		    << "#include <CommonLexer/Regex.h>\n"
 		    << "#include <CommonLexer/Rule.h>\n"
 		    << "#include <CommonLexer/Source.h>\n\n"
-		    << "#include <format>\n"
-		    << "#include <regex>\n\n"
+		    << "#include <format>\n\n"
 		    << "namespace " << namespaceName << "\n"
 		    << "{\n\n"
 		    << "//\n"
@@ -2361,7 +2482,22 @@ namespace CommonLexer
 		    << "//\n\n";
 		for (auto& rule : result.m_Rules)
 			str << "CommonLexer::MatchResult " << rule.first << "Match(CommonLexer::MatcherState& state, CommonLexer::SourceSpan span);\n";
+		str << "\n";
+		for (auto& rule : result.m_Rules)
+			str << "static CommonLexer::RuleID " << rule.first << "ID = 0;\n";
 		str << "\n"
+		    << "// Only holds the interned rule names, every lex only reads it so it is shared by all of them\n"
+		    << "static const CommonLexer::Lexer& GetLexer()\n"
+		    << "{\n"
+		    << "\tstatic const CommonLexer::Lexer lexer = []()\n"
+		    << "\t{\n"
+		    << "\t\tCommonLexer::Lexer names;\n";
+		for (auto& rule : result.m_Rules)
+			str << "\t\t" << rule.first << "ID = names.getRuleID(\"" << rule.first << "\");\n";
+		str << "\t\treturn names;\n"
+		    << "\t}();\n"
+		    << "\treturn lexer;\n"
+		    << "}\n\n"
 		    << "//\n"
 		    << "// Declarations\n"
 		    << "//\n\n";
@@ -2369,19 +2505,23 @@ namespace CommonLexer
 			str << rule.second << "\n\n";
 		str << "CommonLexer::Lex lexSource(CommonLexer::ISource* source, CommonLexer::SourceSpan span)\n"
 		    << "{\n"
-		    << "\tCommonLexer::Lexer lexer;\n\n"
-		    << "\tCommonLexer::Lex lex { lexer, source };\n"
+		    << "\tCommonLexer::Lex lex { GetLexer(), source };\n"
 		    << "\tif (source)\n"
 		    << "\t{\n"
 		    << "\t\tauto& root = lex.getRoot();\n"
-		    << "\t\troot.setRule(\"" << result.m_MainRule << "\");\n"
-		    << "\t\tCommonLexer::MatcherState state { {}, &root, &lexer, source, span, nullptr, span.m_Begin };\n"
+		    << "\t\troot.setRule(" << result.m_MainRule << "ID);\n"
+		    << "\t\tCommonLexer::LexState    lexState;\n"
+		    << "\t\tCommonLexer::MatcherState state { {}, &root, &GetLexer(), &lexState, source, span, nullptr, span.m_Begin };\n"
+		    << "\t\tauto begin  = std::chrono::steady_clock::now();\n"
 		    << "\t\tauto result = " << result.m_MainRule << "Match(state, span);\n"
+		    << "\t\tlex.setDuration(std::chrono::steady_clock::now() - begin);\n"
 		    << "\t\tif (result.m_Status == CommonLexer::EMatchStatus::Success)\n"
-		    << "\t\t\troot.setSourceSpan(source, result.m_Span);\n"
+		    << "\t\t\troot.setSpan(result.m_Span);\n"
 		    << "\t\telse\n"
-		    << "\t\t\troot.setSourceSpan(source, { span.m_Begin, span.m_Begin });\n"
+		    << "\t\t\troot.setSpan({ span.m_Begin, span.m_Begin });\n"
 		    << "\t\tlex.setMessages(std::move(state.m_Messages));\n"
+		    << "\t\tlex.setFarthestFailure(std::move(lexState.m_FarthestFailure));\n"
+		    << "\t\tlex.setMemoStats(lexState.m_MemoStats, lexState.getRuleMemoStats());\n"
 		    << "\t}\n"
 		    << "\treturn lex;\n"
 		    << "}\n\n"
@@ -0,0 +1,130 @@
+#include "CommonLexer/LineTable.h"
+#include "CommonLexer/SIMD.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if COMMON_LEXER_SSE2
+#include <immintrin.h>
+#endif
+
+namespace CommonLexer
+{
+	static void ScanNewlinesScalar(const char* begin, const char* cur, const char* end, std::size_t offset, std::vector<std::size_t>& lineToIndex)
+	{
+		while (cur != end)
+		{
+			auto newline = static_cast<const char*>(std::memchr(cur, '\n', static_cast<std::size_t>(end - cur)));
+			if (!newline)
+				break;
+			lineToIndex.emplace_back(offset + static_cast<std::size_t>(newline - begin) + 1);
+			cur = newline + 1;
+		}
+	}
+
+	static void PushNewlineMask(std::uint32_t mask, std::size_t offset, std::vector<std::size_t>& lineToIndex)
+	{
+		while (mask)
+		{
+			lineToIndex.emplace_back(offset + std::countr_zero(mask) + 1);
+			mask &= mask - 1;
+		}
+	}
+
+#if COMMON_LEXER_SSE2
+	static void ScanNewlinesSSE2(const char* begin, const char* end, std::size_t offset, std::vector<std::size_t>& lineToIndex)
+	{
+		const char* cur     = begin;
+		__m128i     newline = _mm_set1_epi8('\n');
+		for (; end - cur >= 16; cur += 16)
+		{
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur));
+			auto    mask  = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+			PushNewlineMask(mask, offset + static_cast<std::size_t>(cur - begin), lineToIndex);
+		}
+		ScanNewlinesScalar(begin, cur, end, offset, lineToIndex);
+	}
+
+	COMMON_LEXER_TARGET_AVX2 static void ScanNewlinesAVX2(const char* begin, const char* end, std::size_t offset, std::vector<std::size_t>& lineToIndex)
+	{
+		const char* cur     = begin;
+		__m256i     newline = _mm256_set1_epi8('\n');
+		for (; end - cur >= 32; cur += 32)
+		{
+			__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur));
+			auto    mask  = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)));
+			PushNewlineMask(mask, offset + static_cast<std::size_t>(cur - begin), lineToIndex);
+		}
+		ScanNewlinesScalar(begin, cur, end, offset, lineToIndex);
+	}
+#endif
+
+	void LineTable::build(std::string_view str)
+	{
+		m_LineToIndex.clear();
+		m_LineToIndex.emplace_back(0);
+		scanNewlines(str, 0);
+		m_Codepoints.build(str);
+	}
+
+	void LineTable::append(std::string_view str, std::size_t offset)
+	{
+		if (m_LineToIndex.empty())
+			m_LineToIndex.emplace_back(0);
+
+		scanNewlines(str, offset);
+		m_Codepoints.append(str);
+	}
+
+	void LineTable::clear()
+	{
+		m_LineToIndex.clear();
+		m_Codepoints.clear();
+	}
+
+	void LineTable::scanNewlines(std::string_view str, std::size_t offset)
+	{
+		const char* begin = str.data();
+		const char* end   = begin + str.size();
+#if COMMON_LEXER_SSE2
+		if (SIMD::HasAVX2())
+			ScanNewlinesAVX2(begin, end, offset, m_LineToIndex);
+		else
+			ScanNewlinesSSE2(begin, end, offset, m_LineToIndex);
+#else
+		ScanNewlinesScalar(begin, begin, end, offset, m_LineToIndex);
+#endif
+	}
+
+	std::size_t LineTable::getIndexFromLineNumber(std::size_t line) const
+	{
+		return line - 1 < m_LineToIndex.size() ? m_LineToIndex[line - 1] : ~0ULL;
+	}
+
+	std::size_t LineTable::getLineNumberFromIndex(std::size_t index) const
+	{
+		auto itr = std::upper_bound(m_LineToIndex.begin(), m_LineToIndex.end(), index);
+		return itr == m_LineToIndex.begin() ? ~0ULL : static_cast<std::size_t>(itr - m_LineToIndex.begin());
+	}
+
+	std::size_t LineTable::getColumnNumberFromIndex(std::size_t index) const
+	{
+		std::size_t line = getLineNumberFromIndex(index);
+		if (line == ~0ULL)
+			return 1;
+		return m_Codepoints.getCodepointCount(m_LineToIndex[line - 1], index) + 1;
+	}
+
+	std::string_view LineTable::getLine(std::string_view str, std::size_t line) const
+	{
+		std::size_t lineStart = getIndexFromLineNumber(line);
+		if (lineStart == ~0ULL || lineStart > str.size())
+			return {};
+
+		std::size_t lineEnd = getIndexFromLineNumber(line + 1);
+		lineEnd             = lineEnd == ~0ULL ? str.size() : lineEnd - 1;
+		return str.substr(lineStart, lineEnd - lineStart);
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -4,4 +4,18 @@ namespace CommonLexer
 {
 	MatchResult::MatchResult(EMatchStatus status, SourceSpan span)
 	    : m_Status(status), m_Span(span) {}
+
+	FirstSet FirstSet::Any()
+	{
+		FirstSet set;
+		set.m_Bytes.set();
+		set.m_Nullable = true;
+		return set;
+	}
+
+	void FirstSet::add(const FirstSet& other)
+	{
+		m_Bytes    |= other.m_Bytes;
+		m_Nullable |= other.m_Nullable;
+	}
 } // namespace CommonLexer
\ No newline at end of file
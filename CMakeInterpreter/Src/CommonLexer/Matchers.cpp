@@ -1,23 +1,45 @@
 #include "CommonLexer/Matchers.h"
+#include "CommonLexer/Hash.h"
 #include "CommonLexer/Lexer.h"
+#include "CommonLexer/SIMD.h"
 
+#include <algorithm>
+#include <bit>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <string_view>
 
 #include <fmt/format.h>
 
+#if COMMON_LEXER_SSE2
+#include <immintrin.h>
+#endif
+
 namespace CommonLexer
 {
+	static void ReportFailure(MatcherState& state, EMessageCode code, const MessageArgs& args, SourcePoint point, SourceSpan span)
+	{
+		state.m_LexState->noteFailure(state.m_Messages.emplace_back(code, args, point, span));
+	}
+
+	static std::uint64_t HashBits(const std::bitset<256>& bits, std::uint64_t seed)
+	{
+		for (std::size_t i = 0; i < bits.size(); i += 64)
+			seed = Hash::Combine(seed, ((bits >> i) & std::bitset<256> { ~0ULL }).to_ullong());
+		return seed;
+	}
+
 	CombinationMatcher::CombinationMatcher(std::vector<std::unique_ptr<IMatcher>>&& matchers)
 	    : m_Matchers(std::move(matchers)) {}
 
-	void CombinationMatcher::cleanUp()
+	void CombinationMatcher::link(LinkState& state)
 	{
 		for (auto& matcher : m_Matchers)
-			matcher->cleanUp();
+			matcher->link(state);
 	}
 
-	MatchResult CombinationMatcher::match(MatcherState& state, SourceSpan span)
+	MatchResult CombinationMatcher::match(MatcherState& state, SourceSpan span) const
 	{
 		SourceSpan subSpan   = span;
 		SourceSpan totalSpan = { span.m_Begin, span.m_Begin };
@@ -37,26 +59,81 @@ namespace CommonLexer
 		return { EMatchStatus::Success, totalSpan };
 	}
 
-	OrMatcher::OrMatcher(std::vector<std::unique_ptr<IMatcher>>&& matchers)
-	    : m_Matchers(std::move(matchers)) {}
+	FirstSet CombinationMatcher::computeFirstSet(Lexer& lexer)
+	{
+		// Every matcher is visited so nested or matchers build their tables, even past the point where the set is complete
+		FirstSet firstSet;
+		firstSet.m_Nullable = true;
+		for (auto& matcher : m_Matchers)
+		{
+			auto matcherSet = matcher->computeFirstSet(lexer);
+			if (!firstSet.m_Nullable)
+				continue;
 
-	void OrMatcher::cleanUp()
+			firstSet.m_Bytes    |= matcherSet.m_Bytes;
+			firstSet.m_Nullable = matcherSet.m_Nullable;
+		}
+		return firstSet;
+	}
+
+	bool CombinationMatcher::collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules)
 	{
+		// Later matchers are only reached without consuming input while everything before them can match nothing
 		for (auto& matcher : m_Matchers)
-			matcher->cleanUp();
+			if (!matcher->collectLeftRules(lexer, rules))
+				return false;
+		return true;
 	}
 
-	MatchResult OrMatcher::match(MatcherState& state, SourceSpan span)
+	std::uint64_t CombinationMatcher::hash(std::uint64_t seed) const
 	{
-		EMatchStatus         status = EMatchStatus::Failure;
-		std::vector<Message> messages;
-		Node                 largestCopy { *state.m_Lexer };
-		SourceSpan           largestSpan { span.m_Begin, span.m_Begin };
+		seed = Hash::Combine(Hash::Bytes("Combination", seed), m_Matchers.size());
 		for (auto& matcher : m_Matchers)
+			seed = matcher->hash(seed);
+		return seed;
+	}
+
+	OrMatcher::OrMatcher(std::vector<std::unique_ptr<IMatcher>>&& matchers, bool ordered)
+	    : m_Matchers(std::move(matchers)), m_Ordered(ordered) {}
+
+	void OrMatcher::link(LinkState& state)
+	{
+		for (auto& matcher : m_Matchers)
+			matcher->link(state);
+	}
+
+	MatchResult OrMatcher::match(MatcherState& state, SourceSpan span) const
+	{
+		std::size_t begin = 0;
+		std::size_t end   = m_Matchers.size();
+		if (m_HasDispatch)
 		{
-			Node         tempNode { *state.m_Lexer };
-			MatcherState tempState { {}, &tempNode, state.m_Lexer, state.m_Source, state.m_SourceSpan, state.m_CurrentRule, state.m_RuleBegin };
-			auto         result = matcher->match(tempState, span);
+			std::size_t c = span.m_Begin.m_Index < span.m_End.m_Index ? static_cast<std::uint8_t>(state.m_Source->at(span.m_Begin.m_Index)) : FirstSet::s_EOF;
+
+			begin = m_DispatchOffsets[c];
+			end   = m_DispatchOffsets[c + 1];
+			if (begin == end)
+			{
+				ReportFailure(state, EMessageCode::UnexpectedByte, { .m_Rule = state.m_CurrentRule->getName(), .m_Got = static_cast<std::uint16_t>(c) }, span.m_Begin, { span.m_Begin, span.m_Begin });
+				return { EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
+			}
+		}
+
+		// Every alternative appends to the parent and the messages directly, only the largest so far is kept past the marks
+		auto&       parent       = *state.m_ParentNode;
+		std::size_t nodeMark     = parent.getChildren().size();
+		std::size_t messageMark  = state.m_Messages.size();
+		std::size_t largestNodes = nodeMark, largestMessages = messageMark;
+
+		EMatchStatus status = EMatchStatus::Failure;
+		SourceSpan   largestSpan { span.m_Begin, span.m_Begin };
+		bool         cut = state.m_Cut;
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			state.m_Cut   = false;
+			auto& matcher = m_Matchers[m_HasDispatch ? m_Dispatch[i] : i];
+			auto  result  = matcher->match(state, span);
+			bool  largest = false;
 			switch (result.m_Status)
 			{
 			case EMatchStatus::Skip:
@@ -68,54 +145,106 @@ namespace CommonLexer
 				std::size_t len = result.m_Span.length();
 				if (len == 0)
 					len = 1;
-				if ((status == EMatchStatus::Skip || status == EMatchStatus::Failure) && len > largestSpan.length())
-				{
-					largestSpan = result.m_Span;
-					largestCopy = std::move(tempNode);
-					messages    = std::move(tempState.m_Messages);
-				}
-				continue;
+				largest = (status == EMatchStatus::Skip || status == EMatchStatus::Failure) && len > largestSpan.length();
+				break;
 			}
 			case EMatchStatus::Success:
-				if (status == EMatchStatus::Skip || status == EMatchStatus::Failure || result.m_Span.length() > largestSpan.length())
-				{
-					largestSpan = result.m_Span;
-					largestCopy = std::move(tempNode);
-					messages    = std::move(tempState.m_Messages);
-					status      = EMatchStatus::Success;
-				}
+				largest = status == EMatchStatus::Skip || status == EMatchStatus::Failure || result.m_Span.length() > largestSpan.length();
+				if (largest)
+					status = EMatchStatus::Success;
 				break;
 			}
+
+			if (largest)
+			{
+				largestSpan = result.m_Span;
+				parent.eraseChildren(nodeMark, largestNodes);
+				state.m_Messages.erase(state.m_Messages.begin() + messageMark, state.m_Messages.begin() + largestMessages);
+				largestNodes    = parent.getChildren().size();
+				largestMessages = state.m_Messages.size();
+			}
+			else
+			{
+				parent.truncateChildren(largestNodes);
+				state.m_Messages.erase(state.m_Messages.begin() + largestMessages, state.m_Messages.end());
+			}
+
+			if ((m_Ordered && status == EMatchStatus::Success) || (state.m_Cut && result.m_Status != EMatchStatus::Success))
+				break;
 		}
+		state.m_Cut = cut;
 
-		state.m_Messages.reserve(state.m_Messages.size() + messages.size());
-		for (auto& message : messages)
-			state.m_Messages.push_back(std::move(message));
 		switch (status)
 		{
-		case EMatchStatus::Failure: return { EMatchStatus::Failure, largestSpan };
-		case EMatchStatus::Skip: return { EMatchStatus::Skip, largestSpan };
-		case EMatchStatus::Success:
-			state.m_ParentNode->addChildren(largestCopy);
-			return { EMatchStatus::Success, largestSpan };
-		default: return { EMatchStatus::Failure, largestSpan };
+		case EMatchStatus::Failure:
+			parent.truncateChildren(nodeMark);
+			return { EMatchStatus::Failure, largestSpan };
+		case EMatchStatus::Skip:
+			parent.truncateChildren(nodeMark);
+			return { EMatchStatus::Skip, largestSpan };
+		case EMatchStatus::Success: return { EMatchStatus::Success, largestSpan };
+		default:
+			parent.truncateChildren(nodeMark);
+			return { EMatchStatus::Failure, largestSpan };
 		}
 	}
 
+	FirstSet OrMatcher::computeFirstSet(Lexer& lexer)
+	{
+		FirstSet              firstSet;
+		std::vector<FirstSet> matcherSets;
+		matcherSets.reserve(m_Matchers.size());
+		for (auto& matcher : m_Matchers)
+		{
+			matcherSets.push_back(matcher->computeFirstSet(lexer));
+			firstSet.add(matcherSets.back());
+		}
+
+		// Matchers keep their order within a byte's list, so ties are still resolved the same way
+		m_Dispatch.clear();
+		for (std::size_t c = 0; c <= FirstSet::s_EOF; ++c)
+		{
+			m_DispatchOffsets[c] = static_cast<std::uint32_t>(m_Dispatch.size());
+			for (std::size_t i = 0; i < matcherSets.size(); ++i)
+				if (matcherSets[i].canStartWith(c))
+					m_Dispatch.push_back(static_cast<std::uint16_t>(i));
+		}
+		m_DispatchOffsets[FirstSet::s_EOF + 1] = static_cast<std::uint32_t>(m_Dispatch.size());
+		m_HasDispatch                          = m_Matchers.size() <= 0xFFFF;
+		return firstSet;
+	}
+
+	bool OrMatcher::collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules)
+	{
+		bool nullable = false;
+		for (auto& matcher : m_Matchers)
+			nullable = matcher->collectLeftRules(lexer, rules) || nullable;
+		return nullable;
+	}
+
+	std::uint64_t OrMatcher::hash(std::uint64_t seed) const
+	{
+		seed = Hash::Combine(Hash::Bytes("Or", seed), m_Ordered);
+		seed = Hash::Combine(seed, m_Matchers.size());
+		for (auto& matcher : m_Matchers)
+			seed = matcher->hash(seed);
+		return seed;
+	}
+
 	RangeMatcher::RangeMatcher(std::unique_ptr<IMatcher>&& matcher, std::size_t lowerBounds, std::size_t upperBounds)
 	    : m_Matcher(std::move(matcher)), m_LowerBounds(lowerBounds), m_UpperBounds(upperBounds) {}
 
-	void RangeMatcher::cleanUp()
+	void RangeMatcher::link(LinkState& state)
 	{
-		m_Matcher->cleanUp();
+		m_Matcher->link(state);
 	}
 
-	MatchResult RangeMatcher::match(MatcherState& state, SourceSpan span)
+	MatchResult RangeMatcher::match(MatcherState& state, SourceSpan span) const
 	{
 		std::size_t  matches   = 0;
 		SourceSpan   subSpan   = span;
 		SourceSpan   totalSpan = { span.m_Begin, span.m_Begin };
-		MatcherState tempState = { {}, state.m_ParentNode, state.m_Lexer, state.m_Source, state.m_SourceSpan, state.m_CurrentRule, state.m_RuleBegin };
+		MatcherState tempState = { {}, state.m_ParentNode, state.m_Lexer, state.m_LexState, state.m_Source, state.m_SourceSpan, state.m_CurrentRule, state.m_RuleBegin };
 		while (matches < m_UpperBounds)
 		{
 			auto result = m_Matcher->match(tempState, subSpan);
@@ -131,28 +260,46 @@ namespace CommonLexer
 
 		if (totalSpan.m_End.m_Index < span.m_End.m_Index)
 		{
-			state.m_Messages.reserve(state.m_Messages.size() + tempState.m_Messages.size());
-			for (auto& message : tempState.m_Messages)
-				state.m_Messages.push_back(std::move(message));
+			state.m_Messages.insert(state.m_Messages.end(), std::make_move_iterator(tempState.m_Messages.begin()), std::make_move_iterator(tempState.m_Messages.end()));
 		}
 
 		if (matches < m_LowerBounds)
 		{
-			state.m_Messages.emplace_back(fmt::format("Expected at least {} matches but only got {} matches", m_LowerBounds, matches), subSpan.m_End, subSpan);
+			ReportFailure(state, EMessageCode::ExpectedMatches, { .m_Counts = { m_LowerBounds, matches } }, subSpan.m_End, subSpan);
 			return { EMatchStatus::Failure, totalSpan };
 		}
 		return { EMatchStatus::Success, totalSpan };
 	}
 
+	FirstSet RangeMatcher::computeFirstSet(Lexer& lexer)
+	{
+		auto firstSet = m_Matcher->computeFirstSet(lexer);
+		if (m_LowerBounds == 0)
+			firstSet.m_Nullable = true;
+		return firstSet;
+	}
+
+	bool RangeMatcher::collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules)
+	{
+		return m_Matcher->collectLeftRules(lexer, rules) || m_LowerBounds == 0;
+	}
+
+	std::uint64_t RangeMatcher::hash(std::uint64_t seed) const
+	{
+		seed = Hash::Combine(Hash::Bytes("Range", seed), m_LowerBounds);
+		seed = Hash::Combine(seed, m_UpperBounds);
+		return m_Matcher->hash(seed);
+	}
+
 	OptionalMatcher::OptionalMatcher(std::unique_ptr<IMatcher>&& matcher)
 	    : m_Matcher(std::move(matcher)) {}
 
-	void OptionalMatcher::cleanUp()
+	void OptionalMatcher::link(LinkState& state)
 	{
-		m_Matcher->cleanUp();
+		m_Matcher->link(state);
 	}
 
-	MatchResult OptionalMatcher::match(MatcherState& state, SourceSpan span)
+	MatchResult OptionalMatcher::match(MatcherState& state, SourceSpan span) const
 	{
 		auto result = m_Matcher->match(state, span);
 		switch (result.m_Status)
@@ -164,39 +311,77 @@ namespace CommonLexer
 		}
 	}
 
+	FirstSet OptionalMatcher::computeFirstSet(Lexer& lexer)
+	{
+		auto firstSet       = m_Matcher->computeFirstSet(lexer);
+		firstSet.m_Nullable = true;
+		return firstSet;
+	}
+
+	bool OptionalMatcher::collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules)
+	{
+		m_Matcher->collectLeftRules(lexer, rules);
+		return true;
+	}
+
+	std::uint64_t OptionalMatcher::hash(std::uint64_t seed) const
+	{
+		return m_Matcher->hash(Hash::Bytes("Optional", seed));
+	}
+
 	NegativeMatcher::NegativeMatcher(std::unique_ptr<IMatcher>&& matcher)
 	    : m_Matcher(std::move(matcher)) {}
 
-	void NegativeMatcher::cleanUp()
+	void NegativeMatcher::link(LinkState& state)
 	{
-		m_Matcher->cleanUp();
+		m_Matcher->link(state);
 	}
 
-	MatchResult NegativeMatcher::match(MatcherState& state, SourceSpan span)
+	MatchResult NegativeMatcher::match(MatcherState& state, SourceSpan span) const
 	{
-		Node         tempNode { *state.m_Lexer };
-		MatcherState tempState { {}, &tempNode, state.m_Lexer, state.m_Source, state.m_SourceSpan, state.m_CurrentRule, state.m_RuleBegin };
-		auto         result = m_Matcher->match(tempState, span);
+		// Whatever the lookahead produced is rolled back, whether it matched or not
+		std::size_t nodeMark    = state.m_ParentNode->getChildren().size();
+		std::size_t messageMark = state.m_Messages.size();
+		auto        result      = m_Matcher->match(state, span);
+		state.m_ParentNode->truncateChildren(nodeMark);
+		state.m_Messages.erase(state.m_Messages.begin() + messageMark, state.m_Messages.end());
 		switch (result.m_Status)
 		{
 		case EMatchStatus::Failure: [[fallthrough]];
 		case EMatchStatus::Skip: return { EMatchStatus::Success, { span.m_Begin, span.m_Begin } };
 		case EMatchStatus::Success:
-			state.m_Messages.emplace_back("Did not expect following sequence", span.m_Begin, result.m_Span);
+			ReportFailure(state, EMessageCode::UnexpectedSequence, {}, span.m_Begin, result.m_Span);
 			return { EMatchStatus::Failure, result.m_Span };
 		default: return { EMatchStatus::Failure, result.m_Span };
 		}
 	}
 
+	FirstSet NegativeMatcher::computeFirstSet(Lexer& lexer)
+	{
+		m_Matcher->computeFirstSet(lexer);
+		return FirstSet::Any();
+	}
+
+	bool NegativeMatcher::collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules)
+	{
+		m_Matcher->collectLeftRules(lexer, rules);
+		return true;
+	}
+
+	std::uint64_t NegativeMatcher::hash(std::uint64_t seed) const
+	{
+		return m_Matcher->hash(Hash::Bytes("Negative", seed));
+	}
+
 	SpaceMatcher::SpaceMatcher(std::unique_ptr<IMatcher>&& matcher, bool forced, ESpaceMethod method, ESpaceDirection direction)
 	    : m_Matcher(std::move(matcher)), m_Direction(direction), m_Method(method), m_Forced(forced) {}
 
-	void SpaceMatcher::cleanUp()
+	void SpaceMatcher::link(LinkState& state)
 	{
-		m_Matcher->cleanUp();
+		m_Matcher->link(state);
 	}
 
-	MatchResult SpaceMatcher::match(MatcherState& state, SourceSpan span)
+	MatchResult SpaceMatcher::match(MatcherState& state, SourceSpan span) const
 	{
 		MatchResult result { EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
 		SourceSpan  subSpan   = span;
@@ -243,7 +428,36 @@ namespace CommonLexer
 		return { EMatchStatus::Success, totalSpan };
 	}
 
-	bool SpaceMatcher::isSpace(char c)
+	FirstSet SpaceMatcher::computeFirstSet(Lexer& lexer)
+	{
+		auto     matcherSet = m_Matcher->computeFirstSet(lexer);
+		FirstSet spaces;
+		for (std::size_t c = 0; c < 256; ++c)
+			if (isSpace(static_cast<char>(c)))
+				spaces.m_Bytes.set(c);
+
+		// Forced spaces may be satisfied by the previous character, so spaces never make the match non nullable
+		FirstSet firstSet = matcherSet;
+		if (m_Direction == ESpaceDirection::Left || m_Direction == ESpaceDirection::Both || matcherSet.m_Nullable)
+			firstSet.m_Bytes |= spaces.m_Bytes;
+		return firstSet;
+	}
+
+	bool SpaceMatcher::collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules)
+	{
+		// A forced space before the match may be one that was already consumed, so the inner matcher is on the left edge either way
+		return m_Matcher->collectLeftRules(lexer, rules) && !m_Forced;
+	}
+
+	std::uint64_t SpaceMatcher::hash(std::uint64_t seed) const
+	{
+		seed = Hash::Combine(Hash::Bytes("Space", seed), m_Forced);
+		seed = Hash::Combine(seed, static_cast<std::uint64_t>(m_Method));
+		seed = Hash::Combine(seed, static_cast<std::uint64_t>(m_Direction));
+		return m_Matcher->hash(seed);
+	}
+
+	bool SpaceMatcher::isSpace(char c) const
 	{
 		switch (m_Method)
 		{
@@ -276,20 +490,16 @@ namespace CommonLexer
 		}
 	}
 
-	MatchResult SpaceMatcher::matchSpaces(MatcherState& state, SourceSpan span)
+	MatchResult SpaceMatcher::matchSpaces(MatcherState& state, SourceSpan span) const
 	{
 		std::size_t i = 0;
 
 		auto begin = state.m_SourceSpan.begin(state.m_Source);
 		auto itr   = span.begin(state.m_Source);
 		auto end   = span.end(state.m_Source);
-		if (m_Forced)
-		{
-			--itr;
-			if (itr >= begin && isSpace(*itr))
-				++i;
-			++itr;
-		}
+		// A forced space is also satisfied by the one just before span
+		if (m_Forced && itr > begin && isSpace(itr[-1]))
+			++i;
 		while (itr != end)
 		{
 			if (!isSpace(*itr))
@@ -300,15 +510,9 @@ namespace CommonLexer
 
 		if (m_Forced && i == 0)
 		{
-			switch (m_Method)
-			{
-			case ESpaceMethod::Normal:
-				state.m_Messages.emplace_back(fmt::format("Expected space or tab but got '{}'", itr != end ? std::string { *itr } : "EOF"), span.m_Begin, SourceSpan { span.m_Begin, span.m_Begin });
-				break;
-			case ESpaceMethod::Whitespace:
-				state.m_Messages.emplace_back(fmt::format("Expected space, tab, vertical tab, form feed, carriage return or line feed but got '{}'", itr != end ? std::string { *itr } : "EOF"), span.m_Begin, SourceSpan { span.m_Begin, span.m_Begin });
-				break;
-			}
+			auto          code = m_Method == ESpaceMethod::Normal ? EMessageCode::ExpectedSpace : EMessageCode::ExpectedWhitespace;
+			std::uint16_t got  = itr != end ? static_cast<std::uint8_t>(*itr) : MessageArgs::s_EOF;
+			ReportFailure(state, code, { .m_Got = got }, span.m_Begin, { span.m_Begin, span.m_Begin });
 			return { EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
 		}
 		return { EMatchStatus::Success, { span.m_Begin, itr } };
@@ -320,12 +524,13 @@ namespace CommonLexer
 	NamedGroupMatcher::NamedGroupMatcher(std::string&& name, std::unique_ptr<IMatcher>&& matcher)
 	    : m_Name(std::move(name)), m_Matcher(std::move(matcher)) {}
 
-	void NamedGroupMatcher::cleanUp()
+	void NamedGroupMatcher::link(LinkState& state)
 	{
-		m_Matcher->cleanUp();
+		state.m_UsesNamedGroups = true;
+		m_Matcher->link(state);
 	}
 
-	MatchResult NamedGroupMatcher::match(MatcherState& state, SourceSpan span)
+	MatchResult NamedGroupMatcher::match(MatcherState& state, SourceSpan span) const
 	{
 		auto result = m_Matcher->match(state, span);
 		switch (result.m_Status)
@@ -333,21 +538,42 @@ namespace CommonLexer
 		case EMatchStatus::Failure: return { EMatchStatus::Failure, result.m_Span };
 		case EMatchStatus::Skip: return { EMatchStatus::Skip, result.m_Span };
 		case EMatchStatus::Success:
-			state.m_Lexer->setGroupedValue(m_Name, result.m_Span);
+			state.m_LexState->setGroupedValue(m_Name, result.m_Span);
 			return { EMatchStatus::Success, result.m_Span };
 		default: return { EMatchStatus::Failure, result.m_Span };
 		}
 	}
 
+	FirstSet NamedGroupMatcher::computeFirstSet(Lexer& lexer)
+	{
+		return m_Matcher->computeFirstSet(lexer);
+	}
+
+	bool NamedGroupMatcher::collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules)
+	{
+		return m_Matcher->collectLeftRules(lexer, rules);
+	}
+
+	std::uint64_t NamedGroupMatcher::hash(std::uint64_t seed) const
+	{
+		return m_Matcher->hash(Hash::Bytes(m_Name, Hash::Bytes("NamedGroup", seed)));
+	}
+
 	NamedGroupReferenceMatcher::NamedGroupReferenceMatcher(const std::string& name)
 	    : m_Name(name) {}
 
 	NamedGroupReferenceMatcher::NamedGroupReferenceMatcher(std::string&& name)
 	    : m_Name(std::move(name)) {}
 
-	MatchResult NamedGroupReferenceMatcher::match(MatcherState& state, SourceSpan span)
+	void NamedGroupReferenceMatcher::link(LinkState& state)
 	{
-		auto groupedSpan = state.m_Lexer->getGroupedValue(m_Name);
+		state.m_UsesNamedGroups = true;
+	}
+
+	// The expected text lives in the source and may be recycled before the messages are read, so these are formatted right away
+	MatchResult NamedGroupReferenceMatcher::match(MatcherState& state, SourceSpan span) const
+	{
+		auto groupedSpan = state.m_LexState->getGroupedValue(m_Name);
 
 		auto itr        = span.begin(state.m_Source);
 		auto end        = span.end(state.m_Source);
@@ -358,13 +584,13 @@ namespace CommonLexer
 		{
 			if (itr == end)
 			{
-				state.m_Messages.emplace_back(fmt::format("Expected '{}' but got 'EOF', {}", state.m_Source->getSpan({ groupedItr, groupedEnd }), state.m_CurrentRule->getName()), itr, SourceSpan { span.m_Begin, itr });
+				state.m_LexState->noteFailure(state.m_Messages.emplace_back(fmt::format("Expected '{}' but got 'EOF', {}", state.m_Source->getSpan({ groupedItr, groupedEnd }), state.m_CurrentRule->getName()), itr, SourceSpan { span.m_Begin, itr }));
 				return { EMatchStatus::Failure, { span.m_Begin, itr } };
 			}
 
 			if (*itr != *groupedItr)
 			{
-				state.m_Messages.emplace_back(fmt::format("Expected '{}' but got '{}', {}", *groupedItr, *itr, state.m_CurrentRule->getName()), itr, SourceSpan { span.m_Begin, itr });
+				state.m_LexState->noteFailure(state.m_Messages.emplace_back(fmt::format("Expected '{}' but got '{}', {}", *groupedItr, *itr, state.m_CurrentRule->getName()), itr, SourceSpan { span.m_Begin, itr }));
 				return { EMatchStatus::Failure, { span.m_Begin, itr } };
 			}
 
@@ -374,30 +600,86 @@ namespace CommonLexer
 		return { EMatchStatus::Success, { span.m_Begin, itr } };
 	}
 
+	std::uint64_t NamedGroupReferenceMatcher::hash(std::uint64_t seed) const
+	{
+		return Hash::Bytes(m_Name, Hash::Bytes("NamedGroupReference", seed));
+	}
+
+	MatchResult CutMatcher::match(MatcherState& state, SourceSpan span) const
+	{
+		state.m_Cut = true;
+		return { EMatchStatus::Success, { span.m_Begin, span.m_Begin } };
+	}
+
+	FirstSet CutMatcher::computeFirstSet([[maybe_unused]] Lexer& lexer)
+	{
+		FirstSet firstSet;
+		firstSet.m_Nullable = true;
+		return firstSet;
+	}
+
+	std::uint64_t CutMatcher::hash(std::uint64_t seed) const
+	{
+		return Hash::Bytes("Cut", seed);
+	}
+
 	ReferenceMatcher::ReferenceMatcher(const std::string& name)
 	    : m_Name(name), m_Rule(nullptr) {}
 
 	ReferenceMatcher::ReferenceMatcher(std::string&& name)
 	    : m_Name(std::move(name)), m_Rule(nullptr) {}
 
-	void ReferenceMatcher::cleanUp()
+	void ReferenceMatcher::link(LinkState& state)
 	{
-		m_Rule = nullptr;
+		m_Rule = state.m_Lexer->getRule(m_Name);
+		if (!m_Rule)
+		{
+			m_Rule = state.m_Lexer->getMissingRule(m_Name);
+			// Only reported for the first of the rule's references to it
+			if (std::find(state.m_References.begin(), state.m_References.end(), m_Rule) == state.m_References.end())
+				state.m_Messages->emplace_back(fmt::format("Rule '{}' references undefined rule '{}'", state.m_CurrentRule->getName(), m_Name), SourcePoint {}, SourceSpan {});
+		}
+		state.m_References.push_back(m_Rule);
 	}
 
-	MatchResult ReferenceMatcher::match(MatcherState& state, SourceSpan span)
+	MatchResult ReferenceMatcher::match(MatcherState& state, SourceSpan span) const
 	{
-		if (!m_Rule)
+		bool topLevel = state.m_Lexer->getTopLevelReference() == this;
+		if (topLevel && state.m_LexState->isStopPoint(span.m_Begin.m_Index))
+			return { EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
+
+		std::size_t c = span.m_Begin.m_Index < span.m_End.m_Index ? static_cast<std::uint8_t>(state.m_Source->at(span.m_Begin.m_Index)) : FirstSet::s_EOF;
+		if (!m_Rule->getFirstSet().canStartWith(c))
 		{
-			m_Rule = state.m_Lexer->getRule(m_Name);
-			if (!m_Rule)
-			{
-				state.m_Messages.emplace_back(fmt::format("Expected non existent rule '{}'", m_Name), span.m_Begin, SourceSpan { span.m_Begin, span.m_Begin });
-				return { EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
-			}
+			ReportFailure(state, EMessageCode::ExpectedRule, { .m_Text = m_Name, .m_Rule = state.m_CurrentRule->getName(), .m_Got = static_cast<std::uint16_t>(c) }, span.m_Begin, { span.m_Begin, span.m_Begin });
+			return { EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
 		}
 
-		return m_Rule->match(state, span);
+		auto result = m_Rule->match(state, span);
+		// The main rule repeats top level elements without backtracking over them,
+		// so once one is matched a streaming source can recycle everything before it
+		if (result.m_Status == EMatchStatus::Success && topLevel)
+		{
+			state.m_Source->commit(result.m_Span.m_End);
+			state.m_LexState->noteRestartPoint(state.m_ParentNode, result.m_Span.m_End.m_Index);
+		}
+		return result;
+	}
+
+	FirstSet ReferenceMatcher::computeFirstSet([[maybe_unused]] Lexer& lexer)
+	{
+		return m_Rule->getFirstSet();
+	}
+
+	bool ReferenceMatcher::collectLeftRules([[maybe_unused]] Lexer& lexer, std::vector<IRule*>& rules)
+	{
+		rules.push_back(m_Rule);
+		return m_Rule->getFirstSet().m_Nullable;
+	}
+
+	std::uint64_t ReferenceMatcher::hash(std::uint64_t seed) const
+	{
+		return Hash::Bytes(m_Name, Hash::Bytes("Reference", seed));
 	}
 
 	TextMatcher::TextMatcher(const std::string& text)
@@ -406,7 +688,7 @@ namespace CommonLexer
 	TextMatcher::TextMatcher(std::string&& text)
 	    : m_Text(std::move(text)) {}
 
-	MatchResult TextMatcher::match(MatcherState& state, SourceSpan span)
+	MatchResult TextMatcher::match(MatcherState& state, SourceSpan span) const
 	{
 		auto itr     = span.begin(state.m_Source);
 		auto end     = span.end(state.m_Source);
@@ -417,13 +699,13 @@ namespace CommonLexer
 		{
 			if (itr == end)
 			{
-				state.m_Messages.emplace_back(fmt::format("Expected '{}' but got 'EOF', {}", std::string_view { textItr.operator->(), static_cast<std::size_t>(textEnd - textItr) }, state.m_CurrentRule->getName()), itr, SourceSpan { span.m_Begin, itr });
+				ReportFailure(state, EMessageCode::ExpectedText, { .m_Text = std::string_view { m_Text }.substr(static_cast<std::size_t>(textItr - m_Text.begin())), .m_Rule = state.m_CurrentRule->getName() }, itr, { span.m_Begin, itr });
 				return { EMatchStatus::Failure, { span.m_Begin, itr } };
 			}
 
 			if (*itr != *textItr)
 			{
-				state.m_Messages.emplace_back(fmt::format("Expected '{}' but got '{}', {}", *textItr, *itr, state.m_CurrentRule->getName()), itr, SourceSpan { state.m_RuleBegin, itr });
+				ReportFailure(state, EMessageCode::ExpectedText, { .m_Text = std::string_view { m_Text }.substr(static_cast<std::size_t>(textItr - m_Text.begin()), 1), .m_Rule = state.m_CurrentRule->getName(), .m_Got = static_cast<std::uint8_t>(*itr) }, itr, { state.m_RuleBegin, itr });
 				return { EMatchStatus::Failure, { span.m_Begin, itr } };
 			}
 
@@ -433,18 +715,354 @@ namespace CommonLexer
 		return { EMatchStatus::Success, { span.m_Begin, itr } };
 	}
 
+	FirstSet TextMatcher::computeFirstSet([[maybe_unused]] Lexer& lexer)
+	{
+		FirstSet firstSet;
+		if (m_Text.empty())
+			firstSet.m_Nullable = true;
+		else
+			firstSet.m_Bytes.set(static_cast<std::uint8_t>(m_Text[0]));
+		return firstSet;
+	}
+
+	std::uint64_t TextMatcher::hash(std::uint64_t seed) const
+	{
+		return Hash::Bytes(m_Text, Hash::Bytes("Text", seed));
+	}
+
+	LiteralSetMatcher::LiteralSetMatcher(std::vector<std::string>&& literals)
+	    : m_Literals(std::move(literals))
+	{
+		// Build the plain trie first, each state remembers the first literal that created it so failures pick the same literal an or matcher would
+		std::vector<std::array<std::uint32_t, 256>> trie(2);
+		m_Accepts.assign(2, 0);
+		m_FirstLiterals.assign(2, 0);
+		for (std::size_t i = 0; i < m_Literals.size(); ++i)
+		{
+			std::uint32_t current = 1;
+			for (char c : m_Literals[i])
+			{
+				auto& next = trie[current][static_cast<std::uint8_t>(c)];
+				if (!next)
+				{
+					next = static_cast<std::uint32_t>(trie.size());
+					trie.emplace_back();
+					m_Accepts.push_back(0);
+					m_FirstLiterals.push_back(static_cast<std::uint32_t>(i));
+				}
+				current = trie[current][static_cast<std::uint8_t>(c)];
+			}
+			if (!m_Accepts[current])
+				m_Accepts[current] = static_cast<std::uint32_t>(i + 1);
+		}
+
+		std::map<std::vector<std::uint32_t>, std::uint16_t> columns;
+		std::vector<std::uint32_t>                           column(trie.size());
+		columns.emplace(column, 0);
+		for (std::size_t c = 0; c < 256; ++c)
+		{
+			for (std::size_t state = 0; state < trie.size(); ++state)
+				column[state] = trie[state][c];
+			m_ByteClasses[c] = columns.emplace(column, static_cast<std::uint16_t>(columns.size())).first->second;
+		}
+
+		m_Branches.assign(trie.size(), 0);
+		for (std::size_t state = 0; state < trie.size(); ++state)
+			m_Branches[state] = static_cast<std::uint32_t>(std::count_if(trie[state].begin(), trie[state].end(), [](std::uint32_t next) { return next != 0; }));
+
+		m_NumClasses = columns.size();
+		m_Transitions.assign(trie.size() * m_NumClasses, 0);
+		for (std::size_t state = 0; state < trie.size(); ++state)
+			for (std::size_t c = 0; c < 256; ++c)
+				m_Transitions[state * m_NumClasses + m_ByteClasses[c]] = trie[state][c];
+	}
+
+	MatchResult LiteralSetMatcher::match(MatcherState& state, SourceSpan span) const
+	{
+		return matchLiterals(state, span, state.m_CurrentRule->getName());
+	}
+
+	MatchResult LiteralSetMatcher::matchLiterals(MatcherState& state, SourceSpan span, std::string_view rule) const
+	{
+		std::uint32_t current   = 1;
+		std::uint32_t failState = 0;
+		std::size_t   depth     = 0;
+		std::size_t   failDepth = 0;
+		std::size_t   accepted  = m_Accepts[1] ? 0 : ~0ULL;
+		std::uint16_t got       = MessageArgs::s_EOF;
+
+		// The deepest state where some literal stops following the input is where the farthest text matcher would have failed,
+		// literals not starting with the first byte are never tried by a dispatching or matcher so the root doesn't count
+		auto step = [&](char c) -> bool {
+			std::uint32_t next = m_Transitions[current * m_NumClasses + m_ByteClasses[static_cast<std::uint8_t>(c)]];
+			if (depth > 0 && m_Branches[current] > (next ? 1U : 0U))
+			{
+				failState = current;
+				failDepth = depth;
+			}
+			if (!next)
+			{
+				got = static_cast<std::uint8_t>(c);
+				return false;
+			}
+
+			current = next;
+			++depth;
+			if (m_Accepts[current])
+				accepted = depth;
+			return true;
+		};
+
+		auto end = span.end(state.m_Source);
+		for (auto itr = span.begin(state.m_Source); itr != end; ++itr)
+			if (!step(*itr))
+				break;
+		if (depth > 0 && got == MessageArgs::s_EOF && m_Branches[current])
+		{
+			failState = current;
+			failDepth = depth;
+		}
+
+		if (accepted == ~0ULL && depth == 0)
+		{
+			ReportFailure(state, EMessageCode::UnexpectedByte, { .m_Rule = rule, .m_Got = got }, span.m_Begin, { span.m_Begin, span.m_Begin });
+			return { EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
+		}
+		if (accepted != ~0ULL && !failState)
+			return { EMatchStatus::Success, { span.m_Begin, span.m_Begin.m_Index + accepted } };
+
+		// Pick the first literal in declaration order that leaves the input at the failing state, the same one an or matcher would keep
+		std::uint16_t failGot   = failDepth == depth ? got : static_cast<std::uint8_t>(state.m_Source->at(span.m_Begin.m_Index + failDepth));
+		std::uint32_t followed  = failGot == MessageArgs::s_EOF ? 0 : m_Transitions[failState * m_NumClasses + m_ByteClasses[failGot]];
+		std::uint32_t failIndex = ~0U;
+		for (std::size_t byteClass = 1; byteClass < m_NumClasses; ++byteClass)
+		{
+			std::uint32_t next = m_Transitions[failState * m_NumClasses + byteClass];
+			if (next && next != followed)
+				failIndex = std::min(failIndex, m_FirstLiterals[next]);
+		}
+
+		std::string_view literal = m_Literals[failIndex];
+		SourcePoint      point { span.m_Begin.m_Index + failDepth };
+		MessageArgs      args { .m_Text = literal.substr(failDepth, failGot == MessageArgs::s_EOF ? std::string_view::npos : 1), .m_Rule = rule, .m_Got = failGot };
+		SourceSpan       messageSpan { failGot == MessageArgs::s_EOF ? span.m_Begin : state.m_RuleBegin, point };
+		if (accepted != ~0ULL)
+		{
+			// Nothing is reported for a successful match, but the abandoned literals still count towards the farthest failure
+			state.m_LexState->noteFailure(Message { EMessageCode::ExpectedText, args, point, messageSpan });
+			return { EMatchStatus::Success, { span.m_Begin, span.m_Begin.m_Index + accepted } };
+		}
+
+		ReportFailure(state, EMessageCode::ExpectedText, args, point, messageSpan);
+		return { EMatchStatus::Failure, { span.m_Begin, point } };
+	}
+
+	FirstSet LiteralSetMatcher::computeFirstSet([[maybe_unused]] Lexer& lexer)
+	{
+		FirstSet firstSet;
+		for (auto& literal : m_Literals)
+		{
+			if (literal.empty())
+				firstSet.m_Nullable = true;
+			else
+				firstSet.m_Bytes.set(static_cast<std::uint8_t>(literal[0]));
+		}
+		return firstSet;
+	}
+
+	std::uint64_t LiteralSetMatcher::hash(std::uint64_t seed) const
+	{
+		seed = Hash::Combine(Hash::Bytes("LiteralSet", seed), m_Literals.size());
+		for (auto& literal : m_Literals)
+			seed = Hash::Bytes(literal, seed);
+		return seed;
+	}
+
+	CharClassMatcher::CharClassMatcher(const std::bitset<256>& bytes)
+	    : m_Bytes(bytes) {}
+
+	MatchResult CharClassMatcher::match(MatcherState& state, SourceSpan span) const
+	{
+		return matchByte(state, span, state.m_CurrentRule->getName());
+	}
+
+	MatchResult CharClassMatcher::matchByte(MatcherState& state, SourceSpan span, std::string_view rule) const
+	{
+		if (span.m_Begin.m_Index < span.m_End.m_Index && m_Bytes[static_cast<std::uint8_t>(state.m_Source->at(span.m_Begin.m_Index))])
+			return { EMatchStatus::Success, { span.m_Begin, { span.m_Begin.m_Index + 1 } } };
+		ReportFailure(state, EMessageCode::RegexFailed, { .m_Rule = rule }, span.m_Begin, { span.m_Begin, span.m_Begin });
+		return { EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
+	}
+
+	FirstSet CharClassMatcher::computeFirstSet([[maybe_unused]] Lexer& lexer)
+	{
+		FirstSet firstSet;
+		firstSet.m_Bytes = m_Bytes;
+		return firstSet;
+	}
+
+	std::uint64_t CharClassMatcher::hash(std::uint64_t seed) const
+	{
+		return HashBits(m_Bytes, Hash::Bytes("CharClass", seed));
+	}
+
+	static std::size_t ScanRunScalar(const std::bitset<256>& bytes, const char* begin, const char* cur, const char* end)
+	{
+		while (cur != end && bytes[static_cast<std::uint8_t>(*cur)])
+			++cur;
+		return static_cast<std::size_t>(cur - begin);
+	}
+
+#if COMMON_LEXER_SSE2
+	static std::size_t ScanRunSSE2(const std::bitset<256>& bytes, const std::vector<std::pair<std::uint8_t, std::uint8_t>>& ranges, const char* begin, const char* end)
+	{
+		// A byte is in [first, last] when byte - first doesn't wrap past last - first
+		const char* cur = begin;
+		for (; end - cur >= 16; cur += 16)
+		{
+			__m128i chunk   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur));
+			__m128i inRange = _mm_setzero_si128();
+			for (auto [first, last] : ranges)
+			{
+				__m128i offset = _mm_sub_epi8(chunk, _mm_set1_epi8(static_cast<char>(first)));
+				inRange        = _mm_or_si128(inRange, _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(static_cast<char>(last - first))), offset));
+			}
+
+			auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(inRange)) ^ 0xFFFFU;
+			if (mask)
+				return static_cast<std::size_t>(cur - begin) + std::countr_zero(mask);
+		}
+		return ScanRunScalar(bytes, begin, cur, end);
+	}
+
+	COMMON_LEXER_TARGET_AVX2 static std::size_t ScanRunAVX2(const std::bitset<256>& bytes, const std::array<std::uint8_t, 16>& lowTable, const std::array<std::uint8_t, 16>& highTable, const char* begin, const char* end)
+	{
+		// Looks up each byte's row of the bitmap by its low nibble and tests the bit for its high nibble
+		__m256i low    = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lowTable.data())));
+		__m256i high   = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(highTable.data())));
+		__m256i bits   = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+		__m256i nibble = _mm256_set1_epi8(0x0F);
+
+		const char* cur = begin;
+		for (; end - cur >= 32; cur += 32)
+		{
+			__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur));
+			__m256i lows  = _mm256_and_si256(chunk, nibble);
+			__m256i highs = _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble);
+			__m256i row   = _mm256_blendv_epi8(_mm256_shuffle_epi8(low, lows), _mm256_shuffle_epi8(high, lows), chunk);
+			__m256i bit   = _mm256_shuffle_epi8(bits, highs);
+
+			auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), _mm256_setzero_si256())));
+			if (mask)
+				return static_cast<std::size_t>(cur - begin) + std::countr_zero(mask);
+		}
+		return ScanRunScalar(bytes, begin, cur, end);
+	}
+#endif
+
+	CharRunMatcher::CharRunMatcher(const Regex::CharRun& run)
+	    : m_Run(run)
+	{
+		for (std::size_t c = 0; c < 256; ++c)
+		{
+			if (!m_Run.m_Rest[c])
+				continue;
+
+			(c < 0x80 ? m_LowTable : m_HighTable)[c & 0x0F] |= static_cast<std::uint8_t>(1U << ((c >> 4) & 7));
+			if (!m_Ranges.empty() && m_Ranges.back().second == c - 1)
+				m_Ranges.back().second = static_cast<std::uint8_t>(c);
+			else
+				m_Ranges.emplace_back(static_cast<std::uint8_t>(c), static_cast<std::uint8_t>(c));
+		}
+		if (m_Ranges.size() > 4)
+			m_Ranges.clear();
+	}
+
+	MatchResult CharRunMatcher::match(MatcherState& state, SourceSpan span) const
+	{
+		return matchRun(state, span, state.m_CurrentRule->getName());
+	}
+
+	MatchResult CharRunMatcher::matchRun(MatcherState& state, SourceSpan span, std::string_view rule) const
+	{
+		std::size_t index = span.m_Begin.m_Index;
+		std::size_t end   = span.m_End.m_Index;
+		if (!m_Run.m_Optional)
+		{
+			if (index == end || !m_Run.m_First[static_cast<std::uint8_t>(state.m_Source->at(index))])
+			{
+				ReportFailure(state, EMessageCode::RegexFailed, { .m_Rule = rule }, span.m_Begin, { span.m_Begin, span.m_Begin });
+				return { EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
+			}
+			++index;
+		}
+
+		// The rest is scanned a borrowed block at a time, a contiguous source is a single block
+		while (index < end)
+		{
+			auto        block     = state.m_Source->getBlockAt(index);
+			std::size_t offset    = index - block.m_Begin;
+			std::size_t available = std::min(block.m_Size - offset, end - index);
+			std::size_t length    = available ? scanRest({ block.m_Data + offset, available }) : 0;
+			index += length;
+			if (length < available || !available)
+				break;
+		}
+		return { EMatchStatus::Success, { span.m_Begin, { index } } };
+	}
+
+	std::size_t CharRunMatcher::scanRest(std::string_view str) const
+	{
+		const char* begin = str.data();
+		const char* end   = begin + str.size();
+#if COMMON_LEXER_SSE2
+		if (SIMD::HasAVX2())
+			return ScanRunAVX2(m_Run.m_Rest, m_LowTable, m_HighTable, begin, end);
+		if (!m_Ranges.empty())
+			return ScanRunSSE2(m_Run.m_Rest, m_Ranges, begin, end);
+#endif
+		return ScanRunScalar(m_Run.m_Rest, begin, begin, end);
+	}
+
+	FirstSet CharRunMatcher::computeFirstSet([[maybe_unused]] Lexer& lexer)
+	{
+		FirstSet firstSet;
+		firstSet.m_Bytes    = m_Run.m_First;
+		firstSet.m_Nullable = m_Run.m_Optional;
+		return firstSet;
+	}
+
+	std::uint64_t CharRunMatcher::hash(std::uint64_t seed) const
+	{
+		seed = HashBits(m_Run.m_First, Hash::Bytes("CharRun", seed));
+		seed = HashBits(m_Run.m_Rest, seed);
+		return Hash::Combine(seed, m_Run.m_Optional);
+	}
+
 	RegexMatcher::RegexMatcher(const std::string& regex)
-	    : m_Regex(regex, std::regex_constants::ECMAScript | std::regex_constants::optimize) {}
+	    : m_Regex(Regex::Get(regex)) {}
 
 	RegexMatcher::RegexMatcher(std::string&& regex)
-	    : m_Regex(std::move(regex), std::regex_constants::ECMAScript | std::regex_constants::optimize) {}
+	    : m_Regex(Regex::Get(regex)) {}
 
-	MatchResult RegexMatcher::match(MatcherState& state, SourceSpan span)
+	MatchResult RegexMatcher::match(MatcherState& state, SourceSpan span) const
 	{
-		std::match_results<SourceIterator> results;
-		if (std::regex_search(span.begin(state.m_Source), span.end(state.m_Source), results, m_Regex, std::regex_constants::match_continuous))
-			return { EMatchStatus::Success, { results[0].first, results[0].second } };
-		state.m_Messages.emplace_back(fmt::format("Expected regex to succeed, but failed. Sadly I don't get regex error messages, maybe in the future ;), {}", state.m_CurrentRule->getName()), span.m_Begin, SourceSpan { span.m_Begin, span.m_Begin });
+		std::size_t length = m_Regex->match(state.m_Source, span);
+		if (length != Regex::s_NoMatch)
+			return { EMatchStatus::Success, { span.m_Begin, { span.m_Begin.m_Index + length } } };
+		ReportFailure(state, EMessageCode::RegexFailed, { .m_Rule = state.m_CurrentRule->getName() }, span.m_Begin, { span.m_Begin, span.m_Begin });
 		return { EMatchStatus::Failure, { span.m_Begin, span.m_Begin } };
 	}
+
+	FirstSet RegexMatcher::computeFirstSet([[maybe_unused]] Lexer& lexer)
+	{
+		FirstSet firstSet;
+		firstSet.m_Nullable = m_Regex->getFirstBytes(firstSet.m_Bytes);
+		return firstSet;
+	}
+
+	std::uint64_t RegexMatcher::hash(std::uint64_t seed) const
+	{
+		return Hash::Bytes(m_Regex->getPattern(), Hash::Bytes("Regex", seed));
+	}
 } // namespace CommonLexer
\ No newline at end of file
@@ -1,10 +1,45 @@
 #include "CommonLexer/Message.h"
 
+#include <fmt/format.h>
+
 namespace CommonLexer
 {
+	static std::string GotText(std::uint16_t got)
+	{
+		return got == MessageArgs::s_EOF ? "EOF" : std::string(1, static_cast<char>(got));
+	}
+
 	Message::Message(const std::string& message, SourcePoint point, SourceSpan span, EMessageSeverity severity)
-	    : m_Message(message), m_Point(point), m_Span(span), m_Severity(severity) {}
+	    : m_Message(message), m_Point(point), m_Span(span), m_Severity(severity), m_Code(EMessageCode::Text) {}
 
 	Message::Message(std::string&& message, SourcePoint point, SourceSpan span, EMessageSeverity severity)
-	    : m_Message(std::move(message)), m_Point(point), m_Span(span), m_Severity(severity) {}
+	    : m_Message(std::move(message)), m_Point(point), m_Span(span), m_Severity(severity), m_Code(EMessageCode::Text) {}
+
+	Message::Message(EMessageCode code, const MessageArgs& args, SourcePoint point, SourceSpan span, EMessageSeverity severity)
+	    : m_Args(args), m_Point(point), m_Span(span), m_Severity(severity), m_Code(code) {}
+
+	void Message::offsetPosition(std::ptrdiff_t offset)
+	{
+		m_Point.m_Index += static_cast<std::size_t>(offset);
+		m_Span.m_Begin.m_Index += static_cast<std::size_t>(offset);
+		m_Span.m_End.m_Index += static_cast<std::size_t>(offset);
+	}
+
+	std::string Message::getMessage() const
+	{
+		switch (m_Code)
+		{
+		case EMessageCode::Text: return m_Message;
+		case EMessageCode::ExpectedText: return fmt::format("Expected '{}' but got '{}', {}", m_Args.m_Text, GotText(m_Args.m_Got), m_Args.m_Rule);
+		case EMessageCode::ExpectedRule: return fmt::format("Expected {} but got '{}', {}", m_Args.m_Text, GotText(m_Args.m_Got), m_Args.m_Rule);
+		case EMessageCode::MissingRule: return fmt::format("Expected non existent rule '{}'", m_Args.m_Text);
+		case EMessageCode::UnexpectedByte: return fmt::format("Unexpected '{}', {}", GotText(m_Args.m_Got), m_Args.m_Rule);
+		case EMessageCode::ExpectedSpace: return fmt::format("Expected space or tab but got '{}'", GotText(m_Args.m_Got));
+		case EMessageCode::ExpectedWhitespace: return fmt::format("Expected space, tab, vertical tab, form feed, carriage return or line feed but got '{}'", GotText(m_Args.m_Got));
+		case EMessageCode::ExpectedMatches: return fmt::format("Expected at least {} matches but only got {} matches", m_Args.m_Counts[0], m_Args.m_Counts[1]);
+		case EMessageCode::RegexFailed: return fmt::format("Expected regex to succeed, but failed. Sadly I don't get regex error messages, maybe in the future ;), {}", m_Args.m_Rule);
+		case EMessageCode::UnexpectedSequence: return "Did not expect following sequence";
+		default: return m_Message;
+		}
+	}
 } // namespace CommonLexer
\ No newline at end of file
@@ -1,35 +1,32 @@
 #include "CommonLexer/Node.h"
+#include "CommonLexer/Lexer.h"
+
+#include <iterator>
 
 namespace CommonLexer
 {
-	Node::Node(Lexer& lexer)
-	    : m_Lexer(&lexer), m_Source(nullptr) {}
+	Node::Node(const Lexer& lexer)
+	    : m_Lexer(&lexer) {}
 
-	Node::Node(Lexer& lexer, const std::string& rule)
-	    : m_Lexer(&lexer), m_Rule(rule), m_Source(nullptr) {}
+	Node::Node(const Lexer& lexer, RuleID rule)
+	    : m_Lexer(&lexer), m_Rule(rule) {}
 
-	Node::Node(Lexer& lexer, std::string&& rule)
-	    : m_Lexer(&lexer), m_Rule(std::move(rule)), m_Source(nullptr) {}
+	Node::Node(Lexer& lexer, std::string_view rule)
+	    : m_Lexer(&lexer), m_Rule(lexer.getRuleID(rule)) {}
 
-	void Node::setLexer(Lexer& lexer)
+	void Node::setLexer(const Lexer& lexer)
 	{
 		m_Lexer = &lexer;
 	}
 
-	void Node::setRule(const std::string& rule)
+	void Node::setRule(RuleID rule)
 	{
 		m_Rule = rule;
 	}
 
-	void Node::setRule(std::string&& rule)
-	{
-		m_Rule = std::move(rule);
-	}
-
-	void Node::setSourceSpan(ISource* source, SourceSpan span)
+	void Node::setSpan(SourceSpan span)
 	{
-		m_Source = source;
-		m_Span   = span;
+		m_Span = span;
 	}
 
 	void Node::addChild(const Node& child)
@@ -42,19 +39,45 @@ namespace CommonLexer
 		m_Children.push_back(std::move(child));
 	}
 
-	void Node::addChildren(const Node& node)
+	void Node::addChildren(Node&& node)
+	{
+		m_Children.insert(m_Children.end(), std::make_move_iterator(node.m_Children.begin()), std::make_move_iterator(node.m_Children.end()));
+		node.m_Children.clear();
+	}
+
+	void Node::addChildren(Node&& node, std::size_t begin, std::size_t end)
 	{
-		m_Children.reserve(m_Children.size() + node.m_Children.size());
-		for (auto& child : node.m_Children)
-			m_Children.push_back(child);
+		m_Children.insert(m_Children.end(), std::make_move_iterator(node.m_Children.begin() + begin), std::make_move_iterator(node.m_Children.begin() + end));
 	}
 
-	void Node::addChildren(Node&& node)
+	void Node::reserveChildren(std::size_t count)
 	{
-		m_Children.reserve(m_Children.size() + node.m_Children.size());
-		for (auto& child : node.m_Children)
-			m_Children.push_back(std::move(child));
-		node.m_Children.clear();
+		m_Children.reserve(count);
+	}
+
+	void Node::offsetSpans(std::ptrdiff_t offset)
+	{
+		m_Span.m_Begin.m_Index += static_cast<std::size_t>(offset);
+		m_Span.m_End.m_Index += static_cast<std::size_t>(offset);
+		for (auto& child : m_Children)
+			child.offsetSpans(offset);
+	}
+
+	void Node::truncateChildren(std::size_t count)
+	{
+		if (count < m_Children.size())
+			m_Children.erase(m_Children.begin() + count, m_Children.end());
+	}
+
+	void Node::eraseChildren(std::size_t begin, std::size_t end)
+	{
+		if (begin < end)
+			m_Children.erase(m_Children.begin() + begin, m_Children.begin() + end);
+	}
+
+	const std::string& Node::getRule() const
+	{
+		return m_Lexer->getRuleName(m_Rule);
 	}
 
 	Node* Node::getChild(std::size_t index)
@@ -0,0 +1,74 @@
+#include "CommonLexer/NodeArena.h"
+#include "CommonLexer/Lexer.h"
+
+namespace CommonLexer
+{
+	static std::size_t CountNodes(const Node& node)
+	{
+		std::size_t nodes = 1;
+		for (auto& child : node.getChildren())
+			nodes += CountNodes(child);
+		return nodes;
+	}
+
+	NodeArena::NodeArena(const Node& root)
+	    : m_Lexer(root.getLexer())
+	{
+		// Counted up front so the arrays don't grow past the tree
+		std::size_t nodes = CountNodes(root);
+		m_Rules.reserve(nodes);
+		m_Begins.reserve(nodes);
+		m_Ends.reserve(nodes);
+		m_FirstChildren.reserve(nodes);
+		m_NextSiblings.reserve(nodes);
+		addTree(root);
+	}
+
+	std::size_t NodeArena::getMemoryUsage() const
+	{
+		return m_Rules.capacity() * sizeof(RuleID) + (m_Begins.capacity() + m_Ends.capacity()) * sizeof(std::size_t) + (m_FirstChildren.capacity() + m_NextSiblings.capacity()) * sizeof(NodeIndex);
+	}
+
+	NodeIndex NodeArena::addTree(const Node& node)
+	{
+		auto index = static_cast<NodeIndex>(m_Rules.size());
+		m_Rules.push_back(node.getRuleID());
+		m_Begins.push_back(node.getSpan().m_Begin.m_Index);
+		m_Ends.push_back(node.getSpan().m_End.m_Index);
+		m_FirstChildren.push_back(s_NoNode);
+		m_NextSiblings.push_back(s_NoNode);
+
+		NodeIndex previous = s_NoNode;
+		for (auto& child : node.getChildren())
+		{
+			NodeIndex childIndex = addTree(child);
+			if (previous == s_NoNode)
+				m_FirstChildren[index] = childIndex;
+			else
+				m_NextSiblings[previous] = childIndex;
+			previous = childIndex;
+		}
+		return index;
+	}
+
+	const std::string& NodeRef::getRule() const
+	{
+		return m_Arena->getLexer()->getRuleName(getRuleID());
+	}
+
+	std::size_t NodeRef::getChildCount() const
+	{
+		std::size_t count = 0;
+		for (auto child = getFirstChild(); child; child = child.getNextSibling())
+			++count;
+		return count;
+	}
+
+	NodeRef NodeRef::getChild(std::size_t index) const
+	{
+		auto child = getFirstChild();
+		for (; child && index > 0; --index)
+			child = child.getNextSibling();
+		return child;
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,1136 @@
+#include "CommonLexer/Regex.h"
+
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include <fmt/format.h>
+
+namespace CommonLexer
+{
+	using RegexByteSet = std::bitset<256>;
+
+	static constexpr std::size_t s_MaxInstructions = 8192;
+	static constexpr std::size_t s_MaxStates       = 4096;
+	static constexpr std::size_t s_Unbounded       = ~0ULL;
+
+	enum class ERegexNodeType
+	{
+		Empty,
+		Set,
+		Concat,
+		Alternation,
+		Repeat,
+		Lookahead
+	};
+
+	struct RegexNode
+	{
+	public:
+		ERegexNodeType         m_Type = ERegexNodeType::Empty;
+		RegexByteSet           m_Set;
+		std::vector<RegexNode> m_Children;
+		std::size_t            m_Min      = 0;
+		std::size_t            m_Max      = 0;
+		bool                   m_Greedy   = true;
+		bool                   m_Negative = false;
+	};
+
+	static RegexNode MakeSet(const RegexByteSet& set)
+	{
+		RegexNode node;
+		node.m_Type = ERegexNodeType::Set;
+		node.m_Set  = set;
+		return node;
+	}
+
+	static RegexNode MakeChar(char c)
+	{
+		RegexByteSet set;
+		set.set(static_cast<std::uint8_t>(c));
+		return MakeSet(set);
+	}
+
+	// Character classes of std::regex in the classic locale
+	static RegexByteSet MakeClassSet(char c)
+	{
+		RegexByteSet set;
+		switch (c)
+		{
+		case 'd':
+		case 'D':
+			for (char d = '0'; d <= '9'; ++d)
+				set.set(static_cast<std::uint8_t>(d));
+			break;
+		case 's':
+		case 'S':
+			for (char s : { ' ', '\t', '\n', '\v', '\f', '\r' })
+				set.set(static_cast<std::uint8_t>(s));
+			break;
+		case 'w':
+		case 'W':
+			for (std::size_t i = 0; i < 256; ++i)
+				if ((i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z') || (i >= '0' && i <= '9') || i == '_')
+					set.set(i);
+			break;
+		}
+		return c >= 'A' && c <= 'Z' ? ~set : set;
+	}
+
+	static int HexValue(char c)
+	{
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
+		return -1;
+	}
+
+	struct RegexParser
+	{
+	public:
+		RegexParser(std::string_view pattern)
+		    : m_Pattern(pattern) {}
+
+		RegexNode parse()
+		{
+			RegexNode node = parseDisjunction();
+			if (!failed() && m_Pos < m_Pattern.size())
+				invalid("Mismatched '(' and ')'");
+			return node;
+		}
+
+		bool failed() const { return !m_Error.empty() || !m_Unsupported.empty(); }
+
+	public:
+		std::string m_Error;
+		std::string m_Unsupported;
+
+	private:
+		bool atEnd() const { return m_Pos >= m_Pattern.size(); }
+		char peek(std::size_t offset = 0) const { return m_Pos + offset < m_Pattern.size() ? m_Pattern[m_Pos + offset] : '\0'; }
+		bool startsWith(std::string_view str) const { return m_Pattern.substr(m_Pos).starts_with(str); }
+
+		void invalid(std::string_view error)
+		{
+			if (m_Error.empty())
+				m_Error = error;
+		}
+
+		void unsupported(std::string_view construct)
+		{
+			if (m_Unsupported.empty())
+				m_Unsupported = construct;
+		}
+
+		RegexNode parseDisjunction()
+		{
+			RegexNode alternative = parseAlternative();
+			if (failed() || peek() != '|')
+				return alternative;
+
+			RegexNode node;
+			node.m_Type = ERegexNodeType::Alternation;
+			node.m_Children.push_back(std::move(alternative));
+			while (!failed() && peek() == '|')
+			{
+				++m_Pos;
+				node.m_Children.push_back(parseAlternative());
+			}
+			return node;
+		}
+
+		RegexNode parseAlternative()
+		{
+			RegexNode node;
+			node.m_Type = ERegexNodeType::Concat;
+			while (!failed() && !atEnd() && peek() != '|' && peek() != ')')
+				node.m_Children.push_back(parseTerm());
+			return node;
+		}
+
+		RegexNode parseTerm()
+		{
+			char c = peek();
+			if (c == '^' || c == '$')
+			{
+				unsupported("anchors");
+				return {};
+			}
+			if (c == '\\' && (peek(1) == 'b' || peek(1) == 'B'))
+			{
+				unsupported("word boundaries");
+				return {};
+			}
+
+			if (startsWith("(?=") || startsWith("(?!"))
+			{
+				RegexNode node;
+				node.m_Type     = ERegexNodeType::Lookahead;
+				node.m_Negative = peek(2) == '!';
+				m_Pos += 3;
+				node.m_Children.push_back(parseDisjunction());
+				if (failed())
+					return {};
+				if (peek() != ')')
+				{
+					invalid("Mismatched '(' and ')'");
+					return {};
+				}
+				++m_Pos;
+				if (isQuantifier())
+					unsupported("quantified lookaheads");
+				return node;
+			}
+
+			RegexNode atom = parseAtom();
+			if (failed() || !isQuantifier())
+				return atom;
+
+			RegexNode node;
+			node.m_Type = ERegexNodeType::Repeat;
+			node.m_Children.push_back(std::move(atom));
+			parseQuantifier(node);
+			if (isQuantifier())
+				unsupported("stacked quantifiers");
+			return node;
+		}
+
+		bool isQuantifier() const
+		{
+			char c = peek();
+			return c == '*' || c == '+' || c == '?' || c == '{';
+		}
+
+		void parseQuantifier(RegexNode& node)
+		{
+			char c = m_Pattern[m_Pos++];
+			switch (c)
+			{
+			case '*':
+				node.m_Min = 0;
+				node.m_Max = s_Unbounded;
+				break;
+			case '+':
+				node.m_Min = 1;
+				node.m_Max = s_Unbounded;
+				break;
+			case '?':
+				node.m_Min = 0;
+				node.m_Max = 1;
+				break;
+			case '{':
+			{
+				if (!parseNumber(node.m_Min))
+				{
+					invalid("Invalid range in '{}'");
+					return;
+				}
+				node.m_Max = node.m_Min;
+				if (peek() == ',')
+				{
+					++m_Pos;
+					node.m_Max = s_Unbounded;
+					if (peek() != '}' && !parseNumber(node.m_Max))
+					{
+						invalid("Invalid range in '{}'");
+						return;
+					}
+				}
+				if (peek() != '}')
+				{
+					invalid("Mismatched '{' and '}'");
+					return;
+				}
+				++m_Pos;
+				if (node.m_Max < node.m_Min)
+				{
+					invalid("Invalid range in '{}'");
+					return;
+				}
+				break;
+			}
+			}
+
+			if (peek() == '?')
+			{
+				++m_Pos;
+				node.m_Greedy = false;
+			}
+		}
+
+		bool parseNumber(std::size_t& value)
+		{
+			std::size_t begin = m_Pos;
+			value             = 0;
+			while (peek() >= '0' && peek() <= '9')
+			{
+				value = std::min<std::size_t>(value * 10 + static_cast<std::size_t>(peek() - '0'), s_MaxInstructions);
+				++m_Pos;
+			}
+			return m_Pos != begin;
+		}
+
+		RegexNode parseAtom()
+		{
+			char c = peek();
+			switch (c)
+			{
+			case '.':
+			{
+				++m_Pos;
+				RegexByteSet set;
+				set.set();
+				set.reset('\n');
+				set.reset('\r');
+				return MakeSet(set);
+			}
+			case '(':
+			{
+				if (startsWith("(?:"))
+					m_Pos += 3;
+				else if (peek(1) == '?')
+				{
+					unsupported("(?...) groups");
+					return {};
+				}
+				else
+					++m_Pos;
+
+				RegexNode node = parseDisjunction();
+				if (failed())
+					return {};
+				if (peek() != ')')
+				{
+					invalid("Mismatched '(' and ')'");
+					return {};
+				}
+				++m_Pos;
+				return node;
+			}
+			case '[':
+				return parseClass();
+			case '\\':
+			{
+				++m_Pos;
+				RegexByteSet set;
+				parseEscape(set, false);
+				return MakeSet(set);
+			}
+			case '*':
+			case '+':
+			case '?':
+				invalid("Nothing to repeat");
+				return {};
+			case '{':
+				invalid("Mismatched '{' and '}'");
+				return {};
+			default:
+				++m_Pos;
+				return MakeChar(c);
+			}
+		}
+
+		// Parses the escape after a backslash into set, returns true if it was a single character
+		bool parseEscape(RegexByteSet& set, bool inClass)
+		{
+			if (atEnd())
+			{
+				invalid("Trailing backslash");
+				return false;
+			}
+
+			char c = m_Pattern[m_Pos++];
+			switch (c)
+			{
+			case 'd':
+			case 'D':
+			case 's':
+			case 'S':
+			case 'w':
+			case 'W':
+				set |= MakeClassSet(c);
+				return false;
+			case 't': c = '\t'; break;
+			case 'n': c = '\n'; break;
+			case 'r': c = '\r'; break;
+			case 'v': c = '\v'; break;
+			case 'f': c = '\f'; break;
+			case '0': c = '\0'; break;
+			case 'b':
+				// Only reachable inside a class, outside it is a word boundary
+				c = '\b';
+				break;
+			case 'x':
+			case 'u':
+			{
+				std::size_t digits = c == 'x' ? 2 : 4;
+				int         value  = 0;
+				for (std::size_t i = 0; i < digits; ++i)
+				{
+					int digit = HexValue(peek());
+					if (digit < 0)
+					{
+						invalid("Invalid '\\xNN' control character");
+						return false;
+					}
+					value = value * 16 + digit;
+					++m_Pos;
+				}
+				if (value > 0xFF)
+				{
+					unsupported("codepoints above 0xFF");
+					return false;
+				}
+				c = static_cast<char>(value);
+				break;
+			}
+			case 'c':
+				unsupported("control escapes");
+				return false;
+			default:
+				if (c >= '1' && c <= '9')
+				{
+					unsupported(inClass ? "octal escapes" : "backreferences");
+					return false;
+				}
+				break;
+			}
+			set.set(static_cast<std::uint8_t>(c));
+			return true;
+		}
+
+		// A single class atom, returns true if it is one character that may start or end a range
+		bool parseClassAtom(RegexByteSet& set, char& c)
+		{
+			if (peek() == '\\')
+			{
+				++m_Pos;
+				RegexByteSet escape;
+				if (!parseEscape(escape, true))
+				{
+					set |= escape;
+					return false;
+				}
+				for (std::size_t i = 0; i < 256; ++i)
+					if (escape.test(i))
+						c = static_cast<char>(i);
+				return true;
+			}
+			c = m_Pattern[m_Pos++];
+			return true;
+		}
+
+		RegexNode parseClass()
+		{
+			++m_Pos;
+			bool negate = peek() == '^';
+			if (negate)
+				++m_Pos;
+
+			RegexByteSet set;
+			while (!failed() && peek() != ']')
+			{
+				if (atEnd())
+				{
+					invalid("Mismatched '[' and ']'");
+					return {};
+				}
+
+				char first     = 0;
+				bool character = parseClassAtom(set, first);
+				if (failed())
+					return {};
+
+				if (peek() != '-' || peek(1) == ']' || m_Pos + 1 >= m_Pattern.size())
+				{
+					if (character)
+						set.set(static_cast<std::uint8_t>(first));
+					continue;
+				}
+
+				++m_Pos;
+				if (!character)
+				{
+					invalid("Invalid start of '[x-x]' range");
+					return {};
+				}
+
+				char last = 0;
+				if (!parseClassAtom(set, last))
+				{
+					if (!failed())
+						invalid("Invalid end of '[x-x]' range");
+					return {};
+				}
+				if (static_cast<std::uint8_t>(last) < static_cast<std::uint8_t>(first))
+				{
+					invalid("Invalid range in bracket expression");
+					return {};
+				}
+				for (std::size_t i = static_cast<std::uint8_t>(first); i <= static_cast<std::uint8_t>(last); ++i)
+					set.set(i);
+			}
+			++m_Pos;
+			return MakeSet(negate ? ~set : set);
+		}
+
+	private:
+		std::string_view m_Pattern;
+		std::size_t      m_Pos = 0;
+	};
+
+	static bool ContainsLookahead(const RegexNode& node)
+	{
+		if (node.m_Type == ERegexNodeType::Lookahead)
+			return true;
+		return std::any_of(node.m_Children.begin(), node.m_Children.end(), &ContainsLookahead);
+	}
+
+	static bool IsNullable(const RegexNode& node)
+	{
+		switch (node.m_Type)
+		{
+		case ERegexNodeType::Empty: return true;
+		case ERegexNodeType::Set: return false;
+		case ERegexNodeType::Lookahead: return true;
+		case ERegexNodeType::Concat: return std::all_of(node.m_Children.begin(), node.m_Children.end(), &IsNullable);
+		case ERegexNodeType::Alternation: return std::any_of(node.m_Children.begin(), node.m_Children.end(), &IsNullable);
+		case ERegexNodeType::Repeat: return node.m_Min == 0 || IsNullable(node.m_Children[0]);
+		}
+		return true;
+	}
+
+	// std::regex has its own rules for iterations that match nothing, those aren't worth modelling in the automaton
+	static bool RepeatsNullable(const RegexNode& node)
+	{
+		if (node.m_Type == ERegexNodeType::Repeat && IsNullable(node.m_Children[0]))
+			return true;
+		return std::any_of(node.m_Children.begin(), node.m_Children.end(), &RepeatsNullable);
+	}
+
+	// Returns the length every match of node has, or s_Unbounded if matches can differ in length
+	static std::size_t FixedLength(const RegexNode& node)
+	{
+		switch (node.m_Type)
+		{
+		case ERegexNodeType::Empty: return 0;
+		case ERegexNodeType::Set: return 1;
+		case ERegexNodeType::Lookahead: return 0;
+		case ERegexNodeType::Concat:
+		{
+			std::size_t length = 0;
+			for (auto& child : node.m_Children)
+			{
+				std::size_t childLength = FixedLength(child);
+				if (childLength == s_Unbounded)
+					return s_Unbounded;
+				length += childLength;
+			}
+			return length;
+		}
+		case ERegexNodeType::Alternation:
+		{
+			std::size_t length = FixedLength(node.m_Children[0]);
+			for (auto& child : node.m_Children)
+				if (FixedLength(child) != length)
+					return s_Unbounded;
+			return length;
+		}
+		case ERegexNodeType::Repeat:
+		{
+			std::size_t childLength = FixedLength(node.m_Children[0]);
+			if (childLength == 0)
+				return 0;
+			if (childLength == s_Unbounded || node.m_Min != node.m_Max)
+				return s_Unbounded;
+			return childLength * node.m_Min;
+		}
+		}
+		return s_Unbounded;
+	}
+
+	// Thompson style program, splits try m_X before m_Y which is what gives the automaton its priorities
+	struct RegexProgram
+	{
+	public:
+		enum class EOp
+		{
+			Set,
+			Split,
+			Jump,
+			Match
+		};
+
+		struct Instruction
+		{
+		public:
+			EOp          m_Op;
+			std::size_t  m_X   = 0;
+			std::size_t  m_Y   = 0;
+			RegexByteSet m_Set = {};
+		};
+
+	public:
+		bool compile(const RegexNode& node)
+		{
+			if (!emit(node))
+				return false;
+			m_Instructions.push_back({ EOp::Match });
+			return m_Instructions.size() <= s_MaxInstructions;
+		}
+
+	private:
+		std::size_t add(EOp op)
+		{
+			m_Instructions.push_back({ op });
+			return m_Instructions.size() - 1;
+		}
+
+		bool emit(const RegexNode& node)
+		{
+			if (m_Instructions.size() > s_MaxInstructions)
+				return false;
+
+			switch (node.m_Type)
+			{
+			case ERegexNodeType::Empty:
+			case ERegexNodeType::Lookahead:
+				return true;
+			case ERegexNodeType::Set:
+				m_Instructions.push_back({ EOp::Set, m_Instructions.size() + 1, 0, node.m_Set });
+				return true;
+			case ERegexNodeType::Concat:
+				for (auto& child : node.m_Children)
+					if (!emit(child))
+						return false;
+				return true;
+			case ERegexNodeType::Alternation:
+			{
+				std::vector<std::size_t> jumps;
+				for (std::size_t i = 0; i < node.m_Children.size(); ++i)
+				{
+					std::size_t split = ~0ULL;
+					if (i + 1 < node.m_Children.size())
+						split = add(EOp::Split);
+					if (!emit(node.m_Children[i]))
+						return false;
+					if (i + 1 < node.m_Children.size())
+					{
+						jumps.push_back(add(EOp::Jump));
+						m_Instructions[split].m_X = split + 1;
+						m_Instructions[split].m_Y = m_Instructions.size();
+					}
+				}
+				for (auto jump : jumps)
+					m_Instructions[jump].m_X = m_Instructions.size();
+				return true;
+			}
+			case ERegexNodeType::Repeat:
+			{
+				auto& child = node.m_Children[0];
+				for (std::size_t i = 0; i < node.m_Min; ++i)
+					if (!emit(child))
+						return false;
+
+				if (node.m_Max == s_Unbounded)
+				{
+					std::size_t split = add(EOp::Split);
+					if (!emit(child))
+						return false;
+					m_Instructions[add(EOp::Jump)].m_X = split;
+					setSplit(split, split + 1, m_Instructions.size(), node.m_Greedy);
+					return true;
+				}
+
+				std::vector<std::size_t> splits;
+				for (std::size_t i = node.m_Min; i < node.m_Max; ++i)
+				{
+					splits.push_back(add(EOp::Split));
+					if (!emit(child))
+						return false;
+				}
+				for (auto split : splits)
+					setSplit(split, split + 1, m_Instructions.size(), node.m_Greedy);
+				return true;
+			}
+			}
+			return false;
+		}
+
+		void setSplit(std::size_t split, std::size_t body, std::size_t out, bool greedy)
+		{
+			m_Instructions[split].m_X = greedy ? body : out;
+			m_Instructions[split].m_Y = greedy ? out : body;
+		}
+
+	public:
+		std::vector<Instruction> m_Instructions;
+	};
+
+	// Builds the automaton with a priority aware subset construction.
+	// A DFA state is the ordered list of NFA threads, once a thread matches every lower priority thread is dropped.
+	// Reporting the last accepting position therefore gives the same end as a backtracking leftmost first engine.
+	struct RegexAutomatonBuilder
+	{
+	public:
+		using Threads = std::vector<std::size_t>;
+
+	public:
+		RegexAutomatonBuilder(const RegexProgram& program)
+		    : m_Program(program), m_Visited(program.m_Instructions.size(), 0) {}
+
+		bool build(std::uint8_t (&byteClasses)[256], std::size_t& numClasses, std::vector<std::uint32_t>& transitions, std::vector<bool>& accepting)
+		{
+			buildByteClasses(byteClasses, numClasses);
+
+			// State 0 is the dead state
+			m_States.push_back({});
+			Threads start;
+			addThread(start, 0);
+			getState(start);
+
+			for (std::size_t state = 1; state < m_States.size(); ++state)
+			{
+				if (m_States.size() > s_MaxStates)
+					return false;
+
+				for (std::size_t cls = 0; cls < numClasses; ++cls)
+				{
+					Threads next;
+					for (auto pc : m_States[state])
+					{
+						auto& instruction = m_Program.m_Instructions[pc];
+						if (instruction.m_Op == RegexProgram::EOp::Set && instruction.m_Set.test(m_ClassBytes[cls]))
+							if (addThread(next, instruction.m_X))
+								break;
+					}
+					m_Transitions.push_back(static_cast<std::uint32_t>(getState(next)));
+				}
+			}
+
+			transitions.assign(numClasses, 0);
+			transitions.insert(transitions.end(), m_Transitions.begin(), m_Transitions.end());
+			accepting.resize(m_States.size());
+			for (std::size_t state = 0; state < m_States.size(); ++state)
+				accepting[state] = !m_States[state].empty() && m_Program.m_Instructions[m_States[state].back()].m_Op == RegexProgram::EOp::Match;
+			return true;
+		}
+
+	private:
+		void buildByteClasses(std::uint8_t (&byteClasses)[256], std::size_t& numClasses)
+		{
+			// Bytes no set tells apart share a class, refined once per distinct set
+			std::vector<std::uint16_t> classes(256, 0);
+			numClasses = 1;
+			for (auto& instruction : m_Program.m_Instructions)
+			{
+				if (instruction.m_Op != RegexProgram::EOp::Set)
+					continue;
+
+				std::map<std::pair<std::uint16_t, bool>, std::uint16_t> refined;
+				for (std::size_t i = 0; i < 256; ++i)
+				{
+					auto key = std::make_pair(classes[i], instruction.m_Set.test(i));
+					auto itr = refined.find(key);
+					if (itr == refined.end())
+						itr = refined.emplace(key, static_cast<std::uint16_t>(refined.size())).first;
+					classes[i] = itr->second;
+				}
+				numClasses = refined.size();
+			}
+
+			m_ClassBytes.assign(numClasses, 0);
+			for (std::size_t i = 256; i-- > 0;)
+			{
+				byteClasses[i]            = static_cast<std::uint8_t>(classes[i]);
+				m_ClassBytes[classes[i]] = static_cast<std::uint8_t>(i);
+			}
+		}
+
+		// Adds pc and everything reachable through epsilons in priority order, returns true once a match cut the list
+		bool addThread(Threads& threads, std::size_t pc)
+		{
+			++m_Generation;
+			return addThreadImpl(threads, pc);
+		}
+
+		bool addThreadImpl(Threads& threads, std::size_t pc)
+		{
+			if (!threads.empty() && m_Program.m_Instructions[threads.back()].m_Op == RegexProgram::EOp::Match)
+				return true;
+			if (std::find(threads.begin(), threads.end(), pc) != threads.end() || m_Visited[pc] == m_Generation)
+				return false;
+			m_Visited[pc] = m_Generation;
+
+			auto& instruction = m_Program.m_Instructions[pc];
+			switch (instruction.m_Op)
+			{
+			case RegexProgram::EOp::Jump:
+				return addThreadImpl(threads, instruction.m_X);
+			case RegexProgram::EOp::Split:
+				return addThreadImpl(threads, instruction.m_X) || addThreadImpl(threads, instruction.m_Y);
+			case RegexProgram::EOp::Set:
+				threads.push_back(pc);
+				return false;
+			case RegexProgram::EOp::Match:
+				threads.push_back(pc);
+				return true;
+			}
+			return false;
+		}
+
+		std::size_t getState(const Threads& threads)
+		{
+			if (threads.empty())
+				return 0;
+
+			auto itr = m_StateIDs.find(threads);
+			if (itr != m_StateIDs.end())
+				return itr->second;
+
+			m_States.push_back(threads);
+			m_StateIDs.emplace(threads, m_States.size() - 1);
+			return m_States.size() - 1;
+		}
+
+	private:
+		const RegexProgram&            m_Program;
+		std::vector<std::size_t>       m_Visited;
+		std::size_t                    m_Generation = 0;
+		std::vector<std::uint8_t>      m_ClassBytes;
+		std::vector<Threads>           m_States;
+		std::map<Threads, std::size_t> m_StateIDs;
+		std::vector<std::uint32_t>     m_Transitions;
+	};
+
+	// Drops states that can't reach an accepting state, then merges equivalent states with Moore's partition refinement
+	static void MinimizeAutomaton(std::size_t numClasses, std::vector<std::uint32_t>& transitions, std::vector<bool>& accepting, std::uint32_t& start)
+	{
+		std::size_t numStates = accepting.size();
+
+		std::vector<bool> live(numStates, false);
+		for (bool changed = true; changed;)
+		{
+			changed = false;
+			for (std::size_t state = 1; state < numStates; ++state)
+			{
+				if (live[state])
+					continue;
+				bool reaches = accepting[state];
+				for (std::size_t cls = 0; cls < numClasses && !reaches; ++cls)
+					reaches = live[transitions[state * numClasses + cls]];
+				if (reaches)
+				{
+					live[state] = true;
+					changed     = true;
+				}
+			}
+		}
+		for (auto& target : transitions)
+			if (!live[target])
+				target = 0;
+
+		std::vector<std::size_t> partition(numStates);
+		for (std::size_t state = 0; state < numStates; ++state)
+			partition[state] = live[state] ? (accepting[state] ? 2 : 1) : 0;
+
+		for (std::size_t numPartitions = 0;;)
+		{
+			std::map<std::vector<std::size_t>, std::size_t> signatures;
+			std::vector<std::size_t>                        refined(numStates);
+			for (std::size_t state = 0; state < numStates; ++state)
+			{
+				std::vector<std::size_t> signature { partition[state] };
+				for (std::size_t cls = 0; cls < numClasses; ++cls)
+					signature.push_back(partition[transitions[state * numClasses + cls]]);
+				// State 0 comes first, so the dead state keeps id 0 and ids stay dense
+				auto itr       = signatures.emplace(std::move(signature), signatures.size()).first;
+				refined[state] = itr->second;
+			}
+			partition = std::move(refined);
+			if (signatures.size() == numPartitions)
+				break;
+			numPartitions = signatures.size();
+		}
+
+		auto& ids    = partition;
+		auto  numIds = *std::max_element(ids.begin(), ids.end()) + 1;
+
+		std::vector<std::uint32_t> minimized(numIds * numClasses, 0);
+		std::vector<bool>          minimizedAccepting(numIds, false);
+		for (std::size_t state = 1; state < numStates; ++state)
+		{
+			std::size_t id = ids[state];
+			if (!live[state])
+				continue;
+			minimizedAccepting[id] = accepting[state];
+			for (std::size_t cls = 0; cls < numClasses; ++cls)
+				minimized[id * numClasses + cls] = static_cast<std::uint32_t>(ids[transitions[state * numClasses + cls]]);
+		}
+
+		start       = static_cast<std::uint32_t>(live[start] ? ids[start] : 0);
+		transitions = std::move(minimized);
+		accepting   = std::move(minimizedAccepting);
+	}
+
+	std::shared_ptr<const Regex> Regex::Get(const std::string& pattern)
+	{
+		static std::mutex                                                    s_Mutex;
+		static std::unordered_map<std::string, std::shared_ptr<const Regex>> s_Cache;
+
+		std::lock_guard lock(s_Mutex);
+
+		auto& regex = s_Cache[pattern];
+		if (!regex)
+			regex = std::make_shared<const Regex>(pattern);
+		return regex;
+	}
+
+	Regex::Regex(const std::string& pattern)
+	    : m_Pattern(pattern)
+	{
+		RegexParser parser(pattern);
+		RegexNode   root = parser.parse();
+		if (!parser.m_Error.empty())
+		{
+			m_Error = fmt::format("{} in regular expression", parser.m_Error);
+			return;
+		}
+
+		if (parser.m_Unsupported.empty() && RepeatsNullable(root))
+			parser.m_Unsupported = "repeated empty matches";
+
+		// Lookaheads are split off at the top level, everything in front of one must have a fixed length so there is nothing to backtrack into
+		std::vector<std::pair<RegexNode, bool>> segments;
+		if (parser.m_Unsupported.empty() && ContainsLookahead(root))
+		{
+			if (root.m_Type != ERegexNodeType::Concat)
+			{
+				parser.m_Unsupported = "nested lookaheads";
+			}
+			else
+			{
+				RegexNode current;
+				current.m_Type = ERegexNodeType::Concat;
+				for (auto& child : root.m_Children)
+				{
+					if (child.m_Type == ERegexNodeType::Lookahead)
+					{
+						if (FixedLength(current) == s_Unbounded)
+						{
+							parser.m_Unsupported = "lookaheads after a variable length prefix";
+							break;
+						}
+						segments.emplace_back(std::move(current), false);
+						segments.emplace_back(child, true);
+						current        = {};
+						current.m_Type = ERegexNodeType::Concat;
+					}
+					else if (ContainsLookahead(child))
+					{
+						parser.m_Unsupported = "nested lookaheads";
+						break;
+					}
+					else
+					{
+						current.m_Children.push_back(child);
+					}
+				}
+				segments.emplace_back(std::move(current), false);
+			}
+		}
+		else
+		{
+			segments.emplace_back(std::move(root), false);
+		}
+
+		for (auto& [segment, assertion] : segments)
+		{
+			if (!parser.m_Unsupported.empty())
+				break;
+			// Empty segments between lookaheads always match, so they don't need a step
+			if (!assertion && segment.m_Type == ERegexNodeType::Concat && segment.m_Children.empty() && segments.size() > 1)
+				continue;
+
+			Step step;
+			step.m_Assertion = assertion;
+			step.m_Negative  = assertion && segment.m_Negative;
+
+			RegexProgram program;
+			if (!program.compile(assertion ? segment.m_Children[0] : segment))
+			{
+				parser.m_Unsupported = "patterns this large";
+				break;
+			}
+
+			auto&                 automaton = step.m_Automaton;
+			RegexAutomatonBuilder builder(program);
+			if (!builder.build(automaton.m_ByteClasses, automaton.m_NumClasses, automaton.m_Transitions, automaton.m_Accepting))
+			{
+				parser.m_Unsupported = "patterns with this many states";
+				break;
+			}
+			automaton.m_Start = 1;
+			MinimizeAutomaton(automaton.m_NumClasses, automaton.m_Transitions, automaton.m_Accepting, automaton.m_Start);
+			m_Steps.push_back(std::move(step));
+		}
+
+		if (!parser.m_Unsupported.empty())
+		{
+			m_Steps.clear();
+			m_Error.clear();
+			m_Fallback.emplace(pattern, std::regex_constants::ECMAScript | std::regex_constants::optimize);
+			m_Unsupported = std::move(parser.m_Unsupported);
+		}
+	}
+
+	std::size_t Regex::getNumStates() const
+	{
+		std::size_t states = 0;
+		for (auto& step : m_Steps)
+			states += step.m_Automaton.m_Accepting.size();
+		return states;
+	}
+
+	bool Regex::getFirstBytes(std::bitset<256>& bytes) const
+	{
+		bytes.reset();
+		if (!m_Error.empty())
+			return false;
+		if (m_Steps.empty() || m_Steps[0].m_Assertion)
+		{
+			bytes.set();
+			return true;
+		}
+
+		auto& automaton = m_Steps[0].m_Automaton;
+		if (automaton.m_Accepting[automaton.m_Start])
+		{
+			bytes.set();
+			return true;
+		}
+		for (std::size_t c = 0; c < 256; ++c)
+			if (automaton.m_Transitions[automaton.m_Start * automaton.m_NumClasses + automaton.m_ByteClasses[c]])
+				bytes.set(c);
+		return false;
+	}
+
+	std::optional<Regex::CharRun> Regex::getCharRun() const
+	{
+		if (m_Steps.size() != 1 || m_Steps[0].m_Assertion)
+			return std::nullopt;
+
+		// Every byte leaving a state has to lead to the same state, so each state is just a byte set
+		auto& automaton  = m_Steps[0].m_Automaton;
+		auto  transition = [&](std::uint32_t state, std::bitset<256>& bytes) -> std::optional<std::uint32_t> {
+			std::uint32_t target = 0;
+			for (std::size_t c = 0; c < 256; ++c)
+			{
+				std::uint32_t next = automaton.m_Transitions[state * automaton.m_NumClasses + automaton.m_ByteClasses[c]];
+				if (!next)
+					continue;
+				if (target && next != target)
+					return std::nullopt;
+				target = next;
+				bytes.set(c);
+			}
+			return target;
+		};
+
+		CharRun       run;
+		std::uint32_t start = automaton.m_Start;
+		auto          first = transition(start, run.m_First);
+		if (!first || !*first)
+			return std::nullopt;
+
+		if (automaton.m_Accepting[start])
+		{
+			if (*first != start)
+				return std::nullopt;
+			run.m_Rest     = run.m_First;
+			run.m_Optional = true;
+			return run;
+		}
+
+		auto rest = transition(*first, run.m_Rest);
+		if (!rest || !automaton.m_Accepting[*first] || (*rest && *rest != *first))
+			return std::nullopt;
+		return run;
+	}
+
+	template <class Itr>
+	std::size_t Regex::run(Itr begin, Itr end) const
+	{
+		std::size_t offset = 0;
+		for (auto& step : m_Steps)
+		{
+			auto&         automaton = step.m_Automaton;
+			std::uint32_t state     = automaton.m_Start;
+			std::size_t   length    = automaton.m_Accepting[state] ? 0 : s_NoMatch;
+
+			// Assertions only care whether any prefix matches, so they stop at the first accepting state
+			if (!step.m_Assertion || length == s_NoMatch)
+			{
+				std::size_t i = 0;
+				for (Itr itr = begin + static_cast<std::ptrdiff_t>(offset); state && itr != end; ++itr)
+				{
+					state = automaton.m_Transitions[state * automaton.m_NumClasses + automaton.m_ByteClasses[static_cast<std::uint8_t>(*itr)]];
+					++i;
+					if (automaton.m_Accepting[state])
+					{
+						length = i;
+						if (step.m_Assertion)
+							break;
+					}
+				}
+			}
+
+			if (step.m_Assertion)
+			{
+				if ((length != s_NoMatch) == step.m_Negative)
+					return s_NoMatch;
+				continue;
+			}
+			if (length == s_NoMatch)
+				return s_NoMatch;
+			offset += length;
+		}
+		return offset;
+	}
+
+	std::size_t Regex::match(std::string_view str) const
+	{
+		if (!m_Error.empty())
+			return s_NoMatch;
+
+		if (m_Fallback)
+		{
+			std::cmatch results;
+			if (!std::regex_search(str.data(), str.data() + str.size(), results, *m_Fallback, std::regex_constants::match_continuous))
+				return s_NoMatch;
+			return static_cast<std::size_t>(results[0].second - str.data());
+		}
+		return run(str.data(), str.data() + str.size());
+	}
+
+	std::size_t Regex::match(ISource* source, SourceSpan span) const
+	{
+		if (!m_Error.empty())
+			return s_NoMatch;
+
+		if (m_Fallback)
+		{
+			std::match_results<SourceIterator> results;
+			if (!std::regex_search(span.begin(source), span.end(source), results, *m_Fallback, std::regex_constants::match_continuous))
+				return s_NoMatch;
+			return static_cast<SourcePoint>(results[0].second).m_Index - span.m_Begin.m_Index;
+		}
+		return run(span.begin(source), span.end(source));
+	}
+} // namespace CommonLexer
\ No newline at end of file
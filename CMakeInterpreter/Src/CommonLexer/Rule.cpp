@@ -1,4 +1,8 @@
 #include "CommonLexer/Rule.h"
+#include "CommonLexer/Hash.h"
+#include "CommonLexer/Lexer.h"
+
+#include <iterator>
 
 namespace CommonLexer
 {
@@ -8,58 +12,100 @@ namespace CommonLexer
 	IRule::IRule(std::string&& name, bool createNode)
 	    : m_Name(std::move(name)), m_CreateNode(createNode) {}
 
+	std::uint64_t IRule::hashRule(std::uint64_t seed) const
+	{
+		seed = Hash::Combine(Hash::Bytes(m_Name, seed), m_CreateNode);
+		return Hash::Combine(seed, m_Memoize);
+	}
+
 	MatcherRule::MatcherRule(const std::string& name, std::unique_ptr<IMatcher>&& matcher, bool createNode)
 	    : IRule(name, createNode), m_Matcher(std::move(matcher)) {}
 
 	MatcherRule::MatcherRule(std::string&& name, std::unique_ptr<IMatcher>&& matcher, bool createNode)
 	    : IRule(std::move(name), createNode), m_Matcher(std::move(matcher)) {}
 
-	void MatcherRule::cleanUp()
+	void MatcherRule::link(LinkState& state)
+	{
+		m_Matcher->link(state);
+	}
+
+	MatchResult MatcherRule::match(MatcherState& state, SourceSpan span) const
 	{
-		m_Matcher->cleanUp();
+		if (!m_Memoize)
+			return matchUnmemoized(state, span);
+
+		if (auto entry = state.m_LexState->findMemo(this, m_Name, span))
+		{
+			for (auto& node : entry->m_Nodes)
+				state.m_ParentNode->addChild(node);
+			state.m_Messages.insert(state.m_Messages.end(), entry->m_Messages.begin(), entry->m_Messages.end());
+			return entry->m_Result;
+		}
+
+		std::size_t nodeMark    = state.m_ParentNode->getChildren().size();
+		std::size_t messageMark = state.m_Messages.size();
+		auto        result      = matchUnmemoized(state, span);
+
+		auto& children = state.m_ParentNode->getChildren();
+		state.m_LexState->storeMemo(this, span, { result, { children.begin() + nodeMark, children.end() }, { state.m_Messages.begin() + messageMark, state.m_Messages.end() } });
+		return result;
 	}
 
-	MatchResult MatcherRule::match(MatcherState& state, SourceSpan span)
+	MatchResult MatcherRule::matchUnmemoized(MatcherState& state, SourceSpan span) const
 	{
 		if (m_CreateNode)
 		{
-			Node         currentNode { *state.m_Lexer, m_Name };
-			MatcherState tempState { {}, &currentNode, state.m_Lexer, state.m_Source, state.m_SourceSpan, this, span.m_Begin };
+			Node         currentNode { *state.m_Lexer, m_ID };
+			MatcherState tempState { {}, &currentNode, state.m_Lexer, state.m_LexState, state.m_Source, state.m_SourceSpan, this, span.m_Begin };
 			auto         result = m_Matcher->match(tempState, span);
 			if (result.m_Status == EMatchStatus::Success)
 			{
-				currentNode.setSourceSpan(state.m_Source, result.m_Span);
+				currentNode.setSpan(result.m_Span);
 				state.m_ParentNode->addChild(std::move(currentNode));
 			}
-			state.m_Messages.reserve(state.m_Messages.size() + tempState.m_Messages.size());
-			for (auto& message : tempState.m_Messages)
-				state.m_Messages.push_back(std::move(message));
+			state.m_Messages.insert(state.m_Messages.end(), std::make_move_iterator(tempState.m_Messages.begin()), std::make_move_iterator(tempState.m_Messages.end()));
 			return result;
 		}
 		else
 		{
-			MatcherState tempState { {}, state.m_ParentNode, state.m_Lexer, state.m_Source, state.m_SourceSpan, this, span.m_Begin };
+			MatcherState tempState { {}, state.m_ParentNode, state.m_Lexer, state.m_LexState, state.m_Source, state.m_SourceSpan, this, span.m_Begin };
 			auto         result = m_Matcher->match(tempState, span);
-			state.m_Messages.reserve(state.m_Messages.size() + tempState.m_Messages.size());
-			for (auto& message : tempState.m_Messages)
-				state.m_Messages.push_back(std::move(message));
+			state.m_Messages.insert(state.m_Messages.end(), std::make_move_iterator(tempState.m_Messages.begin()), std::make_move_iterator(tempState.m_Messages.end()));
 			return result;
 		}
 	}
 
+	FirstSet MatcherRule::computeFirstSet(Lexer& lexer)
+	{
+		return m_Matcher->computeFirstSet(lexer);
+	}
+
+	bool MatcherRule::collectLeftRules(Lexer& lexer, std::vector<IRule*>& rules)
+	{
+		return m_Matcher->collectLeftRules(lexer, rules);
+	}
+
+	std::uint64_t MatcherRule::hash(std::uint64_t seed) const
+	{
+		return m_Matcher->hash(hashRule(Hash::Bytes("MatcherRule", seed)));
+	}
+
 	CallbackRule::CallbackRule(const std::string& name, Callback&& callback, bool createNode)
 	    : IRule(name, createNode), m_Callback(std::move(callback)) {}
 
 	CallbackRule::CallbackRule(std::string&& name, Callback&& callback, bool createNode)
 	    : IRule(std::move(name), createNode), m_Callback(std::move(callback)) {}
 
-	MatchResult CallbackRule::match(MatcherState& state, SourceSpan span)
+	MatchResult CallbackRule::match(MatcherState& state, SourceSpan span) const
 	{
-		MatcherState tempState { {}, state.m_ParentNode, state.m_Lexer, state.m_Source, state.m_SourceSpan, this, span.m_Begin };
+		MatcherState tempState { {}, state.m_ParentNode, state.m_Lexer, state.m_LexState, state.m_Source, state.m_SourceSpan, this, span.m_Begin };
 		auto         result = m_Callback(tempState, span);
-		state.m_Messages.reserve(state.m_Messages.size() + tempState.m_Messages.size());
-		for (auto& message : tempState.m_Messages)
-			state.m_Messages.push_back(std::move(message));
+		state.m_Messages.insert(state.m_Messages.end(), std::make_move_iterator(tempState.m_Messages.begin()), std::make_move_iterator(tempState.m_Messages.end()));
 		return result;
 	}
+
+	std::uint64_t CallbackRule::hash(std::uint64_t seed) const
+	{
+		return Hash::Combine(hashRule(Hash::Bytes("CallbackRule", seed)), m_CallbackVersion);
+	}
 } // namespace CommonLexer
\ No newline at end of file
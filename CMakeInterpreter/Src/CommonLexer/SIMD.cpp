@@ -0,0 +1,39 @@
+#include "CommonLexer/SIMD.h"
+
+#if COMMON_LEXER_SSE2 && defined(_MSC_VER) && !defined(__clang__)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace CommonLexer::SIMD
+{
+	static bool DetectAVX2()
+	{
+#if !COMMON_LEXER_SSE2
+		return false;
+#elif defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx     = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	bool HasAVX2()
+	{
+		static bool s_HasAVX2 = DetectAVX2();
+		return s_HasAVX2;
+	}
+} // namespace CommonLexer::SIMD
\ No newline at end of file
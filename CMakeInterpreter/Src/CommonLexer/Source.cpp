@@ -1,11 +1,29 @@
 #include "CommonLexer/Source.h"
+#include "CommonLexer/UTF8.h"
 
+#include <algorithm>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#if defined(_WIN32)
+#include <Windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace CommonLexer
 {
+	static_assert(std::is_trivially_copyable_v<SourceIterator> && sizeof(SourceIterator) == 2 * sizeof(void*));
+	static_assert(std::random_access_iterator<SourceIterator>);
+
 	std::size_t SourcePoint::getLine(ISource* source) const
 	{
 		return source->getLineNumberFromIndex(m_Index);
@@ -16,205 +34,521 @@ namespace CommonLexer
 		return source->getColumnNumberFromIndex(m_Index);
 	}
 
-	SourceIterator::SourceIterator()
-	    : m_Source(nullptr), m_CachedOffset(128)
+	SourceIterator SourceSpan::begin(ISource* source) const
 	{
-		movePoint(0);
+		return { source, m_Begin };
 	}
 
-	SourceIterator::SourceIterator(ISource* source, SourcePoint point)
-	    : m_Source(source), m_Point(point), m_CachedOffset(~0ULL)
+	SourceIterator SourceSpan::end(ISource* source) const
 	{
-		movePoint(0);
+		return { source, m_End };
 	}
 
-	char SourceIterator::operator*() const
+	std::size_t SourceSpan::length() const
 	{
-		if (m_Cached.empty() || m_CachedOffset >= m_Cached.size())
-			return '\0';
-		return m_Cached[m_CachedOffset];
+		return m_End.m_Index - m_Begin.m_Index;
 	}
 
-	SourceIterator& SourceIterator::operator++()
+	SourceSpan ISource::getCompleteSpan()
 	{
-		movePoint(1);
-		return *this;
+		return { 0, getSize() };
 	}
 
-	SourceIterator SourceIterator::operator++(int)
+	std::optional<std::string_view> ISource::getSpanView(SourceSpan span)
 	{
-		auto c = *this;
-		++(*this);
-		return c;
+		auto view = data();
+		if (!view)
+			return std::nullopt;
+
+		std::size_t begin = span.m_Begin.m_Index < view->size() ? span.m_Begin.m_Index : view->size();
+		std::size_t end   = span.m_End.m_Index < view->size() ? span.m_End.m_Index : view->size();
+		return view->substr(begin, end > begin ? end - begin : 0);
 	}
 
-	SourceIterator& SourceIterator::operator--()
+	std::size_t ISource::getInvalidUTF8Index()
 	{
-		movePoint(1, true);
-		return *this;
+		std::size_t size = getSize();
+		std::size_t invalid;
+		if (auto view = data())
+			invalid = UTF8::Validate(*view);
+		else
+			invalid = UTF8::Validate(getSpan(0, size));
+		return invalid < size ? invalid : ~0ULL;
+	}
+
+	std::size_t ISource::getCodepointCount(SourceSpan span)
+	{
+		if (auto view = getSpanView(span))
+			return UTF8::CountCodepoints(*view);
+		return UTF8::CountCodepoints(getSpan(span));
+	}
+
+	SourceSpan ISource::getLineSpan(SourcePoint point)
+	{
+		std::size_t line = getLineNumberFromIndex(point.m_Index);
+		if (line == ~0ULL)
+			return { point, point };
+
+		std::size_t begin = getIndexFromLineNumber(line);
+		std::size_t end   = getIndexFromLineNumber(line + 1);
+		return { begin, end == ~0ULL ? getSize() : end - 1 };
 	}
 
-	SourceIterator SourceIterator::operator--(int)
+	SourceBlock ISource::getBlock(std::size_t index)
+	{
+		if (auto view = data())
+			return { view->data(), 0, view->size() };
+
+		std::size_t begin = index & ~std::size_t { 4095 };
+		m_Window          = getSpan(begin, 4096);
+		return { m_Window.data(), begin, m_Window.size() };
+	}
+
+	ISource::ISource([[maybe_unused]] const ISource& copy) {}
+
+	ISource::ISource(ISource&& move) noexcept
 	{
-		auto c = *this;
-		--(*this);
-		return c;
+		move.invalidateBlock();
+		move.m_Window.clear();
 	}
 
-	SourceIterator& SourceIterator::operator+=(std::size_t count)
+	ISource& ISource::operator=([[maybe_unused]] const ISource& copy)
 	{
-		movePoint(count);
+		invalidateBlock();
+		m_Window.clear();
 		return *this;
 	}
 
-	SourceIterator& SourceIterator::operator-=(std::size_t count)
+	ISource& ISource::operator=(ISource&& move) noexcept
 	{
-		movePoint(count, true);
+		invalidateBlock();
+		m_Window.clear();
+		move.invalidateBlock();
+		move.m_Window.clear();
 		return *this;
 	}
 
-	bool SourceIterator::operator==(const SourceIterator& other) const
+	void ISource::invalidateBlock()
+	{
+		m_Block = {};
+		if (m_Wrapper)
+			m_Wrapper->invalidateBlock();
+	}
+
+	char ISource::loadBlock(std::size_t index)
+	{
+		// Lookahead past the end must not replace a block that already covers the whole source
+		if (index >= getSize())
+			return '\0';
+
+		m_Block            = getBlock(index);
+		std::size_t offset = index - m_Block.m_Begin;
+		return offset < m_Block.m_Size ? m_Block.m_Data[offset] : '\0';
+	}
+
+	StringSource::StringSource(const std::string& str)
+	    : m_Str(str)
+	{
+		m_Lines.build(m_Str);
+	}
+
+	StringSource::StringSource(std::string&& str)
+	    : m_Str(std::move(str))
+	{
+		m_Lines.build(m_Str);
+	}
+
+	std::size_t StringSource::getSize()
+	{
+		return m_Str.size();
+	}
+
+	std::size_t StringSource::getNumLines()
+	{
+		return m_Lines.getNumLines();
+	}
+
+	std::size_t StringSource::getIndexFromLineNumber(std::size_t line)
+	{
+		return m_Lines.getIndexFromLineNumber(line);
+	}
+
+	std::size_t StringSource::getLineNumberFromIndex(std::size_t index)
+	{
+		return m_Lines.getLineNumberFromIndex(index);
+	}
+
+	std::size_t StringSource::getColumnNumberFromIndex(std::size_t index)
+	{
+		return m_Lines.getColumnNumberFromIndex(index);
+	}
+
+	std::size_t StringSource::getInvalidUTF8Index()
+	{
+		return m_Lines.getCodepoints().getInvalidIndex();
+	}
+
+	std::size_t StringSource::getCodepointCount(SourceSpan span)
 	{
-		return m_Point.m_Index == other.m_Point.m_Index;
+		return m_Lines.getCodepoints().getCodepointCount(span.m_Begin.m_Index, span.m_End.m_Index);
+	}
+
+	std::optional<std::string_view> StringSource::data()
+	{
+		return std::string_view { m_Str };
+	}
+
+	std::string StringSource::getSpan(std::size_t index, std::size_t length)
+	{
+		if (index >= m_Str.size())
+			return {};
+
+		if ((index + length) >= m_Str.size())
+			length = m_Str.size() - index;
+
+		return m_Str.substr(index, length);
 	}
 
-	bool SourceIterator::operator!=(const SourceIterator& other) const
+	std::string StringSource::getLine(std::size_t line)
 	{
-		return m_Point.m_Index != other.m_Point.m_Index;
+		return std::string { m_Lines.getLine(m_Str, line) };
 	}
 
-	bool SourceIterator::operator<(const SourceIterator& other) const
+	std::vector<std::string> StringSource::getLines(std::size_t startLine, std::size_t lines)
 	{
-		return m_Point.m_Index < other.m_Point.m_Index;
+		std::vector<std::string> lns;
+		for (std::size_t line = startLine, end = startLine + lines; line != end; ++line)
+			lns.push_back(std::move(getLine(line)));
+		return lns;
 	}
 
-	bool SourceIterator::operator<=(const SourceIterator& other) const
+	FileSource::FileSource(const std::filesystem::path& filepath)
+	    : m_Filepath(filepath), m_Data(nullptr), m_Size(0)
 	{
-		return m_Point.m_Index <= other.m_Point.m_Index;
+		map();
 	}
 
-	bool SourceIterator::operator>(const SourceIterator& other) const
+	FileSource::FileSource(FileSource&& move) noexcept
+	    : ISource(std::move(move)), m_Filepath(std::move(move.m_Filepath)), m_Data(move.m_Data), m_Size(move.m_Size), m_Lines(std::move(move.m_Lines))
 	{
-		return m_Point.m_Index > other.m_Point.m_Index;
+		move.m_Data = nullptr;
+		move.m_Size = 0;
 	}
 
-	bool SourceIterator::operator>=(const SourceIterator& other) const
+	FileSource::~FileSource()
 	{
-		return m_Point.m_Index >= other.m_Point.m_Index;
+		unmap();
 	}
 
-	void SourceIterator::movePoint(std::size_t count, bool negative)
+	FileSource& FileSource::operator=(FileSource&& move) noexcept
 	{
-		if (negative)
+		if (this != &move)
 		{
-			m_CachedOffset -= count;
-			m_Point.m_Index -= count;
+			ISource::operator=(std::move(move));
+			unmap();
+			m_Filepath    = std::move(move.m_Filepath);
+			m_Data        = move.m_Data;
+			m_Size        = move.m_Size;
+			m_Lines       = std::move(move.m_Lines);
+			move.m_Data   = nullptr;
+			move.m_Size   = 0;
 		}
-		else
+		return *this;
+	}
+
+	std::size_t FileSource::getSize()
+	{
+		return m_Size;
+	}
+
+	std::size_t FileSource::getNumLines()
+	{
+		setupLines();
+		return m_Lines.getNumLines();
+	}
+
+	std::size_t FileSource::getIndexFromLineNumber(std::size_t line)
+	{
+		setupLines();
+		return m_Lines.getIndexFromLineNumber(line);
+	}
+
+	std::size_t FileSource::getLineNumberFromIndex(std::size_t index)
+	{
+		setupLines();
+		return m_Lines.getLineNumberFromIndex(index);
+	}
+
+	std::size_t FileSource::getColumnNumberFromIndex(std::size_t index)
+	{
+		setupLines();
+		return m_Lines.getColumnNumberFromIndex(index);
+	}
+
+	std::size_t FileSource::getInvalidUTF8Index()
+	{
+		setupLines();
+		return m_Lines.getCodepoints().getInvalidIndex();
+	}
+
+	std::size_t FileSource::getCodepointCount(SourceSpan span)
+	{
+		setupLines();
+		return m_Lines.getCodepoints().getCodepointCount(span.m_Begin.m_Index, span.m_End.m_Index);
+	}
+
+	std::optional<std::string_view> FileSource::data()
+	{
+		if (!m_Data)
+			return std::nullopt;
+		return std::string_view { m_Data, m_Size };
+	}
+
+	std::string FileSource::getSpan(std::size_t index, std::size_t length)
+	{
+		if (index >= m_Size)
+			return {};
+
+		if ((index + length) >= m_Size)
+			length = m_Size - index;
+
+		return std::string { m_Data + index, length };
+	}
+
+	std::string FileSource::getLine(std::size_t line)
+	{
+		setupLines();
+		return std::string { m_Lines.getLine({ m_Data, m_Size }, line) };
+	}
+
+	std::vector<std::string> FileSource::getLines(std::size_t startLine, std::size_t lines)
+	{
+		std::vector<std::string> lns;
+		for (std::size_t line = startLine, end = startLine + lines; line != end; ++line)
+			lns.push_back(std::move(getLine(line)));
+		return lns;
+	}
+
+	void FileSource::map()
+	{
+#if defined(_WIN32)
+		HANDLE file = CreateFileW(m_Filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size))
+		{
+			CloseHandle(file);
+			return;
+		}
+
+		if (size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			m_Data = "";
+			return;
+		}
+
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (!mapping)
+			return;
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (!view)
+			return;
+
+		m_Data = static_cast<const char*>(view);
+		m_Size = static_cast<std::size_t>(size.QuadPart);
+#else
+		int fd = open(m_Filepath.c_str(), O_RDONLY);
+		if (fd < 0)
+			return;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
 		{
-			m_CachedOffset += count;
-			m_Point.m_Index += count;
+			close(fd);
+			return;
 		}
 
-		if (m_Source && m_CachedOffset >= m_Cached.size())
+		if (st.st_size == 0)
 		{
-			std::size_t index = m_Point.m_Index < 128 ? 0 : m_Point.m_Index - 128;
-			m_Cached          = m_Source->getSpan(index, 256);
-			m_CachedOffset    = m_Point.m_Index < 128 ? m_Point.m_Index : 128;
+			close(fd);
+			m_Data = "";
+			return;
 		}
+
+		void* view = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (view == MAP_FAILED)
+			return;
+
+		m_Data = static_cast<const char*>(view);
+		m_Size = static_cast<std::size_t>(st.st_size);
+#endif
 	}
 
-	SourceIterator SourceSpan::begin(ISource* source) const
+	void FileSource::unmap()
 	{
-		return { source, m_Begin };
+		if (m_Data && m_Size > 0)
+		{
+#if defined(_WIN32)
+			UnmapViewOfFile(m_Data);
+#else
+			munmap(const_cast<char*>(m_Data), m_Size);
+#endif
+		}
+		m_Data = nullptr;
+		m_Size = 0;
+		m_Lines.clear();
 	}
 
-	SourceIterator SourceSpan::end(ISource* source) const
+	void FileSource::setupLines()
 	{
-		return { source, m_End };
+		if (m_Lines.empty())
+			m_Lines.build({ m_Data, m_Size });
 	}
 
-	std::size_t SourceSpan::length() const
+	ChunkedSource::ChunkedSource(int fd, std::size_t blockSize, std::size_t blockCount)
+	    : m_Fd(fd), m_OwnsFd(false), m_Size(0), m_BlockSize(blockSize), m_FirstBlock(0), m_ReadBlocks(0)
 	{
-		return m_End.m_Index - m_Begin.m_Index;
+		setup(blockCount);
 	}
 
-	SourceSpan ISource::getCompleteSpan()
+	ChunkedSource::ChunkedSource(const std::filesystem::path& filepath, std::size_t blockSize, std::size_t blockCount)
+	    : m_OwnsFd(true), m_Size(0), m_BlockSize(blockSize), m_FirstBlock(0), m_ReadBlocks(0)
 	{
-		return { 0, getSize() };
+#if defined(_WIN32)
+		m_Fd = _wopen(filepath.c_str(), _O_RDONLY | _O_BINARY);
+#else
+		m_Fd = open(filepath.c_str(), O_RDONLY);
+#endif
+		setup(blockCount);
 	}
 
-	StringSource::StringSource(const std::string& str)
-	    : m_Str(str)
+	ChunkedSource::~ChunkedSource()
 	{
-		setupLineToIndex();
+		if (m_OwnsFd && m_Fd >= 0)
+		{
+#if defined(_WIN32)
+			_close(m_Fd);
+#else
+			close(m_Fd);
+#endif
+		}
 	}
 
-	StringSource::StringSource(std::string&& str)
-	    : m_Str(std::move(str))
+	std::size_t ChunkedSource::getSize()
 	{
-		setupLineToIndex();
+		return m_Size;
 	}
 
-	std::size_t StringSource::getSize()
+	std::size_t ChunkedSource::getNumLines()
 	{
-		return m_Str.size();
+		readThrough(m_Size);
+		return m_Lines.getNumLines();
 	}
 
-	std::size_t StringSource::getNumLines()
+	std::size_t ChunkedSource::getIndexFromLineNumber(std::size_t line)
 	{
-		return m_LineToIndex.size();
+		while (line > m_Lines.getNumLines() && readBlock())
+			;
+		return m_Lines.getIndexFromLineNumber(line);
 	}
 
-	std::size_t StringSource::getIndexFromLineNumber(std::size_t line)
+	std::size_t ChunkedSource::getLineNumberFromIndex(std::size_t index)
 	{
-		return line < m_LineToIndex.size() ? m_LineToIndex[line - 1] : ~0ULL;
+		readThrough(index);
+		return m_Lines.getLineNumberFromIndex(index);
 	}
 
-	std::size_t StringSource::getLineNumberFromIndex(std::size_t index)
+	std::size_t ChunkedSource::getColumnNumberFromIndex(std::size_t index)
 	{
-		for (std::size_t i = m_LineToIndex.size(); i > 0; --i)
-			if (m_LineToIndex[i - 1] <= index)
-				return i;
-		return ~0ULL;
+		readThrough(index);
+		return m_Lines.getColumnNumberFromIndex(index);
 	}
 
-	std::size_t StringSource::getColumnNumberFromIndex(std::size_t index)
+	std::size_t ChunkedSource::getInvalidUTF8Index()
 	{
-		std::size_t line = getLineNumberFromIndex(index);
-		if (line == ~0ULL)
-			return 1;
-		std::size_t lineStart = getIndexFromLineNumber(line);
-		if (lineStart == ~0ULL)
-			return 1;
-		return index - lineStart + 1;
+		readThrough(m_Size);
+		return m_Lines.getCodepoints().getInvalidIndex();
 	}
 
-	std::string StringSource::getSpan(std::size_t index, std::size_t length)
+	std::size_t ChunkedSource::getCodepointCount(SourceSpan span)
 	{
-		if (index >= m_Str.size())
+		readThrough(span.m_End.m_Index);
+		return m_Lines.getCodepoints().getCodepointCount(span.m_Begin.m_Index, span.m_End.m_Index);
+	}
+
+	void ChunkedSource::commit(SourcePoint point)
+	{
+		// Matchers may still look one character behind the commit point, so keep the block holding it
+		std::size_t keepBlock = (point.m_Index > 0 ? point.m_Index - 1 : 0) / m_BlockSize;
+		if (m_FirstBlock >= keepBlock || m_Blocks.empty())
+			return;
+
+		while (m_FirstBlock < keepBlock && !m_Blocks.empty())
+		{
+			m_FreeBlocks.push_back(std::move(m_Blocks.front()));
+			m_Blocks.pop_front();
+			++m_FirstBlock;
+		}
+		invalidateBlock();
+	}
+
+	SourceBlock ChunkedSource::getBlock(std::size_t index)
+	{
+		if (index >= m_Size)
 			return {};
 
-		if ((index + length) >= m_Str.size())
-			length = m_Str.size() - index;
+		std::size_t block = index / m_BlockSize;
+		const char* data  = getBlockData(index);
+		if (!data)
+			return {};
+		return { data, block * m_BlockSize, std::min(m_BlockSize, m_Size - block * m_BlockSize) };
+	}
 
-		return m_Str.substr(index, length);
+	std::string ChunkedSource::getSpan(std::size_t index, std::size_t length)
+	{
+		if (index >= m_Size)
+			return {};
+
+		if ((index + length) >= m_Size)
+			length = m_Size - index;
+
+		std::string str;
+		str.reserve(length);
+		while (length > 0)
+		{
+			std::size_t offset = index % m_BlockSize;
+			std::size_t count  = std::min(length, m_BlockSize - offset);
+
+			const char* data = getBlockData(index);
+			if (!data)
+				return {};
+
+			str.append(data + offset, count);
+			index += count;
+			length -= count;
+		}
+		return str;
 	}
 
-	std::string StringSource::getLine(std::size_t line)
+	std::string ChunkedSource::getLine(std::size_t line)
 	{
 		std::size_t lineStart = getIndexFromLineNumber(line);
 		if (lineStart == ~0ULL)
 			return {};
 
 		std::size_t lineEnd = getIndexFromLineNumber(line + 1);
-		if (lineEnd == ~0ULL)
-			return {};
-
-		return m_Str.substr(lineStart, lineEnd - lineStart - 1);
+		lineEnd             = lineEnd == ~0ULL ? m_Size : lineEnd - 1;
+		return getSpan(lineStart, lineEnd - lineStart);
 	}
 
-	std::vector<std::string> StringSource::getLines(std::size_t startLine, std::size_t lines)
+	std::vector<std::string> ChunkedSource::getLines(std::size_t startLine, std::size_t lines)
 	{
 		std::vector<std::string> lns;
 		for (std::size_t line = startLine, end = startLine + lines; line != end; ++line)
@@ -222,11 +556,95 @@ namespace CommonLexer
 		return lns;
 	}
 
-	void StringSource::setupLineToIndex()
+	void ChunkedSource::setup(std::size_t blockCount)
 	{
-		m_LineToIndex.emplace_back(0);
-		for (std::size_t i = 0; i < m_Str.size(); ++i)
-			if (m_Str[i] == '\n')
-				m_LineToIndex.emplace_back(i + 1);
+		m_Lines.build({});
+		if (m_Fd < 0 || m_BlockSize == 0)
+			return;
+
+#if defined(_WIN32)
+		struct _stat64 st;
+		if (_fstat64(m_Fd, &st) != 0 || (st.st_mode & _S_IFREG) == 0)
+			return;
+#else
+		struct stat st;
+		if (fstat(m_Fd, &st) != 0 || !S_ISREG(st.st_mode))
+			return;
+#endif
+		m_Size = static_cast<std::size_t>(st.st_size);
+
+		m_FreeBlocks.reserve(blockCount);
+		for (std::size_t i = 0; i < blockCount; ++i)
+			m_FreeBlocks.push_back(std::make_unique<char[]>(m_BlockSize));
+	}
+
+	bool ChunkedSource::readBlock()
+	{
+		std::size_t offset = m_ReadBlocks * m_BlockSize;
+		if (offset >= m_Size)
+			return false;
+
+		std::unique_ptr<char[]> block;
+		if (!m_FreeBlocks.empty())
+		{
+			block = std::move(m_FreeBlocks.back());
+			m_FreeBlocks.pop_back();
+		}
+		else
+		{
+			// The ring is full of uncommitted data, either a top level element is larger than the ring or nothing commits at all.
+			// Lexers only commit after top level elements, so with a main rule that repeats no reference the ring grows with the whole file.
+			block = std::make_unique<char[]>(m_BlockSize);
+		}
+
+		std::size_t size = std::min(m_BlockSize, m_Size - offset);
+		std::size_t read = 0;
+		while (read < size)
+		{
+#if defined(_WIN32)
+			int result = _read(m_Fd, block.get() + read, static_cast<unsigned int>(size - read));
+#else
+			auto result = ::read(m_Fd, block.get() + read, size - read);
+#endif
+			if (result <= 0)
+				break;
+			read += static_cast<std::size_t>(result);
+		}
+		if (read < size)
+		{
+			// The file shrunk while reading, treat the rest as the end of the source
+			m_Size = offset + read;
+			if (read == 0)
+			{
+				m_FreeBlocks.push_back(std::move(block));
+				return false;
+			}
+		}
+
+		m_Lines.append({ block.get(), read }, offset);
+		m_Blocks.push_back(std::move(block));
+		++m_ReadBlocks;
+		return true;
+	}
+
+	void ChunkedSource::readThrough(std::size_t index)
+	{
+		while (index >= m_ReadBlocks * m_BlockSize && readBlock())
+			;
+	}
+
+	const char* ChunkedSource::getBlockData(std::size_t index)
+	{
+		std::size_t block = index / m_BlockSize;
+		if (block < m_FirstBlock)
+		{
+			m_RecycledRead = std::min(m_RecycledRead, index);
+			return nullptr;
+		}
+
+		while (block >= m_ReadBlocks)
+			if (!readBlock())
+				return nullptr;
+		return m_Blocks[block - m_FirstBlock].get();
 	}
-} // namespace CommonLexer
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "CommonLexer/SourceManager.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace CommonLexer
+{
+	FileID SourceManager::addSource(std::string name, std::unique_ptr<ISource>&& source)
+	{
+		if (!source)
+			return s_InvalidFileID;
+
+		// The block borrowed from the source has to go whenever the source changes or recycles it
+		std::size_t size = source->getSize();
+		source->setWrapper(this);
+		m_Files.push_back({ std::move(name), std::move(source), m_Size, size });
+		m_Size += size + 1;
+		return static_cast<FileID>(m_Files.size() - 1);
+	}
+
+	FileID SourceManager::addFile(const std::filesystem::path& filepath)
+	{
+		auto source = std::make_unique<FileSource>(filepath);
+		if (!source->isOpen())
+			return s_InvalidFileID;
+		return addSource(filepath.string(), std::move(source));
+	}
+
+	FileID SourceManager::getFileID(SourcePoint point) const
+	{
+		auto file = getFile(point.m_Index);
+		return file ? static_cast<FileID>(file - m_Files.data()) : s_InvalidFileID;
+	}
+
+	ISource* SourceManager::getSource(FileID file) const
+	{
+		return file < m_Files.size() ? m_Files[file].m_Source.get() : nullptr;
+	}
+
+	std::string SourceManager::getName(FileID file) const
+	{
+		return file < m_Files.size() ? m_Files[file].m_Name : std::string {};
+	}
+
+	SourceSpan SourceManager::getFileSpan(FileID file) const
+	{
+		if (file >= m_Files.size())
+			return {};
+		auto& fl = m_Files[file];
+		return { fl.m_Begin, fl.m_Begin + fl.m_Size };
+	}
+
+	SourcePoint SourceManager::getPoint(FileID file, std::size_t localIndex) const
+	{
+		if (file >= m_Files.size())
+			return { ~0ULL };
+		auto& fl = m_Files[file];
+		return { fl.m_Begin + std::min(localIndex, fl.m_Size) };
+	}
+
+	std::size_t SourceManager::getLocalIndex(SourcePoint point) const
+	{
+		auto file = getFile(point.m_Index);
+		return file ? point.m_Index - file->m_Begin : ~0ULL;
+	}
+
+	std::size_t SourceManager::getSize()
+	{
+		return m_Size;
+	}
+
+	// Line numbers are local to a file, so line based queries can't be answered without a file.
+	// Use getSource() for those, index based queries are routed to the owning file.
+	std::size_t SourceManager::getNumLines()
+	{
+		return 0;
+	}
+
+	std::size_t SourceManager::getIndexFromLineNumber([[maybe_unused]] std::size_t line)
+	{
+		return ~0ULL;
+	}
+
+	std::size_t SourceManager::getLineNumberFromIndex(std::size_t index)
+	{
+		auto file = getFile(index);
+		return file ? file->m_Source->getLineNumberFromIndex(index - file->m_Begin) : ~0ULL;
+	}
+
+	std::size_t SourceManager::getColumnNumberFromIndex(std::size_t index)
+	{
+		auto file = getFile(index);
+		return file ? file->m_Source->getColumnNumberFromIndex(index - file->m_Begin) : 1;
+	}
+
+	std::size_t SourceManager::getInvalidUTF8Index()
+	{
+		for (auto& file : m_Files)
+		{
+			std::size_t invalid = file.m_Source->getInvalidUTF8Index();
+			if (invalid != ~0ULL)
+				return file.m_Begin + invalid;
+		}
+		return ~0ULL;
+	}
+
+	std::size_t SourceManager::getCodepointCount(SourceSpan span)
+	{
+		auto file = getFile(span.m_Begin.m_Index);
+		if (!file)
+			return 0;
+
+		std::size_t end = std::min(span.m_End.m_Index, file->m_Begin + file->m_Size);
+		return file->m_Source->getCodepointCount({ span.m_Begin.m_Index - file->m_Begin, std::max(end, span.m_Begin.m_Index) - file->m_Begin });
+	}
+
+	SourceSpan SourceManager::getLineSpan(SourcePoint point)
+	{
+		auto file = getFile(point.m_Index);
+		if (!file)
+			return { point, point };
+
+		auto span = file->m_Source->getLineSpan({ point.m_Index - file->m_Begin });
+		return { file->m_Begin + span.m_Begin.m_Index, file->m_Begin + span.m_End.m_Index };
+	}
+
+	void SourceManager::commit(SourcePoint point)
+	{
+		invalidateBlock();
+		if (auto file = getFile(point.m_Index))
+			file->m_Source->commit({ point.m_Index - file->m_Begin });
+	}
+
+	std::size_t SourceManager::getRecycledReadIndex()
+	{
+		for (auto& file : m_Files)
+		{
+			std::size_t index = file.m_Source->getRecycledReadIndex();
+			if (index != ~0ULL)
+				return file.m_Begin + index;
+		}
+		return ~0ULL;
+	}
+
+	std::optional<std::string_view> SourceManager::getSpanView(SourceSpan span)
+	{
+		auto file = getFile(span.m_Begin.m_Index);
+		if (!file)
+			return std::nullopt;
+
+		std::size_t end = std::min(span.m_End.m_Index, file->m_Begin + file->m_Size);
+		return file->m_Source->getSpanView({ span.m_Begin.m_Index - file->m_Begin, std::max(end, span.m_Begin.m_Index) - file->m_Begin });
+	}
+
+	SourceBlock SourceManager::getBlock(std::size_t index)
+	{
+		auto file = getFile(index);
+		if (!file)
+			return {};
+
+		auto block = file->m_Source->getBlock(index - file->m_Begin);
+		block.m_Begin += file->m_Begin;
+		return block;
+	}
+
+	std::string SourceManager::getSpan(std::size_t index, std::size_t length)
+	{
+		auto file = getFile(index);
+		if (!file)
+			return {};
+		return file->m_Source->getSpan(index - file->m_Begin, length);
+	}
+
+	std::string SourceManager::getLine([[maybe_unused]] std::size_t line)
+	{
+		return {};
+	}
+
+	std::string SourceManager::getLine(SourcePoint point)
+	{
+		auto file = getFile(point.m_Index);
+		return file ? file->m_Source->getLine(SourcePoint { point.m_Index - file->m_Begin }) : std::string {};
+	}
+
+	std::vector<std::string> SourceManager::getLines([[maybe_unused]] std::size_t startLine, [[maybe_unused]] std::size_t lines)
+	{
+		return {};
+	}
+
+	std::vector<std::string> SourceManager::getLines(SourceSpan span)
+	{
+		auto file = getFile(span.m_Begin.m_Index);
+		if (!file)
+			return {};
+
+		std::size_t end = std::min(span.m_End.m_Index, file->m_Begin + file->m_Size);
+		return file->m_Source->getLines(SourceSpan { span.m_Begin.m_Index - file->m_Begin, std::max(end, span.m_Begin.m_Index) - file->m_Begin });
+	}
+
+	const SourceManager::File* SourceManager::getFile(std::size_t index) const
+	{
+		auto itr = std::upper_bound(m_Files.begin(), m_Files.end(), index, [](std::size_t idx, const File& file) { return idx < file.m_Begin; });
+		if (itr == m_Files.begin())
+			return nullptr;
+
+		auto& file = *(itr - 1);
+		return index <= file.m_Begin + file.m_Size ? &file : nullptr;
+	}
+} // namespace CommonLexer
\ No newline at end of file
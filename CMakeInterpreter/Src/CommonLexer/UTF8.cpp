@@ -0,0 +1,449 @@
+#include "CommonLexer/UTF8.h"
+#include "CommonLexer/SIMD.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if COMMON_LEXER_SSE2
+#include <immintrin.h>
+#endif
+
+namespace CommonLexer
+{
+	static std::size_t SequenceLength(std::uint8_t lead)
+	{
+		if (lead < 0x80U)
+			return 1;
+		if (lead < 0xC2U)
+			return 0;
+		if (lead < 0xE0U)
+			return 2;
+		if (lead < 0xF0U)
+			return 3;
+		if (lead < 0xF5U)
+			return 4;
+		return 0;
+	}
+
+	// Returns the length of the sequence starting at cur, or 0 if it is invalid or cut off by end
+	static std::size_t CheckSequence(const std::uint8_t* cur, const std::uint8_t* end)
+	{
+		std::size_t length = SequenceLength(cur[0]);
+		if (length <= 1)
+			return length;
+		if (static_cast<std::size_t>(end - cur) < length)
+			return 0;
+
+		for (std::size_t i = 1; i < length; ++i)
+			if ((cur[i] & 0xC0U) != 0x80U)
+				return 0;
+
+		// Overlong three and four byte forms, surrogates and anything above U+10FFFF
+		switch (cur[0])
+		{
+		case 0xE0U: return cur[1] >= 0xA0U ? length : 0;
+		case 0xEDU: return cur[1] < 0xA0U ? length : 0;
+		case 0xF0U: return cur[1] >= 0x90U ? length : 0;
+		case 0xF4U: return cur[1] < 0x90U ? length : 0;
+		default: return length;
+		}
+	}
+
+	static std::size_t ValidateScalar(const std::uint8_t* begin, const std::uint8_t* cur, const std::uint8_t* end)
+	{
+		while (cur != end)
+		{
+			if (*cur < 0x80U)
+			{
+				++cur;
+				continue;
+			}
+
+			std::size_t length = CheckSequence(cur, end);
+			if (!length)
+				return static_cast<std::size_t>(cur - begin);
+			cur += length;
+		}
+		return static_cast<std::size_t>(end - begin);
+	}
+
+	// Number of bytes at the end of str that start a sequence str doesn't contain the rest of
+	static std::size_t IncompleteTail(std::string_view str)
+	{
+		for (std::size_t back = 1; back <= std::min<std::size_t>(3, str.size()); ++back)
+		{
+			auto c = static_cast<std::uint8_t>(str[str.size() - back]);
+			if ((c & 0xC0U) == 0x80U)
+				continue;
+			return SequenceLength(c) > back ? back : 0;
+		}
+		return 0;
+	}
+
+#if COMMON_LEXER_SSE2
+	static std::size_t ValidateSSE2(const std::uint8_t* begin, const std::uint8_t* end)
+	{
+		// Plain SSE2 has no byte shuffle for the lookup tables, so only ASCII runs are skipped 16 bytes at a time
+		const std::uint8_t* cur = begin;
+		while (end - cur >= 16)
+		{
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur));
+			if (!_mm_movemask_epi8(chunk))
+			{
+				cur += 16;
+				continue;
+			}
+
+			for (const std::uint8_t* chunkEnd = cur + 16; cur < chunkEnd;)
+			{
+				std::size_t length = *cur < 0x80U ? 1 : CheckSequence(cur, end);
+				if (!length)
+					return static_cast<std::size_t>(cur - begin);
+				cur += length;
+			}
+		}
+		return ValidateScalar(begin, cur, end);
+	}
+
+	// Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte".
+	// Every byte is classified together with the byte before it through three 16 entry tables, any bit surviving the AND is an error.
+	namespace AVX2Lookup
+	{
+		static constexpr std::uint8_t TooShort     = 1 << 0;
+		static constexpr std::uint8_t TooLong      = 1 << 1;
+		static constexpr std::uint8_t Overlong3    = 1 << 2;
+		static constexpr std::uint8_t TooLarge     = 1 << 3;
+		static constexpr std::uint8_t Surrogate    = 1 << 4;
+		static constexpr std::uint8_t Overlong2    = 1 << 5;
+		static constexpr std::uint8_t TooLarge1000 = 1 << 6;
+		static constexpr std::uint8_t Overlong4    = 1 << 6;
+		static constexpr std::uint8_t TwoConts     = 1 << 7;
+		static constexpr std::uint8_t Carry        = TooShort | TooLong | TwoConts;
+
+		COMMON_LEXER_TARGET_AVX2 static __m256i Table(std::uint8_t t0, std::uint8_t t1, std::uint8_t t2, std::uint8_t t3, std::uint8_t t4, std::uint8_t t5, std::uint8_t t6, std::uint8_t t7,
+		                                              std::uint8_t t8, std::uint8_t t9, std::uint8_t t10, std::uint8_t t11, std::uint8_t t12, std::uint8_t t13, std::uint8_t t14, std::uint8_t t15)
+		{
+			return _mm256_setr_epi8(static_cast<char>(t0), static_cast<char>(t1), static_cast<char>(t2), static_cast<char>(t3), static_cast<char>(t4), static_cast<char>(t5), static_cast<char>(t6), static_cast<char>(t7),
+			                        static_cast<char>(t8), static_cast<char>(t9), static_cast<char>(t10), static_cast<char>(t11), static_cast<char>(t12), static_cast<char>(t13), static_cast<char>(t14), static_cast<char>(t15),
+			                        static_cast<char>(t0), static_cast<char>(t1), static_cast<char>(t2), static_cast<char>(t3), static_cast<char>(t4), static_cast<char>(t5), static_cast<char>(t6), static_cast<char>(t7),
+			                        static_cast<char>(t8), static_cast<char>(t9), static_cast<char>(t10), static_cast<char>(t11), static_cast<char>(t12), static_cast<char>(t13), static_cast<char>(t14), static_cast<char>(t15));
+		}
+
+		COMMON_LEXER_TARGET_AVX2 static __m256i HighNibble(__m256i v)
+		{
+			return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+		}
+
+		// Bytes of input shifted right by N, with the missing ones taken from the end of prev
+		template <int N>
+		COMMON_LEXER_TARGET_AVX2 static __m256i Prev(__m256i input, __m256i prev)
+		{
+			return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+		}
+
+		COMMON_LEXER_TARGET_AVX2 static __m256i CheckBlock(__m256i input, __m256i prevInput)
+		{
+			__m256i prev1 = Prev<1>(input, prevInput);
+
+			__m256i byte1High = _mm256_shuffle_epi8(Table(TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong,
+			                                              TwoConts, TwoConts, TwoConts, TwoConts,
+			                                              TooShort | Overlong2,
+			                                              TooShort,
+			                                              TooShort | Overlong3 | Surrogate,
+			                                              TooShort | TooLarge | TooLarge1000 | Overlong4),
+			                                        HighNibble(prev1));
+			__m256i byte1Low  = _mm256_shuffle_epi8(Table(Carry | Overlong3 | Overlong2 | Overlong4,
+			                                              Carry | Overlong2,
+			                                              Carry,
+			                                              Carry,
+			                                              Carry | TooLarge,
+			                                              Carry | TooLarge | TooLarge1000,
+			                                              Carry | TooLarge | TooLarge1000,
+			                                              Carry | TooLarge | TooLarge1000,
+			                                              Carry | TooLarge | TooLarge1000,
+			                                              Carry | TooLarge | TooLarge1000,
+			                                              Carry | TooLarge | TooLarge1000,
+			                                              Carry | TooLarge | TooLarge1000,
+			                                              Carry | TooLarge | TooLarge1000,
+			                                              Carry | TooLarge | TooLarge1000 | Surrogate,
+			                                              Carry | TooLarge | TooLarge1000,
+			                                              Carry | TooLarge | TooLarge1000),
+			                                        _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)));
+			__m256i byte2High = _mm256_shuffle_epi8(Table(TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort,
+			                                              TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge1000 | Overlong4,
+			                                              TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge,
+			                                              TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+			                                              TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+			                                              TooShort, TooShort, TooShort, TooShort),
+			                                        HighNibble(input));
+			__m256i special   = _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+
+			// Third and fourth bytes of a sequence have to be continuations, TwoConts marks exactly those
+			__m256i isThird  = _mm256_subs_epu8(Prev<2>(input, prevInput), _mm256_set1_epi8(static_cast<char>(0xE0U - 0x80U)));
+			__m256i isFourth = _mm256_subs_epu8(Prev<3>(input, prevInput), _mm256_set1_epi8(static_cast<char>(0xF0U - 0x80U)));
+			__m256i must23   = _mm256_and_si256(_mm256_or_si256(isThird, isFourth), _mm256_set1_epi8(static_cast<char>(0x80U)));
+			return _mm256_xor_si256(must23, special);
+		}
+
+		struct State
+		{
+		public:
+			__m256i m_Error;
+			__m256i m_PrevInput;
+			__m256i m_PrevIncomplete;
+		};
+
+		COMMON_LEXER_TARGET_AVX2 static void Process(__m256i input, State& state)
+		{
+			if (!_mm256_movemask_epi8(input))
+			{
+				state.m_Error = _mm256_or_si256(state.m_Error, state.m_PrevIncomplete);
+			}
+			else
+			{
+				// A sequence started in the last three bytes of a block has to be finished by the next one
+				__m256i maxIncomplete = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				                                         -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				                                         static_cast<char>(0xF0U - 1), static_cast<char>(0xE0U - 1), static_cast<char>(0xC0U - 1));
+
+				state.m_Error          = _mm256_or_si256(state.m_Error, CheckBlock(input, state.m_PrevInput));
+				state.m_PrevIncomplete = _mm256_subs_epu8(input, maxIncomplete);
+			}
+			state.m_PrevInput = input;
+		}
+
+		COMMON_LEXER_TARGET_AVX2 static bool Validate(const std::uint8_t* begin, const std::uint8_t* end)
+		{
+			State state { _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256() };
+
+			const std::uint8_t* cur = begin;
+			for (; end - cur >= 32; cur += 32)
+				Process(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur)), state);
+
+			if (cur != end)
+			{
+				alignas(32) std::uint8_t tail[32] {};
+				std::memcpy(tail, cur, static_cast<std::size_t>(end - cur));
+				Process(_mm256_load_si256(reinterpret_cast<const __m256i*>(tail)), state);
+			}
+			__m256i error = _mm256_or_si256(state.m_Error, state.m_PrevIncomplete);
+			return _mm256_testz_si256(error, error);
+		}
+	} // namespace AVX2Lookup
+
+	static std::uint64_t LeadMaskSSE2(const char* cur)
+	{
+		__m128i       continuation = _mm_set1_epi8(-65);
+		std::uint64_t mask         = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i * 16));
+			mask |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(chunk, continuation)))) << (i * 16);
+		}
+		return mask;
+	}
+
+	COMMON_LEXER_TARGET_AVX2 static std::uint64_t LeadMaskAVX2(const char* cur)
+	{
+		__m256i continuation = _mm256_set1_epi8(-65);
+		__m256i low          = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur));
+		__m256i high         = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + 32));
+		auto    lowMask      = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(low, continuation)));
+		auto    highMask     = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(high, continuation)));
+		return lowMask | (static_cast<std::uint64_t>(highMask) << 32);
+	}
+#endif
+
+	// Lead bytes are everything but 10xxxxxx, as signed chars that is everything above -65
+	static std::uint64_t LeadMaskScalar(const char* cur, std::size_t count)
+	{
+		std::uint64_t mask = 0;
+		for (std::size_t i = 0; i < count; ++i)
+			if (static_cast<signed char>(cur[i]) > -65)
+				mask |= std::uint64_t { 1 } << i;
+		return mask;
+	}
+
+	static std::uint64_t LeadMask(const char* cur)
+	{
+#if COMMON_LEXER_SSE2
+		return SIMD::HasAVX2() ? LeadMaskAVX2(cur) : LeadMaskSSE2(cur);
+#else
+		return LeadMaskScalar(cur, 64);
+#endif
+	}
+
+	static bool IsASCII(std::string_view str)
+	{
+		const char* cur = str.data();
+		const char* end = cur + str.size();
+#if COMMON_LEXER_SSE2
+		__m128i bits = _mm_setzero_si128();
+		for (; end - cur >= 16; cur += 16)
+			bits = _mm_or_si128(bits, _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur)));
+		if (_mm_movemask_epi8(bits))
+			return false;
+#endif
+		for (; cur != end; ++cur)
+			if (static_cast<std::uint8_t>(*cur) >= 0x80U)
+				return false;
+		return true;
+	}
+
+	namespace UTF8
+	{
+		std::size_t Validate(std::string_view str)
+		{
+			auto begin = reinterpret_cast<const std::uint8_t*>(str.data());
+			auto end   = begin + str.size();
+#if COMMON_LEXER_SSE2
+			if (SIMD::HasAVX2())
+				return AVX2Lookup::Validate(begin, end) ? str.size() : ValidateScalar(begin, begin, end);
+			return ValidateSSE2(begin, end);
+#else
+			return ValidateScalar(begin, begin, end);
+#endif
+		}
+
+		std::size_t CountCodepoints(std::string_view str)
+		{
+			std::size_t count = 0;
+			std::size_t i     = 0;
+			for (; str.size() - i >= 64; i += 64)
+				count += static_cast<std::size_t>(std::popcount(LeadMask(str.data() + i)));
+			return count + static_cast<std::size_t>(std::popcount(LeadMaskScalar(str.data() + i, str.size() - i)));
+		}
+	} // namespace UTF8
+
+	void CodepointTable::build(std::string_view str)
+	{
+		clear();
+		append(str);
+		if (!m_Pending.empty() && m_InvalidIndex == ~0ULL)
+			m_InvalidIndex = m_Size - m_Pending.size();
+		m_Pending.clear();
+	}
+
+	void CodepointTable::append(std::string_view str)
+	{
+		// ASCII is always valid, so the common case only needs the one pass to find out it is ASCII
+		bool ascii = IsASCII(str);
+		if (!ascii || !m_Pending.empty())
+			validate(str);
+
+		if (m_Blocks.empty() && ascii)
+		{
+			m_Size += str.size();
+			m_Codepoints += str.size();
+			return;
+		}
+
+		if (m_Blocks.empty())
+		{
+			// Everything so far was ASCII, so every earlier byte is a lead byte
+			m_Blocks.resize((m_Size + 63) / 64);
+			for (std::size_t i = 0; i < m_Blocks.size(); ++i)
+				m_Blocks[i] = { ~std::uint64_t { 0 }, i * 64 };
+			if (m_Size % 64)
+				m_Blocks.back().m_Mask = (std::uint64_t { 1 } << (m_Size % 64)) - 1;
+		}
+		appendBlocks(str);
+	}
+
+	void CodepointTable::clear()
+	{
+		m_Blocks.clear();
+		m_Size         = 0;
+		m_Codepoints   = 0;
+		m_InvalidIndex = ~0ULL;
+		m_Pending.clear();
+	}
+
+	std::size_t CodepointTable::getInvalidIndex() const
+	{
+		if (m_InvalidIndex != ~0ULL)
+			return m_InvalidIndex;
+		return m_Pending.empty() ? ~0ULL : m_Size - m_Pending.size();
+	}
+
+	std::size_t CodepointTable::getCodepointIndex(std::size_t index) const
+	{
+		if (m_Blocks.empty())
+			return index;
+		if (index >= m_Size)
+			return m_Codepoints + (index - m_Size);
+
+		auto& block = m_Blocks[index / 64];
+		return block.m_Rank + static_cast<std::size_t>(std::popcount(block.m_Mask & ((std::uint64_t { 1 } << (index % 64)) - 1)));
+	}
+
+	void CodepointTable::validate(std::string_view str)
+	{
+		if (m_InvalidIndex != ~0ULL)
+			return;
+
+		std::size_t offset = m_Size;
+		if (!m_Pending.empty())
+		{
+			// Finish the sequence the previous chunk ended in before validating the rest on its own
+			std::size_t length = SequenceLength(static_cast<std::uint8_t>(m_Pending[0]));
+			std::size_t take   = std::min(length - m_Pending.size(), str.size());
+			for (std::size_t i = 0; i < take; ++i)
+			{
+				if ((static_cast<std::uint8_t>(str[i]) & 0xC0U) != 0x80U)
+				{
+					take = i;
+					break;
+				}
+			}
+			m_Pending.append(str.substr(0, take));
+			if (m_Pending.size() < length && take == str.size())
+				return;
+
+			auto pending = reinterpret_cast<const std::uint8_t*>(m_Pending.data());
+			if (CheckSequence(pending, pending + m_Pending.size()) != length)
+			{
+				m_InvalidIndex = offset - (m_Pending.size() - take);
+				return;
+			}
+			m_Pending.clear();
+			str = str.substr(take);
+			offset += take;
+		}
+
+		std::size_t tail    = IncompleteTail(str);
+		std::size_t invalid = UTF8::Validate(str.substr(0, str.size() - tail));
+		if (invalid != str.size() - tail)
+			m_InvalidIndex = offset + invalid;
+		else
+			m_Pending.assign(str.substr(str.size() - tail));
+	}
+
+	void CodepointTable::appendBlocks(std::string_view str)
+	{
+		const char* cur = str.data();
+		const char* end = cur + str.size();
+
+		// Fill up the partial last block before taking whole blocks at a time
+		if (std::size_t used = m_Size % 64; used && cur != end)
+		{
+			std::size_t   count = std::min<std::size_t>(64 - used, static_cast<std::size_t>(end - cur));
+			std::uint64_t mask  = LeadMaskScalar(cur, count);
+			m_Blocks.back().m_Mask |= mask << used;
+			m_Codepoints += static_cast<std::size_t>(std::popcount(mask));
+			m_Size += count;
+			cur += count;
+		}
+
+		for (; cur != end;)
+		{
+			std::size_t   count = std::min<std::size_t>(64, static_cast<std::size_t>(end - cur));
+			std::uint64_t mask  = count == 64 ? LeadMask(cur) : LeadMaskScalar(cur, count);
+			m_Blocks.push_back({ mask, m_Codepoints });
+			m_Codepoints += static_cast<std::size_t>(std::popcount(mask));
+			m_Size += count;
+			cur += count;
+		}
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -1,10 +1,76 @@
 #include <CommonCLI/KeyValue/KVHandler.h>
 #include <MMake/MMake.h>
 
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+
+#include <filesystem>
 #include <iostream>
+#include <string_view>
+#include <vector>
+
+// Only plain decimal numbers, strtoull alone would take signs, spaces and trailing garbage
+static bool ParseCount(const char* str, std::size_t& count)
+{
+	if (!std::isdigit(static_cast<unsigned char>(*str)))
+		return false;
+
+	errno = 0;
+	char* end   = nullptr;
+	auto  value = std::strtoull(str, &end, 10);
+	if (*end != '\0' || errno == ERANGE)
+		return false;
+	count = static_cast<std::size_t>(value);
+	return true;
+}
 
 int main(int argc, char** argv)
 {
+	// mmake lex [--jobs N] [--split] [--cache DIR] <files...>
+	if (argc > 1 && std::string_view { argv[1] } == "lex")
+	{
+		std::size_t                        jobs  = 0;
+		bool                               split = false;
+		std::filesystem::path              cacheDirectory;
+		std::vector<std::filesystem::path> files;
+		for (int i = 2; i < argc; ++i)
+		{
+			std::string_view arg = argv[i];
+			if (arg == "--jobs" || arg == "-j")
+			{
+				if (++i >= argc || !ParseCount(argv[i], jobs))
+				{
+					std::cerr << "--jobs expects a thread count\n";
+					return 1;
+				}
+			}
+			else if (arg == "--split")
+			{
+				split = true;
+			}
+			else if (arg == "--cache")
+			{
+				if (++i >= argc)
+				{
+					std::cerr << "--cache expects a directory\n";
+					return 1;
+				}
+				cacheDirectory = argv[i];
+			}
+			else if (arg.starts_with('-'))
+			{
+				std::cerr << "Unknown option '" << arg << "'\n";
+				return 1;
+			}
+			else
+			{
+				files.emplace_back(arg);
+			}
+		}
+		return MMake::RunLex(files, jobs, split, cacheDirectory) ? 0 : 1;
+	}
+
 	using namespace CommonCLI::KeyValue;
 	Handler handler("MMake", "Build system generator", { 1, 0, 0, "", "alpha" });
 
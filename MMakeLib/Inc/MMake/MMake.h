@@ -1,8 +1,18 @@
 #pragma once
 
+#include <cstddef>
+
+#include <filesystem>
+#include <vector>
+
 namespace MMake
 {
 	void Run();
 
 	void RunCMake();
+	// Lexes the files with the CMake lexer on jobs threads and prints the throughput of every file and the whole batch,
+	// with split every file is lexed on its own and cut into chunks at top level commands instead,
+	// with a cache directory unchanged files are loaded from it and the others are stored to it after lexing,
+	// returns false if a file couldn't be opened or has errors
+	bool RunLex(const std::vector<std::filesystem::path>& files, std::size_t jobs, bool split = false, const std::filesystem::path& cacheDirectory = {});
 } // namespace MMake
\ No newline at end of file
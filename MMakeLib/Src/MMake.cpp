@@ -4,7 +4,9 @@
 #include <CommonCLI/Core.h>
 
 #include <CMakeLexer/Lexer.h>
+#include <CommonLexer/LexCache.h>
 #include <CommonLexer/LexerLexer.h>
+#include <CommonLexer/UTF8.h>
 
 extern "C"
 {
@@ -15,11 +17,15 @@ extern "C"
 
 #include <cstdarg>
 
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <regex>
 #include <sstream>
+#include <thread>
 
 #include <fmt/chrono.h>
 #include <fmt/format.h>
@@ -42,7 +48,7 @@ namespace MMake
 		std::vsnprintf(buf, size + 1, format, args);
 		error << buf;
 		delete[] buf;
-		std::cout << error.str();
+		std::cerr << error.str();
 	}
 
 	void Run()
@@ -93,8 +99,14 @@ namespace MMake
 		auto beginColumn = span.m_Begin.getColumn(source);
 		auto endLine     = span.m_End.getLine(source);
 		auto endColumn   = span.m_End.getColumn(source);
+
+		CommonLexer::SourcePoint lineBegin = span.m_Begin;
 		for (std::size_t i = 0; i < lines.size(); ++i)
 		{
+			auto lineSpan  = source->getLineSpan(lineBegin);
+			auto lineWidth = source->getCodepointCount(lineSpan);
+			lineBegin      = { lineSpan.m_End.m_Index + 1 };
+
 			std::string ln   = std::to_string(beginLine + i) + ": ";
 			auto&       line = lines[i];
 			if (line.empty())
@@ -114,11 +126,11 @@ namespace MMake
 					if (endLine == beginLine)
 						str << std::string(endColumn - pointColumn, '~');
 					else
-						str << std::string(line.size() - pointColumn, '~');
+						str << std::string(lineWidth - pointColumn, '~');
 				}
 				else
 				{
-					str << std::string(line.size() - beginColumn, '~');
+					str << std::string(lineWidth - beginColumn, '~');
 				}
 			}
 			else if (i == lines.size() - 1)
@@ -128,12 +140,12 @@ namespace MMake
 			}
 			else
 			{
-				str << std::string(line.size(), '~');
+				str << std::string(lineWidth, '~');
 			}
 			str << ANSI::GraphicsForegroundDefault << '\n';
 		}
 
-		std::cout << str.str();
+		std::cerr << str.str();
 	}
 
 	std::string EscapeString(const std::string& str)
@@ -141,33 +153,19 @@ namespace MMake
 		return std::regex_replace(str, std::regex { "\"" }, "\\\"");
 	}
 
-	std::size_t UTF8Codepoints(const std::string& str)
+	// Columns are padded to the widest entry, widths are in codepoints so the box drawing prefixes line up
+	struct LexColumn
 	{
-		auto itr = str.begin();
-		auto end = str.end();
+	public:
+		std::string m_Text;
+		std::size_t m_Width;
+	};
 
-		std::size_t count = 0;
-		while (itr != end)
-		{
-			std::uint8_t c = *itr;
-			if (c < 0b1000'0000U)
-				++itr;
-			else if (c < 0b1100'0000U)
-				itr += 2;
-			else if (c < 0b1110'0000U)
-				itr += 3;
-			else if (c < 0b1111'0000U)
-				itr += 4;
-			++count;
-		}
-		return count;
-	}
-
-	void PrintLexNode(const CommonLexer::Node& node, std::vector<std::vector<std::string>>& lines, std::vector<bool>& layers, bool end = true)
+	void PrintLexNode(const CommonLexer::Node& node, CommonLexer::ISource* source, std::vector<std::vector<LexColumn>>& lines, std::vector<bool>& layers, bool end = true)
 	{
 		{
-			std::vector<std::string> line;
-			std::ostringstream       str;
+			std::vector<LexColumn> line;
+			std::ostringstream     str;
 
 			for (auto layer : layers)
 			{
@@ -182,28 +180,31 @@ namespace MMake
 			else
 				str << "\xE2\x94\x9C\xE2\x94\x80";
 
+			std::size_t prefixWidth = layers.size() * 2 + 2;
 			layers.push_back(!end);
 
 			auto span = node.getSpan();
-			str << node.getRule();
-			line.push_back(str.str());
+			auto& rule = node.getRule();
+			str << rule;
+			line.push_back({ str.str(), prefixWidth + CommonLexer::UTF8::CountCodepoints(rule) });
 			str = {};
 
-			auto beginLine   = span.m_Begin.getLine(node.getSource());
-			auto beginColumn = span.m_Begin.getColumn(node.getSource());
-			auto endLine     = span.m_End.getLine(node.getSource());
-			auto endColumn   = span.m_End.getColumn(node.getSource());
+			auto beginLine   = span.m_Begin.getLine(source);
+			auto beginColumn = span.m_Begin.getColumn(source);
+			auto endLine     = span.m_End.getLine(source);
+			auto endColumn   = span.m_End.getColumn(source);
 			str << '(' << beginLine << ':' << beginColumn << " -> " << endLine << ':' << endColumn << ')';
-			line.push_back(str.str());
+			auto position = str.str();
+			line.push_back({ position, position.size() });
 			str = {};
 
 			if (beginLine == endLine)
 			{
-				std::string s = node.getSource()->getSpan(span);
+				std::string s = source->getSpan(span);
 				if (s.find_first_of('\n') >= s.size())
 				{
 					str << "= \"" << EscapeString(s) << '"';
-					line.push_back(str.str());
+					line.push_back({ str.str(), 0 });
 				}
 			}
 			lines.push_back(std::move(line));
@@ -211,16 +212,16 @@ namespace MMake
 
 		auto& children = node.getChildren();
 		for (std::size_t i = 0; i < children.size(); ++i)
-			PrintLexNode(children[i], lines, layers, i >= children.size() - 1);
+			PrintLexNode(children[i], source, lines, layers, i >= children.size() - 1);
 
 		layers.pop_back();
 	}
 
 	void PrintLex(const CommonLexer::Lex& lex)
 	{
-		std::vector<std::vector<std::string>> lines;
-		std::vector<bool>                     layers;
-		PrintLexNode(lex.getRoot(), lines, layers);
+		std::vector<std::vector<LexColumn>> lines;
+		std::vector<bool>                   layers;
+		PrintLexNode(lex.getRoot(), lex.getSource(), lines, layers);
 
 		std::vector<std::size_t> sizes;
 		for (auto& line : lines)
@@ -229,12 +230,7 @@ namespace MMake
 				sizes.resize(line.size() - 1, 0);
 
 			for (std::size_t i = 0; i < line.size() - 1; ++i)
-			{
-				auto&       column     = line[i];
-				std::size_t codepoints = UTF8Codepoints(column);
-				if (codepoints > sizes[i])
-					sizes[i] = codepoints;
-			}
+				sizes[i] = std::max(sizes[i], line[i].m_Width);
 		}
 
 		std::ostringstream str;
@@ -243,9 +239,9 @@ namespace MMake
 			for (std::size_t i = 0; i < line.size(); ++i)
 			{
 				auto& column = line[i];
-				str << column;
+				str << column.m_Text;
 				if (i < line.size() - 1)
-					str << std::string(sizes[i] - UTF8Codepoints(column) + 1, ' ');
+					str << std::string(sizes[i] - column.m_Width + 1, ' ');
 			}
 			str << '\n';
 		}
@@ -368,4 +364,88 @@ message("Skipped")
 
 		PrintLex(lex);*/
 	}
+
+	bool RunLex(const std::vector<std::filesystem::path>& files, std::size_t jobs, bool split, const std::filesystem::path& cacheDirectory)
+	{
+		std::vector<std::unique_ptr<CommonLexer::FileSource>> sources;
+		std::vector<CommonLexer::ISource*>                    batch;
+		for (auto& file : files)
+		{
+			auto source = std::make_unique<CommonLexer::FileSource>(file);
+			if (!source->isOpen())
+			{
+				std::cerr << CommonCLI::Colors::Error << fmt::format("Could not open '{}'", file.string()) << ANSI::GraphicsForegroundDefault << '\n';
+				return false;
+			}
+			batch.push_back(source.get());
+			sources.push_back(std::move(source));
+		}
+		if (jobs == 0)
+			jobs = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+		const CMakeLexer::Lexer lexer;
+
+		std::optional<CommonLexer::LexCache> cache;
+		if (!cacheDirectory.empty())
+			cache.emplace(cacheDirectory);
+
+		auto begin = std::chrono::steady_clock::now();
+
+		// Only the files the cache doesn't have are lexed, their lexes are put back in the order of the files afterwards
+		std::vector<std::optional<CommonLexer::Lex>> cached(batch.size());
+		std::vector<CommonLexer::ISource*>           misses;
+		for (std::size_t i = 0; i < batch.size(); ++i)
+		{
+			if (cache)
+				cached[i] = cache->load(lexer, batch[i]);
+			if (!cached[i])
+				misses.push_back(batch[i]);
+		}
+
+		std::vector<CommonLexer::Lex> lexed;
+		if (split)
+		{
+			lexed.reserve(misses.size());
+			for (auto source : misses)
+				lexed.push_back(lexer.lexSourceParallel(source, jobs));
+		}
+		else
+		{
+			lexed = lexer.lexSources(misses, jobs);
+		}
+		if (cache)
+			for (auto& lex : lexed)
+				cache->store(lex);
+
+		std::vector<CommonLexer::Lex> lexes;
+		lexes.reserve(batch.size());
+		for (std::size_t i = 0, miss = 0; i < batch.size(); ++i)
+			lexes.push_back(cached[i] ? std::move(*cached[i]) : std::move(lexed[miss++]));
+		auto end = std::chrono::steady_clock::now();
+
+		bool                          success = true;
+		std::size_t                   bytes   = 0;
+		std::chrono::duration<double> lexTime {};
+		for (std::size_t i = 0; i < lexes.size(); ++i)
+		{
+			auto& lex  = lexes[i];
+			auto  size = sources[i]->getSize();
+			for (auto& message : lex.getMessages())
+			{
+				PrintMessage(message, sources[i].get());
+				if (message.getSeverity() == CommonLexer::EMessageSeverity::Error)
+					success = false;
+			}
+
+			bytes   += size;
+			lexTime += lex.getDuration();
+			std::cout << fmt::format("{}: {} bytes in {:.3f} ms, {:.1f} MB/s\n", files[i].string(), size, lex.getDuration().count() * 1e3, static_cast<double>(size) / lex.getDuration().count() / 1e6);
+		}
+
+		std::chrono::duration<double> wallTime = end - begin;
+		std::cout << fmt::format("{} files, {} bytes in {:.3f} ms on {} jobs, {:.1f} MB/s, {:.3f} ms summed over the files\n", lexes.size(), bytes, wallTime.count() * 1e3, split ? jobs : std::min(jobs, lexes.size()), static_cast<double>(bytes) / wallTime.count() / 1e6, lexTime.count() * 1e3);
+		if (cache)
+			std::cout << fmt::format("{} files loaded from '{}', {} lexed and stored\n", lexes.size() - lexed.size(), cacheDirectory.string(), lexed.size());
+		return success;
+	}
 } // namespace MMake
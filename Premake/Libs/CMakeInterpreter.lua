@@ -27,4 +27,9 @@ end
 function CMakeInterpreter:setupDep()
 	links({ self.name })
 	sysincludedirs({ self.location .. "/Inc/" })
+
+	filter("system:linux")
+		links({ "pthread" })
+
+	filter({})
 end
@@ -1,7 +1,13 @@
 #include "Test.h"
 
-int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
+#include <string_view>
+
+int main(int argc, char** argv)
 {
-	Tester::Get().test();
+	// Tests --benchmarks runs the benchmarks instead of the tests
+	if (argc > 1 && std::string_view { argv[1] } == "--benchmarks")
+		Tester::Get().benchmark();
+	else
+		Tester::Get().test();
 	return EXIT_SUCCESS;
 }
\ No newline at end of file
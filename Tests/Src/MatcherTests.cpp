@@ -0,0 +1,972 @@
+#include "FileIO.h"
+#include "Test.h"
+
+#include <CMakeLexer/Lexer.h>
+#include <CommonLexer/EditableSource.h>
+#include <CommonLexer/LexCache.h>
+#include <CommonLexer/Lexer.h>
+#include <CommonLexer/LexerLexer.h>
+#include <CommonLexer/Matchers.h>
+#include <CommonLexer/NodeArena.h>
+#include <CommonLexer/Source.h>
+
+#include <atomic>
+#include <cctype>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static CommonLexer::Lexer makeListLexer()
+{
+	using namespace CommonLexer;
+
+	Lexer lexer;
+	lexer.setMainRule("File");
+	lexer.registerRule(MatcherRule { "File", RangeMatcher(SpaceMatcher(ReferenceMatcher("Element"))), false });
+	lexer.registerRule(MatcherRule {
+	    "Element",
+	    OrMatcher(Tuple {
+	        ReferenceMatcher("List"),
+	        ReferenceMatcher("Number"),
+	        ReferenceMatcher("Identifier"),
+	        ReferenceMatcher("Keyword") }),
+	    false });
+	lexer.registerRule(MatcherRule { "List", CombinationMatcher(Tuple { TextMatcher("("), RangeMatcher(SpaceMatcher(ReferenceMatcher("Element"))), TextMatcher(")") }) });
+	lexer.registerRule(MatcherRule { "Number", CombinationMatcher(Tuple { OptionalMatcher(TextMatcher("-")), RegexMatcher("[0-9]+") }) });
+	lexer.registerRule(MatcherRule { "Identifier", RegexMatcher("[a-z_][a-z0-9_]*") });
+	lexer.registerRule(MatcherRule { "Keyword", TextMatcher("@") });
+	return lexer;
+}
+
+static bool testFirstSets([[maybe_unused]] Tester& tester)
+{
+	auto lexer = makeListLexer();
+	lexer.computeFirstSets();
+
+	auto& list = lexer.getRule("List")->getFirstSet();
+	if (list.m_Nullable || list.m_Bytes.count() != 1 || !list.m_Bytes.test('('))
+		return false;
+
+	// The optional sign can be skipped, so the digits can start a number too
+	auto& number = lexer.getRule("Number")->getFirstSet();
+	if (number.m_Nullable || number.m_Bytes.count() != 11 || !number.m_Bytes.test('-') || !number.m_Bytes.test('7'))
+		return false;
+
+	auto& element = lexer.getRule("Element")->getFirstSet();
+	if (element.m_Nullable || !element.m_Bytes.test('(') || !element.m_Bytes.test('a') || !element.m_Bytes.test('@') || element.m_Bytes.test(')'))
+		return false;
+	return lexer.getRule("File")->getFirstSet().m_Nullable;
+}
+
+static bool testFirstSetDispatch([[maybe_unused]] Tester& tester)
+{
+	auto lexer = makeListLexer();
+
+	CommonLexer::StringSource source("(a 12 (b c) @ -3)");
+	auto                      lex = lexer.lexSource(&source);
+	if (lex.getRoot().getSpan().length() != source.getSize())
+		return false;
+
+	auto& children = lex.getRoot().getChildren();
+	if (children.size() != 1 || children[0].getRule() != "List")
+		return false;
+
+	auto& elements = children[0].getChildren();
+	return elements.size() == 5 &&
+	       elements[0].getRule() == "Identifier" &&
+	       elements[1].getRule() == "Number" &&
+	       elements[2].getRule() == "List" &&
+	       elements[3].getRule() == "Keyword" &&
+	       elements[4].getRule() == "Number";
+}
+
+static bool testDeferredMessages([[maybe_unused]] Tester& tester)
+{
+	auto lexer = makeListLexer();
+
+	CommonLexer::StringSource source("(a 12 (b c) @");
+	auto                      lex = lexer.lexSource(&source);
+
+	auto& messages = lex.getMessages();
+	if (messages.size() != 1 || messages[0].getCode() != CommonLexer::EMessageCode::ExpectedText || messages[0].getArgs().m_Got != CommonLexer::MessageArgs::s_EOF)
+		return false;
+	if (messages[0].getMessage() != "Expected ')' but got 'EOF', List")
+		return false;
+
+	auto& farthest = lex.getFarthestFailure();
+	return farthest && farthest->getPoint().m_Index == source.getSize();
+}
+
+static bool testFarthestFailure([[maybe_unused]] Tester& tester)
+{
+	auto lexer = makeListLexer();
+
+	// The list gives up at '-', but the number alternative that was thrown away got one byte further
+	CommonLexer::StringSource source("a (b -x)");
+	auto                      lex = lexer.lexSource(&source);
+	if (lex.getRoot().getSpan().length() != 2)
+		return false;
+
+	auto& farthest = lex.getFarthestFailure();
+	return farthest &&
+	       farthest->getCode() == CommonLexer::EMessageCode::RegexFailed &&
+	       farthest->getPoint().m_Index == 6 &&
+	       farthest->getArgs().m_Rule == "Number";
+}
+
+static bool testSpeculativeRollback([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	// Bad and Short both add an A node before losing, neither may leave it or their messages behind
+	Lexer lexer;
+	lexer.setMainRule("File");
+	lexer.registerRule(MatcherRule { "File", CombinationMatcher(Tuple { NegativeMatcher(ReferenceMatcher("Bad")), OrMatcher(Tuple { ReferenceMatcher("Short"), ReferenceMatcher("Long") }) }), false });
+	lexer.registerRule(MatcherRule { "Bad", CombinationMatcher(Tuple { ReferenceMatcher("A"), TextMatcher("x") }), false });
+	lexer.registerRule(MatcherRule { "Short", CombinationMatcher(Tuple { ReferenceMatcher("A"), TextMatcher("b") }) });
+	lexer.registerRule(MatcherRule { "Long", CombinationMatcher(Tuple { ReferenceMatcher("A"), TextMatcher("bc") }) });
+	lexer.registerRule(MatcherRule { "A", TextMatcher("a") });
+
+	StringSource source("abc");
+	auto         lex = lexer.lexSource(&source);
+	if (lex.getRoot().getSpan().length() != 3 || !lex.getMessages().empty())
+		return false;
+
+	auto& children = lex.getRoot().getChildren();
+	return children.size() == 1 &&
+	       children[0].getRule() == "Long" &&
+	       children[0].getChildren().size() == 1 &&
+	       children[0].getChildren()[0].getRule() == "A";
+}
+
+// Sum and Atom both start with '(' so every level of nesting matches the Atom below it twice
+static CommonLexer::LexerLexerResult makeNestingLexer(bool memoize)
+{
+	std::string grammar = "!MainRule = Expression;\n";
+	grammar += memoize ? "!Memoize = true;\n" : "";
+	grammar += "Expression?: Sum; Atom;\n"
+	           "Sum:         Atom \"+\" Expression;\n"
+	           "Atom:        \"(\" Expression \")\";\n"
+	           "             Identifier;\n"
+	           "Identifier:  '[a-z]+';\n";
+
+	CommonLexer::LexerLexer   lexerLexer;
+	CommonLexer::StringSource source(std::move(grammar));
+	auto                      lex = lexerLexer.lexSource(&source);
+	return lexerLexer.createLexer(lex);
+}
+
+static bool sameSpan(CommonLexer::SourceSpan lhs, CommonLexer::SourceSpan rhs)
+{
+	return lhs.m_Begin.m_Index == rhs.m_Begin.m_Index && lhs.m_End.m_Index == rhs.m_End.m_Index;
+}
+
+static bool sameNodes(const CommonLexer::Node& lhs, const CommonLexer::Node& rhs)
+{
+	if (lhs.getRule() != rhs.getRule() || !sameSpan(lhs.getSpan(), rhs.getSpan()) || lhs.getChildren().size() != rhs.getChildren().size())
+		return false;
+	for (std::size_t i = 0; i < lhs.getChildren().size(); ++i)
+		if (!sameNodes(lhs.getChildren()[i], rhs.getChildren()[i]))
+			return false;
+	return true;
+}
+
+static bool testMemoize([[maybe_unused]] Tester& tester)
+{
+	auto plain    = makeNestingLexer(false);
+	auto memoized = makeNestingLexer(true);
+	if (!plain.m_Messages.empty() || !memoized.m_Messages.empty())
+		return false;
+
+	std::string input = std::string(12, '(') + "a+b" + std::string(12, ')');
+
+	CommonLexer::StringSource source(std::move(input));
+	auto                      plainLex    = plain.m_Lexer.lexSource(&source);
+	auto                      memoizedLex = memoized.m_Lexer.lexSource(&source);
+	if (plainLex.getRoot().getSpan().length() != source.getSize() || !sameNodes(plainLex.getRoot(), memoizedLex.getRoot()))
+		return false;
+
+	auto& plainMessages    = plainLex.getMessages();
+	auto& memoizedMessages = memoizedLex.getMessages();
+	if (plainMessages.size() != memoizedMessages.size())
+		return false;
+	for (std::size_t i = 0; i < plainMessages.size(); ++i)
+		if (plainMessages[i].getMessage() != memoizedMessages[i].getMessage() || !sameSpan(plainMessages[i].getSpan(), memoizedMessages[i].getSpan()))
+			return false;
+
+	// Without memoization the innermost identifier is matched once per path through the nesting
+	auto& plainStats = plainLex.getMemoStats();
+	if (plainStats.m_Hits != 0 || plainStats.m_Misses != 0)
+		return false;
+
+	auto& stats = memoizedLex.getMemoStats();
+	if (stats.m_Hits == 0 || stats.m_Entries != stats.m_Misses || stats.m_Bytes == 0 || stats.m_PeakBytes == 0)
+		return false;
+
+	for (auto& ruleStats : memoizedLex.getRuleMemoStats())
+		if (ruleStats.m_Rule == "Atom" && ruleStats.getHitRate() < 0.4)
+			return false;
+	return true;
+}
+
+static bool testMemoizeNamedGroups([[maybe_unused]] Tester& tester)
+{
+	// A hit on Open would not set Count, so neither Open nor the rules around it may memoize
+	std::string grammar = "!MainRule = File;\n"
+	                      "!Memoize = true;\n"
+	                      "File?:   (Bracket | Word)*;\n"
+	                      "Bracket: Open \"x\" \"]\" \\Count \"]\";\n"
+	                      "Open?:   \"[\" (<Count>: '='*) \"[\";\n"
+	                      "Word:    '[a-z]+';\n";
+
+	CommonLexer::LexerLexer   lexerLexer;
+	CommonLexer::StringSource grammarSource(std::move(grammar));
+	auto                      grammarLex = lexerLexer.lexSource(&grammarSource);
+	auto                      result     = lexerLexer.createLexer(grammarLex, {}, false);
+	if (result.m_Messages.size() != 3 || result.m_Lexer.getRule("Bracket")->doesMemoize() || result.m_Lexer.getRule("Open")->doesMemoize() || !result.m_Lexer.getRule("Word")->doesMemoize())
+		return false;
+
+	CommonLexer::StringSource source("[==[x]==]ab[[x]]");
+	auto                      lex = result.m_Lexer.lexSource(&source);
+	return lex.getRoot().getSpan().length() == source.getSize() && lex.getRoot().getChildren().size() == 3;
+}
+
+static const char* s_Literals[] { "if", "int", "in", "inline", "else", "elif", "<", "<<", "<<=", "<=", "->", "->*", "-" };
+
+// The same literals as either one text matcher per alternative or a literal set, both must lex identically
+static CommonLexer::Lexer makeLiteralLexer(bool literalSet)
+{
+	using namespace CommonLexer;
+
+	Lexer lexer;
+	lexer.setMainRule("File");
+	lexer.registerRule(MatcherRule { "File", CombinationMatcher(Tuple { TextMatcher("("), ReferenceMatcher("Literal"), TextMatcher(")") }), false });
+	if (literalSet)
+	{
+		lexer.registerRule(MatcherRule { "Literal", LiteralSetMatcher(std::vector<std::string>(std::begin(s_Literals), std::end(s_Literals))) });
+	}
+	else
+	{
+		std::vector<std::unique_ptr<IMatcher>> matchers;
+		for (auto literal : s_Literals)
+			matchers.push_back(std::make_unique<TextMatcher>(literal));
+		lexer.registerRule(MatcherRule { "Literal", OrMatcher(std::move(matchers)) });
+	}
+	return lexer;
+}
+
+// Hides the contiguous buffer so matching has to go through SourceIterator
+class MatcherWindowedSource final : public CommonLexer::StringSource
+{
+public:
+	using CommonLexer::StringSource::StringSource;
+
+	virtual std::optional<std::string_view> data() override { return std::nullopt; }
+};
+
+static bool sameLexes(const CommonLexer::Lex& lhs, const CommonLexer::Lex& rhs)
+{
+	if (!sameNodes(lhs.getRoot(), rhs.getRoot()))
+		return false;
+
+	auto& lhsMessages = lhs.getMessages();
+	auto& rhsMessages = rhs.getMessages();
+	if (lhsMessages.size() != rhsMessages.size())
+		return false;
+	for (std::size_t i = 0; i < lhsMessages.size(); ++i)
+		if (lhsMessages[i].getMessage() != rhsMessages[i].getMessage() || lhsMessages[i].getPoint().m_Index != rhsMessages[i].getPoint().m_Index || !sameSpan(lhsMessages[i].getSpan(), rhsMessages[i].getSpan()))
+			return false;
+
+	auto& lhsFarthest = lhs.getFarthestFailure();
+	auto& rhsFarthest = rhs.getFarthestFailure();
+	return lhsFarthest.has_value() == rhsFarthest.has_value() && (!lhsFarthest || lhsFarthest->getMessage() == rhsFarthest->getMessage());
+}
+
+static bool testLiteralSet([[maybe_unused]] Tester& tester)
+{
+	auto texts      = makeLiteralLexer(false);
+	auto literalSet = makeLiteralLexer(true);
+
+	std::string_view alphabet = "ifntlsea<=->*)";
+	std::mt19937     random(13);
+	for (std::size_t i = 0; i < 2000; ++i)
+	{
+		std::string str(1 + random() % 8, '(');
+		for (std::size_t j = 1; j < str.size(); ++j)
+			str[j] = alphabet[random() % alphabet.size()];
+
+		CommonLexer::StringSource source(str);
+		MatcherWindowedSource     windowed(str);
+		if (!sameLexes(texts.lexSource(&source), literalSet.lexSource(&source)) || !sameLexes(texts.lexSource(&source), literalSet.lexSource(&windowed)))
+			return false;
+	}
+	return true;
+}
+
+static bool testLiteralSetLongestMatch([[maybe_unused]] Tester& tester)
+{
+	CommonLexer::LiteralSetMatcher matcher(std::vector<std::string> { "<", "<<=", "<<" });
+	if (matcher.getNumStates() != 5)
+		return false;
+
+	auto lexer = makeLiteralLexer(true);
+
+	CommonLexer::StringSource source("(<<=)");
+	auto                      lex = lexer.lexSource(&source);
+	if (lex.getRoot().getSpan().length() != source.getSize() || !lex.getMessages().empty())
+		return false;
+
+	auto& children = lex.getRoot().getChildren();
+	return children.size() == 1 && children[0].getSpan().length() == 3;
+}
+
+// Lexes with the regex itself or with the matcher LexerLexer lowers it to
+static CommonLexer::Lexer makeRunLexer(const std::string& pattern, bool lowered)
+{
+	using namespace CommonLexer;
+
+	Lexer lexer;
+	lexer.setMainRule("File");
+	lexer.registerRule(MatcherRule { "File", CombinationMatcher(Tuple { ReferenceMatcher("Run"), TextMatcher(";") }), false });
+	auto run = Regex::Get(pattern)->getCharRun();
+	if (!lowered)
+		lexer.registerRule(MatcherRule { "Run", RegexMatcher(pattern) });
+	else if (run->m_Rest.none() && !run->m_Optional)
+		lexer.registerRule(MatcherRule { "Run", CharClassMatcher(run->m_First) });
+	else
+		lexer.registerRule(MatcherRule { "Run", CharRunMatcher(*run) });
+	return lexer;
+}
+
+static bool testCharRun([[maybe_unused]] Tester& tester)
+{
+	// Long inputs go through the 16 and 32 byte scans, the bytes from 0x80 through the high half of the bitmap
+	std::string alphabet = "aZ_09 \t=];\x80\xE9\xFF";
+	std::string patterns[] { "[ \t]+", "[A-Za-z_][A-Za-z0-9_]*", "[^\\]]", "=*", "[a-z\x80-\xFF]+", "[^;]+", "[\x80\xE9" "a]*" };
+	for (auto& pattern : patterns)
+	{
+		if (!CommonLexer::Regex::Get(pattern)->getCharRun())
+			return false;
+
+		auto regex   = makeRunLexer(pattern, false);
+		auto lowered = makeRunLexer(pattern, true);
+
+		std::mt19937 random(static_cast<std::uint32_t>(pattern.size()));
+		for (std::size_t i = 0; i < 500; ++i)
+		{
+			std::string str(random() % 80, '\0');
+			for (auto& c : str)
+				c = random() % 4 ? alphabet[random() % 4] : alphabet[random() % alphabet.size()];
+			str += ';';
+
+			CommonLexer::StringSource source(str);
+			MatcherWindowedSource     windowed(str);
+			if (!sameLexes(regex.lexSource(&source), lowered.lexSource(&source)) || !sameLexes(regex.lexSource(&source), lowered.lexSource(&windowed)))
+				return false;
+		}
+	}
+	return true;
+}
+
+static bool testGrammarOptimize([[maybe_unused]] Tester& tester)
+{
+	std::string grammar = "!MainRule = File;\n"
+	                      "File?:    Item*;\n"
+	                      "Item?:    Keyword; (Operator | Call | Member); Gap;\n"
+	                      "Keyword:  \"e\" \"lse\" Gap \"if\"; \"end\";\n"
+	                      "Operator: \"<\" \"<\"; \"<\" \"=\"; \"<\";\n"
+	                      "Call:     '[a-z]+' \"(\" \")\"; '[a-z]+' \"[\" \"]\"; '[a-z]+';\n"
+	                      "Member:   Name \".\" Name; Name \"-\" \">\" Name;\n"
+	                      "Name:     'x+';\n"
+	                      "Gap?:     '[ \\t]+';\n"
+	                      "Unused:   \"unused\";\n";
+
+	CommonLexer::LexerLexer   lexerLexer;
+	CommonLexer::StringSource grammarSource(std::move(grammar));
+	auto                      grammarLex = lexerLexer.lexSource(&grammarSource);
+	auto                      plain      = lexerLexer.createLexer(grammarLex, {}, false);
+	auto                      optimized  = lexerLexer.createLexer(grammarLex);
+	// Unused is only reported by the plain lexer, the optimizer drops it
+	if (plain.m_Messages.size() != 1 || plain.m_Messages[0].getSeverity() != CommonLexer::EMessageSeverity::Warning || !optimized.m_Messages.empty())
+		return false;
+
+	auto& stats = optimized.m_OptimizeStats;
+	if (stats.m_Inlined == 0 || stats.m_Flattened == 0 || stats.m_Merged == 0 || stats.m_Factored != 2 || stats.m_Removed != 2 || stats.m_After.m_Rules != stats.m_Before.m_Rules - 2)
+		return false;
+
+	std::string_view alphabet = "elsifndu<=()[] \tx.->";
+	std::mt19937     random(17);
+	for (std::size_t i = 0; i < 2000; ++i)
+	{
+		std::string str(random() % 12, '\0');
+		for (auto& c : str)
+			c = alphabet[random() % alphabet.size()];
+
+		CommonLexer::StringSource source(str);
+		if (!sameNodes(plain.m_Lexer.lexSource(&source).getRoot(), optimized.m_Lexer.lexSource(&source).getRoot()))
+			return false;
+	}
+
+	// X factors to N ("a" | "b"), when neither rest matches the N node must go with the choice instead of staying in Elem
+	CommonLexer::StringSource failingSource("!MainRule = File;\n"
+	                                        "File?: Elem*;\n"
+	                                        "Elem:  X? \"n\" \"z\";\n"
+	                                        "X?:    N \"a\"; N \"b\";\n"
+	                                        "N:     \"n\";\n");
+	auto                      failingLex       = lexerLexer.lexSource(&failingSource);
+	auto                      plainFailing     = lexerLexer.createLexer(failingLex, {}, false);
+	auto                      optimizedFailing = lexerLexer.createLexer(failingLex);
+	if (optimizedFailing.m_OptimizeStats.m_Factored == 0)
+		return false;
+	for (auto str : { "nz", "nanz", "nbnz", "nznz", "nanznz", "nnz", "nc" })
+	{
+		CommonLexer::StringSource source(str);
+		if (!sameNodes(plainFailing.m_Lexer.lexSource(&source).getRoot(), optimizedFailing.m_Lexer.lexSource(&source).getRoot()))
+			return false;
+	}
+
+	// The grammar of grammars has nodeless rules on a cycle, both lexers must agree on every grammar in the tree
+	CommonLexer::StringSource lexerLexSource(readFile("../../CMakeInterpreter/Src/LexerLex.txt"));
+	auto                      lexerLex          = lexerLexer.lexSource(&lexerLexSource);
+	auto                      plainLexerLex     = lexerLexer.createLexer(lexerLex, {}, false);
+	auto                      optimizedLexerLex = lexerLexer.createLexer(lexerLex);
+	if (lexerLexSource.getSize() == 0 || optimizedLexerLex.m_OptimizeStats.m_Inlined == 0)
+		return false;
+
+	for (auto file : { "../../CMakeInterpreter/Src/Lex.txt", "../../CMakeInterpreter/Src/LexerLex.txt", "../../CMakeInterpreter/Src/cpp20Lex.txt" })
+	{
+		CommonLexer::StringSource source(readFile(file));
+		if (!sameNodes(plainLexerLex.m_Lexer.lexSource(&source).getRoot(), optimizedLexerLex.m_Lexer.lexSource(&source).getRoot()))
+			return false;
+	}
+	return true;
+}
+
+static bool testRuleIDs([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	auto lexer = makeListLexer();
+	auto list  = lexer.getRule("List");
+	if (!list || lexer.getRule(list->getID()) != list || lexer.getRuleName(list->getID()) != "List" || lexer.getRuleID("List") != list->getID())
+		return false;
+
+	// Names without a rule still get an ID, but nothing to resolve to
+	std::size_t count   = lexer.getRuleNameCount();
+	RuleID      missing = lexer.getRuleID("Missing");
+	if (missing != count || lexer.getRuleNameCount() != count + 1 || lexer.getRule(missing) || lexer.getRule("Missing") || lexer.getRuleName(0) != "")
+		return false;
+
+	StringSource source("(a 1 (@))");
+	auto         lex      = lexer.lexSource(&source);
+	auto&        children = lex.getRoot().getChildren();
+	return lex.getRoot().getRule() == "Root" &&
+	       children.size() == 1 &&
+	       children[0].getRuleID() == list->getID() &&
+	       children[0].getRule() == "List" &&
+	       children[0].getChildren().size() == 3 &&
+	       children[0].getChildren()[2].getRuleID() == list->getID();
+}
+
+static bool testLink([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	auto clean = makeListLexer();
+	if (!clean.link().empty())
+		return false;
+
+	// Setting the main rule unlinks the lexer, linking again reports the rules only the old one used
+	clean.setMainRule("Number");
+	if (clean.isLinked() || clean.link().empty() || !clean.isLinked())
+		return false;
+
+	Lexer lexer;
+	lexer.setMainRule("File");
+	lexer.registerRule(MatcherRule { "File", CombinationMatcher(Tuple { ReferenceMatcher("Missing"), ReferenceMatcher("Missing"), ReferenceMatcher("Left") }) });
+	lexer.registerRule(MatcherRule { "Left", OrMatcher(Tuple { CombinationMatcher(Tuple { ReferenceMatcher("Left"), TextMatcher("x") }), TextMatcher("y") }) });
+	lexer.registerRule(MatcherRule { "Unused", TextMatcher("u") });
+
+	auto messages = lexer.link();
+	if (messages.size() != 3 ||
+	    messages[0].getMessage() != "Rule 'File' references undefined rule 'Missing'" ||
+	    messages[1].getMessage() != "Rule 'Left' is left recursive through Left -> Left" ||
+	    messages[2].getMessage() != "Rule 'Unused' is never used" ||
+	    messages[2].getSeverity() != EMessageSeverity::Warning)
+		return false;
+
+	// Undefined references still fail when reached
+	StringSource source("y");
+	auto         lex = lexer.lexSource(&source);
+	for (auto& message : lex.getMessages())
+		if (message.getCode() == EMessageCode::MissingRule)
+			return true;
+	return false;
+}
+
+static bool lexesFully(const std::string& rules, const std::string& input, bool optimize)
+{
+	CommonLexer::LexerLexer   lexerLexer;
+	CommonLexer::StringSource grammarSource("!MainRule = File;\n" + rules);
+	auto                      grammarLex = lexerLexer.lexSource(&grammarSource);
+	if (grammarLex.getRoot().getSpan().length() != grammarSource.getSize())
+		return false;
+
+	auto result = lexerLexer.createLexer(grammarLex, {}, optimize);
+	if (!result.m_Messages.empty())
+		return false;
+
+	CommonLexer::StringSource source(input);
+	return result.m_Lexer.lexSource(&source).getRoot().getSpan().length() == input.size();
+}
+
+static bool testOrderedChoice([[maybe_unused]] Tester& tester)
+{
+	struct Case
+	{
+		const char* m_Rules;
+		const char* m_Input;
+		bool        m_Matches;
+	};
+	Case cases[] {
+		{ "File?: Choice \"b;\"; Choice: \"a\" / \"ab\";", "ab;", true },
+		{ "File?: Choice \"b;\"; Choice: \"a\" | \"ab\";", "ab;", false },
+		{ "File?: Choice \";\"; Choice: (\"a\" \"b\") / (\"a\" \"c\");", "ac;", true },
+		{ "File?: Choice \";\"; Choice: (\"a\" ^ \"b\") / (\"a\" \"c\");", "ac;", false },
+		{ "File?: Choice \";\"; Choice: (\"a\" ^ \"b\") | (\"a\" \"c\");", "ac;", false },
+		{ "File?: Choice \";\"; Choice: (\"a\" ^ \"b\") / (\"a\" \"c\");", "ab;", true },
+		// A cut only commits the innermost choice of its own rule
+		{ "File?: Choice \";\"; Choice: Inner / \"ac\"; Inner?: \"a\" ^ \"b\";", "ac;", true },
+		{ "File?: Choice \";\"; Choice: ((\"a\" ^ \"b\") | \"x\") / \"ac\";", "ac;", true },
+		{ "File?: Choice \";\"; Choice: (\"a\" (\"b\" | \"d\")) / (\"a\" \"c\");", "ac;", true },
+		{ "File?: Choice \";\"; Choice: (\"a\" ^ (\"b\" | \"d\")) / (\"a\" \"c\");", "ac;", false }
+	};
+	for (auto& testCase : cases)
+		for (bool optimize : { false, true })
+			if (lexesFully(testCase.m_Rules, testCase.m_Input, optimize) != testCase.m_Matches)
+				return false;
+	return true;
+}
+
+static bool testConcurrentLex([[maybe_unused]] Tester& tester)
+{
+	const CMakeLexer::Lexer lexer;
+
+	// Every thread gets its own bracket count, so named groups leaking between lexes would break the bracket arguments
+	std::string                   input = readFile("LexInput.cmake");
+	std::vector<std::string>      inputs;
+	std::vector<CommonLexer::Lex> expected;
+	for (std::size_t i = 0; i < 8; ++i)
+	{
+		std::string equals(i, '=');
+		inputs.push_back(input + "bracket_argument([" + equals + "[a" + (i > 0 ? "]b" : "") + "]" + equals + "])\n");
+
+		CommonLexer::StringSource source(inputs.back());
+		auto&                     lex = expected.emplace_back(lexer.lexSource(&source));
+		if (lex.getRoot().getSpan().length() != source.getSize())
+			return false;
+	}
+
+	std::atomic<bool> same          = true;
+	auto              lexRepeatedly = [&](std::size_t i) {
+		for (std::size_t j = 0; j < 64 && same; ++j)
+		{
+			CommonLexer::StringSource source(inputs[i]);
+			if (!sameLexes(lexer.lexSource(&source), expected[i]))
+				same = false;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (std::size_t i = 0; i < inputs.size(); ++i)
+		threads.emplace_back(lexRepeatedly, i);
+	for (auto& thread : threads)
+		thread.join();
+	return same;
+}
+
+static bool testLexSources([[maybe_unused]] Tester& tester)
+{
+	const CMakeLexer::Lexer lexer;
+
+	std::string                                             input = readFile("LexInput.cmake");
+	std::vector<std::string>                                inputs;
+	std::vector<std::unique_ptr<CommonLexer::StringSource>> sources;
+	std::vector<CommonLexer::ISource*>                      batch;
+	for (std::size_t i = 0; i < 16; ++i)
+	{
+		// Every input has its own length, so lexes coming back out of order show up as wrong spans
+		inputs.push_back(input + std::string(i, '\n') + "message(" + std::to_string(i) + ")\n");
+		batch.push_back(sources.emplace_back(std::make_unique<CommonLexer::StringSource>(inputs.back())).get());
+	}
+
+	for (std::size_t jobs : { 1, 4, 0 })
+	{
+		auto lexes = lexer.lexSources(batch, jobs);
+		if (lexes.size() != batch.size())
+			return false;
+
+		for (std::size_t i = 0; i < batch.size(); ++i)
+		{
+			if (lexes[i].getSource() != batch[i] || lexes[i].getRoot().getSpan().length() != inputs[i].size())
+				return false;
+			if (!sameLexes(lexes[i], lexer.lexSource(batch[i])))
+				return false;
+		}
+	}
+	return lexer.lexSources({}).empty();
+}
+
+// Counts blocks borrowed off the thread that created the source
+class MatcherThreadCheckSource final : public CommonLexer::StringSource
+{
+public:
+	using CommonLexer::StringSource::StringSource;
+
+	virtual CommonLexer::SourceBlock getBlock(std::size_t index) override
+	{
+		if (std::this_thread::get_id() != m_Owner)
+			++m_ForeignLoads;
+		return CommonLexer::StringSource::getBlock(index);
+	}
+
+public:
+	std::thread::id          m_Owner        = std::this_thread::get_id();
+	std::atomic<std::size_t> m_ForeignLoads = 0;
+};
+
+static bool testSplitLex([[maybe_unused]] Tester& tester)
+{
+	const CMakeLexer::Lexer lexer;
+
+	// Newlines inside parentheses, brackets, quotes and comments are no boundaries, a '(' inside an unquoted argument opens nothing
+	std::string tricky = "a(b)\n"
+	                     "c([[\n)\n]] \"(\n\" # (\n)\n"
+	                     "#[=[\n(\n]=]\n"
+	                     "d(\\()\n"
+	                     "f(x a(b)\n";
+	auto boundaries = CMakeLexer::Lexer::findCommandBoundaries(tricky);
+	if (boundaries != std::vector<std::size_t> { 5, 26, 37, 43, 52 })
+		return false;
+
+	auto sameSplit = [&](const std::string& input, std::size_t jobs) {
+		CommonLexer::StringSource source(input);
+		auto                      serial = lexer.lexSource(&source);
+		auto                      split  = lexer.lexSourceSplit(&source, CMakeLexer::Lexer::findCommandBoundaries(input), jobs);
+		auto&                     lhs    = serial.getFarthestFailure();
+		auto&                     rhs    = split.getFarthestFailure();
+		return sameLexes(serial, split) && lhs.has_value() == rhs.has_value() && (!lhs || lhs->getPoint().m_Index == rhs->getPoint().m_Index);
+	};
+
+	// Attempts at the end of a chunk read on into the next one, the farthest failure comes from there like in the serial lex
+	if (!sameSplit("foo(\n\\y(a b)\n\n#[[c]]\n", 1) || !sameSplit("a(b)\nc(d)\n", 1))
+		return false;
+
+	std::string               input = readFile("LexInput.cmake") + tricky;
+	CommonLexer::StringSource inputSource(input);
+	if (lexer.lexSource(&inputSource).getRoot().getSpan().length() != input.size() || !sameSplit(input, 4) || !sameSplit(input, 1))
+		return false;
+
+	// A chunk that stops short hands the whole source to the serial lex, so the error stays where it was
+	std::string broken = input + "e(\"\n" + input;
+	if (!sameSplit(broken, 4))
+		return false;
+
+	std::string large;
+	while (large.size() < 8 * CMakeLexer::Lexer::s_MinChunkSize)
+		large += input;
+	// Chunks share the source, so its block has to be borrowed before they start
+	MatcherThreadCheckSource source(large);
+	auto                     parallel = lexer.lexSourceParallel(&source, 4);
+	return parallel.getRoot().getSpan().length() == large.size() && source.m_ForeignLoads == 0 && sameLexes(parallel, lexer.lexSource(&source));
+}
+
+static void collectSpans(const CommonLexer::Node& node, std::string_view rule, std::vector<CommonLexer::SourceSpan>& spans)
+{
+	if (node.getRule() == rule)
+		spans.push_back(node.getSpan());
+	for (auto& child : node.getChildren())
+		collectSpans(child, rule, spans);
+}
+
+static bool testBracketArgument([[maybe_unused]] Tester& tester)
+{
+	// A ']' followed by the bracket count but no second ']' stays in the content
+	std::string input = "message([=[ a ]=x ]=])\n"
+	                    "message([[ b ]x ]] [==[ ]=] ]==])\n";
+
+	CommonLexer::LexerLexer   lexerLexer;
+	CommonLexer::StringSource grammarSource(readFile("../../CMakeInterpreter/Src/Lex.txt"));
+	auto                      grammarLex   = lexerLexer.lexSource(&grammarSource);
+	auto                      grammarLexer = lexerLexer.createLexer(grammarLex, { { "UnquotedLegacy", &CMakeLexer::Lexer::unquotedLegacyCallback } });
+	if (!grammarLexer.m_Messages.empty())
+		return false;
+
+	CommonLexer::StringSource source(input);
+	const CMakeLexer::Lexer   lexer;
+	auto                      lex = lexer.lexSource(&source);
+	if (!lex.getMessages().empty() || lex.getRoot().getSpan().length() != input.size() || !sameNodes(lex.getRoot(), grammarLexer.m_Lexer.lexSource(&source).getRoot()))
+		return false;
+
+	std::vector<CommonLexer::SourceSpan> spans;
+	collectSpans(lex.getRoot(), "BracketArgument", spans);
+	if (spans.size() != 3 ||
+	    input.substr(spans[0].m_Begin.m_Index, spans[0].length()) != "[=[ a ]=x ]=]" ||
+	    input.substr(spans[1].m_Begin.m_Index, spans[1].length()) != "[[ b ]x ]]" ||
+	    input.substr(spans[2].m_Begin.m_Index, spans[2].length()) != "[==[ ]=] ]==]")
+		return false;
+	return CMakeLexer::Lexer::findCommandBoundaries(input) == std::vector<std::size_t> { 23, 57 };
+}
+
+static bool sameRestartPoints(const CommonLexer::Lex& lhs, const CommonLexer::Lex& rhs)
+{
+	auto& lhsPoints = lhs.getRestartPoints();
+	auto& rhsPoints = rhs.getRestartPoints();
+	if (lhsPoints.size() != rhsPoints.size())
+		return false;
+	for (std::size_t i = 0; i < lhsPoints.size(); ++i)
+		if (lhsPoints[i].m_Index != rhsPoints[i].m_Index || lhsPoints[i].m_Nodes != rhsPoints[i].m_Nodes)
+			return false;
+	return true;
+}
+
+static bool testRelex([[maybe_unused]] Tester& tester)
+{
+	const CMakeLexer::Lexer lexer;
+
+	std::string input = readFile("LexInput.cmake");
+	std::string text;
+	for (std::size_t i = 0; i < 8; ++i)
+		text += input;
+	CommonLexer::EditableSource source(text);
+
+	std::vector<CommonLexer::SourceEdit> edits;
+	source.setChangeCallback([&edits](const CommonLexer::SourceEdit& edit) { edits.push_back(edit); });
+
+	std::uint32_t seed = 4321;
+	auto          next = [&seed]() {
+		seed = seed * 1664525U + 1013904223U;
+		return seed >> 8;
+	};
+
+	// Whole lines come and go, which keeps the source lexing, and now and then a '(' breaks it until the next edit takes it out again
+	auto        lex    = lexer.lexSource(&source);
+	std::size_t broken = 0;
+	std::size_t paren  = ~0ULL;
+	for (std::size_t i = 0; i < 200; ++i)
+	{
+		std::size_t index     = next() % (text.size() + 1);
+		std::size_t lineBegin = index == 0 ? 0 : text.rfind('\n', index - 1) + 1;
+		if (paren != ~0ULL)
+		{
+			source.erase(paren, 1);
+			text.erase(paren, 1);
+			paren = ~0ULL;
+		}
+		else
+		{
+			switch (next() % 4)
+			{
+			case 0:
+				source.insert(lineBegin, "set(A b)\n");
+				text.insert(lineBegin, "set(A b)\n");
+				break;
+			case 1:
+			{
+				std::size_t lineEnd = text.find('\n', lineBegin);
+				if (lineEnd != std::string::npos && text.find('(', lineBegin) < lineEnd && text.find(')', lineBegin) < lineEnd)
+				{
+					source.erase(lineBegin, lineEnd + 1 - lineBegin);
+					text.erase(lineBegin, lineEnd + 1 - lineBegin);
+				}
+				break;
+			}
+			case 2:
+				if (index < text.size() && std::isalpha(static_cast<unsigned char>(text[index])))
+				{
+					source.erase(index, 1);
+					source.insert(index, "y");
+					text[index] = 'y';
+				}
+				break;
+			case 3:
+				source.insert(index, "(");
+				text.insert(index, "(");
+				paren = index;
+				break;
+			}
+		}
+
+		auto relexed  = lexer.relexSource(std::move(lex), edits);
+		auto expected = lexer.lexSource(&source);
+		edits.clear();
+		if (!sameLexes(relexed, expected) || !sameRestartPoints(relexed, expected) || relexed.getRoot().getSpan().length() != expected.getRoot().getSpan().length())
+			return false;
+
+		auto& lhs = relexed.getFarthestFailure();
+		auto& rhs = expected.getFarthestFailure();
+		if (lhs && lhs->getPoint().m_Index != rhs->getPoint().m_Index)
+			return false;
+
+		broken += expected.getRoot().getSpan().length() != source.getSize();
+		lex = std::move(relexed);
+	}
+	return broken > 0 && broken < 200;
+}
+
+static bool sameTree(const CommonLexer::Node& node, CommonLexer::NodeRef ref)
+{
+	auto& children = node.getChildren();
+	if (!ref || ref.getRuleID() != node.getRuleID() || ref.getRule() != node.getRule() || ref.getSpan().m_Begin.m_Index != node.getSpan().m_Begin.m_Index || ref.getSpan().m_End.m_Index != node.getSpan().m_End.m_Index || ref.getChildCount() != children.size())
+		return false;
+
+	std::size_t i = 0;
+	for (auto child : ref.getChildren())
+	{
+		if (child != ref.getChild(i) || !sameTree(children[i], child))
+			return false;
+		++i;
+	}
+	return i == children.size() && !ref.getChild(i);
+}
+
+static bool testNodeArena([[maybe_unused]] Tester& tester)
+{
+	const CMakeLexer::Lexer lexer;
+
+	CommonLexer::StringSource source(readFile("LexInput.cmake"));
+	auto                      lex = lexer.lexSource(&source);
+
+	// Depth first order puts the root first and every first child right after its parent
+	CommonLexer::NodeArena arena(lex.getRoot());
+	auto                   root = arena.getRoot();
+	if (arena.size() < 2 || root.getIndex() != 0 || root.getNextSibling() || root.getFirstChild().getIndex() != 1 || arena.getMemoryUsage() == 0)
+		return false;
+
+	CommonLexer::NodeArena empty;
+	return sameTree(lex.getRoot(), root) && !empty.getRoot() && empty.getMemoryUsage() == 0;
+}
+
+static bool testLexCache([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	const CMakeLexer::Lexer lexer;
+
+	std::error_code error;
+	auto            directory = std::filesystem::temp_directory_path() / "MMakeLexCacheTest";
+	std::filesystem::remove_all(directory, error);
+	LexCache cache(directory);
+
+	// The broken file has messages and a farthest failure to keep as well
+	for (auto text : { readFile("LexInput.cmake"), std::string { "a(b)\ne(\"\n" } })
+	{
+		StringSource source(text);
+		if (cache.load(lexer, &source))
+			return false;
+
+		auto lex    = cache.lexSource(lexer, &source);
+		auto loaded = cache.load(lexer, &source);
+		if (!loaded || !sameLexes(lex, *loaded) || !sameRestartPoints(lex, *loaded) || !std::filesystem::exists(cache.getPath(LexCache::hashSource(&source), lexer.getGrammarHash())))
+			return false;
+
+		// Another source or grammar hashes to another file
+		StringSource      edited(text + "\n");
+		CMakeLexer::Lexer otherGrammar;
+		otherGrammar.setGrammarHash(lexer.getGrammarHash() + 1);
+		if (cache.load(lexer, &edited) || cache.load(otherGrammar, &source))
+			return false;
+
+		// Damaged data must never load as anything but a lex of the source
+		auto data = LexCache::serialize(lex);
+		for (std::size_t size = 0; size < data.size(); size += 1 + size / 8)
+			if (LexCache::deserialize(lexer, &source, std::string_view { data }.substr(0, size)))
+				return false;
+		std::mt19937 random(29);
+		for (std::size_t i = 0; i < 500; ++i)
+		{
+			auto damaged = data;
+			damaged[random() % damaged.size()] ^= static_cast<char>(1 << (random() % 8));
+			if (auto damagedLex = LexCache::deserialize(lexer, &source, damaged); damagedLex && damagedLex->getRoot().getSpan().m_End.m_Index > source.getSize())
+				return false;
+		}
+	}
+
+	// Lexers without a grammar hash aren't cached
+	auto         listLexer = makeListLexer();
+	StringSource listSource("(a 1)");
+	if (listLexer.getGrammarHash() != 0 || cache.store(listLexer.lexSource(&listSource)))
+		return false;
+	std::filesystem::remove_all(directory, error);
+
+	// Registering another rule leaves the hash stale, so it is cleared until the grammar is hashed again
+	listLexer.hashGrammar();
+	if (listLexer.getGrammarHash() == 0)
+		return false;
+	listLexer.registerRule(MatcherRule { "Other", TextMatcher("!") });
+	if (listLexer.getGrammarHash() != 0)
+		return false;
+
+	// The hash is made of the matchers, so bounds and regexes count and callbacks by their version
+	auto hashLexer = [](const std::string& regex, std::size_t upperBounds, std::uint64_t callbackVersion)
+	{
+		Lexer lexer;
+		lexer.setMainRule("File");
+		lexer.registerRule(MatcherRule { "File", RangeMatcher(ReferenceMatcher("Word"), 0, upperBounds), false });
+		lexer.registerRule(MatcherRule { "Word", RegexMatcher(regex) });
+		CallbackRule callback { "Callback", &CMakeLexer::Lexer::unquotedLegacyCallback };
+		callback.setCallbackVersion(callbackVersion);
+		lexer.registerRule(std::move(callback));
+		lexer.hashGrammar();
+		return lexer.getGrammarHash();
+	};
+	auto wordHash = hashLexer("[a-z]+", ~0ULL, 0);
+	if (wordHash == 0 || wordHash != hashLexer("[a-z]+", ~0ULL, 0) || wordHash == hashLexer("[a-y]+", ~0ULL, 0) || wordHash == hashLexer("[a-z]+", 4, 0) || wordHash == hashLexer("[a-z]+", ~0ULL, 1))
+		return false;
+	if (CMakeLexer::Lexer {}.getGrammarHash() != lexer.getGrammarHash())
+		return false;
+
+	// Grammars hash their rules, so the same grammar gets the same hash and any change to it another one
+	LexerLexer   lexerLexer;
+	std::string  grammar = readFile("../../CMakeInterpreter/Src/Lex.txt");
+	std::string  changed = grammar;
+	StringSource grammarSource(grammar), changedSource(changed.replace(changed.find("'[ \\t]+'"), 8, "'[ \\t]*'"));
+	auto         grammarLex = lexerLexer.lexSource(&grammarSource);
+	auto         changedLex = lexerLexer.lexSource(&changedSource);
+	auto         hash       = lexerLexer.createLexer(grammarLex).m_Lexer.getGrammarHash();
+	return hash != 0 && hash == lexerLexer.createLexer(grammarLex).m_Lexer.getGrammarHash() && hash != lexerLexer.createLexer(changedLex).m_Lexer.getGrammarHash();
+}
+
+struct MatcherTestsRegister
+{
+	MatcherTestsRegister()
+	{
+		auto& tester = Tester::Get();
+		tester.addTest("CommonLexer", "FirstSets", &testFirstSets);
+		tester.addTest("CommonLexer", "FirstSetDispatch", &testFirstSetDispatch);
+		tester.addTest("CommonLexer", "DeferredMessages", &testDeferredMessages);
+		tester.addTest("CommonLexer", "FarthestFailure", &testFarthestFailure);
+		tester.addTest("CommonLexer", "SpeculativeRollback", &testSpeculativeRollback);
+		tester.addTest("CommonLexer", "Memoize", &testMemoize);
+		tester.addTest("CommonLexer", "MemoizeNamedGroups", &testMemoizeNamedGroups);
+		tester.addTest("CommonLexer", "LiteralSet", &testLiteralSet);
+		tester.addTest("CommonLexer", "LiteralSetLongestMatch", &testLiteralSetLongestMatch);
+		tester.addTest("CommonLexer", "CharRun", &testCharRun);
+		tester.addTest("CommonLexer", "GrammarOptimize", &testGrammarOptimize);
+		tester.addTest("CommonLexer", "OrderedChoice", &testOrderedChoice);
+		tester.addTest("CommonLexer", "RuleIDs", &testRuleIDs);
+		tester.addTest("CommonLexer", "Link", &testLink);
+		tester.addTest("CommonLexer", "ConcurrentLex", &testConcurrentLex);
+		tester.addTest("CommonLexer", "LexSources", &testLexSources);
+		tester.addTest("CommonLexer", "SplitLex", &testSplitLex);
+		tester.addTest("CommonLexer", "BracketArgument", &testBracketArgument);
+		tester.addTest("CommonLexer", "Relex", &testRelex);
+		tester.addTest("CommonLexer", "NodeArena", &testNodeArena);
+		tester.addTest("CommonLexer", "LexCache", &testLexCache);
+	}
+};
+[[maybe_unused]] MatcherTestsRegister matcherTestsRegister;
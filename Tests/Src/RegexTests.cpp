@@ -0,0 +1,182 @@
+#include "Test.h"
+
+#include <CommonLexer/Regex.h>
+#include <CommonLexer/Source.h>
+
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+
+static std::size_t matchStdRegex(const std::regex& regex, std::string_view str)
+{
+	std::cmatch results;
+	if (!std::regex_search(str.data(), str.data() + str.size(), results, regex, std::regex_constants::match_continuous))
+		return CommonLexer::Regex::s_NoMatch;
+	return static_cast<std::size_t>(results[0].second - str.data());
+}
+
+// Matches random strings from alphabet against both engines, the automaton must agree with std::regex on every one
+static bool compareWithStdRegex(const std::string& pattern, std::string_view alphabet)
+{
+	CommonLexer::Regex regex(pattern);
+	if (!regex.isValid() || regex.isFallback())
+		return false;
+
+	std::regex   expected(pattern, std::regex_constants::ECMAScript);
+	std::mt19937 random(static_cast<std::uint32_t>(pattern.size()));
+	for (std::size_t i = 0; i < 2000; ++i)
+	{
+		std::string str(random() % 16, '\0');
+		for (auto& c : str)
+			c = alphabet[random() % alphabet.size()];
+
+		if (regex.match(str) != matchStdRegex(expected, str))
+			return false;
+	}
+	return true;
+}
+
+static bool testRegexMatches([[maybe_unused]] Tester& tester)
+{
+	struct Case
+	{
+		std::string      m_Pattern;
+		std::string_view m_Alphabet;
+	};
+
+	Case cases[] {
+		{ "abc", "abc" },
+		{ "a|ab|abc", "abc" },
+		{ "(a|ab)(c|bcd)", "abcd" },
+		{ "(?:ab|a)*b", "ab" },
+		{ "a*?b", "ab" },
+		{ "a+?", "ab" },
+		{ "a??b", "ab" },
+		{ "(?:a|b)*?c", "abc" },
+		{ "a{2,3}", "ab" },
+		{ "a{2,}?b", "ab" },
+		{ "(?:ab){2}", "ab" },
+		{ "[a-c]+[^a-c]", "abcde" },
+		{ "[^]x", "ax\n" },
+		{ "[]a]", "a]" },
+		{ "[a-]+", "ab-" },
+		{ "\\d+\\.\\d*", "12.a" },
+		{ "\\s*\\w+\\S", " a_!\t\n" },
+		{ "[\\b]", "\b" },
+		{ "\\x41\\u0042", "ABC" },
+		{ ".*", { "a\n\r\0x", 5 } },
+		{ "a|", "ab" },
+		{ "|a", "ab" },
+		{ "(?:)a", "ab" },
+		{ "ab(?=c)", "abc" },
+		{ "ab(?!c)", "abc" },
+		{ "(?!ab)[a-c]+", "abc" },
+		{ "a(?=b|c)(?:bc|b)", "abc" },
+		{ "#.*", "#a\n" },
+		{ "[A-Za-z_][A-Za-z0-9_]*", "aZ_0-" },
+		{ "\"(?:[^\"\\\\\n]|\\.|\\\\.)*\"", "\"a\\.\n" },
+		{ "(?:[^\\s()#\"\\\\]|\\\\.)+", "a\\ (#\"" },
+		{ "[0-9]+(?:[eE][+-]?[0-9]+)?", "12e+-E" }
+	};
+
+	for (auto& testCase : cases)
+		if (!compareWithStdRegex(testCase.m_Pattern, testCase.m_Alphabet))
+			return false;
+	return true;
+}
+
+// Hides the contiguous buffer so matching has to go through SourceIterator
+class RegexWindowedSource final : public CommonLexer::StringSource
+{
+public:
+	using CommonLexer::StringSource::StringSource;
+
+	virtual std::optional<std::string_view> data() override { return std::nullopt; }
+};
+
+static bool testRegexSource([[maybe_unused]] Tester& tester)
+{
+	RegexWindowedSource source("abcabc123");
+	auto                regex = CommonLexer::Regex::Get("(?:abc)+(?=1)");
+	if (regex->match(&source, { { 0 }, { 9 } }) != 6)
+		return false;
+	if (regex->match(&source, { { 3 }, { 9 } }) != 3)
+		return false;
+	return regex->match(&source, { { 1 }, { 9 } }) == CommonLexer::Regex::s_NoMatch;
+}
+
+static bool testRegexFallback([[maybe_unused]] Tester& tester)
+{
+	const char* fallbacks[] { "^a", "a$", "\\bword", "(a)\\1", "(?:a(?=b))+", "a*(?=b)", "a**", "(?:b?\?)*" };
+	for (auto pattern : fallbacks)
+	{
+		CommonLexer::Regex regex(pattern);
+		if (!regex.isValid() || !regex.isFallback() || regex.getUnsupported().empty())
+			return false;
+	}
+
+	if (CommonLexer::Regex("(a)\\1").match("aa") != 2)
+		return false;
+
+	const char* invalids[] { "(a", "a)", "[b-a]", "[\\s-x]", "*a", "a{2", "x{2,1}", "\\x4", "a\\" };
+	for (auto pattern : invalids)
+	{
+		CommonLexer::Regex regex(pattern);
+		if (regex.isValid() || regex.isFallback() || regex.match("a") != CommonLexer::Regex::s_NoMatch)
+			return false;
+	}
+	return true;
+}
+
+static bool testRegexSharing([[maybe_unused]] Tester& tester)
+{
+	auto first  = CommonLexer::Regex::Get("[a-z]+");
+	auto second = CommonLexer::Regex::Get("[a-z]+");
+	auto other  = CommonLexer::Regex::Get("[a-z]*");
+	return first == second && first != other && first->getNumStates() == 3;
+}
+
+static bool testRegexCharRun([[maybe_unused]] Tester& tester)
+{
+	auto spaces = CommonLexer::Regex("[ \t]+").getCharRun();
+	if (!spaces || spaces->m_Optional || spaces->m_First != spaces->m_Rest || spaces->m_First.count() != 2)
+		return false;
+
+	auto identifier = CommonLexer::Regex("[A-Za-z_][A-Za-z0-9_]*").getCharRun();
+	if (!identifier || identifier->m_Optional || identifier->m_First.count() != 53 || identifier->m_Rest.count() != 63)
+		return false;
+
+	auto bracket = CommonLexer::Regex("[^\\]]").getCharRun();
+	if (!bracket || bracket->m_Optional || bracket->m_First.count() != 255 || bracket->m_Rest.any())
+		return false;
+
+	auto equals = CommonLexer::Regex("=*").getCharRun();
+	if (!equals || !equals->m_Optional || equals->m_First.count() != 1 || equals->m_First != equals->m_Rest)
+		return false;
+
+	// Lazy runs stop after the first byte
+	auto lazy = CommonLexer::Regex("a+?").getCharRun();
+	if (!lazy || lazy->m_Rest.any())
+		return false;
+
+	const char* others[] { "ab", "a|bc", "(?:ab)+", "a*b", "a(?=b)", "a?", "(a)\\1" };
+	for (auto pattern : others)
+		if (CommonLexer::Regex(pattern).getCharRun())
+			return false;
+	return true;
+}
+
+struct RegexTestsRegister
+{
+	RegexTestsRegister()
+	{
+		auto& tester = Tester::Get();
+		tester.addTest("CommonLexer", "RegexMatches", &testRegexMatches);
+		tester.addTest("CommonLexer", "RegexSource", &testRegexSource);
+		tester.addTest("CommonLexer", "RegexFallback", &testRegexFallback);
+		tester.addTest("CommonLexer", "RegexSharing", &testRegexSharing);
+		tester.addTest("CommonLexer", "RegexCharRun", &testRegexCharRun);
+	}
+};
+[[maybe_unused]] RegexTestsRegister regexTestsRegister;
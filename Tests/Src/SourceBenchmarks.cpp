@@ -0,0 +1,791 @@
+#include "FileIO.h"
+#include "Test.h"
+
+#include <CMakeLexer/Lexer.h>
+#include <CommonLexer/EditableSource.h>
+#include <CommonLexer/LexCache.h>
+#include <CommonLexer/Lexer.h>
+#include <CommonLexer/LexerLexer.h>
+#include <CommonLexer/LineTable.h>
+#include <CommonLexer/Matchers.h>
+#include <CommonLexer/NodeArena.h>
+#include <CommonLexer/Regex.h>
+#include <CommonLexer/SIMD.h>
+#include <CommonLexer/UTF8.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <regex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+// Hides the contiguous buffer so matchers have to go through the windowed getSpan path
+class WindowedSource final : public CommonLexer::StringSource
+{
+public:
+	using CommonLexer::StringSource::StringSource;
+
+	virtual std::optional<std::string_view> data() override { return std::nullopt; }
+};
+
+static std::string makeInput(std::size_t minSize)
+{
+	std::string input = readFile("LexInput.cmake");
+	if (input.empty())
+		return {};
+
+	std::string str;
+	str.reserve(minSize + input.size());
+	while (str.size() < minSize)
+		str += input;
+	return str;
+}
+
+static CommonLexer::Lexer makeTokenLexer()
+{
+	using namespace CommonLexer;
+
+	Lexer lexer;
+	lexer.setMainRule("File");
+	lexer.registerRule(MatcherRule { "File", RangeMatcher(ReferenceMatcher("Token")), false });
+	lexer.registerRule(MatcherRule {
+	    "Token",
+	    OrMatcher(Tuple {
+	        ReferenceMatcher("Space"),
+	        ReferenceMatcher("Newline"),
+	        ReferenceMatcher("LineComment"),
+	        ReferenceMatcher("Paren"),
+	        ReferenceMatcher("QuotedArgument"),
+	        ReferenceMatcher("UnquotedArgument") }),
+	    false });
+	lexer.registerRule(MatcherRule { "Space", RegexMatcher("[ \t]+") });
+	lexer.registerRule(MatcherRule { "Newline", TextMatcher("\n") });
+	lexer.registerRule(MatcherRule { "LineComment", RegexMatcher("#.*") });
+	lexer.registerRule(MatcherRule { "Paren", OrMatcher(Tuple { TextMatcher("("), TextMatcher(")") }) });
+	lexer.registerRule(MatcherRule { "QuotedArgument", RegexMatcher("\"(?:[^\"\\\\]|\\\\.)*\"") });
+	lexer.registerRule(MatcherRule { "UnquotedArgument", RegexMatcher("(?:[^\\s()#\"\\\\]|\\\\.)+") });
+	return lexer;
+}
+
+template <class Source>
+static bool benchLexSource(std::string_view name, CommonLexer::Lexer& lexer, const std::string& input, std::size_t& nodes)
+{
+	Source source { input };
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	auto lex   = lexer.lexSource(&source);
+	auto end   = std::chrono::high_resolution_clock::now();
+
+	double seconds = std::chrono::duration<double>(end - begin).count();
+	std::cout << fmt::format("{}: {} bytes in {:.3f} ms, {:.2f} MB/s\n", name, input.size(), seconds * 1e3, (input.size() / 1e6) / seconds);
+
+	nodes = lex.getRoot().getChildren().size();
+	return lex.getRoot().getSpan().length() == input.size();
+}
+
+static bool benchContiguousSource([[maybe_unused]] Tester& tester)
+{
+	auto input = makeInput(256 * 1024);
+	if (input.empty())
+		return false;
+
+	auto lexer = makeTokenLexer();
+
+	std::size_t windowedNodes = 0, contiguousNodes = 0;
+	if (!benchLexSource<WindowedSource>("Windowed", lexer, input, windowedNodes))
+		return false;
+	if (!benchLexSource<CommonLexer::StringSource>("Contiguous", lexer, input, contiguousNodes))
+		return false;
+	return windowedNodes == contiguousNodes;
+}
+
+static bool benchLineTable([[maybe_unused]] Tester& tester)
+{
+	auto input = makeInput(16 * 1024 * 1024);
+	if (input.empty())
+		return false;
+
+	CommonLexer::LineTable lines;
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	lines.build(input);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	double seconds = std::chrono::duration<double>(end - begin).count();
+	std::cout << fmt::format("LineTable build ({}): {} bytes, {} lines in {:.3f} ms, {:.2f} MB/s\n", CommonLexer::SIMD::HasAVX2() ? "AVX2" : "SSE2/scalar", input.size(), lines.getNumLines(), seconds * 1e3, (input.size() / 1e6) / seconds);
+
+	std::size_t expectedLine = 1, expectedColumn = 1, lookups = 0;
+	begin = std::chrono::high_resolution_clock::now();
+	for (std::size_t i = 0; i < input.size(); ++i)
+	{
+		if (i % 61 == 0)
+		{
+			if (lines.getLineNumberFromIndex(i) != expectedLine || lines.getColumnNumberFromIndex(i) != expectedColumn)
+				return false;
+			++lookups;
+		}
+
+		if (input[i] == '\n')
+		{
+			++expectedLine;
+			expectedColumn = 1;
+		}
+		else
+		{
+			++expectedColumn;
+		}
+	}
+	end = std::chrono::high_resolution_clock::now();
+
+	seconds = std::chrono::duration<double>(end - begin).count();
+	std::cout << fmt::format("LineTable lookup: {} line and column lookups in {:.3f} ms\n", lookups, seconds * 1e3);
+	return lines.getNumLines() == expectedLine;
+}
+
+static bool benchUTF8([[maybe_unused]] Tester& tester)
+{
+	// Box drawing characters in every line keep the whole input out of the ASCII fast path
+	auto ascii = makeInput(16 * 1024 * 1024);
+	if (ascii.empty())
+		return false;
+
+	std::string input;
+	input.reserve(ascii.size() * 2);
+	for (char c : ascii)
+	{
+		if (c == '\n')
+			input += "\xE2\x94\x9C";
+		input += c;
+	}
+
+	auto        begin   = std::chrono::high_resolution_clock::now();
+	std::size_t invalid = CommonLexer::UTF8::Validate(input);
+	auto        end     = std::chrono::high_resolution_clock::now();
+
+	double seconds = std::chrono::duration<double>(end - begin).count();
+	std::cout << fmt::format("UTF8 validate ({}): {} bytes in {:.3f} ms, {:.2f} MB/s\n", CommonLexer::SIMD::HasAVX2() ? "AVX2" : "SSE2/scalar", input.size(), seconds * 1e3, (input.size() / 1e6) / seconds);
+
+	CommonLexer::LineTable lines;
+
+	begin = std::chrono::high_resolution_clock::now();
+	lines.build(input);
+	end = std::chrono::high_resolution_clock::now();
+
+	seconds = std::chrono::duration<double>(end - begin).count();
+	std::cout << fmt::format("LineTable build with codepoints: {} bytes in {:.3f} ms, {:.2f} MB/s\n", input.size(), seconds * 1e3, (input.size() / 1e6) / seconds);
+	return invalid == input.size() && lines.getCodepoints().isValid() && lines.getColumnNumberFromIndex(input.find('\n')) == input.find('\n') - 1;
+}
+
+static void collectRegexPatterns(CommonLexer::ISource* source, const CommonLexer::Node& node, std::set<std::string>& patterns)
+{
+	if (node.getRule() == "RegexMatcher")
+		patterns.insert(CommonLexer::UnescapeText(source->getSpan(node.getSpan())));
+	for (auto& child : node.getChildren())
+		collectRegexPatterns(source, child, patterns);
+}
+
+static bool benchRegex([[maybe_unused]] Tester& tester)
+{
+	CommonLexer::LexerLexer lexerLexer;
+
+	std::set<std::string> patterns;
+	for (auto grammar : { "../../CMakeInterpreter/Src/Lex.txt", "../../CMakeInterpreter/Src/LexerLex.txt", "../../CMakeInterpreter/Src/cpp20Lex.txt" })
+	{
+		CommonLexer::StringSource source(readFile(grammar));
+		auto                      lex = lexerLexer.lexSource(&source);
+		collectRegexPatterns(&source, lex.getRoot(), patterns);
+	}
+
+	std::string      text  = makeInput(16 * 1024);
+	std::string_view input = text;
+	if (patterns.empty() || input.empty())
+		return false;
+
+	double      dfaSeconds = 0.0, stdSeconds = 0.0;
+	std::size_t compiled = 0, fallbacks = 0, invalids = 0, states = 0, calls = 0;
+	for (auto& pattern : patterns)
+	{
+		auto regex = CommonLexer::Regex::Get(pattern);
+		if (!regex->isValid())
+		{
+			std::cout << fmt::format("Regex invalid ({}): '{}'\n", regex->getError(), pattern);
+			++invalids;
+			continue;
+		}
+		if (regex->isFallback())
+		{
+			std::cout << fmt::format("Regex fallback ({}): '{}'\n", regex->getUnsupported(), pattern);
+			++fallbacks;
+			continue;
+		}
+		++compiled;
+		states += regex->getNumStates();
+
+		std::regex expected(pattern, std::regex_constants::ECMAScript | std::regex_constants::optimize);
+
+		std::size_t dfaTotal = 0, stdTotal = 0;
+
+		auto begin = std::chrono::high_resolution_clock::now();
+		for (std::size_t i = 0; i < input.size(); ++i)
+			dfaTotal += regex->match(input.substr(i));
+		auto end = std::chrono::high_resolution_clock::now();
+		dfaSeconds += std::chrono::duration<double>(end - begin).count();
+
+		begin = std::chrono::high_resolution_clock::now();
+		for (std::size_t i = 0; i < input.size(); ++i)
+		{
+			std::cmatch results;
+			if (std::regex_search(input.data() + i, input.data() + input.size(), results, expected, std::regex_constants::match_continuous))
+				stdTotal += static_cast<std::size_t>(results[0].second - (input.data() + i));
+			else
+				stdTotal += CommonLexer::Regex::s_NoMatch;
+		}
+		end = std::chrono::high_resolution_clock::now();
+		stdSeconds += std::chrono::duration<double>(end - begin).count();
+
+		calls += input.size();
+		if (dfaTotal != stdTotal)
+		{
+			std::cout << fmt::format("Regex mismatch: '{}'\n", pattern);
+			return false;
+		}
+	}
+
+	std::cout << fmt::format("Regex: {} patterns, {} compiled with {} states, {} fallbacks, {} invalid\n", patterns.size(), compiled, states, fallbacks, invalids);
+	std::cout << fmt::format("Regex DFA: {} matches in {:.3f} ms, std::regex: {:.3f} ms, {:.1f}x\n", calls, dfaSeconds * 1e3, stdSeconds * 1e3, stdSeconds / dfaSeconds);
+	return true;
+}
+
+static CommonLexer::LexerLexerResult makeNestingLexer(bool memoize)
+{
+	std::string grammar = "!MainRule = Expression;\n";
+	grammar += memoize ? "!Memoize = true;\n" : "";
+	grammar += "Expression?: Sum; Atom;\n"
+	           "Sum:         Atom \"+\" Expression;\n"
+	           "Atom:        \"(\" Expression \")\";\n"
+	           "             Identifier;\n"
+	           "Identifier:  '[a-z]+';\n";
+
+	CommonLexer::LexerLexer   lexerLexer;
+	CommonLexer::StringSource source(std::move(grammar));
+	auto                      lex = lexerLexer.lexSource(&source);
+	return lexerLexer.createLexer(lex);
+}
+
+static bool benchMemoize([[maybe_unused]] Tester& tester)
+{
+	std::size_t               depth = 16;
+	CommonLexer::StringSource source(std::string(depth, '(') + "a+b" + std::string(depth, ')'));
+
+	double seconds[2] {};
+	for (bool memoize : { false, true })
+	{
+		auto result = makeNestingLexer(memoize);
+
+		auto begin = std::chrono::high_resolution_clock::now();
+		auto lex   = result.m_Lexer.lexSource(&source);
+		auto end   = std::chrono::high_resolution_clock::now();
+		if (lex.getRoot().getSpan().length() != source.getSize())
+			return false;
+
+		seconds[memoize] = std::chrono::duration<double>(end - begin).count();
+		if (!memoize)
+			continue;
+
+		auto& stats = lex.getMemoStats();
+		std::cout << fmt::format("Memo: {} hits, {} misses, {:.1f}% hit rate, {} bytes stored, {} bytes peak\n", stats.m_Hits, stats.m_Misses, stats.getHitRate() * 100.0, stats.m_Bytes, stats.m_PeakBytes);
+		for (auto& ruleStats : lex.getRuleMemoStats())
+			std::cout << fmt::format("Memo {}: {} hits, {} misses, {:.1f}% hit rate, {} bytes\n", ruleStats.m_Rule, ruleStats.m_Hits, ruleStats.m_Misses, ruleStats.getHitRate() * 100.0, ruleStats.m_Bytes);
+	}
+
+	std::cout << fmt::format("Memoize: nesting depth {} in {:.3f} ms, without: {:.3f} ms, {:.1f}x\n", depth, seconds[1] * 1e3, seconds[0] * 1e3, seconds[0] / seconds[1]);
+	return true;
+}
+
+static bool benchLiteralSet([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	std::vector<std::string> keywords { "alignas", "alignof", "asm", "auto", "bool", "break", "case", "catch", "char", "char8_t", "char16_t", "char32_t", "class", "concept", "const", "consteval", "constexpr", "constinit", "const_cast", "continue", "co_await", "co_return", "co_yield", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "nullptr", "operator", "private", "protected", "public", "register", "reinterpret_cast", "requires", "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while" };
+
+	std::string input;
+	for (std::size_t i = 0; input.size() < 256 * 1024; ++i)
+		input += keywords[(i * 7919) % keywords.size()] + ' ';
+
+	double      seconds[2] {};
+	std::size_t nodes[2] {};
+	for (bool literalSet : { false, true })
+	{
+		Lexer lexer;
+		lexer.setMainRule("File");
+		lexer.registerRule(MatcherRule { "File", RangeMatcher(SpaceMatcher(ReferenceMatcher("Keyword"))), false });
+		if (literalSet)
+		{
+			lexer.registerRule(MatcherRule { "Keyword", LiteralSetMatcher(std::vector<std::string> { keywords }) });
+		}
+		else
+		{
+			std::vector<std::unique_ptr<IMatcher>> matchers;
+			for (auto& keyword : keywords)
+				matchers.push_back(std::make_unique<TextMatcher>(keyword));
+			lexer.registerRule(MatcherRule { "Keyword", OrMatcher(std::move(matchers)) });
+		}
+
+		StringSource source { input };
+
+		auto begin = std::chrono::high_resolution_clock::now();
+		auto lex   = lexer.lexSource(&source);
+		auto end   = std::chrono::high_resolution_clock::now();
+		if (lex.getRoot().getSpan().length() != input.size())
+			return false;
+
+		seconds[literalSet] = std::chrono::duration<double>(end - begin).count();
+		nodes[literalSet]   = lex.getRoot().getChildren().size();
+	}
+
+	std::cout << fmt::format("LiteralSet: {} keywords, {} bytes in {:.3f} ms, or matcher: {:.3f} ms, {:.1f}x\n", keywords.size(), input.size(), seconds[1] * 1e3, seconds[0] * 1e3, seconds[0] / seconds[1]);
+	return nodes[0] == nodes[1];
+}
+
+static bool benchCharRun([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	auto input = makeInput(256 * 1024);
+	if (input.empty())
+		return false;
+
+	std::pair<const char*, std::string> rules[] { { "Identifier", "[A-Za-z_][A-Za-z0-9_]*" }, { "Space", "[ \t\r\n]+" }, { "Other", "[^A-Za-z_ \t\r\n]" } };
+
+	double      seconds[2] {};
+	std::size_t nodes[2] {};
+	for (bool lowered : { false, true })
+	{
+		Lexer lexer;
+		lexer.setMainRule("File");
+		lexer.registerRule(MatcherRule { "File", RangeMatcher(OrMatcher(Tuple { ReferenceMatcher("Identifier"), ReferenceMatcher("Space"), ReferenceMatcher("Other") })), false });
+		for (auto& [name, pattern] : rules)
+		{
+			auto run = Regex::Get(pattern)->getCharRun();
+			if (!run)
+				return false;
+
+			if (!lowered)
+				lexer.registerRule(MatcherRule { name, RegexMatcher(pattern) });
+			else if (run->m_Rest.none())
+				lexer.registerRule(MatcherRule { name, CharClassMatcher(run->m_First) });
+			else
+				lexer.registerRule(MatcherRule { name, CharRunMatcher(*run) });
+		}
+
+		StringSource source { input };
+
+		auto begin = std::chrono::high_resolution_clock::now();
+		auto lex   = lexer.lexSource(&source);
+		auto end   = std::chrono::high_resolution_clock::now();
+		if (lex.getRoot().getSpan().length() != input.size())
+			return false;
+
+		seconds[lowered] = std::chrono::duration<double>(end - begin).count();
+		nodes[lowered]   = lex.getRoot().getChildren().size();
+	}
+
+	std::cout << fmt::format("CharRun: {} bytes in {:.3f} ms, regex: {:.3f} ms, {:.1f}x\n", input.size(), seconds[1] * 1e3, seconds[0] * 1e3, seconds[0] / seconds[1]);
+	return nodes[0] == nodes[1];
+}
+
+static std::size_t countNodes(const CommonLexer::Node& node)
+{
+	std::size_t nodes = 1;
+	for (auto& child : node.getChildren())
+		nodes += countNodes(child);
+	return nodes;
+}
+
+static bool benchGrammarOptimizer([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	std::string cmakeInput, cppInput, grammarInput;
+	while (cmakeInput.size() < 16 * 1024)
+		cmakeInput += "message(\"hello ${name}\" [[raw]])\n  set( \"a\" \"b\\\"c\" )\n# comment\nfoo()\n";
+	while (cppInput.size() < 16 * 1024)
+		cppInput += "int main(int argc, char** argv)\n{\n\tauto value = argc * 2 + 1;\n\treturn value < 3 && argv[1] != nullptr;\n}\n";
+	while (grammarInput.size() < 16 * 1024)
+		grammarInput += readFile("../../CMakeInterpreter/Src/LexerLex.txt") + '\n';
+
+	std::pair<const char*, std::string> workloads[] {
+		{ "../../CMakeInterpreter/Src/Lex.txt", cmakeInput },
+		{ "../../CMakeInterpreter/Src/cpp20Lex.txt", cppInput },
+		{ "../../CMakeInterpreter/Src/LexerLex.txt", grammarInput }
+	};
+	for (auto& [grammarFile, input] : workloads)
+	{
+		LexerLexer   lexerLexer;
+		StringSource grammarSource(readFile(grammarFile));
+		auto         grammarLex = lexerLexer.lexSource(&grammarSource);
+
+		std::vector<Message> messages;
+		Grammar              grammar = lexerLexer.createGrammar(grammarLex, messages, { { "UnquotedLegacy", &CMakeLexer::Lexer::unquotedLegacyCallback } });
+		if (!grammar.hasRule(grammar.getMainRule()))
+		{
+			// The C++ grammar is only complete up to its tokens, so lex a token stream
+			GrammarNode tokens { .m_Op = EGrammarOp::Or, .m_Children = { { .m_Op = EGrammarOp::Reference, .m_Text = "Token" }, { .m_Op = EGrammarOp::Regex, .m_Text = "[ \t\n]+" } } };
+			grammar.addRule({ .m_Name = "Tokens", .m_Matcher = { .m_Op = EGrammarOp::Range, .m_Children = { std::move(tokens) } }, .m_CreateNode = false });
+			grammar.setMainRule("Tokens");
+		}
+
+		Grammar grammars[2] { grammar, grammar };
+		auto    stats = grammars[1].optimize();
+
+		double      seconds[2] {};
+		std::size_t steps[2] {}, nodes[2] {}, lengths[2] {};
+		for (bool optimized : { false, true })
+		{
+			Lexer lexer, countingLexer;
+			grammars[optimized].registerRules(lexer);
+			grammars[optimized].registerRules(countingLexer, &steps[optimized]);
+
+			StringSource source { input };
+
+			auto begin = std::chrono::high_resolution_clock::now();
+			auto lex   = lexer.lexSource(&source);
+			auto end   = std::chrono::high_resolution_clock::now();
+			countingLexer.lexSource(&source);
+
+			// A single lex takes milliseconds, so the fastest of several runs is compared instead of whatever the first one hit
+			seconds[optimized] = std::chrono::duration<double>(end - begin).count();
+			for (std::size_t run = 1; run < 8; ++run)
+			{
+				auto runBegin      = std::chrono::high_resolution_clock::now();
+				auto runLex        = lexer.lexSource(&source);
+				auto runEnd        = std::chrono::high_resolution_clock::now();
+				seconds[optimized] = std::min(seconds[optimized], std::chrono::duration<double>(runEnd - runBegin).count());
+			}
+
+			nodes[optimized]   = countNodes(lex.getRoot());
+			lengths[optimized] = lex.getRoot().getSpan().length();
+		}
+
+		std::cout << fmt::format("GrammarOptimizer {}: {} -> {} rules, {} -> {} matchers, {} inlined, {} flattened, {} merged, {} factored, {} removed in {:.3f} ms\n", grammarFile, stats.m_Before.m_Rules, stats.m_After.m_Rules, stats.m_Before.m_Matchers, stats.m_After.m_Matchers, stats.m_Inlined, stats.m_Flattened, stats.m_Merged, stats.m_Factored, stats.m_Removed, stats.m_Seconds * 1e3);
+		std::cout << fmt::format("GrammarOptimizer {}: {} of {} bytes, {} nodes, {} -> {} match steps, {:.3f} -> {:.3f} ms, {:.2f}x\n", grammarFile, lengths[1], input.size(), nodes[1], steps[0], steps[1], seconds[0] * 1e3, seconds[1] * 1e3, seconds[0] / seconds[1]);
+		if (nodes[0] != nodes[1] || lengths[0] != input.size() || lengths[1] != input.size())
+			return false;
+	}
+	return true;
+}
+
+static bool benchOrderedChoice([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	// The same tokens once with longest match alternatives and once with ordered choices and a cut after the keyword
+	std::string rules = "File?: Token*;\n"
+	                    "Statement: Keyword, {0} Identifier, ((\"=\", Number) {1} (\"(\", Identifier, \")\"));\n"
+	                    "Keyword: (\"let\" | \"var\" | \"call\") ~'[A-Za-z0-9_]';\n"
+	                    "Identifier: '[A-Za-z_][A-Za-z0-9_]*';\n"
+	                    "Number: '[0-9]+';\n"
+	                    "Space?: '[ \\n]+';\n"
+	                    "Other: '[=();]';\n"
+	                    "Token?: Statement {1} Identifier {1} Number {1} Space {1} Other;";
+	std::string input;
+	while (input.size() < 64 * 1024)
+		input += "let x = 1\ncall f(y)\nvalue = 42\nlet (z)\n";
+
+	double      seconds[2] {};
+	std::size_t steps[2] {}, nodes[2] {};
+	for (bool ordered : { false, true })
+	{
+		LexerLexer   lexerLexer;
+		StringSource grammarSource("!MainRule = File;\n" + fmt::format(fmt::runtime(rules), ordered ? "^" : "", ordered ? "/" : "|"));
+		auto         grammarLex = lexerLexer.lexSource(&grammarSource);
+
+		std::vector<Message> messages;
+		Grammar              grammar = lexerLexer.createGrammar(grammarLex, messages);
+		if (!messages.empty())
+			return false;
+
+		Lexer lexer, countingLexer;
+		grammar.registerRules(lexer);
+		grammar.registerRules(countingLexer, &steps[ordered]);
+
+		StringSource source { input };
+
+		auto begin = std::chrono::high_resolution_clock::now();
+		auto lex   = lexer.lexSource(&source);
+		auto end   = std::chrono::high_resolution_clock::now();
+		countingLexer.lexSource(&source);
+
+		seconds[ordered] = std::chrono::duration<double>(end - begin).count();
+		nodes[ordered]   = countNodes(lex.getRoot());
+		if (lex.getRoot().getSpan().length() != input.size())
+			return false;
+	}
+
+	std::cout << fmt::format("OrderedChoice: {} nodes, {} -> {} match steps, {:.3f} -> {:.3f} ms, {:.2f}x\n", nodes[1], steps[0], steps[1], seconds[0] * 1e3, seconds[1] * 1e3, seconds[0] / seconds[1]);
+	return nodes[0] == nodes[1];
+}
+
+static bool benchRuleIDs([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	std::string input;
+	while (input.size() < 16 * 1024)
+		input += readFile("../../CMakeInterpreter/Src/LexerLex.txt") + '\n';
+
+	LexerLexer   lexerLexer;
+	StringSource source { input };
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	auto lex   = lexerLexer.lexSource(&source);
+	auto end   = std::chrono::high_resolution_clock::now();
+
+	// Nodes only keep the ID, the names are resolved through the lexer
+	std::size_t nodes = countNodes(lex.getRoot());
+	std::cout << fmt::format("RuleIDs: {} nodes of {} bytes, {:.1f} KiB of nodes, {} rule names, {:.3f} ms\n", nodes, sizeof(Node), static_cast<double>(nodes * sizeof(Node)) / 1024.0, lexerLexer.getRuleNameCount(), std::chrono::duration<double>(end - begin).count() * 1e3);
+
+	std::vector<std::string> names;
+	for (RuleID id = 0; id < lexerLexer.getRuleNameCount(); ++id)
+		names.push_back(lexerLexer.getRuleName(id));
+
+	std::size_t found = 0;
+	begin             = std::chrono::high_resolution_clock::now();
+	for (std::size_t i = 0; i < 1'000'000; ++i)
+		found += lexerLexer.getRule(names[i % names.size()]) != nullptr;
+	end = std::chrono::high_resolution_clock::now();
+	std::cout << fmt::format("RuleIDs: {} rule lookups by name in {:.3f} ms\n", 1'000'000, std::chrono::duration<double>(end - begin).count() * 1e3);
+	return lex.getRoot().getSpan().length() == input.size() && found > 0;
+}
+
+static bool benchLexSources([[maybe_unused]] Tester& tester)
+{
+	const CMakeLexer::Lexer lexer;
+
+	std::string input = readFile("LexInput.cmake");
+	if (input.empty())
+		return false;
+
+	std::vector<std::string> inputs;
+	for (std::size_t i = 0; i < 64; ++i)
+	{
+		std::string file;
+		while (file.size() < 64 * 1024)
+			file += input;
+		inputs.push_back(std::move(file));
+	}
+
+	std::vector<CommonLexer::StringSource> sources;
+	sources.reserve(inputs.size());
+	std::vector<CommonLexer::ISource*> batch;
+	for (auto& file : inputs)
+		batch.push_back(&sources.emplace_back(file));
+
+	std::size_t bytes = inputs.size() * inputs.front().size();
+	bool        full  = true;
+	for (std::size_t jobs : { 1, 0 })
+	{
+		auto begin = std::chrono::high_resolution_clock::now();
+		auto lexes = lexer.lexSources(batch, jobs);
+		auto end   = std::chrono::high_resolution_clock::now();
+
+		double seconds = std::chrono::duration<double>(end - begin).count();
+		std::cout << fmt::format("LexSources: {} files, {} bytes on {} jobs in {:.3f} ms, {:.2f} MB/s\n", batch.size(), bytes, jobs == 0 ? std::thread::hardware_concurrency() : jobs, seconds * 1e3, (bytes / 1e6) / seconds);
+
+		for (std::size_t i = 0; i < lexes.size(); ++i)
+			full = full && lexes[i].getRoot().getSpan().length() == inputs[i].size();
+	}
+	return full;
+}
+
+static bool benchRelex([[maybe_unused]] Tester& tester)
+{
+	const CMakeLexer::Lexer lexer;
+
+	std::string input = readFile("LexInput.cmake");
+	if (input.empty())
+		return false;
+
+	std::string text;
+	while (text.size() < 1024 * 1024)
+		text += input;
+	CommonLexer::EditableSource source(text);
+
+	std::vector<CommonLexer::SourceEdit> edits;
+	source.setChangeCallback([&edits](const CommonLexer::SourceEdit& edit) { edits.push_back(edit); });
+
+	auto lex = lexer.lexSource(&source);
+
+	// One command in the middle of the file gets another argument
+	std::size_t index = text.find("no_arguments()", text.size() / 2) + 13;
+	source.insert(index, "arg");
+
+	auto begin   = std::chrono::high_resolution_clock::now();
+	auto relexed = lexer.relexSource(std::move(lex), edits);
+	auto middle  = std::chrono::high_resolution_clock::now();
+	auto full    = lexer.lexSource(&source);
+	auto end     = std::chrono::high_resolution_clock::now();
+
+	std::cout << fmt::format("Relex: 3 bytes inserted into {} bytes, relex {:.3f} ms, full lex {:.3f} ms\n", source.getSize(), std::chrono::duration<double>(middle - begin).count() * 1e3, std::chrono::duration<double>(end - middle).count() * 1e3);
+	return relexed.getRoot().getSpan().length() == source.getSize() && relexed.getRoot().getChildren().size() == full.getRoot().getChildren().size();
+}
+
+static std::size_t nodeTreeBytes(const CommonLexer::Node& node, std::size_t& allocations)
+{
+	std::size_t bytes = node.getChildren().capacity() * sizeof(CommonLexer::Node);
+	allocations += node.getChildren().capacity() > 0;
+	for (auto& child : node.getChildren())
+		bytes += nodeTreeBytes(child, allocations);
+	return bytes;
+}
+
+static std::size_t walkNodes(const CommonLexer::Node& node)
+{
+	std::size_t sum = node.getRuleID() + node.getSpan().length();
+	for (auto& child : node.getChildren())
+		sum += walkNodes(child);
+	return sum;
+}
+
+static std::size_t walkNodeRefs(CommonLexer::NodeRef node)
+{
+	std::size_t sum = node.getRuleID() + node.getSpan().length();
+	for (auto child : node.getChildren())
+		sum += walkNodeRefs(child);
+	return sum;
+}
+
+static bool benchNodeArena([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	std::string input;
+	while (input.size() < 1024 * 1024)
+		input += "int main(int argc, char** argv)\n{\n\tauto value = argc * 2 + 1;\n\treturn value < 3 && argv[1] != nullptr;\n}\n";
+
+	LexerLexer   lexerLexer;
+	StringSource grammarSource(readFile("../../CMakeInterpreter/Src/cpp20Lex.txt"));
+	auto         grammarLex = lexerLexer.lexSource(&grammarSource);
+
+	// The C++ grammar is only complete up to its tokens, so lex a token stream
+	std::vector<Message> messages;
+	Grammar              grammar = lexerLexer.createGrammar(grammarLex, messages);
+	GrammarNode          tokens { .m_Op = EGrammarOp::Or, .m_Children = { { .m_Op = EGrammarOp::Reference, .m_Text = "Token" }, { .m_Op = EGrammarOp::Regex, .m_Text = "[ \t\n]+" } } };
+	grammar.addRule({ .m_Name = "Tokens", .m_Matcher = { .m_Op = EGrammarOp::Range, .m_Children = { std::move(tokens) } }, .m_CreateNode = false });
+	grammar.setMainRule("Tokens");
+
+	Lexer lexer;
+	grammar.registerRules(lexer);
+	StringSource source { input };
+	auto         lex = lexer.lexSource(&source);
+
+	auto      begin = std::chrono::high_resolution_clock::now();
+	NodeArena arena(lex.getRoot());
+	auto      end = std::chrono::high_resolution_clock::now();
+
+	std::size_t allocations = 0;
+	std::size_t nodeBytes   = sizeof(Node) + nodeTreeBytes(lex.getRoot(), allocations);
+	std::cout << fmt::format("NodeArena: {} nodes, Node tree {:.1f} KiB in {} allocations, arena {:.1f} KiB in 5 allocations, flattened in {:.3f} ms\n", arena.size(), static_cast<double>(nodeBytes) / 1024.0, allocations, static_cast<double>(arena.getMemoryUsage()) / 1024.0, std::chrono::duration<double>(end - begin).count() * 1e3);
+
+	std::size_t walks = 10;
+
+	std::size_t sums[3] {};
+	double      seconds[3] {};
+	begin = std::chrono::high_resolution_clock::now();
+	for (std::size_t i = 0; i < walks; ++i)
+		sums[0] += walkNodes(lex.getRoot());
+	end        = std::chrono::high_resolution_clock::now();
+	seconds[0] = std::chrono::duration<double>(end - begin).count();
+
+	begin = std::chrono::high_resolution_clock::now();
+	for (std::size_t i = 0; i < walks; ++i)
+		sums[1] += walkNodeRefs(arena.getRoot());
+	end        = std::chrono::high_resolution_clock::now();
+	seconds[1] = std::chrono::duration<double>(end - begin).count();
+
+	// Visiting every node in any order doesn't need the links at all
+	begin = std::chrono::high_resolution_clock::now();
+	for (std::size_t i = 0; i < walks; ++i)
+		for (NodeIndex index = 0; index < arena.size(); ++index)
+			sums[2] += arena.getRuleID(index) + arena.getSpan(index).length();
+	end        = std::chrono::high_resolution_clock::now();
+	seconds[2] = std::chrono::duration<double>(end - begin).count();
+
+	std::cout << fmt::format("NodeArena: {} walks, Node tree {:.3f} ms, NodeRef tree {:.3f} ms, arena in order {:.3f} ms\n", walks, seconds[0] * 1e3, seconds[1] * 1e3, seconds[2] * 1e3);
+	return lex.getRoot().getSpan().length() == input.size() && arena.size() == countNodes(lex.getRoot()) && sums[0] == sums[1] && sums[1] == sums[2];
+}
+
+static bool benchLexCache([[maybe_unused]] Tester& tester)
+{
+	const CMakeLexer::Lexer lexer;
+
+	std::string input = readFile("LexInput.cmake");
+	if (input.empty())
+		return false;
+
+	std::string large;
+	while (large.size() < 1024 * 1024)
+		large += input;
+
+	std::error_code error;
+	auto            directory = std::filesystem::temp_directory_path() / "MMakeLexCacheBenchmark";
+	std::filesystem::remove_all(directory, error);
+	CommonLexer::LexCache cache(directory);
+
+	bool success = true;
+	for (auto& text : { input, large })
+	{
+		CommonLexer::StringSource source(text);
+
+		auto begin  = std::chrono::high_resolution_clock::now();
+		auto lex    = lexer.lexSource(&source);
+		auto middle = std::chrono::high_resolution_clock::now();
+		cache.store(lex);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		// Loading is what every later run with the file unchanged pays
+		std::chrono::duration<double> loadTime {};
+		std::size_t                   loads = 20;
+		for (std::size_t i = 0; i < loads; ++i)
+		{
+			auto loaded = cache.load(lexer, &source);
+			if (!loaded || loaded->getRoot().getChildren().size() != lex.getRoot().getChildren().size())
+				success = false;
+			else
+				loadTime += loaded->getDuration();
+		}
+
+		auto fileSize = std::filesystem::file_size(cache.getPath(CommonLexer::LexCache::hashSource(&source), lexer.getGrammarHash()), error);
+		std::cout << fmt::format("LexCache: {} bytes, {} nodes, lex {:.3f} ms, store {:.3f} ms, load {:.1f} us, {} byte file\n", text.size(), countNodes(lex.getRoot()), std::chrono::duration<double>(middle - begin).count() * 1e3, std::chrono::duration<double>(end - middle).count() * 1e3, loadTime.count() / static_cast<double>(loads) * 1e6, fileSize);
+	}
+	std::filesystem::remove_all(directory, error);
+	return success;
+}
+
+struct SourceBenchmarksRegister
+{
+	SourceBenchmarksRegister()
+	{
+		auto& tester = Tester::Get();
+		tester.addBenchmark("Benchmarks", "ContiguousSource", &benchContiguousSource);
+		tester.addBenchmark("Benchmarks", "LineTable", &benchLineTable);
+		tester.addBenchmark("Benchmarks", "UTF8", &benchUTF8);
+		tester.addBenchmark("Benchmarks", "Regex", &benchRegex);
+		tester.addBenchmark("Benchmarks", "Memoize", &benchMemoize);
+		tester.addBenchmark("Benchmarks", "LiteralSet", &benchLiteralSet);
+		tester.addBenchmark("Benchmarks", "CharRun", &benchCharRun);
+		tester.addBenchmark("Benchmarks", "GrammarOptimizer", &benchGrammarOptimizer);
+		tester.addBenchmark("Benchmarks", "OrderedChoice", &benchOrderedChoice);
+		tester.addBenchmark("Benchmarks", "RuleIDs", &benchRuleIDs);
+		tester.addBenchmark("Benchmarks", "LexSources", &benchLexSources);
+		tester.addBenchmark("Benchmarks", "Relex", &benchRelex);
+		tester.addBenchmark("Benchmarks", "NodeArena", &benchNodeArena);
+		tester.addBenchmark("Benchmarks", "LexCache", &benchLexCache);
+	}
+};
+[[maybe_unused]] SourceBenchmarksRegister sourceBenchmarksRegister;
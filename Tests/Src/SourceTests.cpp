@@ -0,0 +1,455 @@
+#include "FileIO.h"
+#include "Test.h"
+
+#include <CommonLexer/EditableSource.h>
+#include <CommonLexer/Lexer.h>
+#include <CommonLexer/Matchers.h>
+#include <CommonLexer/Source.h>
+#include <CommonLexer/SourceManager.h>
+#include <CommonLexer/UTF8.h>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+
+static bool testFileSource([[maybe_unused]] Tester& tester)
+{
+	CommonLexer::FileSource   fileSource("LexInput.cmake");
+	CommonLexer::StringSource stringSource(readFile("LexInput.cmake"));
+	if (!fileSource.isOpen())
+		return false;
+
+	if (fileSource.getSize() != stringSource.getSize())
+		return false;
+	if (fileSource.data() != stringSource.data())
+		return false;
+	if (fileSource.getNumLines() != stringSource.getNumLines())
+		return false;
+
+	for (std::size_t i = 0; i < fileSource.getSize(); ++i)
+	{
+		if (fileSource.getLineNumberFromIndex(i) != stringSource.getLineNumberFromIndex(i))
+			return false;
+		if (fileSource.getColumnNumberFromIndex(i) != stringSource.getColumnNumberFromIndex(i))
+			return false;
+	}
+
+	for (std::size_t line = 1; line <= fileSource.getNumLines(); ++line)
+		if (fileSource.getLine(line) != stringSource.getLine(line))
+			return false;
+	return true;
+}
+
+static bool testMissingFileSource([[maybe_unused]] Tester& tester)
+{
+	CommonLexer::FileSource source("DoesNotExist.cmake");
+	return !source.isOpen() && source.getSize() == 0 && !source.data();
+}
+
+// A copied, moved or reassigned source must not read through the block it borrowed before
+static bool testSourceCopies([[maybe_unused]] Tester& tester)
+{
+	CommonLexer::StringSource a("abcde");
+	CommonLexer::StringSource b("xyz");
+	if (a.at(1) != 'b' || b.at(1) != 'y')
+		return false;
+	b = a;
+	a = CommonLexer::StringSource("zzzzz");
+	if (b.at(1) != 'b' || a.at(1) != 'z')
+		return false;
+
+	std::string             lexInput       = readFile("LexInput.cmake");
+	std::string             interpretInput = readFile("InterpretInput.cmake");
+	CommonLexer::FileSource file("LexInput.cmake");
+	if (file.at(0) != lexInput[0])
+		return false;
+	file = CommonLexer::FileSource("InterpretInput.cmake");
+	if (file.at(1) != interpretInput[1])
+		return false;
+
+	CommonLexer::FileSource moved(std::move(file));
+	return moved.at(2) == interpretInput[2] && file.getSize() == 0 && file.at(2) == '\0';
+}
+
+static bool testChunkedSource([[maybe_unused]] Tester& tester)
+{
+	CommonLexer::ChunkedSource chunkedSource("LexInput.cmake", 32, 4);
+	CommonLexer::StringSource  stringSource(readFile("LexInput.cmake"));
+	if (!chunkedSource.isOpen())
+		return false;
+
+	if (chunkedSource.getSize() != stringSource.getSize())
+		return false;
+	if (chunkedSource.getSpan(5, 100) != stringSource.getSpan(5, 100))
+		return false;
+	if (chunkedSource.getNumLines() != stringSource.getNumLines())
+		return false;
+
+	for (std::size_t i = 0; i < chunkedSource.getSize(); ++i)
+	{
+		if (chunkedSource.getLineNumberFromIndex(i) != stringSource.getLineNumberFromIndex(i))
+			return false;
+		if (chunkedSource.getColumnNumberFromIndex(i) != stringSource.getColumnNumberFromIndex(i))
+			return false;
+	}
+
+	for (std::size_t line = 1; line <= chunkedSource.getNumLines(); ++line)
+		if (chunkedSource.getLine(line) != stringSource.getLine(line))
+			return false;
+	return true;
+}
+
+static bool testChunkedSourceCommit([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	Lexer lexer;
+	lexer.setMainRule("File");
+	lexer.registerRule(MatcherRule { "File", RangeMatcher(ReferenceMatcher("Token")), false });
+	lexer.registerRule(MatcherRule { "Token", OrMatcher(Tuple { RegexMatcher("\\s+"), RegexMatcher("#.*"), RegexMatcher("[()]"), RegexMatcher("[^\\s()#]+") }) });
+
+	ChunkedSource chunkedSource("LexInput.cmake", 32, 12);
+	StringSource  stringSource(readFile("LexInput.cmake"));
+	if (chunkedSource.getSize() <= 32 * 12)
+		return false;
+
+	auto chunkedLex = lexer.lexSource(&chunkedSource);
+	auto stringLex  = lexer.lexSource(&stringSource);
+	if (!chunkedLex.getMessages().empty() || chunkedLex.getRoot().getSpan().length() != stringSource.getSize())
+		return false;
+
+	auto& chunkedTokens = chunkedLex.getRoot().getChildren();
+	auto& stringTokens  = stringLex.getRoot().getChildren();
+	if (chunkedTokens.size() != stringTokens.size())
+		return false;
+	for (std::size_t i = 0; i < chunkedTokens.size(); ++i)
+		if (chunkedTokens[i].getSpan().m_Begin.m_Index != stringTokens[i].getSpan().m_Begin.m_Index || chunkedTokens[i].getSpan().m_End.m_Index != stringTokens[i].getSpan().m_End.m_Index)
+			return false;
+
+	// Commits after every token must have kept the ring from growing
+	if (chunkedSource.getAllocatedBlocks() != 12)
+		return false;
+
+	// A main rule that can go back over its elements commits none, so the second alternative still reads from the start
+	Lexer choice;
+	choice.setMainRule("File");
+	choice.registerRule(MatcherRule { "File", OrMatcher(Tuple { CombinationMatcher(Tuple { RangeMatcher(ReferenceMatcher("Token")), TextMatcher("!") }), RangeMatcher(ReferenceMatcher("Token")) }), false });
+	choice.registerRule(MatcherRule { "Token", OrMatcher(Tuple { RegexMatcher("\\s+"), RegexMatcher("#.*"), RegexMatcher("[()]"), RegexMatcher("[^\\s()#]+") }) });
+
+	ChunkedSource choiceSource("LexInput.cmake", 32, 12);
+	auto          choiceLex = choice.lexSource(&choiceSource);
+	if (choiceLex.getRoot().getSpan().length() != stringSource.getSize() || choiceLex.getRoot().getChildren().size() != stringTokens.size() || !choiceLex.getRestartPoints().empty() || choiceSource.getRecycledReadIndex() != ~0ULL)
+		return false;
+
+	// Reading behind a commit is noted instead of passing for data
+	choiceSource.commit({ 32 * 4 });
+	return choiceSource.at(0) == '\0' && choiceSource.getRecycledReadIndex() == 0;
+}
+
+static bool compareSources(CommonLexer::ISource& source, CommonLexer::StringSource& expected)
+{
+	if (source.getSize() != expected.getSize() || source.getNumLines() != expected.getNumLines())
+		return false;
+	if (source.getSpan(0, source.getSize()) != expected.getSpan(0, expected.getSize()))
+		return false;
+
+	for (std::size_t i = 0; i < source.getSize(); ++i)
+	{
+		if (source.getLineNumberFromIndex(i) != expected.getLineNumberFromIndex(i))
+			return false;
+		if (source.getColumnNumberFromIndex(i) != expected.getColumnNumberFromIndex(i))
+			return false;
+	}
+
+	for (std::size_t line = 1; line <= source.getNumLines(); ++line)
+		if (source.getLine(line) != expected.getLine(line))
+			return false;
+	return true;
+}
+
+static bool testEditableSource([[maybe_unused]] Tester& tester)
+{
+	std::string                 str = readFile("LexInput.cmake");
+	CommonLexer::EditableSource source(str);
+
+	std::vector<CommonLexer::SourceEdit> edits;
+	source.setChangeCallback([&edits](const CommonLexer::SourceEdit& edit) { edits.push_back(edit); });
+
+	std::uint32_t seed = 1234;
+	auto          next = [&seed]() {
+		seed = seed * 1664525U + 1013904223U;
+		return seed >> 8;
+	};
+
+	for (std::size_t i = 0; i < 200; ++i)
+	{
+		std::size_t index = str.empty() ? 0 : next() % (str.size() + 1);
+		if (next() % 3 == 0)
+		{
+			std::size_t length = next() % 16;
+			source.erase(index, length);
+			if (index < str.size())
+				str.erase(index, length);
+		}
+		else
+		{
+			std::string text = next() % 2 ? "set(A b)\n" : "x";
+			source.insert(index, text);
+			str.insert(index, text);
+		}
+
+		if (i % 20 == 0)
+		{
+			CommonLexer::StringSource expected(str);
+			if (!compareSources(source, expected))
+				return false;
+		}
+	}
+
+	CommonLexer::StringSource expected(str);
+	if (!compareSources(source, expected) || source.data())
+		return false;
+
+	// Blocks are the pieces themselves, nothing gets flattened
+	std::size_t blocks = 0;
+	for (std::size_t index = 0; index < str.size(); ++blocks)
+	{
+		auto block = source.getBlock(index);
+		if (block.m_Begin != index || block.m_Size == 0 || std::string_view { block.m_Data, block.m_Size } != std::string_view { str }.substr(index, block.m_Size))
+			return false;
+		index += block.m_Size;
+	}
+	if (blocks != source.getNumPieces() || source.getBlock(str.size()).m_Size != 0)
+		return false;
+
+	source.insert(3, "abc");
+	auto& edit = edits.back();
+	return edit.m_Begin.m_Index == 3 && edit.m_ErasedLength == 0 && edit.m_InsertedLength == 3;
+}
+
+static bool testSourceManager([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	SourceManager manager;
+	FileID        lexInput       = manager.addFile("LexInput.cmake");
+	FileID        interpretInput = manager.addFile("InterpretInput.cmake");
+	if (lexInput == s_InvalidFileID || interpretInput == s_InvalidFileID || manager.addFile("DoesNotExist.cmake") != s_InvalidFileID)
+		return false;
+
+	StringSource lexInputSource(readFile("LexInput.cmake"));
+	StringSource interpretInputSource(readFile("InterpretInput.cmake"));
+
+	auto lexInputSpan       = manager.getFileSpan(lexInput);
+	auto interpretInputSpan = manager.getFileSpan(interpretInput);
+	if (lexInputSpan.length() != lexInputSource.getSize() || interpretInputSpan.length() != interpretInputSource.getSize())
+		return false;
+	if (lexInputSpan.m_End.m_Index >= interpretInputSpan.m_Begin.m_Index)
+		return false;
+
+	for (std::size_t i = 0; i < interpretInputSource.getSize(); ++i)
+	{
+		SourcePoint point = manager.getPoint(interpretInput, i);
+		if (manager.getFileID(point) != interpretInput || manager.getLocalIndex(point) != i)
+			return false;
+		if (point.getLine(&manager) != interpretInputSource.getLineNumberFromIndex(i) || point.getColumn(&manager) != interpretInputSource.getColumnNumberFromIndex(i))
+			return false;
+	}
+
+	if (manager.getSpan(lexInputSpan) != lexInputSource.getSpan(0, lexInputSource.getSize()))
+		return false;
+	if (manager.getSpanView(interpretInputSpan) != interpretInputSource.data())
+		return false;
+
+	Lexer lexer;
+	lexer.setMainRule("File");
+	lexer.registerRule(MatcherRule { "File", RangeMatcher(ReferenceMatcher("Token")), false });
+	lexer.registerRule(MatcherRule { "Token", OrMatcher(Tuple { RegexMatcher("\\s+"), RegexMatcher("#.*"), RegexMatcher("[()]"), RegexMatcher("[^\\s()#]+") }) });
+
+	auto managerLex = lexer.lexSource(&manager, interpretInputSpan);
+	auto stringLex  = lexer.lexSource(&interpretInputSource);
+	if (!managerLex.getMessages().empty() || managerLex.getRoot().getSpan().m_End.m_Index != interpretInputSpan.m_End.m_Index)
+		return false;
+
+	auto& managerTokens = managerLex.getRoot().getChildren();
+	auto& stringTokens  = stringLex.getRoot().getChildren();
+	if (managerTokens.size() != stringTokens.size())
+		return false;
+	for (std::size_t i = 0; i < managerTokens.size(); ++i)
+		if (manager.getLocalIndex(managerTokens[i].getSpan().m_Begin) != stringTokens[i].getSpan().m_Begin.m_Index)
+			return false;
+	return true;
+}
+
+static bool testSourceManagerBlocks([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	std::string text = readFile("LexInput.cmake");
+
+	SourceManager manager;
+	auto          chunkedSource  = std::make_unique<ChunkedSource>("LexInput.cmake", 32, 12);
+	auto          editableSource = std::make_unique<EditableSource>(text);
+	auto          chunked        = chunkedSource.get();
+	auto          editable       = editableSource.get();
+	FileID        chunkedFile    = manager.addSource("Chunked", std::move(chunkedSource));
+	FileID        editableFile   = manager.addSource("Editable", std::move(editableSource));
+
+	// Lexing through the manager commits into the chunked source, the manager must not keep reading blocks it recycled
+	Lexer lexer;
+	lexer.setMainRule("File");
+	lexer.registerRule(MatcherRule { "File", RangeMatcher(ReferenceMatcher("Token")), false });
+	lexer.registerRule(MatcherRule { "Token", OrMatcher(Tuple { RegexMatcher("\\s+"), RegexMatcher("#.*"), RegexMatcher("[()]"), RegexMatcher("[^\\s()#]+") }) });
+
+	StringSource expected(text);
+	auto         managerLex  = lexer.lexSource(&manager, manager.getFileSpan(chunkedFile));
+	auto         expectedLex = lexer.lexSource(&expected);
+	if (managerLex.getRoot().getSpan().m_End.m_Index != manager.getFileSpan(chunkedFile).m_End.m_Index || managerLex.getRoot().getChildren().size() != expectedLex.getRoot().getChildren().size() || chunked->getAllocatedBlocks() != 12)
+		return false;
+
+	// An edit rebuilds the buffer the manager borrowed its block from
+	SourcePoint point = manager.getPoint(editableFile, 10);
+	if (manager.at(point.m_Index) != text[10])
+		return false;
+	editable->erase(10, 1);
+	editable->insert(10, "Z");
+	return manager.at(point.m_Index) == 'Z' && manager.at(point.m_Index + 1) == text[11];
+}
+
+static bool testSourceIterator([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	std::string   str = readFile("LexInput.cmake");
+	ChunkedSource chunkedSource("LexInput.cmake", 32, 4);
+	if (!chunkedSource.isOpen())
+		return false;
+
+	SourceSpan span { 0, chunkedSource.getSize() };
+	auto       begin = span.begin(&chunkedSource);
+	auto       end   = span.end(&chunkedSource);
+	if (end - begin != static_cast<std::ptrdiff_t>(str.size()) || std::distance(begin, end) != static_cast<std::ptrdiff_t>(str.size()))
+		return false;
+	if (!std::equal(begin, end, str.begin(), str.end()))
+		return false;
+
+	// Jumping around crosses block boundaries in both directions
+	for (std::size_t i = str.size(); i-- > 0;)
+		if (begin[static_cast<std::ptrdiff_t>(i)] != str[i] || *(end - static_cast<std::ptrdiff_t>(str.size() - i)) != str[i])
+			return false;
+
+	auto itr = std::find(begin, end, '(');
+	return static_cast<std::size_t>(itr - begin) == str.find('(') && *end == '\0';
+}
+
+// Straight from the definition in RFC 3629, used as the reference for the vectorized validator
+static std::size_t ReferenceValidateUTF8(std::string_view str)
+{
+	for (std::size_t i = 0; i < str.size();)
+	{
+		auto        c      = static_cast<std::uint8_t>(str[i]);
+		std::size_t length = c < 0x80 ? 1 : c >= 0xC2 && c < 0xE0 ? 2 : c >= 0xE0 && c < 0xF0 ? 3 : c >= 0xF0 && c < 0xF5 ? 4 : 0;
+		if (!length || i + length > str.size())
+			return i;
+
+		std::uint32_t codepoint = length == 1 ? c : c & (0x7F >> length);
+		for (std::size_t j = 1; j < length; ++j)
+		{
+			auto cont = static_cast<std::uint8_t>(str[i + j]);
+			if ((cont & 0xC0) != 0x80)
+				return i;
+			codepoint = (codepoint << 6) | (cont & 0x3F);
+		}
+		if ((length == 3 && codepoint < 0x800) || (length == 4 && codepoint < 0x10000) || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint < 0xE000))
+			return i;
+		i += length;
+	}
+	return str.size();
+}
+
+static bool testUTF8([[maybe_unused]] Tester& tester)
+{
+	using namespace CommonLexer;
+
+	std::uint32_t seed = 4321;
+	auto          next = [&seed]() {
+		seed = seed * 1664525U + 1013904223U;
+		return seed >> 8;
+	};
+
+	// Mostly valid text with the odd corrupted byte, long enough to cross the 32 byte blocks of the vectorized paths
+	const char* pieces[] = { "a", "set(A b)\n", "\xC3\xA9", "\xE2\x94\x9C", "\xF0\x9F\x98\x80", "\xED\x9F\xBF", "\xEF\xBF\xBD" };
+	const char* corrupt[] = { "\x80", "\xC0\xAF", "\xE0\x80\x80", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xF5", "\xE2\x94", "\xFF" };
+	for (std::size_t i = 0; i < 2000; ++i)
+	{
+		std::string str;
+		std::size_t count = next() % 64;
+		for (std::size_t j = 0; j < count; ++j)
+			str += pieces[next() % std::size(pieces)];
+		if (i % 2)
+			str.insert(next() % (str.size() + 1), corrupt[next() % std::size(corrupt)]);
+
+		if (UTF8::Validate(str) != ReferenceValidateUTF8(str))
+			return false;
+
+		// Chunked appends have to agree with validating everything at once, sequences split between chunks included
+		CodepointTable table;
+		for (std::size_t offset = 0; offset < str.size();)
+		{
+			std::size_t length = std::min<std::size_t>(1 + next() % 40, str.size() - offset);
+			table.append(std::string_view { str }.substr(offset, length));
+			offset += length;
+		}
+		std::size_t expected = ReferenceValidateUTF8(str);
+		if (table.getInvalidIndex() != (expected == str.size() ? ~0ULL : expected))
+			return false;
+
+		std::size_t codepoints = 0;
+		for (std::size_t j = 0; j <= str.size(); ++j)
+		{
+			if (table.getCodepointIndex(j) != codepoints)
+				return false;
+			if (j < str.size() && (static_cast<std::uint8_t>(str[j]) & 0xC0) != 0x80)
+				++codepoints;
+		}
+		if (UTF8::CountCodepoints(str) != codepoints)
+			return false;
+	}
+
+	std::string  str = "# \xE2\x94\x9C\xE2\x94\x80 \xC3\xA9t\xC3\xA9\nset(\xF0\x9F\x98\x80 x)\n";
+	StringSource stringSource(str);
+	if (!stringSource.isValidUTF8() || stringSource.getColumnNumberFromIndex(str.find('t')) != 7 || stringSource.getColumnNumberFromIndex(str.find('x')) != 7)
+		return false;
+	if (stringSource.getCodepointCount(stringSource.getLineSpan({ 0 })) != 8)
+		return false;
+
+	EditableSource editableSource(str);
+	editableSource.insert(2, "\xC3\xA9");
+	editableSource.erase(0, 1);
+	str.insert(2, "\xC3\xA9");
+	str.erase(0, 1);
+	StringSource expected(str);
+	for (std::size_t i = 0; i <= str.size(); ++i)
+		if (editableSource.getColumnNumberFromIndex(i) != expected.getColumnNumberFromIndex(i))
+			return false;
+	return editableSource.isValidUTF8() && !StringSource("a\xC3(").isValidUTF8() && StringSource("a\xC3(").getInvalidUTF8Index() == 1;
+}
+
+struct SourceTestsRegister
+{
+	SourceTestsRegister()
+	{
+		auto& tester = Tester::Get();
+		tester.addTest("CommonLexer", "FileSource", &testFileSource);
+		tester.addTest("CommonLexer", "MissingFileSource", &testMissingFileSource);
+		tester.addTest("CommonLexer", "SourceCopies", &testSourceCopies);
+		tester.addTest("CommonLexer", "ChunkedSource", &testChunkedSource);
+		tester.addTest("CommonLexer", "ChunkedSourceCommit", &testChunkedSourceCommit);
+		tester.addTest("CommonLexer", "EditableSource", &testEditableSource);
+		tester.addTest("CommonLexer", "SourceManager", &testSourceManager);
+		tester.addTest("CommonLexer", "SourceManagerBlocks", &testSourceManagerBlocks);
+		tester.addTest("CommonLexer", "SourceIterator", &testSourceIterator);
+		tester.addTest("CommonLexer", "UTF8", &testUTF8);
+	}
+};
+[[maybe_unused]] SourceTestsRegister sourceTestsRegister;
@@ -13,7 +13,27 @@ Tester& Tester::Get()
 
 void Tester::test()
 {
-	for (auto& tests : m_Tests)
+	run(m_Tests);
+}
+
+void Tester::benchmark()
+{
+	run(m_Benchmarks);
+}
+
+void Tester::addBoundedTest(const std::string& category, const std::string& name, TestCallback callback)
+{
+	add(m_Tests, category, name, callback);
+}
+
+void Tester::addBoundedBenchmark(const std::string& category, const std::string& name, TestCallback callback)
+{
+	add(m_Benchmarks, category, name, callback);
+}
+
+void Tester::run(Tests& categories)
+{
+	for (auto& tests : categories)
 	{
 		using namespace CommonCLI;
 		std::cout << Colors::Info << "=== " << tests.first << " ===\n";
@@ -51,10 +71,10 @@ void Tester::test()
 	}
 }
 
-void Tester::addBoundedTest(const std::string& category, const std::string& name, TestCallback callback)
+void Tester::add(Tests& tests, const std::string& category, const std::string& name, TestCallback callback)
 {
-	auto itr = m_Tests.find(category);
-	if (itr == m_Tests.end())
-		itr = m_Tests.insert({ category, {} }).first;
+	auto itr = tests.find(category);
+	if (itr == tests.end())
+		itr = tests.insert({ category, {} }).first;
 	itr->second.push_back({ name, callback });
 }
@@ -24,6 +24,8 @@ public:
 
 public:
 	void test();
+	// Benchmarks only run when asked for, they take long and mostly print their numbers
+	void benchmark();
 
 	template <class Func>
 	void addTest(const std::string& category, const std::string& name, Func&& callback)
@@ -37,8 +39,22 @@ public:
 		addBoundedTest(category, name, std::bind(std::forward<Func>(callback), obj, std::placeholders::_1));
 	}
 
+	template <class Func>
+	void addBenchmark(const std::string& category, const std::string& name, Func&& callback)
+	{
+		addBoundedBenchmark(category, name, std::bind(std::forward<Func>(callback), std::placeholders::_1));
+	}
+
 	void addBoundedTest(const std::string& category, const std::string& name, TestCallback callback);
+	void addBoundedBenchmark(const std::string& category, const std::string& name, TestCallback callback);
+
+private:
+	using Tests = std::unordered_map<std::string, std::vector<Test>>;
+
+	void run(Tests& tests);
+	void add(Tests& tests, const std::string& category, const std::string& name, TestCallback callback);
 
 private:
-	std::unordered_map<std::string, std::vector<Test>> m_Tests;
+	Tests m_Tests;
+	Tests m_Benchmarks;
 };